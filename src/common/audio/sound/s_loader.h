@@ -53,6 +53,12 @@ struct AudioQOutput {
 
 class AudioLoadThread : public ResourceLoader<AudioQInput, AudioQOutput> {
 public:
+	AudioLoadThread() {
+		mPriority = LOADER_PRIORITY_HIGH;	// Sounds are waiting to be played
+	}
+
+	~AudioLoadThread() override { stop(); }
+
 	std::atomic<int> currentSoundID;		// Used to externally determine if this sound is already being loaded
 
 	// Is this soundID already loading/loaded on this thread?
@@ -0,0 +1,200 @@
+/*
+** fs_tests.cpp
+** @Cockatrice - Console stress tests and benchmarks for the file system
+**
+*/
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "c_dispatch.h"
+#include "filesystem.h"
+#include "printf.h"
+#include "v_text.h"
+#include "i_time.h"
+#include "m_crc32.h"
+#include "tarray.h"
+#include "zstring.h"
+#include "basics.h"
+
+// @Cockatrice - Reads every lump of one archive from many threads at once and checks the data against a single threaded pass
+// Usage: fs_stress [file number] [threads] [passes]
+CCMD(fs_stress)
+{
+	int container = argv.argc() > 1 ? (int)strtol(argv[1], nullptr, 0) : -1;
+	int numThreads = argv.argc() > 2 ? clamp((int)strtol(argv[2], nullptr, 0), 1, 64) : max((int)std::thread::hardware_concurrency(), 2);
+	int passes = argv.argc() > 3 ? clamp((int)strtol(argv[3], nullptr, 0), 1, 100) : 4;
+
+	// Default to the largest archive, that's the one the loaders fight over
+	if (container < 0)
+	{
+		for (int i = 0; i < fileSystem.GetNumWads(); i++)
+		{
+			if (fileSystem.GetFileReader(i) != nullptr && (container < 0 || fileSystem.GetEntryCount(i) > fileSystem.GetEntryCount(container))) container = i;
+		}
+	}
+
+	if (container < 0 || container >= fileSystem.GetNumWads())
+	{
+		Printf("No such file\n");
+		return;
+	}
+
+	int first = fileSystem.GetFirstEntry(container);
+	int count = fileSystem.GetEntryCount(container);
+	if (count <= 0) return;
+
+	auto checkLump = [](int lump, int readertype, size_t &bytes) -> uint32_t
+	{
+		auto fr = fileSystem.OpenFileReader(lump, readertype, 0);
+		auto data = fr.Read(fileSystem.FileLength(lump));
+		bytes += data.size();
+		return CalcCRC32(data.bytes(), (unsigned)data.size());
+	};
+
+	TArray<uint32_t> expected(count, true);
+	size_t totalBytes = 0;
+	for (int i = 0; i < count; i++)
+	{
+		expected[i] = checkLump(first + i, FileSys::READER_NEW, totalBytes);
+	}
+
+	Printf("Reading %d lumps (%.2f MB) from %s on %d threads, %d passes\n", count, totalBytes / 1048576.0, fileSystem.GetResourceFileName(container), numThreads, passes);
+
+	std::atomic<int> errors{ 0 };
+	std::atomic<size_t> bytesRead{ 0 };
+	std::vector<std::thread> threads;
+	uint64_t start = I_nsTime();
+
+	for (int t = 0; t < numThreads; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			size_t bytes = 0;
+			for (int pass = 0; pass < passes; pass++)
+			{
+				for (int k = 0; k < count; k++)
+				{
+					// Every thread starts somewhere else and odd passes run backwards, so threads keep colliding on different lumps
+					int index = (k + t * count / numThreads) % count;
+					if (pass & 1) index = count - 1 - index;
+
+					try
+					{
+						if (checkLump(first + index, (k + t) & 1 ? FileSys::READER_SHARED : FileSys::READER_NEW, bytes) != expected[index]) errors++;
+					}
+					catch (const std::exception&)
+					{
+						errors++;
+					}
+				}
+			}
+			bytesRead += bytes;
+		});
+	}
+
+	for (auto& thread : threads) thread.join();
+
+	double ms = (I_nsTime() - start) / 1000000.0;
+	Printf("%.2fms, %.2f MB/s, %s%d errors\n", ms, bytesRead.load() / 1048576.0 / max(ms / 1000.0, 0.001), errors.load() ? TEXTCOLOR_RED : TEXTCOLOR_GREEN, errors.load());
+}
+
+// @Cockatrice - Inflates every compressed lump of one archive through the streaming decompressor and the whole buffer path and compares them
+// Usage: fs_inflatebench [file number] [threads]
+CCMD(fs_inflatebench)
+{
+	int container = argv.argc() > 1 ? (int)strtol(argv[1], nullptr, 0) : -1;
+	int numThreads = argv.argc() > 2 ? clamp((int)strtol(argv[2], nullptr, 0), 1, 64) : max((int)std::thread::hardware_concurrency(), 2);
+
+	if (container < 0)
+	{
+		for (int i = 0; i < fileSystem.GetNumWads(); i++)
+		{
+			if (fileSystem.GetFileReader(i) != nullptr && (container < 0 || fileSystem.GetEntryCount(i) > fileSystem.GetEntryCount(container))) container = i;
+		}
+	}
+
+	if (container < 0 || container >= fileSystem.GetNumWads())
+	{
+		Printf("No such file\n");
+		return;
+	}
+
+	// Only zip entries carry a CRC to check against
+	TArray<int> lumps;
+	size_t totalBytes = 0;
+	int first = fileSystem.GetFirstEntry(container);
+	for (int i = first; i < first + fileSystem.GetEntryCount(container); i++)
+	{
+		if ((fileSystem.GetFileFlags(i) & FileSys::RESFF_COMPRESSED) && fileSystem.GetFileCRC32(i) != 0)
+		{
+			lumps.Push(i);
+			totalBytes += fileSystem.FileLength(i);
+		}
+	}
+
+	if (lumps.Size() == 0)
+	{
+		Printf("%s has no compressed zip entries\n", fileSystem.GetResourceFileName(container));
+		return;
+	}
+
+	Printf("Inflating %u lumps (%.2f MB) from %s\n", lumps.Size(), totalBytes / 1048576.0, fileSystem.GetResourceFileName(container));
+
+	auto report = [&](const char *name, uint64_t start, int errors)
+	{
+		double ms = (I_nsTime() - start) / 1000000.0;
+		Printf("  %-12s %8.2fms %8.2f MB/s %s%d errors\n", name, ms, totalBytes / 1048576.0 / max(ms / 1000.0, 0.001), errors ? TEXTCOLOR_RED : TEXTCOLOR_GREEN, errors);
+	};
+
+	auto checkData = [](int lump, const FileSys::FileData &data)
+	{
+		return data.size() == (size_t)fileSystem.FileLength(lump) && CalcCRC32(data.bytes(), (unsigned)data.size()) == fileSystem.GetFileCRC32(lump);
+	};
+
+	int errors = 0;
+	uint64_t start = I_nsTime();
+	for (int lump : lumps)
+	{
+		// A plain reader without caching goes through the streaming decompressor
+		auto fr = fileSystem.OpenFileReader(lump, FileSys::READER_NEW, 0);
+		if (!checkData(lump, fr.Read(fileSystem.FileLength(lump)))) errors++;
+	}
+	report("streaming", start, errors);
+
+	errors = 0;
+	start = I_nsTime();
+	for (int lump : lumps)
+	{
+		if (!checkData(lump, fileSystem.ReadFile(lump))) errors++;
+	}
+	report("whole", start, errors);
+
+	// Separate lumps are independent, so the whole buffer path also spreads across threads like the background loaders do
+	std::atomic<int> next{ 0 }, threadErrors{ 0 };
+	std::vector<std::thread> threads;
+	start = I_nsTime();
+	for (int t = 0; t < numThreads; t++)
+	{
+		threads.emplace_back([&]()
+		{
+			for (int i = next++; i < (int)lumps.Size(); i = next++)
+			{
+				try
+				{
+					if (!checkData(lumps[i], fileSystem.ReadFile(lumps[i]))) threadErrors++;
+				}
+				catch (const std::exception&)
+				{
+					threadErrors++;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) thread.join();
+
+	FString name;
+	name.Format("whole x%d", numThreads);
+	report(name.GetChars(), start, threadErrors.load());
+}
@@ -766,6 +766,20 @@ const char *FSerializer::GetOutput(unsigned *len)
 //==========================================================================
 
 FCompressedBuffer FSerializer::GetCompressedOutput()
+{
+	auto buff = GetStoredOutput();
+	CompressStoredBuffer(buff);
+	return buff;
+}
+
+//==========================================================================
+//
+// @Cockatrice - The serialized text without compression, so that the
+// deflate can be done later by CompressStoredBuffer, on any thread.
+//
+//==========================================================================
+
+FCompressedBuffer FSerializer::GetStoredOutput()
 {
 	if (isReading()) return{ 0,0,0,0,0,nullptr };
 	FCompressedBuffer buff;
@@ -773,14 +787,30 @@ FCompressedBuffer FSerializer::GetCompressedOutput()
 	EndObject();
 	buff.filename = nullptr;
 	buff.mSize = (unsigned)w->mOutString.GetSize();
+	buff.mCompressedSize = buff.mSize;
 	buff.mCRC32 = crc32(0, (const Bytef*)w->mOutString.GetString(), buff.mSize);
+	buff.mMethod = METHOD_STORED;
+	buff.mBuffer = new char[buff.mSize + 1];
+	memcpy(buff.mBuffer, w->mOutString.GetString(), buff.mSize + 1);
+	return buff;
+}
+
+//==========================================================================
+//
+// Deflates a stored buffer in place. It is left alone if compression fails.
+//
+//==========================================================================
+
+bool CompressStoredBuffer(FCompressedBuffer &buff)
+{
+	if (buff.mMethod != METHOD_STORED || buff.mBuffer == nullptr) return false;
 
 	uint8_t *compressbuf = new uint8_t[buff.mSize+1];
 
 	z_stream stream;
 	int err;
 
-	stream.next_in = (Bytef *)w->mOutString.GetString();
+	stream.next_in = (Bytef *)buff.mBuffer;
 	stream.avail_in = (unsigned)buff.mSize;
 	stream.next_out = (Bytef*)compressbuf;
 	stream.avail_out = (unsigned)buff.mSize;
@@ -792,32 +822,32 @@ FCompressedBuffer FSerializer::GetCompressedOutput()
 	err = deflateInit2(&stream, 8, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
 	if (err != Z_OK)
 	{
-		goto error;
+		delete[] compressbuf;
+		return false;
 	}
 
 	err = deflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END) 
+	if (err != Z_STREAM_END)
 	{
 		deflateEnd(&stream);
-		goto error;
+		delete[] compressbuf;
+		return false;
 	}
-	buff.mCompressedSize = stream.total_out;
 
 	err = deflateEnd(&stream);
-	if (err == Z_OK)
+	if (err != Z_OK)
 	{
-		buff.mBuffer = new char[buff.mCompressedSize];
-		buff.mMethod = METHOD_DEFLATE;
-		memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
 		delete[] compressbuf;
-		return buff;
+		return false;
 	}
 
-error:
-	memcpy(compressbuf, w->mOutString.GetString(), buff.mSize + 1);
-	buff.mCompressedSize = buff.mSize;
-	buff.mMethod = METHOD_STORED;
-	return buff;
+	delete[] buff.mBuffer;
+	buff.mCompressedSize = stream.total_out;
+	buff.mBuffer = new char[buff.mCompressedSize];
+	buff.mMethod = METHOD_DEFLATE;
+	memcpy(buff.mBuffer, compressbuf, buff.mCompressedSize);
+	delete[] compressbuf;
+	return true;
 }
 
 //==========================================================================
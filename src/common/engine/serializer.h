@@ -99,6 +99,7 @@ public:
 	const char *GetKey();
 	const char *GetOutput(unsigned *len = nullptr);
 	FileSys::FCompressedBuffer GetCompressedOutput();
+	FileSys::FCompressedBuffer GetStoredOutput();	// @Cockatrice - uncompressed, see CompressStoredBuffer
 	// The sprite serializer is a special case because it is needed by the VM to handle its 'spriteid' type.
 	virtual FSerializer &Sprite(const char *key, int32_t &spritenum, int32_t *def);
 	// This is only needed by the type system.
@@ -227,6 +228,9 @@ public:
 	FString fullErrorMessage = "";
 };
 
+// @Cockatrice - Deflates a buffer returned by FSerializer::GetStoredOutput in place. Safe to call on any thread.
+bool CompressStoredBuffer(FileSys::FCompressedBuffer &buff);
+
 FSerializer& Serialize(FSerializer& arc, const char* key, char& value, char* defval);
 
 FSerializer &Serialize(FSerializer &arc, const char *key, bool &value, bool *defval);
@@ -36,6 +36,7 @@ enum EDecompressFlags
 };
 
 bool OpenDecompressor(FileReader& self, FileReader &parent, FileReader::Size length, int method, int flags = 0);	// creates a decompressor stream. 'seekable' uses a buffered version so that the Seek and Tell methods can be used.
+bool DecompressWhole(void* dest, size_t length, FileReader& parent, int method);	// @Cockatrice - one shot decode of everything left in 'parent' when the output size is known. Only deflate and zlib are supported.
 
 // This holds a compresed Zip entry with all needed info to decompress it.
 struct FCompressedBuffer
@@ -72,6 +72,7 @@ public:
 };
 
 class FileReader;
+class PositionalFile;
 
 // an opaque memory buffer to the file's content. Can either own the memory or just point to an external buffer.
 class FileData
@@ -253,6 +254,8 @@ public:
 
 	bool OpenFile(const char *filename, Size start = 0, Size length = -1, bool buffered = false);
 	bool OpenFilePart(FileReader &parent, Size start, Size length);
+	bool OpenMapped(const char *filename);	// @Cockatrice - memory map the whole file, GetBuffer() returns the mapping
+	bool OpenFilePart(const PositionalFile *file, Size start, Size length);	// @Cockatrice - thread safe view into a shared file handle
 	bool OpenMemory(const void *mem, Size length);	// read directly from the buffer
 	bool OpenMemoryArray(FileData& data);	// take the given array
 
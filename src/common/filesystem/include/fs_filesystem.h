@@ -46,6 +46,7 @@ public:
 	bool InitSingleFile(const char *filename, FileSystemMessageFunc Printf = nullptr);
 	bool InitMultipleFiles (std::vector<std::string>& filenames, LumpFilterInfo* filter = nullptr, FileSystemMessageFunc Printf = nullptr, bool allowduplicates = false, FILE* hashfile = nullptr);
 	void AddFile (const char *filename, FileReader *wadinfo, LumpFilterInfo* filter, FileSystemMessageFunc Printf, FILE* hashfile);
+	void PrintStartupStats(FileSystemMessageFunc Printf) const;
 	int CheckIfResourceFileLoaded (const char *name) noexcept;
 	void AddAdditionalFile(const char* filename, FileReader* wadinfo = NULL) {}
 
@@ -122,6 +123,8 @@ public:
 	static uint32_t LumpNameHash (const char *name);		// [RH] Create hash key from an 8-char name
 
 	ptrdiff_t FileLength (int lump) const;
+	size_t GetFileOffset (int lump) const;			// Position of the lump's entry inside its container
+	uint32_t GetFileCRC32 (int lump) const;			// CRC32 from the container's directory, 0 if the format doesn't store one
 	int GetFileFlags (int lump);					// Return the flags for this lump
 	const char* GetFileShortName(int lump) const;
 	const char *GetFileFullName (int lump, bool returnshort = true) const;	// [RH] Returns the lump's full name
@@ -182,9 +185,22 @@ protected:
 
 	StringPool* stringpool = nullptr;
 
+	// @Cockatrice - Timing of the last InitMultipleFiles, for -stat startup
+	struct FileOpenStat
+	{
+		std::string name;
+		double openMS;
+		int lumps;
+	};
+	std::vector<FileOpenStat> OpenStats;
+	double OpenMS = 0, MergeMS = 0, HashMS = 0;
+	int OpenThreads = 0;
+
 private:
 	void DeleteAll();
 	void MoveLumpsInFolder(const char *);
+	static FResourceFile* OpenContainer(const char* filename, FileReader* filer, FileReader& filereader, LumpFilterInfo* filter, FileSystemMessageFunc Printf);
+	void AddContainer(const char* filename, FResourceFile* resfile, FileReader& filereader, LumpFilterInfo* filter, FileSystemMessageFunc Printf, FILE* hashfile);
 
 };
 
@@ -6,6 +6,8 @@
 #include <limits.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 #include "fs_files.h"
 #include "fs_decompress.h"
 
@@ -108,6 +110,8 @@ struct FResourceEntry
 };
 
 void SetMainThread();
+void SetFileMapping(bool enable);
+bool UseFileMapping();
 
 class FResourceFile
 {
@@ -126,11 +130,13 @@ protected:
 	char Hash[48];
 	StringPool* stringpool;
 
-	// for archives that can contain directories
-	virtual void SetEntryAddress(uint32_t entry)
-	{
-		Entries[entry].Flags &= ~RESFF_NEEDFILESTART;
-	}
+	// @Cockatrice - Shared handle for positional reads, opened on first use
+	// Only for containers that were opened from FileName on disk, nested ones only have a lump name there.
+	std::atomic<PositionalFile*> SharedFile{ nullptr };
+	std::atomic<bool> SharedFileFailed{ false };
+	bool OnDisk = false;
+	std::mutex ReaderMutex;	// serializes seeking Reader for containers without a shared handle
+	const PositionalFile* GetSharedFile();
 	bool IsFileInFolder(const char* const resPath);
 	void CheckEmbedded(uint32_t entry, LumpFilterInfo* lfi);
 
@@ -154,6 +160,7 @@ public:
 	uint32_t GetFirstEntry() const { return FirstLump; }
 	void SetFirstLump(uint32_t f) { FirstLump = f; }
 	const char* GetHash() const { return Hash; }
+	void SetOnDisk() { OnDisk = true; }	// @Cockatrice - FileName is the path the container was read from
 
 	int EntryCount() const { return NumLumps; }
 	int FindEntry(const char* name);
@@ -166,9 +173,14 @@ public:
 	{
 		return (entry < NumLumps) ? Entries[entry].Position : 0;
 	}
+	uint32_t CRC32(uint32_t entry)
+	{
+		return (entry < NumLumps) ? Entries[entry].CRC32 : 0;
+	}
 
-	// @Cocaktrice - Used for moving the file reader past the header (mostly zips) from exterior thread
-	virtual void SkipHeader(FileReader& fr);
+	// @Cockatrice - Start of the entry's data. Thread safe, entries are never modified after the archive is opened
+	virtual size_t GetEntryDataPosition(uint32_t entry);
+	FileReader OpenEntryData(uint32_t entry, int readertype);	// @Cockatrice - raw (still compressed) entry data
 
 	// default is the safest reader type.
 	virtual FileReader GetEntryReader(uint32_t entry, int readertype = READER_NEW, int flags = READERFLAG_SEEKABLE);
@@ -36,12 +36,15 @@
 #include <time.h>
 #include <stdexcept>
 #include <cstdint>
+#include <atomic>
+#include <memory>
 #include "w_zip.h"
 #include "ancientzip.h"
 #include "resourcefile.h"
 #include "fs_findfile.h"
 #include "fs_swap.h"
 #include "fs_stringpool.h"
+#include "files_internal.h"
 
 namespace FileSys {
 	using namespace byteswap;
@@ -109,8 +112,11 @@ static uint32_t Zip_FindCentralDir(FileReader &fin, bool* zip64)
 
 class FZipFile : public FResourceFile
 {
-	void SetEntryAddress(uint32_t entry) override;
-	void SkipHeader(FileReader& fr) override;
+	size_t GetEntryDataPosition(uint32_t entry) override;
+	void ReadAt(void* buffer, size_t length, size_t position);
+
+	// @Cockatrice - Data start of each entry once its local header has been read, 0 if not known yet
+	std::unique_ptr<std::atomic<size_t>[]> DataStart;
 
 public:
 	FZipFile(const char* filename, FileReader& file, StringPool* sp);
@@ -320,6 +326,8 @@ bool FZipFile::Open(LumpFilterInfo* filter, FileSystemMessageFunc Printf)
 
 	GenerateHash();
 	PostProcessArchive(filter);
+
+	DataStart.reset(new std::atomic<size_t>[NumLumps]());
 	return true;
 }
 
@@ -342,9 +350,7 @@ FCompressedBuffer FZipFile::GetRawData(uint32_t entry)
 	{
 		auto& e = Entries[entry];
 		cbuf = { e.Length, e.CompressedSize, e.Method, e.CRC32, new char[e.CompressedSize] };
-		if (e.Flags & RESFF_NEEDFILESTART) SetEntryAddress(entry);
-		Reader.Seek(e.Position, FileReader::SeekSet);
-		Reader.Read(cbuf.mBuffer, e.CompressedSize);
+		ReadAt(cbuf.mBuffer, e.CompressedSize, GetEntryDataPosition(entry));
 	}
 	
 	return cbuf;
@@ -352,41 +358,52 @@ FCompressedBuffer FZipFile::GetRawData(uint32_t entry)
 
 //==========================================================================
 //
-// SetLumpAddress
+// @Cockatrice - Reads raw bytes from the archive without touching a shared file position
 //
 //==========================================================================
 
-void FZipFile::SetEntryAddress(uint32_t entry)
+void FZipFile::ReadAt(void* buffer, size_t length, size_t position)
 {
-	// This file is inside a zip and has not been opened before.
-	// Position points to the start of the local file header, which we must
-	// read and skip so that we can get to the actual file data.
-	FZipLocalFileHeader localHeader;
-	int skiplen;
-
-	Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
-	Reader.Read(&localHeader, sizeof(localHeader));
-	skiplen = LittleShort(localHeader.NameLength) + LittleShort(localHeader.ExtraLength);
-	Entries[entry].Position += sizeof(localHeader) + skiplen;
-	Entries[entry].Flags &= ~RESFF_NEEDFILESTART;
+	if (auto buf = Reader.GetBuffer())
+	{
+		memcpy(buffer, buf + position, length);
+	}
+	else if (auto shared = GetSharedFile())
+	{
+		shared->ReadAt(buffer, length, position);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(ReaderMutex);
+		Reader.Seek(position, FileReader::SeekSet);
+		Reader.Read(buffer, length);
+	}
 }
 
-
 //==========================================================================
 //
-// @Cockatrice - Skip over ZIP header
+// GetEntryDataPosition
+//
+// Position points to the start of the local file header, which we must
+// read and skip so that we can get to the actual file data. The result is
+// cached separately so the entry itself is never written after Open.
 //
 //==========================================================================
 
-void FZipFile::SkipHeader(FileReader& fr) {
+size_t FZipFile::GetEntryDataPosition(uint32_t entry)
+{
+	if (!(Entries[entry].Flags & RESFF_NEEDFILESTART)) return Entries[entry].Position;
+
+	size_t start = DataStart ? DataStart[entry].load(std::memory_order_relaxed) : 0;
+	if (start != 0) return start;
+
 	FZipLocalFileHeader localHeader;
-	int skiplen;
+	ReadAt(&localHeader, sizeof(localHeader), Entries[entry].Position);
+	start = Entries[entry].Position + sizeof(localHeader) + LittleShort(localHeader.NameLength) + LittleShort(localHeader.ExtraLength);
 
-	fr.Seek(0, FileReader::SeekSet);
-	fr.Read(&localHeader, sizeof(localHeader));
-	skiplen = LittleShort(localHeader.NameLength) + LittleShort(localHeader.ExtraLength);
-	fr.Seek(skiplen, FileReader::SeekCur);
-	fr.ShiftStart(sizeof(localHeader) + skiplen);
+	// Any thread computing this gets the same value, so racing stores are harmless
+	if (DataStart) DataStart[entry].store(start, std::memory_order_relaxed);
+	return start;
 }
 
 //==========================================================================
@@ -41,6 +41,21 @@
 #include "zstring.h"
 #include "files_internal.h"
 
+#ifdef _WIN32
+#ifndef _WINNT_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <atomic>
+#include <mutex>
+#endif
+
 namespace FileSys {
 	
 #ifdef _WIN32
@@ -385,6 +400,323 @@ char* BufferingReader::Gets(char* strbuf, ptrdiff_t len)
 	return MemoryReader::Gets(strbuf, len);
 }
 
+//==========================================================================
+//
+// PositionalFile
+//
+// @Cockatrice - Reads never touch a shared file position, so the handle
+// can be used by every loader thread at once without locking.
+//
+//==========================================================================
+
+PositionalFile::~PositionalFile()
+{
+#ifdef _WIN32
+	if (Handle != nullptr) CloseHandle((HANDLE)Handle);
+#else
+	if (Handle >= 0) close(Handle);
+#endif
+}
+
+bool PositionalFile::Open(const char* filename)
+{
+#ifdef _WIN32
+	auto widename = toWide(filename);
+	HANDLE file = CreateFileW(widename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	Handle = file;
+	Length = (ptrdiff_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+	Handle = fd;
+	Length = (ptrdiff_t)info.st_size;
+#endif
+	return true;
+}
+
+ptrdiff_t PositionalFile::ReadAt(void* buffer, ptrdiff_t len, ptrdiff_t offset) const
+{
+	ptrdiff_t total = 0;
+	while (total < len)
+	{
+#ifdef _WIN32
+		// Synchronous handles still take the offset from the OVERLAPPED struct and leave no shared state behind
+		OVERLAPPED ov = {};
+		ov.Offset = (DWORD)(offset + total);
+		ov.OffsetHigh = (DWORD)((uint64_t)(offset + total) >> 32);
+		DWORD chunk = (DWORD)std::min<ptrdiff_t>(len - total, 0x40000000);
+		DWORD read = 0;
+		if (!::ReadFile((HANDLE)Handle, (char*)buffer + total, chunk, &read, &ov) || read == 0) break;
+#else
+		auto read = pread(Handle, (char*)buffer + total, (size_t)(len - total), (off_t)(offset + total));
+		if (read <= 0) break;
+#endif
+		total += (ptrdiff_t)read;
+	}
+	return total;
+}
+
+//==========================================================================
+//
+// PositionalFileReader
+//
+// reads part of a PositionalFile, with its own position
+//
+//==========================================================================
+
+class PositionalFileReader : public FileReaderInterface
+{
+	const PositionalFile* File;
+	ptrdiff_t StartPos;
+	ptrdiff_t FilePos = 0;
+
+public:
+	PositionalFileReader(const PositionalFile* file, ptrdiff_t start, ptrdiff_t length)
+	{
+		File = file;
+		StartPos = start;
+		Length = length;
+	}
+
+	void ShiftStart(ptrdiff_t offset) override
+	{
+		StartPos += offset;
+	}
+
+	ptrdiff_t Tell() const override
+	{
+		return FilePos;
+	}
+
+	ptrdiff_t Seek(ptrdiff_t offset, int origin) override
+	{
+		if (origin == SEEK_CUR) offset += FilePos;
+		else if (origin == SEEK_END) offset += Length;
+		if (offset < 0 || offset > Length) return -1;	// out of scope
+		FilePos = offset;
+		return 0;
+	}
+
+	ptrdiff_t Read(void* buffer, ptrdiff_t len) override
+	{
+		assert(len >= 0);
+		if (len > Length - FilePos) len = Length - FilePos;
+		if (len <= 0) return 0;
+
+		len = File->ReadAt(buffer, len, StartPos + FilePos);
+		FilePos += len;
+		return len;
+	}
+
+	char* Gets(char* strbuf, ptrdiff_t len) override
+	{
+		if (len <= 1 || FilePos >= Length) return nullptr;
+
+		ptrdiff_t read = File->ReadAt(strbuf, std::min(len - 1, Length - FilePos), StartPos + FilePos);
+		if (read <= 0) return nullptr;
+
+		auto eol = (char*)memchr(strbuf, '\n', read);
+		if (eol != nullptr) read = eol - strbuf + 1;
+		strbuf[read] = 0;
+		FilePos += read;
+		return strbuf;
+	}
+};
+
+#ifndef _WIN32
+//==========================================================================
+//
+// @Cockatrice - Touching a page of a mapping whose file was truncated
+// raises SIGBUS. Inside one of our mappings the page is replaced with
+// zeros and the access goes on, so the loaders see bad data instead of
+// the game crashing. Any other SIGBUS goes to the previous handler.
+//
+//==========================================================================
+
+static const int MaxMappings = 1024;
+static std::atomic<uintptr_t> MappingStart[MaxMappings], MappingEnd[MaxMappings];
+static std::mutex MappingLock;
+static struct sigaction OldBusAction;
+static uintptr_t MappingPageSize;
+
+static void MappingBusHandler(int sig, siginfo_t* info, void* context)
+{
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	for (int i = 0; i < MaxMappings; i++)
+	{
+		uintptr_t start = MappingStart[i].load(std::memory_order_acquire);
+		if (start == 0 || addr < start || addr >= MappingEnd[i].load(std::memory_order_relaxed)) continue;
+
+		void* page = (void*)(addr & ~(MappingPageSize - 1));
+		if (mmap(page, MappingPageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) return;
+		break;
+	}
+
+	if (OldBusAction.sa_flags & SA_SIGINFO)
+	{
+		OldBusAction.sa_sigaction(sig, info, context);
+	}
+	else if (OldBusAction.sa_handler != SIG_DFL && OldBusAction.sa_handler != SIG_IGN)
+	{
+		OldBusAction.sa_handler(sig);
+	}
+	else
+	{
+		// The access is repeated and takes the default action
+		signal(sig, SIG_DFL);
+	}
+}
+
+static bool RegisterMapping(const void* mapping, size_t length)
+{
+	std::lock_guard<std::mutex> lock(MappingLock);
+	if (MappingPageSize == 0)
+	{
+		MappingPageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+		struct sigaction action = {};
+		action.sa_sigaction = MappingBusHandler;
+		action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGBUS, &action, &OldBusAction);
+	}
+	for (int i = 0; i < MaxMappings; i++)
+	{
+		if (MappingStart[i].load(std::memory_order_relaxed) != 0) continue;
+		MappingEnd[i].store((uintptr_t)mapping + length, std::memory_order_relaxed);
+		MappingStart[i].store((uintptr_t)mapping, std::memory_order_release);
+		return true;
+	}
+	return false;
+}
+
+static void UnregisterMapping(const void* mapping)
+{
+	std::lock_guard<std::mutex> lock(MappingLock);
+	for (int i = 0; i < MaxMappings; i++)
+	{
+		if (MappingStart[i].load(std::memory_order_relaxed) == (uintptr_t)mapping)
+		{
+			MappingStart[i].store(0, std::memory_order_release);
+			return;
+		}
+	}
+}
+#endif
+
+//==========================================================================
+//
+// MappedFileReader
+//
+// @Cockatrice - Reads from a read-only mapping of an entire file. Since
+// GetBuffer() returns the mapping, archives opened this way hand out
+// views into it for stored entries instead of copying them. Views are
+// never writable, FileData::writable() returns null for them.
+//
+//==========================================================================
+
+class MappedFileReader : public MemoryReader
+{
+	void* mapping = nullptr;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mapHandle = nullptr;
+#endif
+
+public:
+	~MappedFileReader()
+	{
+		if (mapping == nullptr) return;
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+		CloseHandle(mapHandle);
+		CloseHandle(fileHandle);
+#else
+		UnregisterMapping(mapping);
+		munmap(mapping, (size_t)Length);
+#endif
+	}
+
+	bool Open(const char* filename)
+	{
+		// The whole file has to fit in the address space
+		if (sizeof(void*) < 8) return false;
+
+#ifdef _WIN32
+		// The handle stays open without write sharing so nobody can truncate the file while it is mapped
+		auto widename = toWide(filename);
+		HANDLE file = CreateFileW(widename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		mapHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapHandle == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		mapping = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+		if (mapping == nullptr)
+		{
+			CloseHandle(mapHandle);
+			CloseHandle(file);
+			mapHandle = nullptr;
+			return false;
+		}
+		fileHandle = file;
+		Length = (ptrdiff_t)size.QuadPart;
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size <= 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		void* map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) return false;
+
+		// Without the SIGBUS guard the file is read through stdio instead
+		if (!RegisterMapping(map, (size_t)info.st_size))
+		{
+			munmap(map, (size_t)info.st_size);
+			return false;
+		}
+
+		mapping = map;
+		Length = (ptrdiff_t)info.st_size;
+#endif
+		bufptr = (const char*)mapping;
+		FilePos = 0;
+		return true;
+	}
+};
+
 //==========================================================================
 //
 // FileReader
@@ -415,6 +747,26 @@ bool FileReader::OpenFilePart(FileReader &parent, FileReader::Size start, FileRe
 	return true;
 }
 
+bool FileReader::OpenMapped(const char *filename)
+{
+	auto reader = new MappedFileReader;
+	if (!reader->Open(filename))
+	{
+		delete reader;
+		return false;
+	}
+	Close();
+	mReader = reader;
+	return true;
+}
+
+bool FileReader::OpenFilePart(const PositionalFile *file, FileReader::Size start, FileReader::Size length)
+{
+	Close();
+	mReader = new PositionalFileReader(file, start, length);
+	return true;
+}
+
 bool FileReader::OpenMemory(const void *mem, FileReader::Size length)
 {
 	Close();
@@ -850,6 +850,62 @@ public:
 };
 
 
+//==========================================================================
+//
+// DecompressWhole
+//
+// @Cockatrice - For callers that want the entire lump anyway. Inflating into
+// an output buffer that holds the whole result lets tinfl resolve matches
+// directly in the destination, instead of going through z_stream's 32KB
+// dictionary and refilling a 4KB input buffer as DecompressorZ has to.
+// Memory backed sources (including mapped archives) are decoded in place,
+// everything else costs a single read of the compressed data.
+//
+//==========================================================================
+
+bool DecompressWhole(void* dest, size_t length, FileReader& parent, int method)
+{
+	if (method != METHOD_DEFLATE && method != METHOD_ZLIB) return false;
+	if (length == 0) return true;
+
+	auto start = parent.Tell();
+	auto srclen = parent.GetLength() - start;
+	if (srclen <= 0) return false;
+
+	FileData compressed;
+	const char* src = parent.GetBuffer();
+	if (src != nullptr)
+	{
+		src += start;
+	}
+	else
+	{
+		compressed = parent.Read(srclen);
+		if (compressed.size() != (size_t)srclen)
+		{
+			parent.Seek(start, FileReader::SeekSet);
+			return false;
+		}
+		src = compressed.string();
+	}
+
+	int tflags = method == METHOD_ZLIB ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0;
+	size_t result = tinfl_decompress_mem_to_mem(dest, length, src, srclen, tflags);
+	if (result != length)
+	{
+		// leave the reader where it was so that the caller can still fall back to streaming
+		parent.Seek(start, FileReader::SeekSet);
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// OpenDecompressor
+//
+//==========================================================================
+
 bool OpenDecompressor(FileReader& self, FileReader &parent, FileReader::Size length, int method, int flags)
 {
 	FileReaderInterface* fr = nullptr;
@@ -864,6 +920,18 @@ bool OpenDecompressor(FileReader& self, FileReader &parent, FileReader::Size len
 		case METHOD_DEFLATE:
 		case METHOD_ZLIB:
 		{
+			// @Cockatrice - everything gets read anyway when caching, so skip the stream
+			if ((flags & (DCF_CACHED | DCF_SEEKABLE)) && length >= 0)
+			{
+				FileData buffer(nullptr, length);
+				if (DecompressWhole(buffer.writable(), length, *p, method))
+				{
+					fr = new MemoryArrayReader(buffer);
+					flags &= ~(DCF_SEEKABLE | DCF_CACHED);
+					break;
+				}
+			}
+
 			auto idec = new DecompressorZ;
 			fr = dec = idec;
 			idec->EnableExceptions(exceptions);
@@ -5,6 +5,24 @@
 
 namespace FileSys {
 
+// @Cockatrice - One OS handle to an archive that any number of threads can read from at explicit offsets (pread)
+class PositionalFile
+{
+public:
+	~PositionalFile();
+	bool Open(const char* filename);
+	ptrdiff_t ReadAt(void* buffer, ptrdiff_t len, ptrdiff_t offset) const;
+	ptrdiff_t GetLength() const { return Length; }
+
+private:
+#ifdef _WIN32
+	void* Handle = nullptr;
+#else
+	int Handle = -1;
+#endif
+	ptrdiff_t Length = 0;
+};
+
 class MemoryReader : public FileReaderInterface
 {
 protected:
@@ -41,6 +41,10 @@
 #include <ctype.h>
 #include <string.h>
 #include <inttypes.h>
+#include <stdarg.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #include "resourcefile.h"
 #include "fs_filesystem.h"
@@ -89,6 +93,49 @@ static void md5Hash(FileReader& reader, uint8_t* digest)
 }
 
 
+// @Cockatrice - A container opened on a worker thread, waiting to be added in load order
+struct PendingFile
+{
+	struct Message
+	{
+		FSMessageLevel level;
+		std::string text;
+	};
+
+	FResourceFile* resfile = nullptr;
+	FileReader reader;
+	std::vector<Message> messages;
+	double openMS = 0;
+};
+
+// Messages from the open phase are held back and printed in load order
+static thread_local PendingFile* CapturingFile = nullptr;
+
+static int CaptureMessage(FSMessageLevel level, const char* format, ...)
+{
+	if (CapturingFile == nullptr) return 0;
+
+	va_list ap;
+	va_start(ap, format);
+	va_list ap2;
+	va_copy(ap2, ap);
+	int len = vsnprintf(nullptr, 0, format, ap2);
+	va_end(ap2);
+
+	std::string text;
+	if (len > 0)
+	{
+		text.resize(len + 1);
+		vsnprintf(&text[0], len + 1, format, ap);
+		text.resize(len);
+	}
+	va_end(ap);
+
+	CapturingFile->messages.push_back({ level, std::move(text) });
+	return len;
+}
+
+
 struct FileSystem::LumpRecord
 {
 	FResourceFile *resfile;
@@ -267,9 +314,51 @@ bool FileSystem::InitMultipleFiles (std::vector<std::string>& filenames, LumpFil
 		}
 	}
 
+	// @Cockatrice - Open and parse every container in parallel, then add them in the original order
+	// so the override order is exactly the same as loading them one by one.
+	using clock = std::chrono::steady_clock;
+	auto startTime = clock::now();
+
+	std::vector<PendingFile> pending(filenames.size());
+	std::atomic<size_t> nextFile{ 0 };
+
+	auto openProc = [&]()
+	{
+		size_t i;
+		while ((i = nextFile++) < pending.size())
+		{
+			auto& p = pending[i];
+			auto fileStart = clock::now();
+
+			CapturingFile = &p;
+			p.resfile = OpenContainer(filenames[i].c_str(), nullptr, p.reader, filter, Printf ? CaptureMessage : nullptr);
+			CapturingFile = nullptr;
+
+			p.openMS = std::chrono::duration<double, std::milli>(clock::now() - fileStart).count();
+		}
+	};
+
+	OpenThreads = (int)std::min<size_t>(pending.size(), std::max(std::thread::hardware_concurrency(), 1u));
+	std::vector<std::thread> openThreads;
+	for (int i = 1; i < OpenThreads; i++) openThreads.emplace_back(openProc);
+	openProc();
+	for (auto& t : openThreads) t.join();
+
+	auto mergeTime = clock::now();
+	OpenMS = std::chrono::duration<double, std::milli>(mergeTime - startTime).count();
+	OpenStats.clear();
+
 	for(size_t i=0;i<filenames.size(); i++)
 	{
-		AddFile(filenames[i].c_str(), nullptr, filter, Printf, hashfile);
+		auto& p = pending[i];
+
+		if (Printf)
+		{
+			for (auto& msg : p.messages) Printf(msg.level, "%s", msg.text.c_str());
+		}
+
+		OpenStats.push_back({ filenames[i], p.openMS, p.resfile ? (int)p.resfile->EntryCount() : 0 });
+		if (p.resfile != nullptr) AddContainer(filenames[i].c_str(), p.resfile, p.reader, filter, Printf, hashfile);
 
 		if (i == (unsigned)MaxIwadIndex) MoveLumpsInFolder("after_iwad/");
 		std::string path = "filter/%s";
@@ -284,11 +373,35 @@ bool FileSystem::InitMultipleFiles (std::vector<std::string>& filenames, LumpFil
 	}
 	if (filter && filter->postprocessFunc) filter->postprocessFunc();
 
+	auto hashTime = clock::now();
+	MergeMS = std::chrono::duration<double, std::milli>(hashTime - mergeTime).count();
+
 	// [RH] Set up hash table
 	InitHashChains ();
+
+	HashMS = std::chrono::duration<double, std::milli>(clock::now() - hashTime).count();
 	return true;
 }
 
+//==========================================================================
+//
+// PrintStartupStats
+//
+// @Cockatrice - Breakdown of the last InitMultipleFiles call
+//
+//==========================================================================
+
+void FileSystem::PrintStartupStats(FileSystemMessageFunc Printf) const
+{
+	if (Printf == nullptr) return;
+
+	Printf(FSMessageLevel::Message, "File system startup: %.2fms open (%d threads), %.2fms merge, %.2fms hash chains\n", OpenMS, OpenThreads, MergeMS, HashMS);
+	for (auto& stat : OpenStats)
+	{
+		Printf(FSMessageLevel::Message, "  %8.2fms %7d lumps  %s\n", stat.openMS, stat.lumps, stat.name.c_str());
+	}
+}
+
 //==========================================================================
 //
 // AddFromBuffer
@@ -329,9 +442,23 @@ int FileSystem::AddFromBuffer(const char* name, char* data, int size, int id, in
 
 void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInfo* filter, FileSystemMessageFunc Printf, FILE* hashfile)
 {
-	int startlump;
-	bool isdir = false;
 	FileReader filereader;
+	FResourceFile* resfile = OpenContainer(filename, filer, filereader, filter, Printf);
+	if (resfile != nullptr) AddContainer(filename, resfile, filereader, filter, Printf, hashfile);
+}
+
+//==========================================================================
+//
+// OpenContainer
+//
+// Opens a file or directory and reads its directory. This does not touch
+// the file system's state, so it can be run for several files at once.
+//
+//==========================================================================
+
+FResourceFile* FileSystem::OpenContainer(const char* filename, FileReader* filer, FileReader& filereader, LumpFilterInfo* filter, FileSystemMessageFunc Printf)
+{
+	bool isdir = false;
 
 	if (filer == nullptr)
 	{
@@ -343,72 +470,102 @@ void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInf
 				Printf(FSMessageLevel::Error, "%s: File or Directory not found\n", filename);
 				PrintLastError(Printf);
 			}
-			return;
+			return nullptr;
 		}
 
 		if (!isdir)
 		{
-			if (!filereader.OpenFile(filename))
+			// @Cockatrice - Map the archive if possible so stored lumps can be handed out without copying
+			if (!(UseFileMapping() && filereader.OpenMapped(filename)) && !filereader.OpenFile(filename))
 			{ // Didn't find file
 				if (Printf)
 				{
 					Printf(FSMessageLevel::Error, "%s: File not found\n", filename);
 					PrintLastError(Printf);
 				}
-				return;
+				return nullptr;
 			}
 		}
 	}
 	else filereader = std::move(*filer);
 
-	startlump = NumEntries;
+	// Containers get their own string pool here, the shared one is not thread safe
+	if (!isdir)
+	{
+		auto resfile = FResourceFile::OpenResourceFile(filename, filereader, false, filter, Printf);
+		// @Cockatrice - only a container read from the path itself may reopen it for positional reads
+		if (resfile != nullptr && filer == nullptr) resfile->SetOnDisk();
+		return resfile;
+	}
+	else
+		return FResourceFile::OpenDirectory(filename, filter, Printf);
+}
 
-	FResourceFile *resfile;
+//==========================================================================
+//
+// AddContainer
+//
+// Adds the lumps of an opened file to the directory
+//
+//==========================================================================
 
+void FileSystem::AddContainer(const char* filename, FResourceFile* resfile, FileReader& filereader, LumpFilterInfo* filter, FileSystemMessageFunc Printf, FILE* hashfile)
+{
+	if (Printf) 
+		Printf(FSMessageLevel::Message, "adding %s, %d lumps\n", filename, resfile->EntryCount());
 
-	if (!isdir)
-		resfile = FResourceFile::OpenResourceFile(filename, filereader, false, filter, Printf, stringpool);
-	else
-		resfile = FResourceFile::OpenDirectory(filename, filter, Printf, stringpool);
+	uint32_t lumpstart = (uint32_t)FileInfo.size();
 
-	if (resfile != NULL)
+	resfile->SetFirstLump(lumpstart);
+	Files.push_back(resfile);
+	for (int i = 0; i < resfile->EntryCount(); i++)
 	{
-		if (Printf) 
-			Printf(FSMessageLevel::Message, "adding %s, %d lumps\n", filename, resfile->EntryCount());
-
-		uint32_t lumpstart = (uint32_t)FileInfo.size();
+		FileInfo.resize(FileInfo.size() + 1);
+		FileSystem::LumpRecord* lump_p = &FileInfo.back();
+		lump_p->SetFromLump(resfile, i, (int)Files.size() - 1, stringpool);
+	}
 
-		resfile->SetFirstLump(lumpstart);
-		Files.push_back(resfile);
-		for (int i = 0; i < resfile->EntryCount(); i++)
+	for (int i = 0; i < resfile->EntryCount(); i++)
+	{
+		int flags = resfile->GetEntryFlags(i);
+		if (flags & RESFF_EMBEDDED)
 		{
-			FileInfo.resize(FileInfo.size() + 1);
-			FileSystem::LumpRecord* lump_p = &FileInfo.back();
-			lump_p->SetFromLump(resfile, i, (int)Files.size() - 1, stringpool);
+			std::string path = filename;
+			path += ':';
+			path += resfile->getName(i);
+			auto embedded = resfile->GetEntryReader(i, READER_CACHED);
+			AddFile(path.c_str(), &embedded, filter, Printf, hashfile);
 		}
+	}
 
-		for (int i = 0; i < resfile->EntryCount(); i++)
+	if (hashfile)
+	{
+		uint8_t cksum[16];
+		char cksumout[33];
+		memset(cksumout, 0, sizeof(cksumout));
+
+		if (filereader.isOpen())
 		{
-			int flags = resfile->GetEntryFlags(i);
-			if (flags & RESFF_EMBEDDED)
+			filereader.Seek(0, FileReader::SeekSet);
+			md5Hash(filereader, cksum);
+
+			for (size_t j = 0; j < sizeof(cksum); ++j)
 			{
-				std::string path = filename;
-				path += ':';
-				path += resfile->getName(i);
-				auto embedded = resfile->GetEntryReader(i, READER_CACHED);
-				AddFile(path.c_str(), &embedded, filter, Printf, hashfile);
+				snprintf(cksumout + (j * 2), 3, "%02X", cksum[j]);
 			}
+
+			fprintf(hashfile, "file: %s, hash: %s, size: %td\n", filename, cksumout, filereader.GetLength());
 		}
 
-		if (hashfile)
-		{
-			uint8_t cksum[16];
-			char cksumout[33];
-			memset(cksumout, 0, sizeof(cksumout));
+		else
+			fprintf(hashfile, "file: %s, Directory structure\n", filename);
 
-			if (filereader.isOpen())
+		for (int i = 0; i < resfile->EntryCount(); i++)
+		{
+			int flags = resfile->GetEntryFlags(i);
+			if (!(flags & RESFF_EMBEDDED))
 			{
-				filereader.Seek(0, FileReader::SeekSet);
+				auto reader = resfile->GetEntryReader(i, READER_SHARED, 0);
 				md5Hash(filereader, cksum);
 
 				for (size_t j = 0; j < sizeof(cksum); ++j)
@@ -416,30 +573,9 @@ void FileSystem::AddFile (const char *filename, FileReader *filer, LumpFilterInf
 					snprintf(cksumout + (j * 2), 3, "%02X", cksum[j]);
 				}
 
-				fprintf(hashfile, "file: %s, hash: %s, size: %td\n", filename, cksumout, filereader.GetLength());
-			}
-
-			else
-				fprintf(hashfile, "file: %s, Directory structure\n", filename);
-
-			for (int i = 0; i < resfile->EntryCount(); i++)
-			{
-				int flags = resfile->GetEntryFlags(i);
-				if (!(flags & RESFF_EMBEDDED))
-				{
-					auto reader = resfile->GetEntryReader(i, READER_SHARED, 0);
-					md5Hash(filereader, cksum);
-
-					for (size_t j = 0; j < sizeof(cksum); ++j)
-					{
-						snprintf(cksumout + (j * 2), 3, "%02X", cksum[j]);
-					}
-
-					fprintf(hashfile, "file: %s, lump: %s, hash: %s, size: %zu\n", filename, resfile->getName(i), cksumout, (uint64_t)resfile->Length(i));
-				}
+				fprintf(hashfile, "file: %s, lump: %s, hash: %s, size: %zu\n", filename, resfile->getName(i), cksumout, (uint64_t)resfile->Length(i));
 			}
 		}
-		return;
 	}
 }
 
@@ -781,6 +917,44 @@ ptrdiff_t FileSystem::FileLength (int lump) const
 	return (int)lump_p.resfile->Length(lump_p.resindex);
 }
 
+//==========================================================================
+//
+// GetFileOffset
+//
+// Returns the position of the lump's entry in its container. For formats
+// that compute the data start lazily this is the entry header's position.
+//
+//==========================================================================
+
+size_t FileSystem::GetFileOffset (int lump) const
+{
+	if ((size_t)lump >= NumEntries)
+	{
+		return 0;
+	}
+	const auto &lump_p = FileInfo[lump];
+	return lump_p.resfile->Offset(lump_p.resindex);
+}
+
+//==========================================================================
+//
+// GetFileCRC32
+//
+// Returns the CRC32 stored in the container's directory, 0 if the
+// container format does not have one.
+//
+//==========================================================================
+
+uint32_t FileSystem::GetFileCRC32 (int lump) const
+{
+	if ((size_t)lump >= NumEntries)
+	{
+		return 0;
+	}
+	const auto &lump_p = FileInfo[lump];
+	return lump_p.resfile->CRC32(lump_p.resindex);
+}
+
 //==========================================================================
 //
 // 
@@ -59,6 +59,18 @@ void SetMainThread()
 	}
 }
 
+// @Cockatrice - Archives added through the file system are memory mapped unless this is turned off
+static bool fileMapping = true;
+void SetFileMapping(bool enable)
+{
+	fileMapping = enable;
+}
+
+bool UseFileMapping()
+{
+	return fileMapping;
+}
+
 std::string ExtractBaseName(const char* path, bool include_extension)
 {
 	const char* src, * dot;
@@ -182,7 +194,9 @@ FResourceFile *FResourceFile::OpenResourceFile(const char *filename, bool contai
 {
 	FileReader file;
 	if (!file.OpenFile(filename)) return nullptr;
-	return DoOpenResourceFile(filename, file, containeronly, filter, Printf, sp);
+	auto resfile = DoOpenResourceFile(filename, file, containeronly, filter, Printf, sp);
+	if (resfile != nullptr) resfile->SetOnDisk();
+	return resfile;
 }
 
 FResourceFile *FResourceFile::OpenDirectory(const char *filename, LumpFilterInfo* filter, FileSystemMessageFunc Printf, StringPool* sp)
@@ -211,9 +225,41 @@ FResourceFile::FResourceFile(const char *filename, FileReader &r, StringPool* sp
 
 FResourceFile::~FResourceFile()
 {
+	delete SharedFile.load();
 	if (!stringpool->shared) delete stringpool;
 }
 
+//==========================================================================
+//
+// @Cockatrice - Opens the shared handle for positional reads
+// Returns null for anything that isn't a plain file on disk
+//
+//==========================================================================
+
+const PositionalFile* FResourceFile::GetSharedFile()
+{
+	auto file = SharedFile.load(std::memory_order_acquire);
+	if (file != nullptr) return file;
+	if (!OnDisk || SharedFileFailed.load(std::memory_order_relaxed)) return nullptr;
+
+	auto newFile = new PositionalFile;
+	if (!newFile->Open(FileName))
+	{
+		// Don't retry the open on every read
+		SharedFileFailed.store(true, std::memory_order_relaxed);
+		delete newFile;
+		return nullptr;
+	}
+
+	// Another thread may have won the race, use its handle instead
+	if (!SharedFile.compare_exchange_strong(file, newFile, std::memory_order_acq_rel))
+	{
+		delete newFile;
+		return file;
+	}
+	return newFile;
+}
+
 //==========================================================================
 //
 // this is just for completeness. For non-Zips only an uncompressed lump can
@@ -661,58 +707,61 @@ int FResourceFile::FindEntry(const char *name)
 //
 //==========================================================================
 
+FileReader FResourceFile::OpenEntryData(uint32_t entry, int readertype)
+{
+	// @Cockatrice - Every path here is safe on any thread. Memory backed archives hand out views,
+	// everything else reads through the shared handle at explicit offsets, so no reader
+	// ever moves the archive's file position or needs a lock.
+	auto buf = Reader.GetBuffer();
+	auto position = GetEntryDataPosition(entry);
+	auto size = (Entries[entry].Flags & RESFF_COMPRESSED) ? Entries[entry].CompressedSize : Entries[entry].Length;
+	FileReader fri;
+
+	if (buf != nullptr)
+	{
+		fri.OpenMemory(buf + position, size);
+	}
+	else if (auto shared = GetSharedFile())
+	{
+		fri.OpenFilePart(shared, position, size);
+	}
+	else if (readertype == READER_SHARED && mainThread)
+	{
+		fri.OpenFilePart(Reader, position, size);
+	}
+	else if (OnDisk)
+	{
+		fri.OpenFile(FileName, position, size);
+	}
+	else
+	{
+		// Nested containers have no path to reopen, copy the data out of the container's reader
+		std::lock_guard<std::mutex> lock(ReaderMutex);
+		Reader.Seek(position, FileReader::SeekSet);
+		auto data = Reader.Read(size);
+		fri.OpenMemoryArray(data);
+	}
+	return fri;
+}
+
 FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int readerflags)
 {
 	FileReader fr;
 	if (entry < NumLumps)
 	{
-		if (Entries[entry].Flags & RESFF_NEEDFILESTART)
-		{
-			if(mainThread) 
-				SetEntryAddress(entry);
-		}
+		FileReader fri = OpenEntryData(entry, readertype);
+
 		if (!(Entries[entry].Flags & RESFF_COMPRESSED))
 		{
-			auto buf = Reader.GetBuffer();
-			// if this is backed by a memory buffer, create a new reader directly referencing it.
-			if (buf != nullptr)
+			if (readertype == READER_CACHED && Reader.GetBuffer() == nullptr)
 			{
-				fr.OpenMemory(buf + Entries[entry].Position, Entries[entry].Length);
-			}
-			else
-			{
-				if (readertype == READER_SHARED && !mainThread)
-					readertype = READER_NEW;
-				if (readertype == READER_SHARED)
-				{
-					fr.OpenFilePart(Reader, Entries[entry].Position, Entries[entry].Length);
-				}
-				else if (readertype == READER_NEW)
-				{
-					fr.OpenFile(FileName, Entries[entry].Position, Entries[entry].Length);
-				}
-				else if (readertype == READER_CACHED)
-				{
-					assert(mainThread);
-					Reader.Seek(Entries[entry].Position, FileReader::SeekSet);
-					auto data = Reader.Read(Entries[entry].Length);
-					fr.OpenMemoryArray(data);
-				}
+				auto data = fri.Read(Entries[entry].Length);
+				fr.OpenMemoryArray(data);
 			}
+			else fr = std::move(fri);
 		}
 		else
 		{
-			FileReader fri;
-			
-			if (readertype == READER_NEW || !mainThread) {
-				fri.OpenFile(FileName, Entries[entry].Position, Entries[entry].CompressedSize);
-				
-				// @Cockatrice - To make this properly thread safe we CANNOT write the filestart info
-				// in a thread, so skip to the correct location without storing
-				if (!mainThread && Entries[entry].Flags & RESFF_NEEDFILESTART) {
-					SkipHeader(fri);
-				}
-			} else fri.OpenFilePart(Reader, Entries[entry].Position, Entries[entry].CompressedSize);
 			int flags = DCF_TRANSFEROWNER | DCF_EXCEPTIONS;
 			if (readertype == READER_CACHED) flags |= DCF_CACHED;
 			else if (readerflags & READERFLAG_SEEKABLE) flags |= DCF_SEEKABLE;
@@ -723,8 +772,8 @@ FileReader FResourceFile::GetEntryReader(uint32_t entry, int readertype, int rea
 }
 
 
-void FResourceFile::SkipHeader(FileReader& fr) {
-	// Do nothing by defualt
+size_t FResourceFile::GetEntryDataPosition(uint32_t entry) {
+	return Entries[entry].Position;
 }
 
 
@@ -736,7 +785,20 @@ FileData FResourceFile::Read(uint32_t entry)
 		// if this is backed by a memory buffer, we can just return a reference to the backing store.
 		if (buf != nullptr)
 		{
-			return FileData(buf + Entries[entry].Position, Entries[entry].Length, false);
+			return FileData(buf + GetEntryDataPosition(entry), Entries[entry].Length, false);
+		}
+	}
+
+	// @Cockatrice - Deflated lumps are decoded in one go straight into the returned buffer.
+	// Other methods stream, so they get neither the buffer nor a second reader.
+	auto method = entry < NumLumps ? Entries[entry].Method : METHOD_STORED;
+	if ((method == METHOD_DEFLATE || method == METHOD_ZLIB) && (Entries[entry].Flags & RESFF_COMPRESSED))
+	{
+		FileData data(nullptr, Entries[entry].Length);
+		auto fri = OpenEntryData(entry, READER_SHARED);
+		if (DecompressWhole(data.writable(), Entries[entry].Length, fri, method))
+		{
+			return data;
 		}
 	}
 
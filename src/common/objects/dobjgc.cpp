@@ -173,6 +173,15 @@ bool HadToDestroy;
 static FAveragizer AllocHistory;// Tracks allocation rate over time
 static cycle_t GCTime;			// Track time spent in GC
 
+// @Cockatrice - Pause times for stat gc
+struct FPauseStats
+{
+	double StepMaxMS = 0, CycleMS = 0;			// Incremental steps of the current cycle
+	double PrevStepMaxMS = 0, PrevCycleMS = 0;	// ... and of the last finished one
+	double FullMS = 0;
+};
+static FPauseStats PauseStats;
+
 // CODE --------------------------------------------------------------------
 
 //==========================================================================
@@ -384,6 +393,9 @@ static void MarkRoot()
 {
 	PrevStepStats = StepStats;
 	StepStats.Reset();
+	PauseStats.PrevStepMaxMS = PauseStats.StepMaxMS;
+	PauseStats.PrevCycleMS = PauseStats.CycleMS;
+	PauseStats.StepMaxMS = PauseStats.CycleMS = 0;
 
 	Gray = nullptr;
 
@@ -550,6 +562,10 @@ void Step()
 	StepStats.Clock[enter_state].Unclock();
 	StepStats.BytesCovered[enter_state] += did;
 	GCTime.Unclock();
+
+	double ms = GCTime.TimeMS();
+	PauseStats.CycleMS += ms;
+	PauseStats.StepMaxMS = std::max(PauseStats.StepMaxMS, ms);
 }
 
 //==========================================================================
@@ -562,6 +578,9 @@ void Step()
 
 void FullGC()
 {
+	cycle_t time;
+	time.ResetAndClock();
+
 	bool ContinueCheck = true;
 	while (ContinueCheck)
 	{
@@ -590,6 +609,9 @@ void FullGC()
 			ContinueCheck |= HadToDestroy;
 		} while (HadToDestroy);
 	}
+
+	time.Unclock();
+	PauseStats.FullMS = time.TimeMS();
 }
 
 //==========================================================================
@@ -787,6 +809,10 @@ ADD_STAT(gc)
 		(GC::AllocBytes + 1023) >> 10,
 		(GC::Estimate + 1023) >> 10,
 		(GC::Threshold + 1023) >> 10);
+
+	auto &ps = GC::PauseStats;
+	out.AppendFormat("\nPauses: step max %.3fms (%.3fms)  cycle %.2fms (%.2fms)  full %.2fms",
+		ps.StepMaxMS, ps.PrevStepMaxMS, ps.CycleMS, ps.PrevCycleMS, ps.FullMS);
 	return out;
 }
 
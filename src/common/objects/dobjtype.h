@@ -79,6 +79,7 @@ public:
 	bool				 bSealed = false;
 	bool				 bFinal = false;
 	bool				 bOptional = false;
+	int					 ProfilerSlot = -1;		// @Cockatrice - Index into the tick profiler's per-class counters, assigned on first tick
 	TArray<VMFunction*>	 Virtuals;	// virtual function table
 	TArray<FTypeAndOffset> MetaInits;
 	TArray<FTypeAndOffset> SpecialInits;
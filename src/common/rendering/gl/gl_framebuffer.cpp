@@ -67,6 +67,7 @@
 #include "hw_cvars.h"
 
 #include "filesystem.h"
+#include "texdiskcache.h"
 #include "c_dispatch.h"
 
 EXTERN_CVAR (Bool, vid_vsync)
@@ -182,25 +183,34 @@ bool GlTexLoadThread::loadResource(GlTexLoadIn & input, GlTexLoadOut & output) {
 	const int buffHeight = src->GetHeight() + 2 * exx;
 	unsigned char* pixelData = nullptr;
 	size_t pixelDataSize = 0;
+
+	// Decoded pixels may already be in the disk cache from a previous run
+	FTexDiskCacheKey cacheKey;
+	const bool cacheable = !gpu && TexDiskCache.MakeKey(params, exx, input.spi.notrimming, cacheKey);
+	SpritePositioningInfo* cacheSpi = input.spi.generateSpi ? output.spi.info : nullptr;
 	
 
 	if (exx && !gpu) {
 		pixelDataSize = 4u * (size_t)buffWidth * (size_t)buffHeight;
 		pixelData = (unsigned char*)malloc(pixelDataSize);
-		memset(pixelData, 0, pixelDataSize);
 		
-		FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
-
-		// This is incredibly wasteful, but necessary for now since we can't read the bitmap with an offset into a larger buffer
-		// Read into a buffer and blit 
-		FBitmap srcBitmap;
-		srcBitmap.Create(srcWidth, srcHeight);
-		output.isTranslucent = src->ReadPixels(params, &srcBitmap);
-		pixels.Blit(exx, exx, srcBitmap);
-
-		// If we need sprite positioning info, generate it here and assign it in the main thread later
-		if (input.spi.generateSpi) {
-			FGameTexture::GenerateInitialSpriteData(output.spi.info, &srcBitmap, input.spi.shouldExpand, input.spi.notrimming);
+		if (!cacheable || !TexDiskCache.Read(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi)) {
+			memset(pixelData, 0, pixelDataSize);
+			FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
+
+			// This is incredibly wasteful, but necessary for now since we can't read the bitmap with an offset into a larger buffer
+			// Read into a buffer and blit 
+			FBitmap srcBitmap;
+			srcBitmap.Create(srcWidth, srcHeight);
+			output.isTranslucent = src->ReadPixels(params, &srcBitmap);
+			pixels.Blit(exx, exx, srcBitmap);
+
+			// If we need sprite positioning info, generate it here and assign it in the main thread later
+			if (input.spi.generateSpi) {
+				FGameTexture::GenerateInitialSpriteData(output.spi.info, &srcBitmap, input.spi.shouldExpand, input.spi.notrimming);
+			}
+
+			if (cacheable) TexDiskCache.Write(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi);
 		}
 
 		output.totalDataSize = pixelDataSize;
@@ -224,15 +234,19 @@ bool GlTexLoadThread::loadResource(GlTexLoadIn & input, GlTexLoadOut & output) {
 		else {
 			pixelDataSize = 4u * (size_t)buffWidth * (size_t)buffHeight;
 			pixelData = (unsigned char*)malloc(pixelDataSize);
-			memset(pixelData, 0, pixelDataSize);
+			output.totalDataSize = pixelDataSize;
 
-			FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
+			if (!cacheable || !TexDiskCache.Read(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi)) {
+				memset(pixelData, 0, pixelDataSize);
+				FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
 
-			output.isTranslucent = src->ReadPixels(params, &pixels);
-			output.totalDataSize = pixelDataSize;
+				output.isTranslucent = src->ReadPixels(params, &pixels);
 
-			if (input.spi.generateSpi) {
-				FGameTexture::GenerateInitialSpriteData(output.spi.info, &pixels, input.spi.shouldExpand, input.spi.notrimming);
+				if (input.spi.generateSpi) {
+					FGameTexture::GenerateInitialSpriteData(output.spi.info, &pixels, input.spi.shouldExpand, input.spi.notrimming);
+				}
+
+				if (cacheable) TexDiskCache.Write(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi);
 			}
 		}
 	}
@@ -348,11 +362,11 @@ bool OpenGLFrameBuffer::BackgroundLoadModel(FModel* model) {
 
 
 // @Cockatrice - Cache a texture material, intended for use outside of the main thread
-bool OpenGLFrameBuffer::BackgroundCacheTextureMaterial(FGameTexture* tex, FTranslationID translation, int scaleFlags, bool makeSPI) {
+bool OpenGLFrameBuffer::BackgroundCacheTextureMaterial(FGameTexture* tex, FTranslationID translation, int scaleFlags, bool makeSPI, float priority) {
 	if (!tex || !tex->isValid() || tex->GetID().GetIndex() == 0) return false;
 
 	QueuedPatch qp = {
-		tex, translation, scaleFlags, makeSPI
+		tex, translation, scaleFlags, makeSPI, priority
 	};
 
 	patchQueue.queue(qp);
@@ -363,7 +377,7 @@ bool OpenGLFrameBuffer::BackgroundCacheTextureMaterial(FGameTexture* tex, FTrans
 
 // @Cockatrice - Submit each texture in the material to the background loader
 // Call from main thread only!
-bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID translation, bool makeSPI, bool secondary) {
+bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID translation, bool makeSPI, bool secondary, float priority) {
 	if (mat->Source()->GetUseType() == ETextureType::SWCanvas) return false;
 
 	MaterialLayerInfo* layer;
@@ -387,10 +401,16 @@ bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID t
 			[](void* a, GlTexLoadIn& b)
 		{ return (FHardwareTexture*)a == b.tex; })) {
 			systex->SetHardwareState(IHardwareTexture::HardwareState::LOADING, 0);
+			in.priority = priority;
+			RequestTexPriority(systex, priority);
 			primaryTexQueue.queue(in);
 			return true;
 		}
 	}
+	else if (lumpExists && !secondary && systex->GetState(0) == IHardwareTexture::HardwareState::LOADING) {
+		// Already queued, make sure it is sorted by the most important request this frame
+		RequestTexPriority(systex, priority);
+	}
 	else if (lumpExists && systex->GetState(0) == IHardwareTexture::HardwareState::NONE) {
 		assert(systex->GetTextureHandle() == 0);
 		systex->SetHardwareState(secondary ? IHardwareTexture::HardwareState::CACHING : IHardwareTexture::HardwareState::LOADING, 0);
@@ -415,11 +435,15 @@ bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID t
 				systex,
 				mat->sourcetex,
 				0,
-				allowMipmaps
+				allowMipmaps,
+				priority
 			};
 
 			if (secondary) secondaryTexQueue.queue(in);
-			else primaryTexQueue.queue(in);
+			else {
+				RequestTexPriority(systex, priority);
+				primaryTexQueue.queue(in);
+			}
 		}
 		else {
 			systex->SetHardwareState(IHardwareTexture::HardwareState::READY, 0); // TODO: Set state to a special "unloadable" state
@@ -442,10 +466,15 @@ bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID t
 				[](void* a, GlTexLoadIn& b)
 			{ return (FHardwareTexture*)a == b.tex; })) {
 				syslayer->SetHardwareState(IHardwareTexture::HardwareState::LOADING, i);
+				in.priority = priority;
+				RequestTexPriority(syslayer, priority);
 				primaryTexQueue.queue(in);
 				return true;
 			}
 		}
+		else if (lumpExists && !secondary && syslayer->GetState(i) == IHardwareTexture::HardwareState::LOADING) {
+			RequestTexPriority(syslayer, priority);
+		}
 		else if (lumpExists && syslayer->GetState(i) == IHardwareTexture::HardwareState::NONE) {
 			syslayer->SetHardwareState(secondary ? IHardwareTexture::HardwareState::CACHING : IHardwareTexture::HardwareState::LOADING, i);
 			
@@ -468,11 +497,15 @@ bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID t
 					syslayer,
 					nullptr,
 					i,
-					allowMipmaps
+					allowMipmaps,
+					priority
 				};
 
 				if (secondary) secondaryTexQueue.queue(in);
-				else primaryTexQueue.queue(in);
+				else {
+					RequestTexPriority(syslayer, priority);
+					primaryTexQueue.queue(in);
+				}
 			}
 			else {
 				syslayer->SetHardwareState(IHardwareTexture::HardwareState::READY, i); // TODO: Set state to a special "unloadable" state
@@ -487,11 +520,41 @@ bool OpenGLFrameBuffer::BackgroundCacheMaterial(FMaterial* mat, FTranslationID t
 }
 
 
+// @Cockatrice - Remember the most important request for a queued texture this frame
+void OpenGLFrameBuffer::RequestTexPriority(FHardwareTexture* tex, float priority) {
+	std::lock_guard<std::mutex> lock(texPrioritiesLock);
+	float* p = texPriorities.CheckKey(tex);
+	if (p) *p = max(*p, priority);
+	else texPriorities.Insert(tex, priority);
+}
+
+
+// @Cockatrice - Re-sort the primary queue by the priorities requested this frame
+// Textures that were not requested again sink behind fresh requests
+void OpenGLFrameBuffer::ReprioritizeTexQueue() {
+	std::lock_guard<std::mutex> lock(texPrioritiesLock);
+	if (primaryTexQueue.size() > 1) {
+		primaryTexQueue.foreach([&](GlTexLoadIn& in) {
+			float* p = texPriorities.CheckKey(in.tex);
+			in.priority = p ? *p : in.priority * 0.5f;
+		});
+
+		primaryTexQueue.sort([](const GlTexLoadIn& a, const GlTexLoadIn& b) { return a.priority > b.priority; });
+	}
+
+	texPriorities.Clear();
+}
+
+
 void OpenGLFrameBuffer::StopBackgroundCache() {
 	primaryTexQueue.clear();
 	secondaryTexQueue.clear();
 	patchQueue.clear();
 	modelInQueue.clear();
+	{
+		std::lock_guard<std::mutex> lock(texPrioritiesLock);
+		texPriorities.Clear();
+	}
 
 	for (auto& tfr : bgTransferThreads) {
 		tfr->stop();
@@ -601,10 +664,12 @@ void OpenGLFrameBuffer::UpdateBackgroundCache(bool flush) {
 	while (patchQueue.dequeue(qp)) {
 		FMaterial* gltex = FMaterial::ValidateTexture(qp.tex, qp.scaleFlags, true);
 		if (gltex && !gltex->IsHardwareCached(qp.translation.index())) {
-			BackgroundCacheMaterial(gltex, qp.translation, qp.generateSPI);
+			BackgroundCacheMaterial(gltex, qp.translation, qp.generateSPI, false, qp.priority);
 		}
 	}
 
+	ReprioritizeTexQueue();
+
 	// Process any loaded models
 	GLModelLoadOut modelOut;
 	while (modelOutQueue.dequeue(modelOut)) {
@@ -746,8 +811,11 @@ void OpenGLFrameBuffer::InitializeState()
 		int numThreads = 1;
 		bool canUpload = gl_texture_thread_upload && gl_numAUXContexts() > 0;
 
+		// Upload threads are bound to an aux context each, decode-only loaders share the loader pool
 		if(canUpload)
 			numThreads = min(4, min((int)gl_max_transfer_threads, gl_numAUXContexts()));
+		else
+			numThreads = ResourceLoaderPool::Instance().numWorkers();
 		
 		for (int x = 0; x < numThreads; x++) {
 			std::unique_ptr<GlTexLoadThread> ptr(new GlTexLoadThread(this, canUpload ? x : -1, &primaryTexQueue, &secondaryTexQueue, &outputTexQueue));
@@ -36,6 +36,7 @@ struct GlTexLoadIn {
 	FGameTexture* gtex;
 	int texUnit;
 	bool allowMipmaps;
+	float priority = 0;		// Primary queue is sorted by this each frame, higher loads first
 };
 
 struct GlTexLoadOut {
@@ -76,7 +77,7 @@ public:
 		cmd = buffer;
 	}
 
-	~GlTexLoadThread() override {};
+	~GlTexLoadThread() override { stop(); };
 
 	bool uploadPossible() const { return auxContext >= 0; }
 
@@ -91,6 +92,7 @@ protected:
 	void cancelLoad() override {  }		// TODO: Actually finish this
 	void completeLoad() override {  }	// TODO: Same
 	void prepareLoad() override;
+	bool usesDedicatedThread() override { return auxContext >= 0; }	// Bound to an aux GL context
 
 	void bgproc() override;
 };
@@ -99,9 +101,11 @@ protected:
 class GLModelLoadThread : public ResourceLoader2<GLModelLoadIn, GLModelLoadOut> {
 public:
 	GLModelLoadThread(TSQueue<GLModelLoadIn>* inQueue, TSQueue<GLModelLoadOut>* outQueue) : ResourceLoader2(inQueue, nullptr, outQueue) {
-
+		mPriority = LOADER_PRIORITY_LOW;
 	}
 
+	~GLModelLoadThread() override { stop(); }
+
 protected:
 	std::atomic<int> maxQueue;
 
@@ -143,8 +147,8 @@ public:
 	void PrecacheMaterial(FMaterial *mat, int translation) override;
 	void PrequeueMaterial(FMaterial* mat, int translation) override;
 	bool BackgroundLoadModel(FModel* model) override;
-	bool BackgroundCacheMaterial(FMaterial* mat, FTranslationID translation, bool makeSPI = false, bool secondary = false) override;
-	bool BackgroundCacheTextureMaterial(FGameTexture* tex, FTranslationID translation, int scaleFlags, bool makeSPI = false) override;
+	bool BackgroundCacheMaterial(FMaterial* mat, FTranslationID translation, bool makeSPI = false, bool secondary = false, float priority = 0) override;
+	bool BackgroundCacheTextureMaterial(FGameTexture* tex, FTranslationID translation, int scaleFlags, bool makeSPI = false, float priority = 0) override;
 	bool CachingActive() override { return secondaryTexQueue.size() > 0; }
 	bool SupportsBackgroundCache() override { return bgTransferThreads.size() > 0; }
 	void StopBackgroundCache() override;
@@ -196,8 +200,12 @@ private:
 		FTranslationID translation;
 		int scaleFlags;
 		bool generateSPI;
+		float priority;
 	};
 
+	void RequestTexPriority(FHardwareTexture* tex, float priority);
+	void ReprioritizeTexQueue();
+
 	int statMaxQueued = 0, statMaxQueuedSecondary = 0, statCollisions = 0, statModelsLoaded = 0;
 	TSQueue<GlTexLoadIn> primaryTexQueue, secondaryTexQueue;
 	TSQueue<GlTexLoadOut> outputTexQueue;
@@ -206,6 +214,8 @@ private:
 	TSQueue<QueuedPatch> patchQueue;									// @Cockatrice - Thread safe queue of textures to create materials for and submit to the bg thread
 	std::vector<std::unique_ptr<GlTexLoadThread>> bgTransferThreads;	// @Cockatrice - Threads that handle the background transfers
 	std::unique_ptr<GLModelLoadThread> modelThread;						// Loads models, always 1 thread
+	TMap<FHardwareTexture*, float> texPriorities;						// Highest priority each queued texture was requested at this frame
+	std::mutex texPrioritiesLock;										// Requests come from the render workers
 
 	double fgTotalTime = 0, fgTotalCount = 0, fgMin = 0, fgMax = 0;		// Foreground integration time stats
 };
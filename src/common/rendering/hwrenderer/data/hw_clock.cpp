@@ -51,10 +51,12 @@ glcycle_t Dirty;
 glcycle_t drawcalls;
 glcycle_t twoD, Flush3D;
 glcycle_t MTWait, WTTotal;
+glcycle_t SortTranslucent;	// @Cockatrice
 int vertexcount, flatvertices, flatprimitives;
 
 int rendered_lines,rendered_flats,rendered_sprites,render_vertexsplit,render_texsplit,rendered_decals, rendered_portals, rendered_commandbuffers;
 int iter_dlightf, iter_dlight, draw_dlight, draw_dlightf;
+int sort_partitions;
 
 void ResetProfilingData()
 {
@@ -75,9 +77,11 @@ void ResetProfilingData()
 	drawcalls.Reset();
 	MTWait.Reset();
 	WTTotal.Reset();
+	SortTranslucent.Reset();
 
 	flatvertices=flatprimitives=vertexcount=0;
 	render_texsplit=render_vertexsplit=rendered_lines=rendered_flats=rendered_sprites=rendered_decals=rendered_portals = 0;
+	sort_partitions = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -99,7 +103,8 @@ static void AppendRenderTimes(FString &str)
 		"2D: %2.3f Finish3D: %2.3f\n"
 		"Main thread total=%2.3f, Main thread waiting=%2.3f Worker thread total=%2.3f, Worker thread waiting=%2.3f\n"
 		"All=%2.3f, Render=%2.3f, Setup=%2.3f, Portal=%2.3f, Drawcalls=%2.3f, Postprocess=%2.3f, Finish=%2.3f\n"
-		"GPU Wait=%2.3f, FPS Limiter: %2.3f",
+		"GPU Wait=%2.3f, FPS Limiter: %2.3f\n"
+		"Translucent sort=%2.3f (%d partitions)",
 		bsp, clipwall,
 		RenderWall.TimeMS(), setupwall,
 		RenderFlat.TimeMS(), SetupFlat.TimeMS(),
@@ -107,7 +112,8 @@ static void AppendRenderTimes(FString &str)
 		twoD.TimeMS(), Flush3D.TimeMS() - twoD.TimeMS(),
 		MTWait.TimeMS() + Bsp.TimeMS(), MTWait.TimeMS(), WTTotal.TimeMS(), WTTotal.TimeMS() - setupwall - SetupFlat.TimeMS() - SetupSprite.TimeMS(),
 		All.TimeMS() + Finish.TimeMS(), RenderAll.TimeMS(), ProcessAll.TimeMS(), PortalAll.TimeMS(), drawcalls.TimeMS(), PostProcess.TimeMS(), Finish.TimeMS(),
-		GPUWait.TimeMS(), FPSWait.TimeMS()
+		GPUWait.TimeMS(), FPSWait.TimeMS(),
+		SortTranslucent.TimeMS(), sort_partitions
 	);
 }
 
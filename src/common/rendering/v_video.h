@@ -78,6 +78,16 @@ enum EHWCaps
 	RFL_DEBUG = 128,
 };
 
+// @Cockatrice - Background texture load priorities
+// World textures use roughly the fraction of the screen height they will cover, so anything
+// that is about to fill the screen jumps ahead of distant decals. HUD textures always come first.
+enum EBGLoadPriority
+{
+	BGLOAD_PRIORITY_NONE = 0,
+	BGLOAD_PRIORITY_HUD_NEXT = 500,		// Upcoming weapon frames
+	BGLOAD_PRIORITY_HUD = 1000,
+};
+
 
 extern int DisplayWidth, DisplayHeight;
 
@@ -227,8 +237,8 @@ public:
 	virtual void PrecacheMaterial(FMaterial *mat, int translation) {}
 	virtual void PrequeueMaterial(FMaterial *mat, int translation) {}
 
-	virtual bool BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI = false, bool secondary = false) { PrecacheMaterial(mat, translation.index()); return true; }	// @Cockatrice - Default implementation for now. DOES NOT BG CACHE 
-	virtual bool BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI = false) { return false; }
+	virtual bool BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI = false, bool secondary = false, float priority = 0) { PrecacheMaterial(mat, translation.index()); return true; }	// @Cockatrice - Default implementation for now. DOES NOT BG CACHE 
+	virtual bool BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI = false, float priority = 0) { return false; }
 	virtual bool BackgroundLoadModel(FModel* model) { return false; }
 	virtual bool CachingActive() { return false; }																	// Is background cache currently running?
 	virtual float CacheProgress() { return 0; }																		// Current progress of background cache op
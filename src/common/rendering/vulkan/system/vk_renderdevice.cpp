@@ -66,6 +66,7 @@
 #include "engineerrors.h"
 #include "c_dispatch.h"
 #include "image.h"
+#include "texdiskcache.h"
 #include "model.h"
 
 
@@ -242,6 +243,8 @@ float VulkanRenderDevice::CacheProgress() {
 // @Cockatrice - Background Loader Stuff ===========================================
 // =================================================================================
 VkTexLoadThread::~VkTexLoadThread() {
+	stop();
+
 	/*VulkanDevice* device = cmd->GetFrameBuffer()->device;
 
 	// Finish up anything that was running so we can destroy the resources
@@ -315,23 +318,32 @@ bool VkTexLoadThread::loadResource(VkTexLoadIn &input, VkTexLoadOut &output) {
 	unsigned char* pixelData = nullptr;
 	size_t pixelDataSize = 0;
 
+	// Decoded pixels may already be in the disk cache from a previous run
+	FTexDiskCacheKey cacheKey;
+	const bool cacheable = !gpu && TexDiskCache.MakeKey(params, exx, input.spi.notrimming, cacheKey);
+	SpritePositioningInfo* cacheSpi = input.spi.generateSpi ? output.spi.info : nullptr;
+
 	if (exx && !gpu) {
 		pixelDataSize = 4u * (size_t)buffWidth * (size_t)buffHeight;
 		pixelData = (unsigned char*)malloc(pixelDataSize);
-		memset(pixelData, 0, pixelDataSize);
 
-		FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
+		if (!cacheable || !TexDiskCache.Read(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi)) {
+			memset(pixelData, 0, pixelDataSize);
+			FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
+
+			// This is incredibly wasteful, but necessary for now since we can't read the bitmap with an offset into a larger buffer
+			// Read into a buffer and blit 
+			FBitmap srcBitmap;
+			srcBitmap.Create(srcWidth, srcHeight);
+			output.isTranslucent = src->ReadPixels(params, &srcBitmap);
+			pixels.Blit(exx, exx, srcBitmap);
 
-		// This is incredibly wasteful, but necessary for now since we can't read the bitmap with an offset into a larger buffer
-		// Read into a buffer and blit 
-		FBitmap srcBitmap;
-		srcBitmap.Create(srcWidth, srcHeight);
-		output.isTranslucent = src->ReadPixels(params, &srcBitmap);
-		pixels.Blit(exx, exx, srcBitmap);
+			// If we need sprite positioning info, generate it here and assign it in the main thread later
+			if (input.spi.generateSpi) {
+				FGameTexture::GenerateInitialSpriteData(output.spi.info, &srcBitmap, input.spi.shouldExpand, input.spi.notrimming);
+			}
 
-		// If we need sprite positioning info, generate it here and assign it in the main thread later
-		if (input.spi.generateSpi) {
-			FGameTexture::GenerateInitialSpriteData(output.spi.info, &srcBitmap, input.spi.shouldExpand, input.spi.notrimming);
+			if (cacheable) TexDiskCache.Write(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi);
 		}
 
 		output.totalDataSize = pixelDataSize;
@@ -370,15 +382,19 @@ bool VkTexLoadThread::loadResource(VkTexLoadIn &input, VkTexLoadOut &output) {
 		else {
 			pixelDataSize = 4u * (size_t)buffWidth * (size_t)buffHeight;
 			pixelData = (unsigned char*)malloc(pixelDataSize);
-			memset(pixelData, 0, pixelDataSize);
+			output.totalDataSize = pixelDataSize;
 
-			FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
+			if (!cacheable || !TexDiskCache.Read(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi)) {
+				memset(pixelData, 0, pixelDataSize);
+				FBitmap pixels(pixelData, buffWidth * 4, buffWidth, buffHeight);
 
-			output.isTranslucent = src->ReadPixels(params, &pixels);
-			output.totalDataSize = pixelDataSize;
+				output.isTranslucent = src->ReadPixels(params, &pixels);
 
-			if (input.spi.generateSpi) {
-				FGameTexture::GenerateInitialSpriteData(output.spi.info, &pixels, input.spi.shouldExpand, input.spi.notrimming);
+				if (input.spi.generateSpi) {
+					FGameTexture::GenerateInitialSpriteData(output.spi.info, &pixels, input.spi.shouldExpand, input.spi.notrimming);
+				}
+
+				if (cacheable) TexDiskCache.Write(cacheKey, pixelData, buffWidth, buffHeight, output.isTranslucent, cacheSpi);
 			}
 		}
 	}
@@ -662,10 +678,12 @@ void VulkanRenderDevice::UpdateBackgroundCache(bool flush) {
 	while (patchQueue.dequeue(qp)) {
 		FMaterial * gltex = FMaterial::ValidateTexture(qp.tex, qp.scaleFlags, true);
 		if (gltex && !gltex->IsHardwareCached(qp.translation)) {
-			BackgroundCacheMaterial(gltex, FTranslationID::fromInt(qp.translation), qp.generateSPI);
+			BackgroundCacheMaterial(gltex, FTranslationID::fromInt(qp.translation), qp.generateSPI, false, qp.priority);
 		}
 	}
 
+	ReprioritizeTexQueue();
+
 	// Process any loaded models
 	VkModelLoadOut modelOut;
 	while (modelOutQueue.dequeue(modelOut)) {
@@ -812,6 +830,10 @@ void VulkanRenderDevice::StopBackgroundCache() {
 	primaryTexQueue.clear();
 	secondaryTexQueue.clear();
 	modelInQueue.clear();
+	{
+		std::lock_guard<std::mutex> lock(texPrioritiesLock);
+		texPriorities.Clear();
+	}
 
 	for (auto& tfr : bgTransferThreads) {
 		tfr->stop();
@@ -900,6 +922,7 @@ void VulkanRenderDevice::InitializeState()
 		else {
 			// Init queues but only load from disk, upload will have to happen on the main thread
 			bgUploadEnabled = false;
+			numThreads = ResourceLoaderPool::Instance().numWorkers();	// Decode-only loaders share the loader pool
 
 			for (int x = 0; x < numThreads; x++) {
 				std::unique_ptr<VkTexLoadThread> ptr(new VkTexLoadThread(nullptr, device.get(), -1, &primaryTexQueue, &secondaryTexQueue, &outputTexQueue));
@@ -1036,14 +1059,14 @@ bool VulkanRenderDevice::BackgroundLoadModel(FModel* model) {
 
 
 // @Cockatrice - Cache a texture material, intended for use outside of the main thread
-bool VulkanRenderDevice::BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI) {
+bool VulkanRenderDevice::BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI, float priority) {
 	if (!tex || !tex->isValid() || tex->GetID().GetIndex() == 0) {
 
 		return false;
 	}
 
 	QueuedPatch qp = {
-		tex, translation.index(), scaleFlags, makeSPI
+		tex, translation.index(), scaleFlags, makeSPI, priority
 	};
 
 	patchQueue.queue(qp);
@@ -1054,7 +1077,7 @@ bool VulkanRenderDevice::BackgroundCacheTextureMaterial(FGameTexture *tex, FTran
 
 // @Cockatrice - Submit each texture in the material to the background loader
 // Call from main thread only
-bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI, bool secondary) {
+bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI, bool secondary, float priority) {
 	if (mat->Source()->GetUseType() == ETextureType::SWCanvas) {
 		return false;
 	}
@@ -1082,9 +1105,14 @@ bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID
 			[](void* a, VkTexLoadIn& b)
 		{ return (VkHardwareTexture*)a == b.tex; })) {
 			systex->SetHardwareState(IHardwareTexture::HardwareState::LOADING, 0);
+			in.priority = priority;
+			RequestTexPriority(systex, priority);
 			primaryTexQueue.queue(in);
 			return true;
 		}
+	} else if (lumpExists && !secondary && systex->GetState() == IHardwareTexture::HardwareState::LOADING) {
+		// Already queued, make sure it is sorted by the most important request this frame
+		RequestTexPriority(systex, priority);
 	} else if (lumpExists && systex->GetState() == IHardwareTexture::HardwareState::NONE) {
 		systex->SetHardwareState(secondary ? IHardwareTexture::HardwareState::CACHING : IHardwareTexture::HardwareState::LOADING);
 
@@ -1107,11 +1135,15 @@ bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID
 				spi,
 				systex,
 				mat->sourcetex,
-				allowMips
+				allowMips,
+				priority
 			};
 
 			if (secondary) secondaryTexQueue.queue(in);
-			else primaryTexQueue.queue(in);
+			else {
+				RequestTexPriority(systex, priority);
+				primaryTexQueue.queue(in);
+			}
 		}
 		else {
 			systex->SetHardwareState(IHardwareTexture::HardwareState::READY); // TODO: Set state to a special "unloadable" state
@@ -1136,9 +1168,13 @@ bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID
 				[](void* a, VkTexLoadIn& b)
 			{ return (VkHardwareTexture*)a == b.tex; })) {
 				syslayer->SetHardwareState(IHardwareTexture::HardwareState::LOADING, 0);
+				in.priority = priority;
+				RequestTexPriority(syslayer, priority);
 				primaryTexQueue.queue(in);
 				return true;
 			}
+		} else if (lumpExists && !secondary && syslayer->GetState() == IHardwareTexture::HardwareState::LOADING) {
+			RequestTexPriority(syslayer, priority);
 		} else if (lumpExists && syslayer->GetState() == IHardwareTexture::HardwareState::NONE) {
 			syslayer->SetHardwareState(secondary ? IHardwareTexture::HardwareState::CACHING : IHardwareTexture::HardwareState::LOADING);
 			
@@ -1158,11 +1194,15 @@ bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID
 					},
 					syslayer,
 					nullptr,
-					allowMips
+					allowMips,
+					priority
 				};
 
 				if (secondary) secondaryTexQueue.queue(in);
-				else primaryTexQueue.queue(in);
+				else {
+					RequestTexPriority(syslayer, priority);
+					primaryTexQueue.queue(in);
+				}
 			}
 			else {
 				syslayer->SetHardwareState(IHardwareTexture::HardwareState::READY); // TODO: Set state to a special "unloadable" state
@@ -1177,6 +1217,32 @@ bool VulkanRenderDevice::BackgroundCacheMaterial(FMaterial *mat, FTranslationID
 	return true;
 }
 
+
+// @Cockatrice - Remember the most important request for a queued texture this frame
+void VulkanRenderDevice::RequestTexPriority(VkHardwareTexture* tex, float priority) {
+	std::lock_guard<std::mutex> lock(texPrioritiesLock);
+	float* p = texPriorities.CheckKey(tex);
+	if (p) *p = max(*p, priority);
+	else texPriorities.Insert(tex, priority);
+}
+
+
+// @Cockatrice - Re-sort the primary queue by the priorities requested this frame
+// Textures that were not requested again sink behind fresh requests
+void VulkanRenderDevice::ReprioritizeTexQueue() {
+	std::lock_guard<std::mutex> lock(texPrioritiesLock);
+	if (primaryTexQueue.size() > 1) {
+		primaryTexQueue.foreach([&](VkTexLoadIn& in) {
+			float* p = texPriorities.CheckKey(in.tex);
+			in.priority = p ? *p : in.priority * 0.5f;
+		});
+
+		primaryTexQueue.sort([](const VkTexLoadIn& a, const VkTexLoadIn& b) { return a.priority > b.priority; });
+	}
+
+	texPriorities.Clear();
+}
+
 IHardwareTexture *VulkanRenderDevice::CreateHardwareTexture(int numchannels)
 {
 	return new VkHardwareTexture(this, numchannels);
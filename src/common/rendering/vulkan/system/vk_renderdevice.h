@@ -44,6 +44,7 @@ struct VkTexLoadIn {
 	VkHardwareTexture *tex;					// Texture is created in main thread
 	FGameTexture *gtex;
 	bool allowMipmaps;
+	float priority = 0;		// Primary queue is sorted by this each frame, higher loads first
 };
 
 struct VkTexLoadOut {
@@ -114,15 +115,18 @@ protected:
 	bool loadResource(VkTexLoadIn &input, VkTexLoadOut &output) override;
 	void cancelLoad() override;
 	void completeLoad() override;
+	bool usesDedicatedThread() override { return cmd != nullptr; }	// Bound to an upload queue
 };
 
 
 class VkModelLoadThread : public ResourceLoader2<VkModelLoadIn, VkModelLoadOut> {
 public:
 	VkModelLoadThread(TSQueue<VkModelLoadIn>* inQueue, TSQueue<VkModelLoadOut>* outQueue) : ResourceLoader2(inQueue, nullptr, outQueue) {
-		
+		mPriority = LOADER_PRIORITY_LOW;
 	}
 
+	~VkModelLoadThread() override { stop(); }
+
 protected:
 	std::atomic<int> maxQueue;
 
@@ -166,8 +170,8 @@ public:
 	bool CompileNextShader() override;
 	void PrecacheMaterial(FMaterial *mat, int translation) override;
 	void PrequeueMaterial(FMaterial *mat, int translation) override;
-	bool BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI = false, bool secondary = false) override;
-	bool BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI = false) override;
+	bool BackgroundCacheMaterial(FMaterial *mat, FTranslationID translation, bool makeSPI = false, bool secondary = false, float priority = 0) override;
+	bool BackgroundCacheTextureMaterial(FGameTexture *tex, FTranslationID translation, int scaleFlags, bool makeSPI = false, float priority = 0) override;
 	bool BackgroundLoadModel(FModel* model) override;
 	bool CachingActive() override;
 	bool SupportsBackgroundCache() override { return bgTransferEnabled; }
@@ -230,8 +234,12 @@ private:
 		FGameTexture *tex;
 		int translation, scaleFlags;
 		bool generateSPI;
+		float priority;
 	};
 
+	void RequestTexPriority(VkHardwareTexture* tex, float priority);
+	void ReprioritizeTexQueue();
+
 	//inline int findLeastFullSecondaryQueue();
 	//inline int findLeastFullPrimaryQueue();
 
@@ -244,6 +252,8 @@ private:
 	TSQueue<VkModelLoadIn> modelInQueue;
 	TSQueue<VkModelLoadOut> modelOutQueue;
 	std::unique_ptr<VkModelLoadThread> modelThread;						// Loads models, always 1 thread
+	TMap<VkHardwareTexture*, float> texPriorities;						// Highest priority each queued texture was requested at this frame
+	std::mutex texPrioritiesLock;										// Requests come from the render workers
 	std::vector<std::unique_ptr<VkTexLoadThread>> bgTransferThreads;	// @Cockatrice - Threads that handle the background transfers
 	std::unique_ptr<VulkanFence> bgtFence;								// @Cockatrice - Used to block for tranferring resources between queues
 	std::vector<std::unique_ptr<VulkanSemaphore>> bgtSm4List;			// Semaphores to release after queue resource transfers
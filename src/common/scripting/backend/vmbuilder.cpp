@@ -956,6 +956,7 @@ void FFunctionBuildList::Build()
 		delete item.Code;
 		disasmdump.Flush();
 	}
+	JitCacheFlush();
 	VMFunction::CreateRegUseInfo();
 	FScriptPosition::StrictErrors = strictdecorate;
 
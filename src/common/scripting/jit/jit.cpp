@@ -19,6 +19,10 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 		return nullptr;
 #endif
 
+	// @Cockatrice - Reuse the code from an earlier run when nothing it depends on has changed
+	if (void *cached = JitCacheLoad(sfunc))
+		return reinterpret_cast<JitFuncPtr>(cached);
+
 	using namespace asmjit;
 	StringLogger logger;
 	try
@@ -274,6 +278,17 @@ void JitCompiler::Setup()
 
 	CreateRegisters();
 	IncrementVMCalls();
+
+	// @Cockatrice - Count the calls of functions that have something to inline, tier 2 recompiles them once they're hot
+	if (Tier == 1 && JitWantsProfile(sfunc))
+	{
+		Profile = JitGetProfile(sfunc);
+		EmitTierCountdown();
+	}
+
+	// @Cockatrice - Finds the addresses in the final code for the JIT cache
+	if (Tier == 1) JitCacheAddPass(cc, this);
+
 	SetupFrame();
 }
 
@@ -399,7 +414,7 @@ void JitCompiler::SetupFullVMFrame()
 	stack = cc.newIntPtr("stack");
 	auto allocFrame = CreateCall<VMFrameStack *, VMScriptFunction *, VMValue *, int>(CreateFullVMFrame);
 	allocFrame->setRet(0, stack);
-	allocFrame->setArg(0, imm_ptr(sfunc));
+	allocFrame->setArg(0, ImmPtr(sfunc));
 	allocFrame->setArg(1, args);
 	allocFrame->setArg(2, numargs);
 
@@ -440,7 +455,7 @@ void JitCompiler::IncrementVMCalls()
 	// VMCalls[0]++
 	auto vmcallsptr = newTempIntPtr();
 	auto vmcalls = newTempInt32();
-	cc.mov(vmcallsptr, asmjit::imm_ptr(VMCalls));
+	cc.mov(vmcallsptr, ImmPtr(VMCalls));
 	cc.mov(vmcalls, asmjit::x86::dword_ptr(vmcallsptr));
 	cc.add(vmcalls, (int)1);
 	cc.mov(asmjit::x86::dword_ptr(vmcallsptr), vmcalls);
@@ -504,12 +519,22 @@ asmjit::Label JitCompiler::EmitThrowExceptionLabel(EVMAbortException reason)
 	EmitThrowException(reason);
 	cc.setCursor(cursor);
 
+	AddLineInfo(label, CurrentLine());
+
+	return label;
+}
+
+void JitCompiler::AddLineInfo(asmjit::Label label, int line)
+{
 	JitLineInfo info;
 	info.Label = label;
-	info.LineNumber = sfunc->PCToLine(pc);
+	info.LineNumber = line;
+	if (Inline)
+	{
+		info.Inlined = sfunc;
+		info.CallLine = Inline->line;
+	}
 	LineInfo.Push(info);
-
-	return label;
 }
 
 asmjit::X86Gp JitCompiler::CheckRegD(int r0, int r1)
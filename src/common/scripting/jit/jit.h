@@ -5,4 +5,5 @@
 
 JitFuncPtr JitCompile(VMScriptFunction *func);
 void JitDumpLog(FILE *file, VMScriptFunction *func);
+void JitCacheFlush();	// @Cockatrice - Writes the JIT cache if anything was added
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int maxFrames = -1);
@@ -0,0 +1,739 @@
+/*
+** jit_cache.cpp
+** @Cockatrice - Persistent cache for JIT compiled script functions
+**
+** The machine code of every compiled function is kept in a file in the
+** cache directory, keyed by a hash of its bytecode and everything else the
+** code generator looks at. The only parts of the code that differ between
+** runs are the addresses baked into it, so each of them is stored as a
+** relocation that says where it came from: the function itself, one of its
+** constant tables, or a native function or global inside the executable.
+** When a function is loaded from the cache those addresses are written
+** back in for the current run, which is a lot faster than running it
+** through asmjit again.
+**
+** Functions where an address can't be accounted for are never cached,
+** and the whole file is thrown away when the executable changes or its
+** checksum doesn't match.
+**
+*/
+
+#include <algorithm>
+#include <memory>
+
+#include "jit.h"
+#include "jitintern.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "md5.h"
+#include "i_specialpaths.h"
+#include "printf.h"
+#include "version.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+CVAR(Bool, vm_jit_cache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+static const char *JitCacheMagic = "ZJIT";
+static const uint32_t JitCacheVersion = 3;
+
+enum EJitRelocKind : uint8_t
+{
+	JITREL_Function,		// The script function itself
+	JITREL_KonstD,			// Byte offset into one of the function's constant tables
+	JITREL_KonstF,
+	JITREL_KonstS,
+	JITREL_KonstA,
+	JITREL_KonstAValue,		// Pointer stored in a KonstA entry
+	JITREL_Module,			// Offset into the executable, for natives and globals
+	JITREL_Code,			// Offset into the code itself
+	JITREL_Profile,			// Byte offset into the function's tiering profile
+	JITREL_ProfileSites,	// Byte offset into the profile's call sites
+};
+
+struct JitCacheReloc
+{
+	uint32_t Offset;
+	uint8_t Relative;		// 32 bit displacement of a call instead of a 64 bit address
+	uint8_t Kind;
+	uint16_t Pad;
+	int64_t Value;
+};
+
+struct JitCacheEntry
+{
+	TArray<uint8_t> Code;
+	TArray<uint8_t> Unwind;
+	uint32_t FdeFunctionStart = 0;
+	TArray<JitCacheReloc> Relocs;
+	TArray<JitLineInfo> LineInfo;
+	bool Used = false;		// Only entries used in this session are written back
+};
+
+static TMap<FString, JitCacheEntry> JitCache;
+static FString JitCacheBuild;
+static bool JitCacheLoaded, JitCacheDirty;
+static int JitCacheHits, JitCacheMisses, JitCacheRejected;
+
+//==========================================================================
+//
+// The executable
+//
+//==========================================================================
+
+static const uint8_t *JitModuleBase()
+{
+	static const uint8_t *base = nullptr;
+	static bool checked = false;
+	if (!checked)
+	{
+		checked = true;
+#ifdef WIN32
+		HMODULE module;
+		if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)&JitModuleBase, &module))
+			base = (const uint8_t *)module;
+#else
+		Dl_info info;
+		if (dladdr((const void *)&JitModuleBase, &info) && info.dli_fbase != nullptr)
+			base = (const uint8_t *)info.dli_fbase;
+#endif
+	}
+	return base;
+}
+
+static bool InJitModule(const void *p)
+{
+#ifdef WIN32
+	HMODULE module;
+	return GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR)p, &module) && (const uint8_t *)module == JitModuleBase();
+#else
+	Dl_info info;
+	return dladdr(p, &info) && info.dli_fbase == JitModuleBase();
+#endif
+}
+
+// Local builds of the same commit still move the natives around, so the executable itself is part of this
+static FString GetJitBuildStamp()
+{
+	FString stamp;
+	stamp.Format("%s %s %s %d", GetVersionString(), GetGitHash(), GetGitTime(), (int)sizeof(void *));
+
+#ifdef WIN32
+	wchar_t path[MAX_PATH];
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (GetModuleFileNameW((HMODULE)JitModuleBase(), path, MAX_PATH) && GetFileAttributesExW(path, GetFileExInfoStandard, &attr))
+	{
+		stamp.AppendFormat(" %u %u %u", (unsigned)attr.nFileSizeLow, (unsigned)attr.ftLastWriteTime.dwLowDateTime, (unsigned)attr.ftLastWriteTime.dwHighDateTime);
+	}
+#else
+#ifdef __linux__
+	const char *path = "/proc/self/exe";
+#else
+	Dl_info info;
+	const char *path = dladdr((const void *)&JitModuleBase, &info) ? info.dli_fname : "";
+#endif
+	struct stat st;
+	if (stat(path, &st) == 0)
+	{
+		stamp.AppendFormat(" %lld %lld", (long long)st.st_size, (long long)st.st_mtime);
+	}
+#endif
+	return stamp;
+}
+
+//==========================================================================
+//
+// Everything in a script function that the code generator looks at
+//
+//==========================================================================
+
+static FString JitCacheKey(VMScriptFunction *sfunc)
+{
+	MD5Context md5;
+	auto add = [&](const void *data, size_t size) { if (size > 0) md5.Update((const uint8_t *)data, (unsigned)size); };
+	auto addString = [&](const char *str) { add(str, strlen(str) + 1); };
+
+	addString(sfunc->PrintableName);
+	addString(sfunc->SourceFileName.GetChars());
+	add(sfunc->Code, sfunc->CodeSize * sizeof(VMOP));
+	add(sfunc->LineInfo, sfunc->LineInfoCount * sizeof(FStatementInfo));
+	add(sfunc->KonstD, sfunc->NumKonstD * sizeof(int));
+	add(sfunc->KonstF, sfunc->NumKonstF * sizeof(double));
+	for (int i = 0; i < sfunc->NumKonstS; i++)
+	{
+		addString(sfunc->KonstS[i].GetChars());
+	}
+
+	int shape[] = { sfunc->NumRegD, sfunc->NumRegF, sfunc->NumRegS, sfunc->NumRegA, sfunc->NumKonstA, sfunc->MaxParam, sfunc->NumArgs,
+		(int)sfunc->StackSize, sfunc->ExtraSpace, (int)sfunc->SpecialInits.Size(), sfunc->VarFlags };
+	add(shape, sizeof(shape));
+
+	if (sfunc->Proto != nullptr)
+	{
+		for (auto type : sfunc->Proto->ArgumentTypes)
+		{
+			addString(type->DescriptiveName());
+		}
+	}
+	add(sfunc->ArgFlags.Data(), sfunc->ArgFlags.Size() * sizeof(uint32_t));
+
+	// Tier 1 code is only instrumented with tiering on
+	uint8_t profiled = JitWantsProfile(sfunc);
+	add(&profiled, sizeof(profiled));
+
+	// Whether a call goes straight to a native is decided while compiling
+	for (int i = 0; i < sfunc->CodeSize; i++)
+	{
+		if (sfunc->Code[i].op != OP_CALL_K) continue;
+
+		auto target = static_cast<VMFunction *>(sfunc->KonstA[sfunc->Code[i].a].v);
+		if (target == nullptr) continue;
+
+		uint8_t direct[2] = { (uint8_t)((target->VarFlags & VARF_Native) && static_cast<VMNativeFunction *>(target)->DirectNativeCall != nullptr), target->ImplicitArgs };
+		addString(target->PrintableName);
+		add(direct, sizeof(direct));
+	}
+
+	uint8_t digest[16];
+	md5.Final(digest);
+
+	char hexdigest[33];
+	for (int i = 0; i < 16; i++)
+	{
+		int v = digest[i] >> 4;
+		hexdigest[i * 2] = v < 10 ? ('0' + v) : ('a' + v - 10);
+		v = digest[i] & 15;
+		hexdigest[i * 2 + 1] = v < 10 ? ('0' + v) : ('a' + v - 10);
+	}
+	hexdigest[32] = 0;
+	return hexdigest;
+}
+
+//==========================================================================
+//
+// Relocations
+//
+//==========================================================================
+
+static bool ClassifyAddress(VMScriptFunction *sfunc, uint64_t addr, JitCacheReloc &reloc)
+{
+	auto inTable = [&](const void *table, size_t size, EJitRelocKind kind)
+	{
+		uint64_t start = (uint64_t)(uintptr_t)table;
+		if (table == nullptr || addr < start || addr >= start + size) return false;
+		reloc.Kind = kind;
+		reloc.Value = (int64_t)(addr - start);
+		return true;
+	};
+
+	if (addr == (uint64_t)(uintptr_t)sfunc)
+	{
+		reloc.Kind = JITREL_Function;
+		reloc.Value = 0;
+		return true;
+	}
+	if (inTable(sfunc->KonstD, sfunc->NumKonstD * sizeof(int), JITREL_KonstD)) return true;
+	if (inTable(sfunc->KonstF, sfunc->NumKonstF * sizeof(double), JITREL_KonstF)) return true;
+	if (inTable(sfunc->KonstS, sfunc->NumKonstS * sizeof(FString), JITREL_KonstS)) return true;
+	if (inTable(sfunc->KonstA, sfunc->NumKonstA * sizeof(FVoidObj), JITREL_KonstA)) return true;
+	if (auto profile = sfunc->JitProfile)
+	{
+		if (inTable(profile, sizeof(JitFunctionProfile), JITREL_Profile)) return true;
+		if (inTable(profile->Sites.Data(), profile->Sites.Size() * sizeof(JitCallSiteProfile), JITREL_ProfileSites)) return true;
+	}
+
+	for (int i = 0; i < sfunc->NumKonstA; i++)
+	{
+		if ((uint64_t)(uintptr_t)sfunc->KonstA[i].v == addr)
+		{
+			reloc.Kind = JITREL_KonstAValue;
+			reloc.Value = i;
+			return true;
+		}
+	}
+
+	if (InJitModule((const void *)(uintptr_t)addr))
+	{
+		reloc.Kind = JITREL_Module;
+		reloc.Value = (int64_t)(addr - (uint64_t)(uintptr_t)JitModuleBase());
+		return true;
+	}
+	return false;
+}
+
+static bool ResolveAddress(VMScriptFunction *sfunc, const uint8_t *code, const JitCacheReloc &reloc, uint64_t &addr)
+{
+	auto fromTable = [&](const void *table, size_t size)
+	{
+		if (reloc.Value < 0 || (uint64_t)reloc.Value >= size) return false;
+		addr = (uint64_t)(uintptr_t)table + reloc.Value;
+		return true;
+	};
+
+	switch (reloc.Kind)
+	{
+	case JITREL_Function:	addr = (uint64_t)(uintptr_t)sfunc; return true;
+	case JITREL_KonstD:		return fromTable(sfunc->KonstD, sfunc->NumKonstD * sizeof(int));
+	case JITREL_KonstF:		return fromTable(sfunc->KonstF, sfunc->NumKonstF * sizeof(double));
+	case JITREL_KonstS:		return fromTable(sfunc->KonstS, sfunc->NumKonstS * sizeof(FString));
+	case JITREL_KonstA:		return fromTable(sfunc->KonstA, sfunc->NumKonstA * sizeof(FVoidObj));
+	case JITREL_Module:		addr = (uint64_t)(uintptr_t)JitModuleBase() + reloc.Value; return true;
+	case JITREL_Code:		addr = (uint64_t)(uintptr_t)code + reloc.Value; return true;
+	case JITREL_Profile:	return fromTable(JitGetProfile(sfunc), sizeof(JitFunctionProfile));
+	case JITREL_ProfileSites:
+	{
+		auto profile = JitGetProfile(sfunc);
+		return fromTable(profile->Sites.Data(), profile->Sites.Size() * sizeof(JitCallSiteProfile));
+	}
+
+	case JITREL_KonstAValue:
+		if (reloc.Value < 0 || reloc.Value >= sfunc->NumKonstA) return false;
+		addr = (uint64_t)(uintptr_t)sfunc->KonstA[reloc.Value].v;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static TArray<uint64_t> SortedAddresses(const TArray<const void *> &addresses)
+{
+	TArray<uint64_t> sorted;
+	for (auto addr : addresses) sorted.Push((uint64_t)(uintptr_t)addr);
+	std::sort(sorted.begin(), sorted.end());
+	return sorted;
+}
+
+// Runs after register allocation and puts labels around every instruction that carries one of the
+// compiler's addresses as an immediate, so BuildRelocs knows where asmjit encoded it. Calls and jumps
+// are left out, asmjit lists their targets in its relocation table.
+class JitCacheAddressPass : public asmjit::CBPass
+{
+public:
+	JitCacheAddressPass(JitCompiler *compiler) : CBPass("JitCacheAddressPass"), Compiler(compiler) { }
+
+	asmjit::Error process(asmjit::Zone *zone) noexcept override
+	{
+		using namespace asmjit;
+
+		TArray<uint64_t> sorted = SortedAddresses(Compiler->Addresses);
+		for (CBNode *node = _cb->getFirstNode(); node != nullptr; node = node->getNext())
+		{
+			if (node->getType() != CBNode::kNodeInst && node->getType() != CBNode::kNodeFuncCall) continue;
+
+			CBInst *inst = node->as<CBInst>();
+			if (inst->getInstId() == X86Inst::kIdCall || inst->getInstId() == X86Inst::kIdJmp) continue;
+
+			for (uint32_t i = 0; i < inst->getOpCount(); i++)
+			{
+				const Operand &op = inst->getOpArray()[i];
+				if (!op.isImm()) continue;
+
+				uint64_t value = static_cast<const Imm &>(op).getUInt64();
+				if (!std::binary_search(sorted.begin(), sorted.end(), value)) continue;
+
+				CBLabel *start = _cb->newLabelNode();
+				CBLabel *end = _cb->newLabelNode();
+				if (start == nullptr || end == nullptr) return DebugUtils::errored(kErrorNoHeapMemory);
+				_cb->addBefore(start, inst);
+				_cb->addAfter(end, inst);
+				Compiler->AddressSites.Push({ start->getLabel(), end->getLabel(), value });
+				break;
+			}
+		}
+		return kErrorOk;
+	}
+
+private:
+	JitCompiler *Compiler;
+};
+
+void JitCacheAddPass(asmjit::X86Compiler &cc, JitCompiler *compiler)
+{
+	if (vm_jit_cache) cc.addPass(cc.newPassT<JitCacheAddressPass>(compiler));
+}
+
+// Turns every address the compiler put into the code into a relocation. Calls are relative and listed
+// in asmjit's relocation table. Those that didn't reach go through a trampoline behind the code, which
+// is filled in the order of the table. Everything else is a 64 bit immediate at the end of one of the
+// instructions JitCacheAddressPass marked. If the number of places found doesn't match what the
+// compiler recorded, the function is not cached.
+static bool BuildRelocs(JitCompiler *compiler, asmjit::CodeHolder *code, const uint8_t *p, size_t size, TArray<JitCacheReloc> &relocs)
+{
+	using namespace asmjit;
+
+	VMScriptFunction *sfunc = compiler->GetScriptFunction();
+	TArray<uint64_t> sorted = SortedAddresses(compiler->Addresses);
+
+	unsigned found = 0;
+	size_t trampOffset = code->getSectionEntry(0)->getBuffer().getLength();
+	const auto &entries = code->getRelocEntries();
+	for (size_t i = 0; i < entries.getLength(); i++)
+	{
+		const RelocEntry *re = entries[i];
+		if (re->getType() == RelocEntry::kTypeNone) continue;
+
+		size_t offset = (size_t)re->getSourceOffset();
+		if (offset + re->getSize() > size) return false;
+
+		JitCacheReloc reloc = { (uint32_t)offset, 0, 0, 0, 0 };
+		switch (re->getType())
+		{
+		case RelocEntry::kTypeRelToAbs:
+			if (re->getSize() != 8) return false;
+			reloc.Kind = JITREL_Code;
+			reloc.Value = (int64_t)re->getData();
+			relocs.Push(reloc);
+			continue;
+
+		case RelocEntry::kTypeAbsToAbs:
+			if (re->getSize() != 8) return false;
+			break;
+
+		case RelocEntry::kTypeAbsToRel:
+		case RelocEntry::kTypeTrampoline:
+			if (re->getSize() != 4 || offset < 2) return false;
+			if (p[offset - 1] == 0xE8 || p[offset - 1] == 0xE9)
+			{
+				reloc.Relative = 1;
+			}
+			else if (re->getType() == RelocEntry::kTypeTrampoline && p[offset - 2] == 0xFF && (p[offset - 1] == 0x15 || p[offset - 1] == 0x25))
+			{
+				// Patched by asmjit into an indirect call through the next trampoline slot
+				uint64_t value;
+				if (trampOffset + 8 > size) return false;
+				memcpy(&value, p + trampOffset, 8);
+				if (value != re->getData()) return false;
+				reloc.Offset = (uint32_t)trampOffset;
+				trampOffset += 8;
+			}
+			else
+			{
+				return false;
+			}
+			break;
+
+		default:
+			return false;
+		}
+
+		if (!ClassifyAddress(sfunc, re->getData(), reloc)) return false;
+		relocs.Push(reloc);
+		if (std::binary_search(sorted.begin(), sorted.end(), re->getData())) found++;
+	}
+
+	for (auto &site : compiler->AddressSites)
+	{
+		if (!code->isLabelValid(site.Start) || !code->isLabelValid(site.End)) return false;
+
+		// x86 puts a 64 bit immediate last in the instruction
+		size_t start = (size_t)code->getLabelOffset(site.Start);
+		size_t end = (size_t)code->getLabelOffset(site.End);
+		if (end < start + 8 || end > size) return false;
+
+		uint64_t value;
+		memcpy(&value, p + end - 8, 8);
+		if (value != site.Value) return false;
+
+		JitCacheReloc reloc = { (uint32_t)(end - 8), 0, 0, 0, 0 };
+		if (!ClassifyAddress(sfunc, value, reloc)) return false;
+		relocs.Push(reloc);
+		found++;
+	}
+
+	return found == compiler->Addresses.Size();
+}
+
+//==========================================================================
+//
+// File
+//
+//==========================================================================
+
+static FString JitCacheFileName(bool create)
+{
+	FString path = M_GetCachePath(create);
+	if (create) CreatePath(path.GetChars());
+	path << "/jitcache.zdjc";
+	return path;
+}
+
+static void LoadJitCache()
+{
+	if (JitCacheLoaded) return;
+	JitCacheLoaded = true;
+	JitCacheBuild = GetJitBuildStamp();
+
+	FString path = JitCacheFileName(false);
+	FileReader file;
+	if (!file.OpenFile(path.GetChars()))
+		return;
+
+	// The checksum covers everything behind it and is checked before any of the code is looked at
+	char magic[4];
+	uint8_t checksum[16], digest[16];
+	if (file.Read(magic, 4) != 4 || memcmp(magic, JitCacheMagic, 4) != 0 || file.ReadUInt32() != JitCacheVersion || file.Read(checksum, 16) != 16)
+		return;
+	auto payload = file.Read(file.GetLength() - file.Tell());
+	file.Close();
+
+	MD5Context md5;
+	md5.Update(payload.bytes(), (unsigned)payload.size());
+	md5.Final(digest);
+	if (memcmp(checksum, digest, 16) != 0)
+	{
+		DPrintf(DMSG_NOTIFY, "JIT cache is damaged, discarding it\n");
+		RemoveFile(path.GetChars());
+		return;
+	}
+
+	FileReader fr;
+	fr.OpenMemory(payload.data(), payload.size());
+
+	auto readArray = [&](auto &array, uint32_t limit)
+	{
+		uint32_t count = fr.ReadUInt32();
+		if (count > limit) return false;
+		array.Resize(count);
+		size_t bytes = count * sizeof(array[0]);
+		return bytes == 0 || fr.Read(array.Data(), bytes) == (FileReader::Size)bytes;
+	};
+
+	TArray<char> build;
+	if (!readArray(build, 4096) || FString(build.Data(), build.Size()).Compare(JitCacheBuild) != 0)
+		return;
+
+	uint32_t count = fr.ReadUInt32();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		char hexdigest[33];
+		if (fr.Read(hexdigest, 32) != 32)
+			break;
+		hexdigest[32] = 0;
+
+		JitCacheEntry entry;
+		TArray<int32_t> lines;
+		bool ok = readArray(entry.Code, 64 * 1024 * 1024) && readArray(entry.Unwind, 64 * 1024);
+		entry.FdeFunctionStart = fr.ReadUInt32();
+		ok = ok && readArray(lines, 1024 * 1024) && readArray(entry.Relocs, 1024 * 1024);
+		if (!ok || (lines.Size() & 1) || entry.FdeFunctionStart > entry.Unwind.Size())
+		{
+			// Keep what was read so far, the rest will just be compiled again
+			break;
+		}
+
+		for (unsigned j = 0; j < lines.Size(); j += 2)
+		{
+			JitLineInfo info;
+			info.InstructionIndex = lines[j];
+			info.LineNumber = lines[j + 1];
+			entry.LineInfo.Push(info);
+		}
+		JitCache.Insert(hexdigest, std::move(entry));
+	}
+}
+
+static void SaveJitCache()
+{
+	TArray<uint8_t> payload;
+	auto write = [&](const void *data, size_t size)
+	{
+		if (size > 0) memcpy(&payload[payload.Reserve((unsigned)size)], data, size);
+	};
+	auto writeArray = [&](const auto &array)
+	{
+		uint32_t count = array.Size();
+		write(&count, sizeof(uint32_t));
+		write(array.Data(), count * sizeof(array[0]));
+	};
+
+	uint32_t count = 0;
+	TMap<FString, JitCacheEntry>::ConstPair *pair;
+	{
+		TMap<FString, JitCacheEntry>::ConstIterator it(JitCache);
+		while (it.NextPair(pair))
+		{
+			if (pair->Value.Used) count++;
+		}
+	}
+
+	TArray<char> build(JitCacheBuild.Len(), true);
+	memcpy(build.Data(), JitCacheBuild.GetChars(), build.Size());
+	writeArray(build);
+	write(&count, sizeof(uint32_t));
+
+	TArray<int32_t> lines;
+	TMap<FString, JitCacheEntry>::ConstIterator it(JitCache);
+	while (it.NextPair(pair))
+	{
+		auto &entry = pair->Value;
+		if (!entry.Used) continue;
+
+		lines.Clear();
+		for (auto &info : entry.LineInfo)
+		{
+			lines.Push((int32_t)info.InstructionIndex);
+			lines.Push(info.LineNumber);
+		}
+
+		write(pair->Key.GetChars(), 32);
+		writeArray(entry.Code);
+		writeArray(entry.Unwind);
+		write(&entry.FdeFunctionStart, sizeof(uint32_t));
+		writeArray(lines);
+		writeArray(entry.Relocs);
+	}
+
+	uint8_t checksum[16];
+	MD5Context md5;
+	md5.Update(payload.Data(), payload.Size());
+	md5.Final(checksum);
+
+	// Written next to the old file and only moved over it once it is complete
+	FString path = JitCacheFileName(true);
+	FString temp = path + ".tmp";
+	std::unique_ptr<FileWriter> fw(FileWriter::Open(temp.GetChars()));
+	if (!fw) return;
+
+	bool ok = fw->Write(JitCacheMagic, 4) == 4 &&
+		fw->Write(&JitCacheVersion, sizeof(uint32_t)) == sizeof(uint32_t) &&
+		fw->Write(checksum, 16) == 16 &&
+		fw->Write(payload.Data(), payload.Size()) == payload.Size();
+	fw.reset();
+
+	// Running out of space can also fail the final flush
+	FileReader check;
+	ok = ok && check.OpenFile(temp.GetChars()) && check.GetLength() == (FileReader::Size)(4 + sizeof(uint32_t) + 16 + payload.Size());
+	check.Close();
+
+	if (!ok || !RenameFileReplacing(temp.GetChars(), path.GetChars()))
+	{
+		DPrintf(DMSG_NOTIFY, "Could not write the JIT cache\n");
+		RemoveFile(temp.GetChars());
+	}
+}
+
+//==========================================================================
+//
+// Interface to the compiler
+//
+//==========================================================================
+
+void *JitCacheLoad(VMScriptFunction *sfunc)
+{
+	if (!vm_jit_cache || JitModuleBase() == nullptr) return nullptr;
+	LoadJitCache();
+
+	FString key = JitCacheKey(sfunc);
+	JitCacheEntry *entry = JitCache.CheckKey(key);
+	if (entry == nullptr)
+	{
+		JitCacheMisses++;
+		return nullptr;
+	}
+
+	void *p = AddCachedJitFunction(sfunc, entry->Code, entry->Unwind, entry->FdeFunctionStart, entry->LineInfo, [&](uint8_t *code)
+	{
+		for (auto &reloc : entry->Relocs)
+		{
+			uint64_t addr;
+			if (reloc.Offset + (reloc.Relative ? 4 : 8) > entry->Code.Size() || !ResolveAddress(sfunc, code, reloc, addr))
+				return false;
+
+			if (reloc.Relative)
+			{
+				int64_t disp = (int64_t)(addr - ((uint64_t)(uintptr_t)code + reloc.Offset + 4));
+				if (disp != (int32_t)disp) return false;
+				int32_t disp32 = (int32_t)disp;
+				memcpy(code + reloc.Offset, &disp32, 4);
+			}
+			else
+			{
+				memcpy(code + reloc.Offset, &addr, 8);
+			}
+		}
+		return true;
+	});
+
+	if (p == nullptr)
+	{
+		// Compiled again below, which replaces the entry
+		JitCacheRejected++;
+		return nullptr;
+	}
+
+	JitCacheHits++;
+	if (!entry->Used)
+	{
+		entry->Used = true;
+		JitCacheDirty = true;	// So entries that went unused are dropped
+	}
+	return p;
+}
+
+void JitCacheStore(JitCompiler *compiler, asmjit::CodeHolder *code, const uint8_t *p, size_t size, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart)
+{
+	// Tier 2 code depends on the profile of this session
+	if (!vm_jit_cache || compiler->Tier > 1 || JitModuleBase() == nullptr) return;
+	LoadJitCache();
+
+	VMScriptFunction *sfunc = compiler->GetScriptFunction();
+	TArray<JitCacheReloc> relocs;
+	if (!BuildRelocs(compiler, code, p, size, relocs))
+		return;
+
+	auto &entry = JitCache[JitCacheKey(sfunc)];
+	entry.Code.Resize((unsigned)size);
+	memcpy(entry.Code.Data(), p, size);
+	entry.Unwind = unwindInfo;
+	entry.FdeFunctionStart = fdeFunctionStart;
+	entry.Relocs = std::move(relocs);
+	entry.LineInfo.Clear();
+	for (auto &info : compiler->LineInfo)
+	{
+		JitLineInfo copy;
+		copy.InstructionIndex = info.InstructionIndex;
+		copy.LineNumber = info.LineNumber;
+		entry.LineInfo.Push(copy);
+	}
+	entry.Used = true;
+	JitCacheDirty = true;
+}
+
+void JitCacheFlush()
+{
+	if (JitCacheDirty && vm_jit_cache)
+	{
+		SaveJitCache();
+	}
+	JitCacheDirty = false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+CCMD(jitcache)
+{
+	if (argv.argc() > 1 && !stricmp(argv[1], "clear"))
+	{
+		JitCache.Clear();
+		JitCacheDirty = false;
+		remove(JitCacheFileName(false).GetChars());
+		Printf("JIT cache cleared\n");
+		return;
+	}
+
+	Printf("%u cached functions, %d loaded, %d compiled, %d rejected%s\n", JitCache.CountUsed(), JitCacheHits, JitCacheMisses, JitCacheRejected,
+		vm_jit_cache ? "" : " (vm_jit_cache is off)");
+	if (JitModuleBase() == nullptr) Printf("The executable's base address can't be determined on this system, nothing gets cached\n");
+}
@@ -42,6 +42,35 @@ void JitCompiler::EmitVtbl(const VMOP *op)
 
 void JitCompiler::EmitCALL()
 {
+	// @Cockatrice - A virtual call that only ever went to one function is inlined, behind a check that it still does
+	if (Tier > 1 && pc > sfunc->Code && (pc - 1)->op == OP_VTBL && (pc - 1)->a == A)
+	{
+		TArray<InlineArg> inlineArgs;
+		VMScriptFunction *callee = CanInline(GetMonomorphicTarget(pc - 1), inlineArgs);
+		if (callee)
+		{
+			auto slowpath = cc.newLabel();
+			auto done = cc.newLabel();
+
+			EmitVtbl(pc - 1);
+			auto expected = newTempIntPtr();
+			cc.mov(expected, ImmPtr(callee));
+			cc.cmp(regA[A], expected);
+			cc.jne(slowpath);
+
+			EmitInlineCall(callee, inlineArgs);
+			cc.jmp(done);
+
+			cc.bind(slowpath);
+			EmitVMCall(regA[A], nullptr, false);
+			cc.bind(done);
+
+			DevirtualizedCalls++;
+			pc += C; // Skip RESULTs
+			return;
+		}
+	}
+
 	EmitVMCall(regA[A], nullptr);
 	pc += C; // Skip RESULTs
 }
@@ -54,21 +83,30 @@ void JitCompiler::EmitCALL_K()
 	if (target && (target->VarFlags & VARF_Native))
 		ntarget = static_cast<VMNativeFunction *>(target);
 
-	if (ntarget && ntarget->DirectNativeCall)
+	// @Cockatrice - Small script functions are copied into hot callers
+	TArray<InlineArg> inlineArgs;
+	VMScriptFunction *callee = (Tier > 1 && ntarget == nullptr) ? CanInline(target, inlineArgs) : nullptr;
+
+	if (callee)
+	{
+		EmitInlineCall(callee, inlineArgs);
+		ParamOpcodes.Clear();
+	}
+	else if (ntarget && ntarget->DirectNativeCall)
 	{
 		EmitNativeCall(ntarget);
 	}
 	else
 	{
 		auto ptr = newTempIntPtr();
-		cc.mov(ptr, asmjit::imm_ptr(target));
+		cc.mov(ptr, ImmPtr(target));
 		EmitVMCall(ptr, target);
 	}
 
 	pc += C; // Skip RESULTs
 }
 
-void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
+void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target, bool loadVtbl)
 {
 	using namespace asmjit;
 
@@ -78,8 +116,11 @@ void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
 	if (numparams != B)
 		I_Error("OP_CALL parameter count does not match the number of preceding OP_PARAM instructions");
 
-	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
+	if (loadVtbl && pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
+	{
 		EmitVtbl(pc - 1);
+		if (Profile) EmitCallSiteProfile(pc - 1, vmfunc);
+	}
 
 	FillReturns(pc + 1, C);
 
@@ -150,7 +191,7 @@ int JitCompiler::StoreCallParams()
 			cc.mov(x86::ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, a)), regS[bc]);
 			break;
 		case REGT_STRING | REGT_KONST:
-			cc.mov(tmp, asmjit::imm_ptr(&konsts[bc]));
+			cc.mov(tmp, ImmPtr(&konsts[bc]));
 			cc.mov(x86::ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, sp)), tmp);
 			break;
 		case REGT_POINTER:
@@ -162,7 +203,7 @@ int JitCompiler::StoreCallParams()
 			cc.mov(x86::ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, a)), stackPtr);
 			break;
 		case REGT_POINTER | REGT_KONST:
-			cc.mov(tmp, asmjit::imm_ptr(konsta[bc].v));
+			cc.mov(tmp, ImmPtr(konsta[bc].v));
 			cc.mov(x86::ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, a)), tmp);
 			break;
 		case REGT_FLOAT:
@@ -200,7 +241,7 @@ int JitCompiler::StoreCallParams()
 			cc.mov(x86::ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, a)), stackPtr);
 			break;
 		case REGT_FLOAT | REGT_KONST:
-			cc.mov(tmp, asmjit::imm_ptr(konstf + bc));
+			cc.mov(tmp, ImmPtr(konstf + bc));
 			cc.movsd(tmp2, asmjit::x86::qword_ptr(tmp));
 			cc.movsd(x86::qword_ptr(vmframe, offsetParams + slot * sizeof(VMValue) + myoffsetof(VMValue, f)), tmp2);
 			break;
@@ -359,7 +400,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 	}
 
 	asmjit::CBNode *cursorBefore = cc.getCursor();
-	auto call = cc.call(imm_ptr(target->DirectNativeCall), CreateFuncSignature());
+	auto call = cc.call(ImmPtr(target->DirectNativeCall), CreateFuncSignature());
 	call->setInlineComment(target->PrintableName);
 	asmjit::CBNode *cursorAfter = cc.getCursor();
 	cc.setCursor(cursorBefore);
@@ -397,7 +438,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 				break;
 			case REGT_STRING | REGT_KONST:
 				tmp = newTempIntPtr();
-				cc.mov(tmp, imm_ptr(&konsts[bc]));
+				cc.mov(tmp, ImmPtr(&konsts[bc]));
 				call->setArg(slot, tmp);
 				break;
 			case REGT_POINTER:
@@ -405,7 +446,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 				break;
 			case REGT_POINTER | REGT_KONST:
 				tmp = newTempIntPtr();
-				cc.mov(tmp, imm_ptr(konsta[bc].v));
+				cc.mov(tmp, ImmPtr(konsta[bc].v));
 				call->setArg(slot, tmp);
 				break;
 			case REGT_FLOAT:
@@ -429,7 +470,7 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 			case REGT_FLOAT | REGT_KONST:
 				tmp = newTempIntPtr();
 				tmp2 = newTempXmmSd();
-				cc.mov(tmp, asmjit::imm_ptr(konstf + bc));
+				cc.mov(tmp, ImmPtr(konstf + bc));
 				cc.movsd(tmp2, asmjit::x86::qword_ptr(tmp));
 				call->setArg(slot, tmp2);
 				break;
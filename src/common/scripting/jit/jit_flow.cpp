@@ -57,7 +57,7 @@ void JitCompiler::EmitSCOPE()
 	cc.jz(label);
 
 	auto f = newTempIntPtr();
-	cc.mov(f, asmjit::imm_ptr(konsta[C].v));
+	cc.mov(f, ImmPtr(konsta[C].v));
 
 	typedef int(*FuncPtr)(DObject*, VMFunction*, int);
 	auto call = CreateCall<void, DObject*, VMFunction*, int>(ValidateCall);
@@ -74,6 +74,12 @@ static void SetString(VMReturn* ret, FString* str)
 void JitCompiler::EmitRET()
 {
 	using namespace asmjit;
+	if (Inline)
+	{
+		EmitInlineRET();
+		return;
+	}
+
 	if (B == REGT_NIL)
 	{
 		EmitPopFrame();
@@ -182,7 +188,7 @@ void JitCompiler::EmitRET()
 			cc.add(ptr, (int)(retnum * sizeof(VMReturn)));
 			auto call = CreateCall<void, VMReturn*, FString*>(SetString);
 			call->setArg(0, ptr);
-			if (regtype & REGT_KONST) call->setArg(1, asmjit::imm_ptr(&konsts[regnum]));
+			if (regtype & REGT_KONST) call->setArg(1, ImmPtr(&konsts[regnum]));
 			else                      call->setArg(1, regS[regnum]);
 			break;
 		}
@@ -192,7 +198,7 @@ void JitCompiler::EmitRET()
 				if (regtype & REGT_KONST)
 				{
 					auto ptr = newTempIntPtr();
-					cc.mov(ptr, asmjit::imm_ptr(konsta[regnum].v));
+					cc.mov(ptr, ImmPtr(konsta[regnum].v));
 					cc.mov(x86::qword_ptr(location), ptr);
 				}
 				else
@@ -205,7 +211,7 @@ void JitCompiler::EmitRET()
 				if (regtype & REGT_KONST)
 				{
 					auto ptr = newTempIntPtr();
-					cc.mov(ptr, asmjit::imm_ptr(konsta[regnum].v));
+					cc.mov(ptr, ImmPtr(konsta[regnum].v));
 					cc.mov(x86::dword_ptr(location), ptr);
 				}
 				else
@@ -235,6 +241,11 @@ void JitCompiler::EmitRET()
 void JitCompiler::EmitRETI()
 {
 	using namespace asmjit;
+	if (Inline)
+	{
+		EmitInlineRETI();
+		return;
+	}
 
 	int a = A;
 	int retnum = a & ~RET_FINAL;
@@ -283,10 +294,7 @@ void JitCompiler::EmitBOUND()
 	cc.cmp(regD[A], (int)BC);
 	cc.jae(label);
 
-	JitLineInfo info;
-	info.Label = label;
-	info.LineNumber = sfunc->PCToLine(pc);
-	LineInfo.Push(info);
+	AddLineInfo(label, CurrentLine());
 }
 
 void JitCompiler::EmitBOUND_K()
@@ -302,10 +310,7 @@ void JitCompiler::EmitBOUND_K()
 	cc.cmp(regD[A], (int)konstd[BC]);
 	cc.jae(label);
 
-	JitLineInfo info;
-	info.Label = label;
-	info.LineNumber = sfunc->PCToLine(pc);
-	LineInfo.Push(info);
+	AddLineInfo(label, CurrentLine());
 }
 
 void JitCompiler::EmitBOUND_R()
@@ -321,10 +326,7 @@ void JitCompiler::EmitBOUND_R()
 	cc.cmp(regD[A], regD[B]);
 	cc.jae(label);
 
-	JitLineInfo info;
-	info.Label = label;
-	info.LineNumber = sfunc->PCToLine(pc);
-	LineInfo.Push(info);
+	AddLineInfo(label, CurrentLine());
 }
 
 void JitCompiler::ThrowArrayOutOfBounds(int index, int size)
@@ -69,6 +69,11 @@ static void *AllocJitMemory(size_t size)
 	}
 }
 
+static size_t JitAlignCode(size_t size)
+{
+	return (size + 15) / 16 * 16;
+}
+
 #ifdef WIN32
 
 #define UWOP_PUSH_NONVOL 0
@@ -253,40 +258,23 @@ static TArray<uint16_t> CreateUnwindInfoWindows(asmjit::CCFunc *func)
 	return info;
 }
 
-void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+// Room for the code, its unwind info and the function table entry
+static uint8_t *AllocJitCode(size_t codeSize, size_t unwindInfoSize)
 {
-	using namespace asmjit;
-
-	CCFunc *func = compiler->Codegen();
-
-	size_t codeSize = code->getCodeSize();
-	if (codeSize == 0)
-		return nullptr;
-
 #ifdef _WIN64
-	TArray<uint16_t> unwindInfo = CreateUnwindInfoWindows(func);
-	size_t unwindInfoSize = unwindInfo.Size() * sizeof(uint16_t);
-	size_t functionTableSize = sizeof(RUNTIME_FUNCTION);
-#else
-	size_t unwindInfoSize = 0;
-	size_t functionTableSize = 0;
+	unwindInfoSize += sizeof(RUNTIME_FUNCTION);
 #endif
+	return (uint8_t *)AllocJitMemory(JitAlignCode(codeSize) + unwindInfoSize);
+}
 
-	codeSize = (codeSize + 15) / 16 * 16;
-
-	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize + functionTableSize);
-	if (!p)
-		return nullptr;
-
-	size_t relocSize = code->relocate(p);
-	if (relocSize == 0)
-		return nullptr;
-
-	size_t unwindStart = relocSize;
-	unwindStart = (unwindStart + 15) / 16 * 16;
-	JitBlockPos -= codeSize - unwindStart;
+// Stores the unwind info behind the code that was just written to p and registers the function
+static void RegisterJitCode(uint8_t *p, size_t codeSize, size_t relocSize, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart, VMScriptFunction *sfunc, const TArray<JitLineInfo> &lineInfo)
+{
+	size_t unwindStart = JitAlignCode(relocSize);
+	JitBlockPos -= JitAlignCode(codeSize) - unwindStart;
 
 #ifdef _WIN64
+	size_t unwindInfoSize = unwindInfo.Size();
 	uint8_t *baseaddr = JitBlocks.Last();
 	uint8_t *startaddr = p;
 	uint8_t *endaddr = p + relocSize;
@@ -306,10 +294,20 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 	if (result == 0)
 		I_Error("RtlAddFunctionTable failed");
 
-	JitDebugInfo.Push({ FString(compiler->GetScriptFunction()->PrintableName), compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push({ FString(sfunc->PrintableName), sfunc->SourceFileName, lineInfo, startaddr, endaddr });
 #endif
+}
 
-	return p;
+static TArray<uint8_t> CreateUnwindInfo(asmjit::CCFunc *func, unsigned int &functionStart)
+{
+	TArray<uint8_t> info;
+#ifdef _WIN64
+	TArray<uint16_t> codes = CreateUnwindInfoWindows(func);
+	info.Resize(codes.Size() * sizeof(uint16_t));
+	memcpy(info.Data(), codes.Data(), info.Size());
+#endif
+	functionStart = 0;
+	return info;
 }
 
 #else
@@ -649,33 +647,16 @@ static TArray<uint8_t> CreateUnwindInfoUnix(asmjit::CCFunc *func, unsigned int &
 	return stream;
 }
 
-void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+static uint8_t *AllocJitCode(size_t codeSize, size_t unwindInfoSize)
 {
-	using namespace asmjit;
-
-	CCFunc *func = compiler->Codegen();
-
-	size_t codeSize = code->getCodeSize();
-	if (codeSize == 0)
-		return nullptr;
+	return (uint8_t *)AllocJitMemory(JitAlignCode(codeSize) + unwindInfoSize);
+}
 
-	unsigned int fdeFunctionStart = 0;
-	TArray<uint8_t> unwindInfo = CreateUnwindInfoUnix(func, fdeFunctionStart);
+static void RegisterJitCode(uint8_t *p, size_t codeSize, size_t relocSize, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart, VMScriptFunction *sfunc, const TArray<JitLineInfo> &lineInfo)
+{
 	size_t unwindInfoSize = unwindInfo.Size();
-
-	codeSize = (codeSize + 15) / 16 * 16;
-
-	uint8_t *p = (uint8_t *)AllocJitMemory(codeSize + unwindInfoSize);
-	if (!p)
-		return nullptr;
-
-	size_t relocSize = code->relocate(p);
-	if (relocSize == 0)
-		return nullptr;
-
-	size_t unwindStart = relocSize;
-	unwindStart = (unwindStart + 15) / 16 * 16;
-	JitBlockPos -= codeSize - unwindStart;
+	size_t unwindStart = JitAlignCode(relocSize);
+	JitBlockPos -= JitAlignCode(codeSize) - unwindStart;
 
 	uint8_t *baseaddr = JitBlocks.Last();
 	uint8_t *startaddr = p;
@@ -730,14 +711,79 @@ void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
 #endif
 	}
 
-	JitDebugInfo.Push({ compiler->GetScriptFunction()->PrintableName, compiler->GetScriptFunction()->SourceFileName, compiler->LineInfo, startaddr, endaddr });
+	JitDebugInfo.Push({ sfunc->PrintableName, sfunc->SourceFileName, lineInfo, startaddr, endaddr });
+}
 
-	return p;
+static TArray<uint8_t> CreateUnwindInfo(asmjit::CCFunc *func, unsigned int &functionStart)
+{
+	return CreateUnwindInfoUnix(func, functionStart);
 }
+
 #endif
 
+void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler)
+{
+	using namespace asmjit;
+
+	CCFunc *func = compiler->Codegen();
+
+	size_t codeSize = code->getCodeSize();
+	if (codeSize == 0)
+		return nullptr;
+
+	unsigned int fdeFunctionStart = 0;
+	TArray<uint8_t> unwindInfo = CreateUnwindInfo(func, fdeFunctionStart);
+
+	uint8_t *p = AllocJitCode(codeSize, unwindInfo.Size());
+	if (!p)
+		return nullptr;
+
+	size_t relocSize = code->relocate(p);
+	if (relocSize == 0)
+		return nullptr;
+
+	RegisterJitCode(p, codeSize, relocSize, unwindInfo, fdeFunctionStart, compiler->GetScriptFunction(), compiler->LineInfo);
+	JitCacheStore(compiler, code, p, relocSize, unwindInfo, fdeFunctionStart);
+	return p;
+}
+
+//==========================================================================
+//
+// @Cockatrice - Installs code from the JIT cache. The patch callback
+// writes the addresses for this run into the copied code and can
+// still refuse it, in which case the memory is given back.
+//
+//==========================================================================
+
+void *AddCachedJitFunction(VMScriptFunction *sfunc, const TArray<uint8_t> &codeBytes, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart, const TArray<JitLineInfo> &lineInfo, const std::function<bool(uint8_t *)> &patch)
+{
+	size_t codeSize = codeBytes.Size();
+	if (codeSize == 0)
+		return nullptr;
+
+	size_t oldPos = JitBlockPos;
+	unsigned oldBlocks = JitBlocks.Size();
+	uint8_t *p = AllocJitCode(codeSize, unwindInfo.Size());
+	if (!p)
+		return nullptr;
+
+	memcpy(p, codeBytes.Data(), codeSize);
+	if (!patch(p))
+	{
+		// A fresh block stays around for the next function
+		JitBlockPos = JitBlocks.Size() == oldBlocks ? oldPos : 0;
+		return nullptr;
+	}
+
+	RegisterJitCode(p, codeSize, codeSize, unwindInfo, fdeFunctionStart, sfunc, lineInfo);
+	return p;
+}
+
 void JitRelease()
 {
+	JitCacheFlush();
+	JitReleaseProfiles();
+
 #ifdef _WIN64
 	for (auto p : JitFrames)
 	{
@@ -929,18 +975,18 @@ public:
 };
 #endif
 
-int JITPCToLine(uint8_t *pc, const JitFuncInfo *info)
+static const JitLineInfo *JITPCToLine(uint8_t *pc, const JitFuncInfo *info)
 {
 	int PCIndex = int(pc - ((uint8_t *) (info->start)));
-	if (info->LineInfo.Size () == 1) return info->LineInfo[0].LineNumber;
+	if (info->LineInfo.Size () == 1) return &info->LineInfo[0];
 	for (unsigned i = 1; i < info->LineInfo.Size (); i++)
 	{
 		if (info->LineInfo[i].InstructionIndex >= PCIndex)
 		{
-			return info->LineInfo[i - 1].LineNumber;
+			return &info->LineInfo[i - 1];
 		}
 	}
-	return -1;
+	return nullptr;
 }
 
 FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
@@ -950,14 +996,22 @@ FString JitGetStackFrameName(NativeSymbolResolver *nativeSymbols, void *pc)
 		const auto &info = JitDebugInfo[i];
 		if (pc >= info.start && pc < info.end)
 		{
-			int line = JITPCToLine ((uint8_t *)pc, &info);
+			const JitLineInfo *lineinfo = JITPCToLine ((uint8_t *)pc, &info);
+			int line = lineinfo ? lineinfo->LineNumber : -1;
 
 			FString s;
 
+			// @Cockatrice - Code inlined by tier 2 reports the inlined function as its own frame
+			if (lineinfo && lineinfo->Inlined)
+			{
+				s.Format("Called from %s at %s, line %d\n", lineinfo->Inlined->PrintableName, lineinfo->Inlined->SourceFileName.GetChars(), line);
+				line = lineinfo->CallLine;
+			}
+
 			if (line == -1)
-				s.Format("Called from %s at %s\n", info.name.GetChars(), info.filename.GetChars());
+				s.AppendFormat("Called from %s at %s\n", info.name.GetChars(), info.filename.GetChars());
 			else
-				s.Format("Called from %s at %s, line %d\n", info.name.GetChars(), info.filename.GetChars(), line);
+				s.AppendFormat("Called from %s at %s, line %d\n", info.name.GetChars(), info.filename.GetChars(), line);
 
 			return s;
 		}
@@ -0,0 +1,779 @@
+/*
+** jit_tier.cpp
+** @Cockatrice - Tiered compilation of script functions
+**
+** Functions are compiled one to one at first (tier 1). Those that call other
+** script functions also count down their calls in a profile and record which
+** function each virtual call site dispatched to. When the count runs out the
+** function is queued, and between frames it is compiled again (tier 2) with
+** small leaf callees copied into it. Statically bound calls are inlined
+** directly; virtual calls that only ever saw one function are inlined behind
+** a check that the vtable still resolves to it, with the normal call as the
+** fallback. Callers pick up the new code through VMFunction::ScriptCall.
+**
+** Only callees that need no VM frame of their own are inlined: no strings,
+** no out or ref arguments, no calls and no frame pointer loads.
+**
+*/
+
+#include <climits>
+#include <mutex>
+
+#include "jit.h"
+#include "jitintern.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "printf.h"
+
+extern PString *TypeString;
+extern PStruct *TypeVector2;
+extern PStruct *TypeVector3;
+extern PStruct *TypeVector4;
+extern PStruct *TypeQuaternion;
+extern PStruct *TypeFQuaternion;
+
+CVAR(Bool, vm_jit_tiered, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, vm_jit_tier_threshold, 5000, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, vm_jit_inline_size, 32, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Float, vm_jit_tier_budget, 2.f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// Milliseconds per frame
+
+static TArray<JitFunctionProfile *> JitProfiles;
+static TArray<VMScriptFunction *> TierQueue;
+static std::mutex TierMutex;
+
+static struct
+{
+	int Compiled, Failed, Inlined, Devirtualized;
+	uint64_t Time;
+} TierStats;
+
+//==========================================================================
+//
+// Profiles
+//
+//==========================================================================
+
+JitCallSiteProfile *JitFunctionProfile::FindSite(int pcoffset)
+{
+	for (unsigned i = 0; i < SitePCs.Size(); i++)
+	{
+		if (SitePCs[i] == pcoffset) return &Sites[i];
+	}
+	return nullptr;
+}
+
+bool JitWantsProfile(VMScriptFunction *sfunc)
+{
+	if (!vm_jit_tiered) return false;
+
+	for (int i = 0; i < sfunc->CodeSize; i++)
+	{
+		const VMOP &op = sfunc->Code[i];
+		if (op.op == OP_VTBL) return true;
+		if (op.op == OP_CALL_K)
+		{
+			auto target = static_cast<VMFunction *>(sfunc->KonstA[op.a].v);
+			if (target != nullptr && !(target->VarFlags & VARF_Native)) return true;
+		}
+	}
+	return false;
+}
+
+JitFunctionProfile *JitGetProfile(VMScriptFunction *sfunc)
+{
+	if (sfunc->JitProfile == nullptr)
+	{
+		auto profile = new JitFunctionProfile;
+		profile->Countdown = max(*vm_jit_tier_threshold, 1);
+		for (int i = 0; i < sfunc->CodeSize; i++)
+		{
+			if (sfunc->Code[i].op == OP_VTBL) profile->SitePCs.Push(i);
+		}
+		profile->Sites.Resize(profile->SitePCs.Size());
+
+		JitProfiles.Push(profile);
+		sfunc->JitProfile = profile;
+	}
+	return sfunc->JitProfile;
+}
+
+// Called from JitRelease, the functions are all going away
+void JitReleaseProfiles()
+{
+	std::lock_guard<std::mutex> lock(TierMutex);
+	for (auto profile : JitProfiles) delete profile;
+	JitProfiles.Clear();
+	TierQueue.Clear();
+}
+
+//==========================================================================
+//
+// Tier 1 instrumentation
+//
+//==========================================================================
+
+void JitCompiler::EmitTierCountdown()
+{
+	using namespace asmjit;
+
+	// Worker threads may race on the counter. A lost decrement doesn't matter, and going past zero still requests the tier up.
+	auto skip = cc.newLabel();
+	auto countdown = newTempIntPtr();
+	cc.mov(countdown, ImmPtr(&Profile->Countdown));
+	cc.sub(x86::dword_ptr(countdown), 1);
+	cc.jg(skip);
+	auto call = CreateCall<void, VMScriptFunction *>(&JitCompiler::RequestTierUp);
+	call->setArg(0, ImmPtr(sfunc));
+	cc.bind(skip);
+}
+
+void JitCompiler::EmitCallSiteProfile(const VMOP *vtbl, asmjit::X86Gp vmfunc)
+{
+	using namespace asmjit;
+
+	JitCallSiteProfile *site = Profile->FindSite((int)(ptrdiff_t)(vtbl - sfunc->Code));
+	if (site == nullptr) return;
+
+	// if (site->Target != vmfunc) { if (site->Target == nullptr) site->Target = vmfunc; else site->Polymorphic = 1; }
+	auto done = cc.newLabel();
+	auto first = cc.newLabel();
+	auto siteptr = newTempIntPtr();
+	auto seen = newTempIntPtr();
+	cc.mov(siteptr, ImmPtr(site));
+	cc.mov(seen, x86::ptr(siteptr, myoffsetof(JitCallSiteProfile, Target)));
+	cc.cmp(seen, vmfunc);
+	cc.je(done);
+	cc.test(seen, seen);
+	cc.jz(first);
+	cc.mov(x86::dword_ptr(siteptr, myoffsetof(JitCallSiteProfile, Polymorphic)), 1);
+	cc.jmp(done);
+	cc.bind(first);
+	cc.mov(x86::ptr(siteptr, myoffsetof(JitCallSiteProfile, Target)), vmfunc);
+	cc.bind(done);
+}
+
+void JitCompiler::RequestTierUp(VMScriptFunction *func)
+{
+	auto profile = func->JitProfile;
+	profile->Countdown = INT_MAX;
+	if (profile->Queued.exchange(true)) return;
+
+	std::lock_guard<std::mutex> lock(TierMutex);
+	TierQueue.Push(func);
+}
+
+VMFunction *JitCompiler::GetMonomorphicTarget(const VMOP *vtbl)
+{
+	if (sfunc->JitProfile == nullptr) return nullptr;
+	JitCallSiteProfile *site = sfunc->JitProfile->FindSite((int)(ptrdiff_t)(vtbl - sfunc->Code));
+	return (site != nullptr && !site->Polymorphic) ? site->Target : nullptr;
+}
+
+//==========================================================================
+//
+// Tier 2 inlining
+//
+//==========================================================================
+
+// Checks that the call at pc can be replaced with the body of target and
+// matches the PARAM instructions up with the callee's argument registers.
+VMScriptFunction *JitCompiler::CanInline(VMFunction *target, TArray<InlineArg> &inlineArgs)
+{
+	if (target == nullptr || (target->VarFlags & (VARF_Native | VARF_Abstract | VARF_VarArg)) || target->Proto == nullptr)
+		return nullptr;
+
+	auto callee = static_cast<VMScriptFunction *>(target);
+	if (callee == sfunc || Inline != nullptr || callee->blockJit || callee->CodeSize > vm_jit_inline_size)
+		return nullptr;
+
+	// Only simple frames, those live entirely in registers
+	if (callee->SpecialInits.Size() != 0 || callee->NumRegS != 0 || callee->ExtraSpace != 0)
+		return nullptr;
+
+	const VMOP *retval = pc + 1;
+	int numret = C;
+	for (int i = 0; i < numret; i++)
+	{
+		if (retval[i].op != OP_RESULT || (retval[i].b & REGT_TYPE) == REGT_STRING) return nullptr;
+	}
+
+	// Leaf functions only, with every return going to a register of the same type
+	for (int i = 0; i < callee->CodeSize; i++)
+	{
+		const VMOP &code = callee->Code[i];
+		switch (code.op)
+		{
+		case OP_PARAM:
+		case OP_PARAMI:
+		case OP_CALL:
+		case OP_CALL_K:
+		case OP_VTBL:
+		case OP_RESULT:
+		case OP_LFP:
+			return nullptr;
+
+		case OP_RET:
+		{
+			if (code.b == REGT_NIL) break;
+			if ((code.b & REGT_TYPE) == REGT_STRING) return nullptr;
+			int retnum = code.a & ~RET_FINAL;
+			if (retnum < numret && (retval[retnum].b & (REGT_TYPE | REGT_MULTIREG)) != (code.b & (REGT_TYPE | REGT_MULTIREG))) return nullptr;
+			break;
+		}
+
+		case OP_RETI:
+		{
+			int retnum = code.a & ~RET_FINAL;
+			if (retnum < numret && (retval[retnum].b & (REGT_TYPE | REGT_MULTIREG)) != REGT_INT) return nullptr;
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	// Expand the PARAM instructions to one entry per VMValue slot
+	TArray<InlineArg> slots;
+	for (auto param : ParamOpcodes)
+	{
+		if (param->op == OP_PARAMI)
+		{
+			slots.Push({ REGT_INT, param->i24, true });
+			continue;
+		}
+
+		int regtype = param->a;
+		int bc = param->i16u;
+		switch (regtype)
+		{
+		case REGT_NIL:
+		case REGT_INT:
+		case REGT_INT | REGT_KONST:
+		case REGT_POINTER:
+		case REGT_POINTER | REGT_KONST:
+		case REGT_FLOAT:
+		case REGT_FLOAT | REGT_KONST:
+			slots.Push({ regtype, bc, false });
+			break;
+
+		case REGT_FLOAT | REGT_MULTIREG2:
+		case REGT_FLOAT | REGT_MULTIREG3:
+		case REGT_FLOAT | REGT_MULTIREG4:
+		{
+			int count = (regtype & REGT_MULTIREG4) ? 4 : (regtype & REGT_MULTIREG3) ? 3 : 2;
+			for (int j = 0; j < count; j++) slots.Push({ REGT_FLOAT, bc + j, false });
+			break;
+		}
+
+		default:	// Strings and addresses of registers need a frame
+			return nullptr;
+		}
+	}
+	if ((int)slots.Size() != B || (int)slots.Size() != callee->NumArgs)
+		return nullptr;
+
+	// Assign the slots to argument registers the same way SetupSimpleFrame does
+	inlineArgs.Clear();
+	int regd = 0, regf = 0, rega = 0;
+	unsigned slot = 0;
+	auto take = [&](int regclass) -> bool
+	{
+		if (slot >= slots.Size()) return false;
+		InlineArg arg = slots[slot++];
+		if (arg.regtype == REGT_NIL) arg.regtype = regclass | REGT_NIL;
+		else if ((arg.regtype & REGT_TYPE) != regclass) return false;
+		inlineArgs.Push(arg);
+		return true;
+	};
+
+	for (unsigned i = 0; i < callee->Proto->ArgumentTypes.Size(); i++)
+	{
+		const PType *type = callee->Proto->ArgumentTypes[i];
+		int regclass, count = 1;
+
+		if (callee->ArgFlags.Size() && callee->ArgFlags[i] & (VARF_Out | VARF_Ref)) return nullptr;
+		else if (type == TypeVector2 || type == TypeFVector2) regclass = REGT_FLOAT, count = 2;
+		else if (type == TypeVector3 || type == TypeFVector3) regclass = REGT_FLOAT, count = 3;
+		else if (type == TypeVector4 || type == TypeFVector4 || type == TypeQuaternion || type == TypeFQuaternion) regclass = REGT_FLOAT, count = 4;
+		else if (type == TypeFloat64) regclass = REGT_FLOAT;
+		else if (type == TypeString) return nullptr;
+		else if (type->isIntCompatible()) regclass = REGT_INT;
+		else regclass = REGT_POINTER;
+
+		for (int j = 0; j < count; j++)
+		{
+			if (!take(regclass)) return nullptr;
+		}
+		(regclass == REGT_INT ? regd : regclass == REGT_FLOAT ? regf : rega) += count;
+	}
+
+	if (slot != slots.Size() || regd > callee->NumRegD || regf > callee->NumRegF || rega > callee->NumRegA)
+		return nullptr;
+
+	return callee;
+}
+
+void JitCompiler::EmitInlineCall(VMScriptFunction *callee, const TArray<InlineArg> &inlineArgs)
+{
+	using namespace asmjit;
+
+	FString comment;
+	comment.Format("; inlined %s", callee->PrintableName);
+	cc.comment(comment.GetChars(), comment.Len());
+
+	// Fresh registers for the callee, with the arguments moved in
+	TArray<X86Gp> calleeD(callee->NumRegD, true);
+	TArray<X86Xmm> calleeF(callee->NumRegF, true);
+	TArray<X86Gp> calleeA(callee->NumRegA, true);
+	for (int i = 0; i < callee->NumRegD; i++)
+	{
+		regname.Format("inlD%d", i);
+		calleeD[i] = cc.newInt32(regname.GetChars());
+	}
+	for (int i = 0; i < callee->NumRegF; i++)
+	{
+		regname.Format("inlF%d", i);
+		calleeF[i] = cc.newXmmSd(regname.GetChars());
+	}
+	for (int i = 0; i < callee->NumRegA; i++)
+	{
+		regname.Format("inlA%d", i);
+		calleeA[i] = cc.newIntPtr(regname.GetChars());
+	}
+
+	int regd = 0, regf = 0, rega = 0;
+	for (auto &arg : inlineArgs)
+	{
+		bool konst = !!(arg.regtype & REGT_KONST);
+		bool nil = !!(arg.regtype & REGT_NIL);
+		switch (arg.regtype & REGT_TYPE)
+		{
+		case REGT_INT:
+		{
+			auto &dst = calleeD[regd++];
+			if (nil) cc.xor_(dst, dst);
+			else if (arg.immediate) cc.mov(dst, arg.index);
+			else if (konst) cc.mov(dst, konstd[arg.index]);
+			else cc.mov(dst, regD[arg.index]);
+			break;
+		}
+		case REGT_FLOAT:
+		{
+			auto &dst = calleeF[regf++];
+			if (nil) cc.xorpd(dst, dst);
+			else if (konst)
+			{
+				auto tmp = newTempIntPtr();
+				cc.mov(tmp, ImmPtr(&konstf[arg.index]));
+				cc.movsd(dst, x86::qword_ptr(tmp));
+			}
+			else cc.movsd(dst, regF[arg.index]);
+			break;
+		}
+		default:
+		{
+			auto &dst = calleeA[rega++];
+			if (nil) cc.xor_(dst, dst);
+			else if (konst) cc.mov(dst, ImmPtr(konsta[arg.index].v));
+			else cc.mov(dst, regA[arg.index]);
+			break;
+		}
+		}
+	}
+
+	for (int i = regd; i < callee->NumRegD; i++)
+		cc.xor_(calleeD[i], calleeD[i]);
+
+	for (int i = regf; i < callee->NumRegF; i++)
+		cc.xorpd(calleeF[i], calleeF[i]);
+
+	for (int i = rega; i < callee->NumRegA; i++)
+		cc.xor_(calleeA[i], calleeA[i]);
+
+	// Switch over to the callee; after the swaps the callee* arrays hold the caller's registers
+	InlineFrame frame;
+	frame.retval = pc + 1;
+	frame.numret = C;
+	frame.line = sfunc->PCToLine(pc);
+	frame.callerD = &calleeD;
+	frame.callerF = &calleeF;
+	frame.callerA = &calleeA;
+	frame.exit = cc.newLabel();
+
+	VMScriptFunction *callerFunc = sfunc;
+	const VMOP *callerPC = pc;
+	VM_UBYTE callerOp = op;
+	TArray<OpcodeLabel> callerLabels = std::move(labels);
+
+	regD.Swap(calleeD);
+	regF.Swap(calleeF);
+	regA.Swap(calleeA);
+	sfunc = callee;
+	konstd = callee->KonstD;
+	konstf = callee->KonstF;
+	konsts = callee->KonstS;
+	konsta = callee->KonstA;
+	labels.Clear();
+	labels.Resize(callee->CodeSize);
+	Inline = &frame;
+
+	pc = callee->Code;
+	auto end = pc + callee->CodeSize;
+	int lastLine = -1;
+	while (pc != end)
+	{
+		int i = (int)(ptrdiff_t)(pc - callee->Code);
+		op = pc->op;
+
+		int curLine = CurrentLine();
+		if (curLine != lastLine)
+		{
+			lastLine = curLine;
+			auto label = cc.newLabel();
+			cc.bind(label);
+			AddLineInfo(label, curLine);
+		}
+
+		labels[i].cursor = cc.getCursor();
+		ResetTemp();
+		EmitOpcode();
+		pc++;
+	}
+	BindLabels();
+	cc.bind(frame.exit);
+
+	Inline = nullptr;
+	regD.Swap(calleeD);
+	regF.Swap(calleeF);
+	regA.Swap(calleeA);
+	sfunc = callerFunc;
+	konstd = sfunc->KonstD;
+	konstf = sfunc->KonstF;
+	konsts = sfunc->KonstS;
+	konsta = sfunc->KonstA;
+	labels = std::move(callerLabels);
+	pc = callerPC;
+	op = callerOp;
+	ResetTemp();
+
+	// The rest of the caller's instruction is back on the caller's line
+	auto resume = cc.newLabel();
+	cc.bind(resume);
+	AddLineInfo(resume, frame.line);
+
+	InlinedCalls++;
+}
+
+// Returns write straight into the caller's RESULT registers
+void JitCompiler::EmitInlineRET()
+{
+	using namespace asmjit;
+
+	int retnum = A & ~RET_FINAL;
+	if (B != REGT_NIL && retnum < Inline->numret)
+	{
+		int regtype = B;
+		int regnum = C;
+		int dst = Inline->retval[retnum].c;
+		switch (regtype & REGT_TYPE)
+		{
+		case REGT_INT:
+			if (regtype & REGT_KONST) cc.mov((*Inline->callerD)[dst], konstd[regnum]);
+			else cc.mov((*Inline->callerD)[dst], regD[regnum]);
+			break;
+
+		case REGT_FLOAT:
+		{
+			int count = (regtype & REGT_MULTIREG4) ? 4 : (regtype & REGT_MULTIREG3) ? 3 : (regtype & REGT_MULTIREG2) ? 2 : 1;
+			for (int i = 0; i < count; i++)
+			{
+				if (regtype & REGT_KONST)
+				{
+					auto tmp = newTempIntPtr();
+					cc.mov(tmp, ImmPtr(&konstf[regnum + i]));
+					cc.movsd((*Inline->callerF)[dst + i], x86::qword_ptr(tmp));
+				}
+				else
+				{
+					cc.movsd((*Inline->callerF)[dst + i], regF[regnum + i]);
+				}
+			}
+			break;
+		}
+
+		case REGT_POINTER:
+			if (regtype & REGT_KONST) cc.mov((*Inline->callerA)[dst], ImmPtr(konsta[regnum].v));
+			else cc.mov((*Inline->callerA)[dst], regA[regnum]);
+			break;
+		}
+	}
+
+	if (B == REGT_NIL || (A & RET_FINAL))
+		cc.jmp(Inline->exit);
+}
+
+void JitCompiler::EmitInlineRETI()
+{
+	int retnum = A & ~RET_FINAL;
+	if (retnum < Inline->numret)
+		cc.mov((*Inline->callerD)[Inline->retval[retnum].c], (int)BCs);
+
+	if (A & RET_FINAL)
+		cc.jmp(Inline->exit);
+}
+
+//==========================================================================
+//
+// Tier up
+//
+//==========================================================================
+
+static JitFuncPtr JitCompileTier2(VMScriptFunction *sfunc)
+{
+	using namespace asmjit;
+	StringLogger logger;
+	try
+	{
+		ThrowingErrorHandler errorHandler;
+		CodeHolder code;
+		code.init(GetHostCodeInfo());
+		code.setErrorHandler(&errorHandler);
+		code.setLogger(&logger);
+
+		JitCompiler compiler(&code, sfunc, 2);
+		auto p = reinterpret_cast<JitFuncPtr>(AddJitFunction(&code, &compiler));
+		TierStats.Inlined += compiler.InlinedCalls;
+		TierStats.Devirtualized += compiler.DevirtualizedCalls;
+		return p;
+	}
+	catch (const std::exception &e)
+	{
+		// The tier 1 code keeps running
+		DPrintf(DMSG_NOTIFY, "%s: JIT tier 2 failed: %s\n", sfunc->PrintableName, e.what());
+		return nullptr;
+	}
+}
+
+void JitProcessTierUps()
+{
+	TArray<VMScriptFunction *> work;
+	{
+		std::lock_guard<std::mutex> lock(TierMutex);
+		if (TierQueue.Size() == 0) return;
+		work = std::move(TierQueue);
+		TierQueue.Clear();
+	}
+
+	uint64_t start = I_nsTime();
+	uint64_t budget = (uint64_t)(max(*vm_jit_tier_budget, 0.f) * 1e6);
+	unsigned done = 0;
+	while (done < work.Size() && (done == 0 || I_nsTime() - start < budget))
+	{
+		VMScriptFunction *func = work[done++];
+		if (!vm_jit_tiered) continue;
+
+		if (JitFuncPtr code = JitCompileTier2(func))
+		{
+			func->ScriptCall = code;
+			TierStats.Compiled++;
+		}
+		else
+		{
+			TierStats.Failed++;
+		}
+	}
+	TierStats.Time += I_nsTime() - start;
+
+	// Whatever didn't fit waits for the next frame
+	if (done < work.Size())
+	{
+		std::lock_guard<std::mutex> lock(TierMutex);
+		for (unsigned i = done; i < work.Size(); i++) TierQueue.Push(work[i]);
+	}
+}
+
+//==========================================================================
+//
+// Runs a static script function through the interpreter, its tier 1 code
+// and freshly compiled tier 2 code and compares what they return. Without
+// arguments on the command line it is called with a range of generated
+// ones. Only number arguments and results are supported, and the function
+// runs several times, so it should not have side effects.
+//
+//==========================================================================
+
+struct JitCompareResult
+{
+	bool Threw = false;
+	TArray<uint64_t> Values;
+
+	bool operator==(const JitCompareResult &other) const { return Threw == other.Threw && Values == other.Values; }
+};
+
+static JitCompareResult JitCompareCall(VMScriptFunction *func, JitFuncPtr code, TArray<VMValue> &params)
+{
+	auto &rettypes = func->Proto->ReturnTypes;
+	TArray<int> ints(rettypes.Size(), true);
+	TArray<double> floats(rettypes.Size(), true);
+	TArray<VMReturn> rets(rettypes.Size(), true);
+	for (unsigned i = 0; i < rettypes.Size(); i++)
+	{
+		ints[i] = 0;
+		floats[i] = 0;
+		if (rettypes[i]->isFloat()) rets[i].FloatAt(&floats[i]);
+		else rets[i].IntAt(&ints[i]);
+	}
+
+	JitCompareResult result;
+	try
+	{
+		code(func, params.Data(), params.Size(), rets.Data(), rets.Size());
+	}
+	catch (const CVMAbortException &)
+	{
+		result.Threw = true;
+		return result;
+	}
+
+	for (unsigned i = 0; i < rettypes.Size(); i++)
+	{
+		uint64_t bits = (uint32_t)ints[i];
+		if (rettypes[i]->isFloat()) memcpy(&bits, &floats[i], sizeof(bits));
+		result.Values.Push(bits);
+	}
+	return result;
+}
+
+static FString JitCompareFormat(VMScriptFunction *func, const JitCompareResult &result)
+{
+	if (result.Threw) return "exception";
+
+	FString out;
+	for (unsigned i = 0; i < result.Values.Size(); i++)
+	{
+		if (i > 0) out += ", ";
+		if (func->Proto->ReturnTypes[i]->isFloat())
+		{
+			double d;
+			memcpy(&d, &result.Values[i], sizeof(d));
+			out.AppendFormat("%g", d);
+		}
+		else out.AppendFormat("%d", (int)(uint32_t)result.Values[i]);
+	}
+	return out;
+}
+
+static void JitCompareTiers(FCommandLine &argv)
+{
+	if (argv.argc() < 4)
+	{
+		Printf("Usage: jittiers compare <class> <function> [arguments]\n");
+		return;
+	}
+
+	auto vmfunc = PClass::FindFunction(argv[2], argv[3]);
+	if (vmfunc == nullptr || (vmfunc->VarFlags & (VARF_Native | VARF_Abstract)) || vmfunc->Proto == nullptr)
+	{
+		Printf("%s.%s is not a script function\n", argv[2], argv[3]);
+		return;
+	}
+	auto func = static_cast<VMScriptFunction *>(vmfunc);
+	if (func->VarFlags & VARF_Method)
+	{
+		Printf("%s is not static\n", func->PrintableName);
+		return;
+	}
+
+	auto &argtypes = func->Proto->ArgumentTypes;
+	for (auto type : argtypes)
+	{
+		if (!type->isIntCompatible() && !type->isFloat())
+		{
+			Printf("%s takes arguments other than numbers\n", func->PrintableName);
+			return;
+		}
+	}
+	for (auto type : func->Proto->ReturnTypes)
+	{
+		if (!type->isIntCompatible() && !type->isFloat())
+		{
+			Printf("%s returns something other than numbers\n", func->PrintableName);
+			return;
+		}
+	}
+
+	bool given = argv.argc() > 4;
+	if (given && argv.argc() - 4 != (int)argtypes.Size())
+	{
+		Printf("%s takes %u arguments\n", func->PrintableName, argtypes.Size());
+		return;
+	}
+
+	JitFuncPtr tier1 = JitCompile(func);
+	JitFuncPtr tier2 = JitCompileTier2(func);
+	if (tier1 == nullptr || tier2 == nullptr)
+	{
+		Printf("%s could not be compiled\n", func->PrintableName);
+		return;
+	}
+
+	static const int intValues[] = { 0, 1, -1, 2, 7, -100, 1000, 65536, INT_MAX, INT_MIN };
+	static const double floatValues[] = { 0, 1, -1, 0.5, -2.25, 100, 1e-3, 1e6, 90, -180 };
+	const int runs = given ? 1 : 64;
+	int mismatches = 0;
+
+	for (int run = 0; run < runs; run++)
+	{
+		TArray<VMValue> params;
+		for (unsigned i = 0; i < argtypes.Size(); i++)
+		{
+			int pick = (run * (i * 2 + 3) + i) % 10;
+			if (argtypes[i]->isFloat()) params.Push(given ? atof(argv[4 + i]) : floatValues[pick]);
+			else params.Push(given ? atoi(argv[4 + i]) : intValues[pick]);
+		}
+
+		auto interp = JitCompareCall(func, VMExec, params);
+		auto r1 = JitCompareCall(func, tier1, params);
+		auto r2 = JitCompareCall(func, tier2, params);
+		if (!(interp == r1) || !(r1 == r2))
+		{
+			FString args;
+			for (unsigned i = 0; i < params.Size(); i++)
+			{
+				if (i > 0) args += ", ";
+				if (argtypes[i]->isFloat()) args.AppendFormat("%g", params[i].f);
+				else args.AppendFormat("%d", params[i].i);
+			}
+			Printf(TEXTCOLOR_RED "%s(%s): interpreter %s, tier 1 %s, tier 2 %s\n", func->PrintableName, args.GetChars(),
+				JitCompareFormat(func, interp).GetChars(), JitCompareFormat(func, r1).GetChars(), JitCompareFormat(func, r2).GetChars());
+			mismatches++;
+		}
+		else if (given)
+		{
+			Printf("%s\n", JitCompareFormat(func, r1).GetChars());
+		}
+	}
+	Printf("%s: %d of %d calls differ\n", func->PrintableName, mismatches, runs);
+}
+
+CCMD(jittiers)
+{
+	if (argv.argc() > 1 && !stricmp(argv[1], "compare"))
+	{
+		JitCompareTiers(argv);
+		return;
+	}
+
+	unsigned profiled = JitProfiles.Size(), queued;
+	{
+		std::lock_guard<std::mutex> lock(TierMutex);
+		queued = TierQueue.Size();
+	}
+
+	Printf("Tiered JIT is %s, threshold %d calls, inlining up to %d instructions\n", vm_jit_tiered ? "on" : "off", *vm_jit_tier_threshold, *vm_jit_inline_size);
+	Printf("%u functions profiled, %u waiting\n", profiled, queued);
+	Printf("%d recompiled (%d failed) in %.3f ms: %d calls inlined, %d of them virtual\n",
+		TierStats.Compiled, TierStats.Failed, TierStats.Time * 1e-6, TierStats.Inlined, TierStats.Devirtualized);
+}
@@ -10,6 +10,7 @@
 
 #include <asmjit/asmjit.h>
 #include <asmjit/x86.h>
+#include <atomic>
 #include <functional>
 #include <vector>
 
@@ -30,18 +31,62 @@ struct JitLineInfo
 	ptrdiff_t InstructionIndex = 0;
 	int32_t LineNumber = -1;
 	asmjit::Label Label;
+
+	// @Cockatrice - Code inlined by tier 2 keeps the lines of the function it came from, with the line of the call
+	VMScriptFunction *Inlined = nullptr;
+	int32_t CallLine = -1;
+};
+
+// @Cockatrice - Tiered compilation (jit_tier.cpp)
+// Tier 1 code of functions that call other script functions counts its calls down and records which
+// function each virtual call site ended up in. Once the count runs out the function is queued and
+// recompiled as tier 2, which inlines small leaf callees at static and monomorphic virtual call sites.
+struct JitCallSiteProfile
+{
+	VMFunction *Target = nullptr;	// First function seen at this site
+	int Polymorphic = 0;			// Set once a different function was seen
+};
+
+struct JitFunctionProfile
+{
+	int Countdown = 0;
+	std::atomic<bool> Queued { false };	// Stays set, a function is only recompiled once
+	TArray<int> SitePCs;					// Code offset of each VTBL instruction
+	TArray<JitCallSiteProfile> Sites;		// Sized once, the tier 1 code stores into it directly
+
+	JitCallSiteProfile *FindSite(int pcoffset);
 };
 
+bool JitWantsProfile(VMScriptFunction *sfunc);
+JitFunctionProfile *JitGetProfile(VMScriptFunction *sfunc);
+void JitReleaseProfiles();
+
 class JitCompiler
 {
 public:
-	JitCompiler(asmjit::CodeHolder *code, VMScriptFunction *sfunc) : cc(code), sfunc(sfunc) { }
+	JitCompiler(asmjit::CodeHolder *code, VMScriptFunction *sfunc, int tier = 1) : cc(code), sfunc(sfunc) { Tier = tier; }
 
 	asmjit::CCFunc *Codegen();
 	VMScriptFunction *GetScriptFunction() { return sfunc; }
 
 	TArray<JitLineInfo> LineInfo;
 
+	// @Cockatrice - Every address baked into the code, so the JIT cache can tell where they came from
+	TArray<const void *> Addresses;
+
+	// Instructions that carry one of them as an immediate, marked by the JIT cache's pass after register allocation
+	struct AddressSite
+	{
+		asmjit::Label Start, End;
+		uint64_t Value;
+	};
+	TArray<AddressSite> AddressSites;
+
+	// @Cockatrice - Tiered compilation
+	int Tier;
+	int InlinedCalls = 0;
+	int DevirtualizedCalls = 0;
+
 private:
 	// Declare EmitXX functions for the opcodes:
 	#define xx(op, name, mode, alt, kreg, ktype)	void Emit##op();
@@ -61,9 +106,44 @@ private:
 	void EmitPopFrame();
 
 	void EmitNativeCall(VMNativeFunction *target);
-	void EmitVMCall(asmjit::X86Gp ptr, VMFunction *target);
+	void EmitVMCall(asmjit::X86Gp ptr, VMFunction *target, bool loadVtbl = true);
 	void EmitVtbl(const VMOP *op);
 
+	// @Cockatrice - Tiered compilation (jit_tier.cpp)
+	struct InlineArg
+	{
+		int regtype;	// REGT_INT, REGT_FLOAT or REGT_POINTER, with REGT_KONST for constants and REGT_NIL for omitted args
+		int index;		// Caller register or constant, or the value for PARAMI
+		bool immediate;
+	};
+
+	struct InlineFrame
+	{
+		const VMOP *retval;
+		int numret;
+		int line;
+		TArray<asmjit::X86Gp> *callerD;
+		TArray<asmjit::X86Xmm> *callerF;
+		TArray<asmjit::X86Gp> *callerA;
+		asmjit::Label exit;
+	};
+
+	void EmitTierCountdown();
+	void EmitCallSiteProfile(const VMOP *vtbl, asmjit::X86Gp vmfunc);
+	VMFunction *GetMonomorphicTarget(const VMOP *vtbl);
+	VMScriptFunction *CanInline(VMFunction *target, TArray<InlineArg> &inlineArgs);
+	void EmitInlineCall(VMScriptFunction *callee, const TArray<InlineArg> &inlineArgs);
+	void EmitInlineRET();
+	void EmitInlineRETI();
+	static void RequestTierUp(VMScriptFunction *func);
+
+	// While inlining, sfunc and pc are the callee's
+	int CurrentLine() { return sfunc->PCToLine(pc); }
+	void AddLineInfo(asmjit::Label label, int line);
+
+	JitFunctionProfile *Profile = nullptr;
+	InlineFrame *Inline = nullptr;
+
 	int StoreCallParams();
 	void LoadInOuts();
 	void LoadReturns(const VMOP *retval, int numret);
@@ -156,11 +236,20 @@ private:
 		}
 	}
 
-	static uint64_t ToMemAddress(const void *d)
+	uint64_t ToMemAddress(const void *d)
 	{
+		if (d != nullptr) Addresses.Push(d);
 		return (uint64_t)(ptrdiff_t)d;
 	}
 
+	// All pointer immediates go through here instead of asmjit::imm_ptr
+	template<typename T>
+	asmjit::Imm ImmPtr(T p)
+	{
+		if (p != nullptr) Addresses.Push((const void *)p);
+		return asmjit::imm_ptr(p);
+	}
+
 	void CallSqrt(const asmjit::X86Xmm &a, const asmjit::X86Xmm &b);
 
 	static void CallAssignString(FString* to, FString* from) {
@@ -168,31 +257,31 @@ private:
 	}
 
 	template<typename RetType, typename P1>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1)>(func))), asmjit::FuncSignature1<RetType, P1>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1)>(func))), asmjit::FuncSignature1<RetType, P1>()); }
 
 	template<typename RetType, typename P1, typename P2>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2)>(func))), asmjit::FuncSignature2<RetType, P1, P2>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2)>(func))), asmjit::FuncSignature2<RetType, P1, P2>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3)>(func))), asmjit::FuncSignature3<RetType, P1, P2, P3>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3)>(func))), asmjit::FuncSignature3<RetType, P1, P2, P3>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4)>(func))), asmjit::FuncSignature4<RetType, P1, P2, P3, P4>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4)>(func))), asmjit::FuncSignature4<RetType, P1, P2, P3, P4>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4, typename P5>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5)>(func))), asmjit::FuncSignature5<RetType, P1, P2, P3, P4, P5>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5)>(func))), asmjit::FuncSignature5<RetType, P1, P2, P3, P4, P5>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
-	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6)>(func))), asmjit::FuncSignature6<RetType, P1, P2, P3, P4, P5, P6>()); }
+	asmjit::CCFuncCall *CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6)>(func))), asmjit::FuncSignature6<RetType, P1, P2, P3, P4, P5, P6>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
-	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7)>(func))), asmjit::FuncSignature7<RetType, P1, P2, P3, P4, P5, P6, P7>()); }
+	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7)>(func))), asmjit::FuncSignature7<RetType, P1, P2, P3, P4, P5, P6, P7>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
-	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7, P8)>(func))), asmjit::FuncSignature8<RetType, P1, P2, P3, P4, P5, P6, P7, P8>()); }
+	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7, P8)>(func))), asmjit::FuncSignature8<RetType, P1, P2, P3, P4, P5, P6, P7, P8>()); }
 
 	template<typename RetType, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
-	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)) { return cc.call(asmjit::imm_ptr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7, P8, P9)>(func))), asmjit::FuncSignature9<RetType, P1, P2, P3, P4, P5, P6, P7, P8, P9>()); }
+	asmjit::CCFuncCall* CreateCall(RetType(*func)(P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)) { return cc.call(ImmPtr(reinterpret_cast<void*>(static_cast<RetType(*)(P1, P2, P3, P4, P5, P6, P7, P8, P9)>(func))), asmjit::FuncSignature9<RetType, P1, P2, P3, P4, P5, P6, P7, P8, P9>()); }
 
 	FString regname;
 	size_t tmpPosInt32, tmpPosInt64, tmpPosIntPtr, tmpPosXmmSd, tmpPosXmmSs, tmpPosXmmPd, resultPosInt32, resultPosIntPtr, resultPosXmmSd;
@@ -354,4 +443,10 @@ public:
 };
 
 void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler);
+void *AddCachedJitFunction(VMScriptFunction *sfunc, const TArray<uint8_t> &codeBytes, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart, const TArray<JitLineInfo> &lineInfo, const std::function<bool(uint8_t *)> &patch);
 asmjit::CodeInfo GetHostCodeInfo();
+
+// @Cockatrice - Persistent code cache (jit_cache.cpp)
+void *JitCacheLoad(VMScriptFunction *sfunc);
+void JitCacheAddPass(asmjit::X86Compiler &cc, JitCompiler *compiler);
+void JitCacheStore(JitCompiler *compiler, asmjit::CodeHolder *code, const uint8_t *p, size_t size, const TArray<uint8_t> &unwindInfo, unsigned int fdeFunctionStart);
@@ -57,6 +57,7 @@ extern FMemArena ClassDataAllocator;
 #define MAX_TRY_DEPTH	8	// Maximum number of nested TRYs in a single function
 
 void JitRelease();
+void JitProcessTierUps();	// @Cockatrice - Recompiles script functions that got hot, between frames
 
 extern void (*VM_CastSpriteIDToString)(FString* a, unsigned int b);
 
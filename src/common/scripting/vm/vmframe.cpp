@@ -64,6 +64,8 @@ CVAR(Bool, vm_jit, false, CVAR_NOINITCALL|CVAR_NOSET)
 CVAR(Bool, vm_jit_aot, false, CVAR_NOINITCALL|CVAR_NOSET)
 FString JitCaptureStackTrace(int framesToSkip, bool includeNativeFrames, int maxFrames) { return FString(); }
 void JitRelease() {}
+void JitCacheFlush() {}
+void JitProcessTierUps() {}
 #endif
 
 cycle_t VMCycles[10];
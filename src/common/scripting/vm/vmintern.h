@@ -475,6 +475,7 @@ public:
 	TArray<FTypeAndOffset> SpecialInits;	// list of all contents on the extra stack which require construction and destruction
 
 	bool blockJit = false; // function triggers Jit bugs, block compilation until bugs are fixed
+	struct JitFunctionProfile *JitProfile = nullptr;	// @Cockatrice - Call counts and call site targets for tiered compilation, owned by the JIT
 
 	void InitExtra(void *addr);
 	void DestroyExtra(void *addr);
@@ -325,12 +325,12 @@ public:
 
 	//int32_t vkFormat, glFormat;
 
-	bool SerializeForTextureDef(FILE* fp, FString& name, int useType, FGameTexture* gameTex)  override {
+	bool SerializeForTextureDef(FString& out, FString& name, int useType, FGameTexture* gameTex)  override {
 		const char* fullName = fileSystem.GetFileFullName(SourceLump);
-		fprintf(fp, "%d:%s:%s:%d:%dx%d:%dx%d:%d:%d:%d:%d:", 2, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset, LinearSize, storedMips,  (int)bMasked, (int)bTranslucent);
+		out.AppendFormat("%d:%s:%s:%d:%dx%d:%dx%d:%d:%d:%d:%d:", 2, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset, LinearSize, storedMips,  (int)bMasked, (int)bTranslucent);
 
 		// Signal that the next line is not SPI
-		fprintf(fp, "0\n");
+		out.AppendFormat("0\n");
 
 		return true;
 	}
@@ -65,9 +65,9 @@ public:
 	PalettedPixels CreatePalettedPixels(int conversion, int frame = 0) override;
 	TArray<uint8_t> ReadPalettedPixels(FileReader *lump, int conversion);
 
-	bool SerializeForTextureDef(FILE *fp, FString &name, int useType, FGameTexture *gameTex)  override {
+	bool SerializeForTextureDef(FString &out, FString &name, int useType, FGameTexture *gameTex)  override {
 		const char* fullName = fileSystem.GetFileFullName(SourceLump);
-		fprintf(fp, "%d:%s:%s:%d:%dx%d:%dx%d:%hhu:%d:%d:%d:%hu:%hu:%hu:%d:%u:%u:%d:", 0, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset, BitDepth, ColorType, Interlace, (int)HaveTrans, NonPaletteTrans[0], NonPaletteTrans[1], NonPaletteTrans[2], PaletteSize, StartOfIDAT, StartOfPalette, (int)bMasked);
+		out.AppendFormat("%d:%s:%s:%d:%dx%d:%dx%d:%hhu:%d:%d:%d:%hu:%hu:%hu:%d:%u:%u:%d:", 0, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset, BitDepth, ColorType, Interlace, (int)HaveTrans, NonPaletteTrans[0], NonPaletteTrans[1], NonPaletteTrans[2], PaletteSize, StartOfIDAT, StartOfPalette, (int)bMasked);
 		
 		// Now dump sprite positioning info if necessary
 		if (useType == (int)ETextureType::Sprite		||
@@ -75,12 +75,12 @@ public:
 			useType == (int)ETextureType::Decal
 		) {
 			// Signal 2 lines of SPI
-			fprintf(fp, "2\n");
+			out.AppendFormat("2\n");
 
 			// This is expensive and dirty, but only necessary for dumping data and should not be done when running the game normally
 			for (int x = 0; x < 2; x++) {
 				const SpritePositioningInfo& info = gameTex->GetSpritePositioning(x);
-				fprintf(fp,
+				out.AppendFormat(
 					"-1:%hu:%hu:%hu:%hu:%d:%d:%g:%g:%g:%g:%g:%g:%g:%g:%hhu\n", 
 					info.trim[0], info.trim[1], info.trim[2], info.trim[3],
 					info.spriteWidth, info.spriteHeight,
@@ -92,7 +92,7 @@ public:
 		}
 		else {
 			// Signal that the next line is not SPI
-			fprintf(fp, "0\n");
+			out.AppendFormat("0\n");
 		}
 		
 		return true;
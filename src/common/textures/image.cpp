@@ -227,9 +227,9 @@ FImageLoadParams *FImageSource::NewLoaderParams(int conversion, int translation,
 }
 
 
-bool FImageSource::SerializeForTextureDef(FILE* fp, FString& name, int useType, FGameTexture* gameTex) {
+bool FImageSource::SerializeForTextureDef(FString& out, FString& name, int useType, FGameTexture* gameTex) {
 	const char* fullName = fileSystem.GetFileFullName(SourceLump, false);
-	fprintf(fp, "%d:%s:%s:%d:%dx%d:%dx%d\n", 999, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset);
+	out.AppendFormat("%d:%s:%s:%d:%dx%d:%dx%d\n", 999, name.GetChars(), fullName != NULL ? fullName : "-", useType, Width, Height, LeftOffset, TopOffset);
 	return true;
 }
 
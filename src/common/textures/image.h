@@ -181,7 +181,7 @@ public:
 	FImageSource(int sourcelump = -1) noexcept : SourceLump(sourcelump) { ImageID = ++NextID; }
 	virtual ~FImageSource() = default;
 
-	virtual bool SerializeForTextureDef(FILE* fp, FString& name, int useType, FGameTexture* gameTex);
+	virtual bool SerializeForTextureDef(FString& out, FString& name, int useType, FGameTexture* gameTex);
 	virtual int DeSerializeFromTextureDef(FileReader &fr);
 	virtual bool DeSerializeExtraDataFromTextureDef(FileReader& fr, FGameTexture* gameTex) { return true; }
 
@@ -179,6 +179,41 @@ bool M_CreatePNG (FileWriter *file, const uint8_t *buffer, const PalEntry *palet
 	return M_SaveBitmap (buffer, color_type, width, height, pitch, file);
 }
 
+//==========================================================================
+//
+// FPNGImage :: Capture
+//
+//==========================================================================
+
+void FPNGImage::Capture(const uint8_t *buffer, const PalEntry *pal, ESSType color_type, int w, int h, int pitch, float g)
+{
+	int rowbytes = w * (color_type == SS_PAL ? 1 : color_type == SS_RGB ? 3 : 4);
+
+	colorType = color_type;
+	width = w;
+	height = h;
+	gamma = g;
+	if (pal != nullptr) memcpy(palette, pal, sizeof(palette));
+
+	pixels.Resize(rowbytes * h);
+	for (int y = 0; y < h; y++)
+	{
+		memcpy(&pixels[y * rowbytes], buffer + (ptrdiff_t)y * pitch, rowbytes);
+	}
+}
+
+//==========================================================================
+//
+// FPNGImage :: Write
+//
+//==========================================================================
+
+bool FPNGImage::Write(FileWriter *file) const
+{
+	int rowbytes = width * (colorType == SS_PAL ? 1 : colorType == SS_RGB ? 3 : 4);
+	return M_CreatePNG(file, pixels.Data(), colorType == SS_PAL ? palette : nullptr, colorType, width, height, rowbytes, gamma);
+}
+
 //==========================================================================
 //
 // M_CreateDummyPNG
@@ -37,6 +37,7 @@
 #include "zstring.h"
 #include "files.h"
 #include "palentry.h"
+#include "tarray.h"
 
 // Screenshot buffer image data types
 enum ESSType
@@ -69,6 +70,23 @@ bool M_FinishPNG (FileWriter *file);
 
 bool M_SaveBitmap(const uint8_t *from, ESSType color_type, int width, int height, int pitch, FileWriter *file);
 
+// @Cockatrice - Image data captured for M_CreatePNG, so that the encoding can happen later on another thread.
+struct FPNGImage
+{
+	TArray<uint8_t> pixels;
+	PalEntry palette[256];
+	ESSType colorType = SS_RGB;
+	int width = 0, height = 0;
+	float gamma = 1.f;
+
+	// Takes the same arguments as M_CreatePNG. Rows are copied top to bottom, so a negative pitch flips the image.
+	void Capture(const uint8_t *buffer, const PalEntry *pal, ESSType color_type, int width, int height, int pitch, float gamma);
+	bool IsEmpty() const { return width <= 0 || height <= 0; }
+
+	// Starts a PNG file with the captured image, same as M_CreatePNG
+	bool Write(FileWriter *file) const;
+};
+
 // PNG Reading --------------------------------------------------------------
 
 struct PNGHandle
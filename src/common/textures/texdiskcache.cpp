@@ -0,0 +1,324 @@
+/*
+** texdiskcache.cpp
+** @Cockatrice - Persistent cache of decoded texture data
+**
+** Entries are keyed on the source lump's container, offset, size and CRC
+** (or the source file's size and time where there is no CRC) and on the
+** game palette, so that any change to the archive or the palette
+** invalidates them. Each entry is a small
+** header followed by the raw RGBA buffer exactly as the loaders upload it,
+** which lets a cache hit copy straight from the mapped file into the
+** upload buffer.
+**
+** The directory is kept below gl_texture_diskcache_size by deleting the
+** oldest entries, checked on first use and whenever writes go past it.
+**
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <vector>
+
+#include "texdiskcache.h"
+#include "image.h"
+#include "textures.h"
+#include "filesystem.h"
+#include "fs_findfile.h"
+#include "i_specialpaths.h"
+#include "cmdlib.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "m_crc32.h"
+#include "palettecontainer.h"
+
+CVAR(Bool, gl_texture_diskcache, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, gl_texture_diskcache_size, 1024, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// in megabytes
+
+FTextureDiskCache TexDiskCache;
+
+static const uint32_t TEXCACHE_MAGIC = MAKE_ID('T', 'X', 'D', 'C');
+static const uint32_t TEXCACHE_VERSION = 3;
+
+struct FTexDiskCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	FTexDiskCacheKey key;
+	int32_t width, height;
+	int32_t translucent;
+	int32_t hasSpi;
+	SpritePositioningInfo spi[2];
+};
+
+
+static uint64_t HashBytes(const void *data, size_t len, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	auto *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t FTexDiskCacheKey::Hash() const
+{
+	return HashBytes(this, sizeof(*this));
+}
+
+
+bool FTextureDiskCache::IsEnabled() const
+{
+	return gl_texture_diskcache;
+}
+
+const char *FTextureDiskCache::CacheDir()
+{
+	static FString dir;
+	static std::once_flag created;
+
+	std::call_once(created, [this]() {
+		dir = M_GetCachePath(true);
+		dir << "/textures/";
+		CreatePath(dir.GetChars());
+		Prune(dir.GetChars());
+	});
+
+	return dir.GetChars();
+}
+
+static FString EntryPath(const char *dir, const FTexDiskCacheKey &key)
+{
+	FString path;
+	path.Format("%s%016llx.tex", dir, (unsigned long long)key.Hash());
+	return path;
+}
+
+
+bool FTextureDiskCache::MakeKey(const FImageLoadParams *params, int expand, bool notrimming, FTexDiskCacheKey &key)
+{
+	if (!gl_texture_diskcache || params == nullptr) return false;
+	if (params->lump < 0 || params->translation != 0 || params->remap != nullptr) return false;
+
+	// Zero everything first so padding doesn't leak into the hash
+	memset(&key, 0, sizeof(key));
+
+	int container = fileSystem.GetFileContainer(params->lump);
+	const char *containerName = fileSystem.GetResourceFileFullName(container);
+	if (containerName == nullptr) return false;
+
+	key.containerHash = HashBytes(containerName, strlen(containerName));
+	key.offset = fileSystem.GetFileOffset(params->lump);
+	key.length = (uint32_t)fileSystem.FileLength(params->lump);
+	key.crc = fileSystem.GetFileCRC32(params->lump);
+	key.conversion = params->conversion;
+	key.expand = (uint8_t)expand;
+	key.notrimming = notrimming;
+	// Patches, flats and other paletted formats decode through the game palette, which a later PWAD's PLAYPAL can replace
+	key.palette = HashBytes(GPalette.BaseColors, sizeof(GPalette.BaseColors));
+
+	if (key.crc == 0)
+	{
+		// Only zips carry a CRC in the directory. For everything else the source file's size and
+		// modification time stand in for it, so that building the key doesn't read the lump.
+		size_t size;
+		time_t mtime;
+		bool found = GetFileInfo(containerName, &size, &mtime);
+		if (!found)
+		{
+			// Directories: the lump is a file of its own
+			FString lumpPath;
+			lumpPath.Format("%s/%s", containerName, fileSystem.GetFileFullName(params->lump, false));
+			found = GetFileInfo(lumpPath.GetChars(), &size, &mtime);
+		}
+
+		if (found)
+		{
+			int64_t info[2] = { (int64_t)size, (int64_t)mtime };
+			key.filestamp = HashBytes(info, sizeof(info));
+		}
+		else
+		{
+			// Nested containers or names that don't map back to the disk, hash the data
+			auto data = fileSystem.ReadFile(params->lump);
+			key.crc = CalcCRC32(data.bytes(), (unsigned)data.size());
+		}
+	}
+
+	return true;
+}
+
+
+//==========================================================================
+//
+// Counts the cache directory and, if it is over the size limit, deletes
+// the entries that were written longest ago until it is down to three
+// quarters of it. Only one thread prunes at a time, the others go on.
+//
+//==========================================================================
+
+void FTextureDiskCache::Prune(const char *dir)
+{
+	if (pruning.exchange(true)) return;
+
+	const int64_t limit = int64_t(max(*gl_texture_diskcache_size, 16)) << 20;
+	auto files = FileSys::FileList();
+	int64_t total = 0;
+	if (FileSys::ScanDirectory(files, dir, "*.tex", true))
+	{
+		for (auto &file : files)
+		{
+			if (!file.isDirectory) total += file.Length;
+		}
+	}
+
+	if (total > limit)
+	{
+		struct FAgedEntry
+		{
+			const FileSys::FileListEntry *file;
+			time_t time;
+		};
+		std::vector<FAgedEntry> entries;
+		for (auto &file : files)
+		{
+			size_t size;
+			time_t time;
+			if (!file.isDirectory && GetFileInfo(file.FilePath.c_str(), &size, &time)) entries.push_back({ &file, time });
+		}
+		std::sort(entries.begin(), entries.end(), [](const FAgedEntry &a, const FAgedEntry &b) { return a.time < b.time; });
+
+		// An entry a loader is reading either keeps its data until it is closed or, on Windows, stays for now
+		for (auto &entry : entries)
+		{
+			if (total <= limit / 4 * 3) break;
+			if (remove(entry.file->FilePath.c_str()) == 0) total -= entry.file->Length;
+		}
+	}
+
+	totalSize = total;
+	pruning = false;
+}
+
+
+bool FTextureDiskCache::Read(const FTexDiskCacheKey &key, uint8_t *pixels, int width, int height, bool &translucent, SpritePositioningInfo *spi)
+{
+	FString path = EntryPath(CacheDir(), key);
+	FileReader fr;
+
+	// Mapped, a hit is a single copy out of the page cache. Where mapping isn't available it is read normally.
+	if (!fr.OpenMapped(path.GetChars()) && !fr.OpenFile(path.GetChars()))
+	{
+		statMisses++;
+		return false;
+	}
+
+	FTexDiskCacheHeader header;
+	size_t pixelSize = 4u * (size_t)width * (size_t)height;
+	bool ok = fr.GetLength() == (FileReader::Size)(sizeof(header) + pixelSize) &&
+		fr.Read(&header, sizeof(header)) == (FileReader::Size)sizeof(header) &&
+		header.magic == TEXCACHE_MAGIC &&
+		header.version == TEXCACHE_VERSION &&
+		memcmp(&header.key, &key, sizeof(key)) == 0 &&
+		header.width == width && header.height == height &&
+		(spi == nullptr || header.hasSpi) &&
+		fr.Read(pixels, pixelSize) == (FileReader::Size)pixelSize;
+
+	fr.Close();
+
+	if (!ok)
+	{
+		statMisses++;
+		return false;
+	}
+
+	translucent = header.translucent != 0;
+	if (spi != nullptr)
+	{
+		spi[0] = header.spi[0];
+		spi[1] = header.spi[1];
+	}
+
+	statHits++;
+	return true;
+}
+
+
+void FTextureDiskCache::Write(const FTexDiskCacheKey &key, const uint8_t *pixels, int width, int height, bool translucent, const SpritePositioningInfo *spi)
+{
+	FTexDiskCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXCACHE_MAGIC;
+	header.version = TEXCACHE_VERSION;
+	header.key = key;
+	header.width = width;
+	header.height = height;
+	header.translucent = translucent ? 1 : 0;
+	header.hasSpi = spi != nullptr;
+	if (spi != nullptr)
+	{
+		header.spi[0] = spi[0];
+		header.spi[1] = spi[1];
+	}
+
+	// Write to a per-thread temp file and rename it into place so a reader never sees a partial entry
+	FString path = EntryPath(CacheDir(), key);
+	FString tempPath;
+	tempPath.Format("%s.%zx", path.GetChars(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	FILE *f = fopen(tempPath.GetChars(), "wb");
+	if (f == nullptr) return;
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		fwrite(pixels, 4u * (size_t)width * (size_t)height, 1, f) == 1;
+	ok = fclose(f) == 0 && ok;
+
+	// Replaces an existing entry in one step, there is no moment without a file for other threads or instances
+	ok = ok && RenameFileReplacing(tempPath.GetChars(), path.GetChars());
+	if (!ok)
+	{
+		RemoveFile(tempPath.GetChars());
+		return;
+	}
+
+	// Entries that replaced an older one are counted twice until the next prune recounts the directory
+	int64_t entrySize = int64_t(sizeof(header) + 4u * (size_t)width * (size_t)height);
+	if (totalSize.fetch_add(entrySize) + entrySize > (int64_t(max(*gl_texture_diskcache_size, 16)) << 20)) Prune(CacheDir());
+}
+
+
+void FTextureDiskCache::Clear()
+{
+	FString dir = CacheDir();
+	auto files = FileSys::FileList();
+	if (!FileSys::ScanDirectory(files, dir.GetChars(), "*.tex", true))
+		return;
+
+	int count = 0;
+	for (auto &file : files)
+	{
+		if (!file.isDirectory && remove(file.FilePath.c_str()) == 0) count++;
+	}
+
+	statHits = statMisses = 0;
+	totalSize = 0;
+	Printf("Removed %d cached textures\n", count);
+}
+
+
+CCMD(texcache_clear)
+{
+	TexDiskCache.Clear();
+}
+
+CCMD(texcache_stats)
+{
+	Printf("Texture disk cache: %s, %d hits, %d misses, %.1f of %d MB used\n", gl_texture_diskcache ? "enabled" : "disabled", TexDiskCache.statHits.load(), TexDiskCache.statMisses.load(),
+		TexDiskCache.UsedBytes() / 1048576., *gl_texture_diskcache_size);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+class FImageLoadParams;
+struct SpritePositioningInfo;
+
+// @Cockatrice - Key for one decoded texture in the disk cache
+// Identifies the source lump by container, position and CRC or file time, plus everything that changes the decoded output,
+// including the game palette
+struct FTexDiskCacheKey
+{
+	uint64_t containerHash;
+	uint64_t offset;
+	uint64_t filestamp;	// size and time of the file on disk, for containers without CRCs
+	uint64_t palette;	// the game palette that paletted sources are decoded with
+	uint32_t length;
+	uint32_t crc;
+	int32_t conversion;
+	uint8_t expand, notrimming, pad[2];
+
+	uint64_t Hash() const;
+};
+
+// @Cockatrice - Optional on-disk cache of decoded RGBA texture data and sprite positioning info
+// Filled by the background texture loaders so that the next launch can skip PNG inflate and sprite trimming.
+// All functions are safe to call from the loader threads.
+class FTextureDiskCache
+{
+public:
+	bool IsEnabled() const;
+
+	// Returns false if this load can't be cached (translated, remapped, or not from a lump)
+	bool MakeKey(const FImageLoadParams *params, int expand, bool notrimming, FTexDiskCacheKey &key);
+
+	// Reads the cached pixels straight into the upload buffer. spi is only filled when not null,
+	// a cache entry without positioning info is treated as a miss in that case.
+	bool Read(const FTexDiskCacheKey &key, uint8_t *pixels, int width, int height, bool &translucent, SpritePositioningInfo *spi);
+	void Write(const FTexDiskCacheKey &key, const uint8_t *pixels, int width, int height, bool translucent, const SpritePositioningInfo *spi);
+
+	void Clear();
+	int64_t UsedBytes() const { return totalSize; }
+
+	std::atomic<int> statHits = 0, statMisses = 0;
+
+private:
+	const char *CacheDir();
+	void Prune(const char *dir);
+
+	std::atomic<int64_t> totalSize = 0;	// bytes in the cache directory, counted by Prune and kept up by Write
+	std::atomic<bool> pruning = false;
+};
+
+extern FTextureDiskCache TexDiskCache;
@@ -50,8 +50,12 @@
 #include "basics.h"
 #include "cmdlib.h"
 #include "m_argv.h"
+#include "m_crc32.h"
+#include "i_specialpaths.h"
 using namespace FileSys;
 
+CVAR(Bool, r_texturescancache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
 FTextureManager TexMan;
 
 
@@ -103,6 +107,9 @@ void FTextureManager::DeleteAll()
 
 	BuildTileData.Clear();
 	tmanips.Clear();
+	// @Cockatrice - a restart may load different files, the scan cache must be validated against the new ones
+	ContainerHashes.Clear();
+	LoadOrderHash = 0;
 }
 
 //==========================================================================
@@ -1101,9 +1108,12 @@ void FTextureManager::LoadTextureX(int wadnum, FMultipatchTextureBuilder &build)
 
 
 int FTextureManager::ParseBatchTextureDef(int lump, int wadnum) {
-	int total = 0, lineCnt = 0;
-
 	auto reader = fileSystem.OpenFileReader(lump);
+	return ParseBatchTextureDef(reader, wadnum);
+}
+
+int FTextureManager::ParseBatchTextureDef(FileReader &reader, int wadnum) {
+	int total = 0, lineCnt = 0;
 	char buf[1800];
 
 	auto lastPos = reader.Tell();
@@ -1215,6 +1225,11 @@ void FTextureManager::AddTexturesForWad(int wadnum, FMultipatchTextureBuilder& b
 	bool writeCache = Args->CheckParm("-writetexturecache");
 	bool defsLoaded = !writeCache && LoadTextureDefsForWad(wadnum) > 0;
 
+	// @Cockatrice - Without a shipped TEXTURDEF, fall back to the scan cache generated on a previous run.
+	// Folders are left out, their files carry no CRC and are the ones most likely to be edited between runs.
+	bool useScanCache = !writeCache && !defsLoaded && r_texturescancache && !DirExists(fileSystem.GetResourceFileFullName(wadnum));
+	if (useScanCache) defsLoaded = LoadScanCacheForWad(wadnum) > 0;
+
 	// Check if the wad has pre-defined textures
 	if (!defsLoaded) {
 
@@ -1329,6 +1344,7 @@ void FTextureManager::AddTexturesForWad(int wadnum, FMultipatchTextureBuilder& b
 	Printf(TEXTCOLOR_GOLD"Added %d textures for file %d\n", Textures.Size() - firsttexture, wadnum);
 
 	if(!defsLoaded && writeCache) WriteCacheForWad(wadnum);
+	else if (!defsLoaded && useScanCache) WriteScanCacheForWad(wadnum);
 }
 
 
@@ -1341,7 +1357,20 @@ void FTextureManager::WriteCacheForWad(int wadnum) {
 	}
 	fs.AppendFormat("TEXTURDEF.%s.txt", fn.GetChars());
 
+	FString defs;
+	if (!SerializeTexturesForWad(wadnum, defs)) return;
+
+	FILE* f = fopen(fs.GetChars(), "w");
+	if (f == nullptr) return;
 
+	fwrite(defs.GetChars(), defs.Len(), 1, f);
+	fclose(f);
+}
+
+
+// @Cockatrice - Write a TEXTURDEF style definition for every texture that came from this file
+// Returns false if the file has nothing worth caching
+bool FTextureManager::SerializeTexturesForWad(int wadnum, FString &out) {
 	const char* nms[] =
 	{
 		"Any",
@@ -1363,13 +1392,12 @@ void FTextureManager::WriteCacheForWad(int wadnum) {
 		"SWCanvas",
 	};
 
+	FString fn = fileSystem.GetResourceFileName(wadnum);
 	int firsttexture = FirstTextureForFile[wadnum];
 	int lasttexture = (int)FirstTextureForFile.Size() > wadnum + 1 ? FirstTextureForFile[wadnum + 1] : Textures.Size();
 
-	if (firsttexture >= lasttexture) return;	// No textures, skip
-	if (fn.CompareNoCase("game_support.pk3") == 0 || fn.CompareNoCase("gzdoom.pk3") == 0) return; // Skip known useless files
-
-	FILE* f = fopen(fs.GetChars(), "w");
+	if (firsttexture >= lasttexture) return false;	// No textures, skip
+	if (fn.CompareNoCase("game_support.pk3") == 0 || fn.CompareNoCase("gzdoom.pk3") == 0) return false; // Skip known useless files
 
 	for (int x = firsttexture; x < lasttexture; x++) {
 		FGameTexture* tx = Textures[x].Texture;
@@ -1396,11 +1424,159 @@ void FTextureManager::WriteCacheForWad(int wadnum) {
 
 		// Get image source, serialize image from image source
 		FString name = tx->GetName();
-		img->GetImage()->SerializeForTextureDef(f, name, useType, tx);
+		img->GetImage()->SerializeForTextureDef(out, name, useType, tx);
 		progressFunc();
 	}
 
-	fclose(f);
+	return true;
+}
+
+
+//==========================================================================
+//
+// @Cockatrice - Texture scan cache
+//
+// The same definitions WriteCacheForWad produces, generated automatically
+// into the user's cache folder. The binary header ties the cache to the
+// exact file it was made from and to the load order, since overrides from
+// later files change what gets scanned. Only archives are cached.
+//
+//==========================================================================
+
+static const uint32_t TEXSCAN_MAGIC = MAKE_ID('T', 'S', 'C', 'N');
+static const uint32_t TEXSCAN_VERSION = 1;	// Bump when the TEXTURDEF serialization changes
+
+struct FTexScanCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t archiveSize;
+	int64_t archiveTime;
+	uint64_t directoryHash;
+	uint64_t loadOrderHash;
+	uint32_t payloadSize;
+	uint32_t payloadCRC;
+};
+
+static uint64_t HashScanBytes(const void *data, size_t len, uint64_t hash)
+{
+	auto *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+void FTextureManager::HashContainers()
+{
+	int wadcnt = fileSystem.GetNumWads();
+	if ((int)ContainerHashes.Size() == wadcnt) return;
+
+	ContainerHashes.Resize(wadcnt);
+	LoadOrderHash = 0xcbf29ce484222325ull;
+
+	for (int wadnum = 0; wadnum < wadcnt; wadnum++) {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		int first = fileSystem.GetFirstEntry(wadnum);
+		int last = fileSystem.GetLastEntry(wadnum);
+
+		for (int i = first; i <= last; i++) {
+			const char *name = fileSystem.GetFileFullName(i, false);
+			uint64_t info[2] = { (uint64_t)fileSystem.FileLength(i), fileSystem.GetFileCRC32(i) };
+			if (name != nullptr) hash = HashScanBytes(name, strlen(name), hash);
+			hash = HashScanBytes(info, sizeof(info), hash);
+		}
+
+		ContainerHashes[wadnum] = hash;
+		LoadOrderHash = HashScanBytes(&hash, sizeof(hash), LoadOrderHash);
+	}
+}
+
+FString FTextureManager::ScanCachePath(int wadnum) {
+	const char *fullName = fileSystem.GetResourceFileFullName(wadnum);
+	FString path = M_GetCachePath(true);
+	path << "/texscan/";
+	CreatePath(path.GetChars());
+
+	// The file name alone is not unique, two mods can ship a textures.pk3
+	FString fn = fileSystem.GetResourceFileName(wadnum);
+	path.AppendFormat("%s.%016llx.tsc", fn.GetChars(), (unsigned long long)HashScanBytes(fullName, strlen(fullName), 0xcbf29ce484222325ull));
+	return path;
+}
+
+static void FillScanCacheHeader(FTexScanCacheHeader &header, int wadnum, uint64_t directoryHash, uint64_t loadOrderHash) {
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXSCAN_MAGIC;
+	header.version = TEXSCAN_VERSION;
+	header.directoryHash = directoryHash;
+	header.loadOrderHash = loadOrderHash;
+
+	size_t size = 0;
+	time_t mtime = 0;
+	if (GetFileInfo(fileSystem.GetResourceFileFullName(wadnum), &size, &mtime)) {
+		header.archiveSize = size;
+		header.archiveTime = (int64_t)mtime;
+	}
+}
+
+int FTextureManager::LoadScanCacheForWad(int wadnum) {
+	HashContainers();
+
+	FString path = ScanCachePath(wadnum);
+	FileReader fr;
+	if (!fr.OpenFile(path.GetChars())) return 0;
+
+	// Read everything at once and parse from memory
+	auto data = fr.Read(fr.GetLength());
+	fr.Close();
+
+	FTexScanCacheHeader expected, header;
+	FillScanCacheHeader(expected, wadnum, ContainerHashes[wadnum], LoadOrderHash);
+
+	if (data.size() < sizeof(header)) return 0;
+	memcpy(&header, data.data(), sizeof(header));
+
+	if (header.magic != expected.magic || header.version != expected.version ||
+		header.archiveSize != expected.archiveSize || header.archiveTime != expected.archiveTime ||
+		header.directoryHash != expected.directoryHash || header.loadOrderHash != expected.loadOrderHash ||
+		header.payloadSize != data.size() - sizeof(header) ||
+		header.payloadCRC != CalcCRC32(data.bytes() + sizeof(header), header.payloadSize)) {
+		DPrintf(DMSG_NOTIFY, "Texture scan cache for %s is out of date\n", fileSystem.GetResourceFileName(wadnum));
+		return 0;
+	}
+
+	FileReader payload;
+	payload.OpenMemory(data.bytes() + sizeof(header), header.payloadSize);
+	return ParseBatchTextureDef(payload, wadnum);
+}
+
+void FTextureManager::WriteScanCacheForWad(int wadnum) {
+	HashContainers();
+
+	// Header and definitions are put together in memory and written in one go
+	FString payload;
+	if (!SerializeTexturesForWad(wadnum, payload) || payload.Len() == 0) return;
+
+	FTexScanCacheHeader header;
+	FillScanCacheHeader(header, wadnum, ContainerHashes[wadnum], LoadOrderHash);
+	header.payloadSize = (uint32_t)payload.Len();
+	header.payloadCRC = CalcCRC32((const uint8_t *)payload.GetChars(), (unsigned)payload.Len());
+
+	TArray<uint8_t> buffer(sizeof(header) + payload.Len(), true);
+	memcpy(buffer.Data(), &header, sizeof(header));
+	memcpy(buffer.Data() + sizeof(header), payload.GetChars(), payload.Len());
+
+	FString path = ScanCachePath(wadnum);
+	FString tempPath = path + ".tmp";
+	FILE* f = fopen(tempPath.GetChars(), "wb");
+	if (f == nullptr) return;
+
+	bool ok = fwrite(buffer.Data(), buffer.Size(), 1, f) == 1;
+	ok = fclose(f) == 0 && ok;
+	ok = ok && RenameFileReplacing(tempPath.GetChars(), path.GetChars());
+	if (!ok) RemoveFile(tempPath.GetChars());
 }
 
 
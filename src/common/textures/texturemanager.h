@@ -133,6 +133,7 @@ public:
 	void LoadTextureDefs(int wadnum, const char *lumpname, FMultipatchTextureBuilder &build);
 	void ParseColorization(FScanner& sc);
 	int ParseBatchTextureDef(int lump, int wadnum);
+	int ParseBatchTextureDef(FileReader &reader, int wadnum);
 	void ParseTextureDef(int remapLump, FMultipatchTextureBuilder &build);
 	void SortTexturesByType(int start, int end);
 	bool AreTexturesCompatible (FTextureID picnum1, FTextureID picnum2);
@@ -140,6 +141,8 @@ public:
 	int LoadTextureDefsForWad(int wadnum);
 	void WriteCache();
 	void WriteCacheForWad(int wadnum);
+	int LoadScanCacheForWad(int wadnum);
+	void WriteScanCacheForWad(int wadnum);
 
 	FTextureID CreateTexture (int lumpnum, ETextureType usetype=ETextureType::Any);	// Also calls AddTexture
 	FTextureID AddGameTexture(FGameTexture* texture, bool addtohash = true);
@@ -204,6 +207,9 @@ public:
 private:
 
 	void InitPalettedVersions();
+	bool SerializeTexturesForWad(int wadnum, FString &out);
+	void HashContainers();
+	FString ScanCachePath(int wadnum);
 
 	// Switches
 
@@ -231,6 +237,8 @@ private:
 	int HashFirst[HASH_SIZE];
 	FTextureID DefaultTexture;
 	TArray<int> FirstTextureForFile;
+	TArray<uint64_t> ContainerHashes;	// @Cockatrice - Directory hash of every loaded file, used to validate the scan cache
+	uint64_t LoadOrderHash = 0;
 	TArray<TArray<uint8_t> > BuildTileData;
 	TArray<int> Translation;
 
@@ -1,35 +1,176 @@
 #include "TSQueue.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "i_time.h"
+#include "c_cvars.h"
 
-/*template <typename IP, typename OP>
-void ResourceLoader<IP, OP>::bgproc() { 
-	std::unique_lock<std::mutex> lock(mWakeLock);
+#include <vector>
 
-	while (mActive.load()) {
-		bool processed = false;
+// 0 = size from the number of hardware threads
+CUSTOM_CVAR(Int, bg_loader_threads, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOINITCALL)
+{
+	if (self < 0) self = 0;
+	else if (self > 64) self = 64;
+	else Printf("Background loader thread count will change after restart.\n");
+}
 
-		// Process the queue
-		while (true) {
-			if (mInputQ.size() > 0) {
-				prepareLoad();
-			}
 
-			IP input;
-			if (!mInputQ.dequeue(input)) {
-				cancelLoad();
+// @Cockatrice - Shared background loader pool ====================================
+// =================================================================================
+ResourceLoaderPool& ResourceLoaderPool::Instance() {
+	static ResourceLoaderPool pool;
+	return pool;
+}
+
+int ResourceLoaderPool::numWorkers() {
+	if (bg_loader_threads > 0) return bg_loader_threads;
+
+	// Leave room for the game and render threads
+	int hw = (int)std::thread::hardware_concurrency();
+	return clamp(hw - 2, 2, 32);
+}
+
+void ResourceLoaderPool::startWorkers() {
+	if (mActive.load()) return;
+
+	mActive.store(true);
+	int count = numWorkers();
+	for (int x = 0; x < count; x++) {
+		mWorkers.emplace_back(&ResourceLoaderPool::workerProc, this);
+	}
+}
+
+void ResourceLoaderPool::shutdown() {
+	{
+		std::lock_guard lock(mLock);
+		if (!mActive.load()) return;
+		mActive.store(false);
+	}
+
+	mWake.notify_all();
+	for (auto& t : mWorkers) t.join();
+	mWorkers.clear();
+}
+
+void ResourceLoaderPool::addLoader(ResourceLoaderJob* job) {
+	{
+		std::lock_guard lock(mLock);
+		startWorkers();
+
+		// Keep the list sorted by priority, jobs of equal priority are serviced in the order they were added
+		unsigned int index = 0;
+		while (index < mJobs.Size() && mJobs[index]->priority() >= job->priority()) index++;
+		mJobs.Insert(index, job);
+		mPendingWake = true;
+	}
+
+	mWake.notify_all();
+}
+
+void ResourceLoaderPool::removeLoader(ResourceLoaderJob* job) {
+	{
+		std::lock_guard lock(mLock);
+		unsigned int index = mJobs.Find(job);
+		if (index < mJobs.Size()) mJobs.Delete(index);
+	}
+
+	// No worker can claim the job anymore, wait for the current load to finish
+	while (job->mClaimed.load()) {
+		std::this_thread::yield();
+	}
+}
+
+void ResourceLoaderPool::wake() {
+	{
+		std::lock_guard lock(mLock);
+		mPendingWake = true;
+	}
+
+	mWake.notify_one();
+}
+
+void ResourceLoaderPool::workerProc() {
+	std::unique_lock<std::mutex> lock(mLock);
+
+	while (mActive.load()) {
+		ResourceLoaderJob* job = nullptr;
+
+		// Take the highest priority job that has work and is not being run by another worker
+		for (auto j : mJobs) {
+			if (j->hasWork() && !j->mClaimed.exchange(true)) {
+				job = j;
 				break;
 			}
+		}
 
-			OP output;
-			if (loadResource(input, output)) {
-				mOutputQ.queue(output);
-			}
-			processed = true;
+		if (job == nullptr) {
+			// The timeout is only a fallback for queues that were filled without notifying
+			mWake.wait_for(lock, std::chrono::milliseconds(50), [this] { return mPendingWake || !mActive.load(); });
+			mPendingWake = false;
+			continue;
+		}
+
+		// Load one item and go back to the list so higher priority work can preempt this job
+		lock.unlock();
+		job->processOne();
+		job->mClaimed.store(false);
+		lock.lock();
+	}
+}
 
-			completeLoad();
+
+// @Cockatrice - Contention benchmark for TSQueue
+// Usage: bench_tsqueue [items per producer] [consumers]
+// Runs 1-8 producer threads against a fixed set of consumers and reports throughput
+CCMD(bench_tsqueue)
+{
+	int itemsPerProducer = argv.argc() > 1 ? max(1, (int)strtol(argv[1], nullptr, 0)) : 100000;
+	int numConsumers = argv.argc() > 2 ? clamp((int)strtol(argv[2], nullptr, 0), 1, 8) : 2;
+
+	Printf("TSQueue contention benchmark: %d items per producer, %d consumers\n", itemsPerProducer, numConsumers);
+
+	for (int numProducers = 1; numProducers <= 8; numProducers++) {
+		TSQueue<int64_t> q;
+		std::atomic<int> remaining{ itemsPerProducer * numProducers };
+		std::atomic<int64_t> checksum{ 0 };
+		std::atomic<int> maxDepth{ 0 };
+		std::vector<std::thread> threads;
+
+		uint64_t start = I_nsTime();
+
+		for (int p = 0; p < numProducers; p++) {
+			threads.emplace_back([&q, itemsPerProducer]() {
+				for (int64_t x = 1; x <= itemsPerProducer; x++) q.queue(x);
+			});
 		}
 
-		if (!processed) {
-			mWake.wait_for(lock, std::chrono::milliseconds(5));
+		for (int c = 0; c < numConsumers; c++) {
+			threads.emplace_back([&]() {
+				int64_t sum = 0, item;
+				while (remaining.load(std::memory_order_relaxed) > 0) {
+					int depth = q.size();
+					if (depth > maxDepth.load(std::memory_order_relaxed)) maxDepth.store(depth, std::memory_order_relaxed);
+
+					if (q.dequeue(item)) {
+						sum += item;
+						remaining.fetch_sub(1, std::memory_order_relaxed);
+					}
+					else {
+						std::this_thread::yield();
+					}
+				}
+				checksum += sum;
+			});
 		}
+
+		for (auto& t : threads) t.join();
+
+		double ms = (I_nsTime() - start) / 1000000.0;
+		int64_t total = (int64_t)itemsPerProducer * numProducers;
+		int64_t expected = (int64_t)numProducers * ((int64_t)itemsPerProducer * (itemsPerProducer + 1) / 2);
+
+		Printf("  %d producer(s): %8.2fms  %10.0f ops/ms  max depth %-7d %s\n",
+			numProducers, ms, total / max(ms, 0.001), maxDepth.load(),
+			checksum.load() == expected ? "OK" : TEXTCOLOR_RED "CHECKSUM MISMATCH");
 	}
-}*/
\ No newline at end of file
+}
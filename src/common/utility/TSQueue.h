@@ -6,6 +6,7 @@
 #include <mutex>
 #include <atomic>
 #include <algorithm>
+#include <vector>
 
 #ifdef __linux__
 #include <condition_variable>
@@ -65,55 +66,116 @@ struct RingBuffer {
 
 // @Cockatrice: Queue wrapper
 // Funcs added as are necessary
+// Items are stored in a power-of-two ring buffer so queue() and dequeue() are O(1) while
+// the lock is held. The item count is mirrored in an atomic so size() and empty checks
+// never touch the lock, which keeps the main thread from stalling on busy loader queues.
 template <typename T>
 class TSQueue {
 public:
-	TSQueue() {}
+	TSQueue(unsigned int initialCapacity = 64) {
+		unsigned int cap = 1;
+		while (cap < initialCapacity) cap <<= 1;
+		mItems.Resize(cap);
+	}
 	~TSQueue() {
 		clear();
 	}
 
 	bool dequeue(T &item) {
+		if (mCount.load(std::memory_order_acquire) == 0) return false;
+
 		std::lock_guard lock(mQLock);
-		return mQueue.Pop(item);
+		if (mCount.load(std::memory_order_relaxed) == 0) return false;
+
+		item = std::move(mItems[mHead]);
+		mItems[mHead] = T();
+		mHead = (mHead + 1) & mask();
+		mCount.fetch_sub(1, std::memory_order_release);
+		return true;
 	}
 
 	void queue(T &item) {
-		std::lock_guard lock(mQLock);
-		mQueue.Insert(0, item);
+		{
+			std::lock_guard lock(mQLock);
+			unsigned int count = mCount.load(std::memory_order_relaxed);
+			if (count == mItems.Size()) grow();
+
+			mItems[(mHead + count) & mask()] = item;
+			mCount.fetch_add(1, std::memory_order_release);
+		}
+
+		if (mNotify) mNotify();
+	}
+
+	// Called after every queue(), outside the lock. Used to wake whoever consumes this queue
+	void setNotify(void (*func)()) {
+		mNotify = func;
 	}
 
 	void clear() {
 		std::lock_guard lock(mQLock);
-		mQueue.Clear();
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		for (unsigned int x = 0; x < count; x++) mItems[(mHead + x) & mask()] = T();
+		mHead = 0;
+		mCount.store(0, std::memory_order_release);
 	}
 
 	// Delete all items from the queue that match
 	// based on search function
 	int deleteSearch(const std::function <bool(T&)>func) {
 		std::lock_guard lock(mQLock);
-		int size = mQueue.Size();
-		for (unsigned int x = 0; x < mQueue.Size(); x++) {
-			if (func(mQueue[x])) {
-				mQueue.Delete(x);
-				x--;
-			}
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		unsigned int kept = 0;
+
+		// Compact the survivors towards the head, preserving order
+		for (unsigned int x = 0; x < count; x++) {
+			T& it = mItems[(mHead + x) & mask()];
+			if (func(it)) continue;
+			if (kept != x) mItems[(mHead + kept) & mask()] = std::move(it);
+			kept++;
 		}
+		for (unsigned int x = kept; x < count; x++) mItems[(mHead + x) & mask()] = T();
 
-		return size - mQueue.Size();
+		mCount.store(kept, std::memory_order_release);
+		return int(count - kept);
 	}
 
-	// Run this func for all elements in the queue
+	// Run this func for all elements in the queue, oldest first
 	void foreach(const std::function <void(T&)>func) {
 		std::lock_guard lock(mQLock);
-		for (unsigned int x = 0; x < mQueue.Size(); x++) { func(mQueue[x]); }
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		for (unsigned int x = 0; x < count; x++) { func(mItems[(mHead + x) & mask()]); }
+	}
+
+	// Stable sort of the queued items, items that sort first are dequeued first
+	void sort(const std::function <bool(const T&, const T&)>func) {
+		std::lock_guard lock(mQLock);
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		if (count < 2) return;
+
+		std::vector<T> sorted;
+		sorted.reserve(count);
+		for (unsigned int x = 0; x < count; x++) sorted.push_back(std::move(mItems[(mHead + x) & mask()]));
+		std::stable_sort(sorted.begin(), sorted.end(), func);
+		for (unsigned int x = 0; x < count; x++) mItems[(mHead + x) & mask()] = std::move(sorted[x]);
 	}
 
+	// Remove the oldest item matching func and return it in item
 	bool dequeueSearch(T &item, void *cmp, const std::function <bool(void *a,T&)>func) {
+		if (mCount.load(std::memory_order_acquire) == 0) return false;
+
 		std::lock_guard lock(mQLock);
-		for (int x = (int)mQueue.Size() - 1; x >= 0; x--) { 
-			if(func(cmp,mQueue[x])) {
-				mQueue.Pop(item);
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		for (unsigned int x = 0; x < count; x++) {
+			if (func(cmp, mItems[(mHead + x) & mask()])) {
+				item = std::move(mItems[(mHead + x) & mask()]);
+
+				// Close the gap so FIFO order is kept for the remaining items
+				for (unsigned int y = x + 1; y < count; y++) {
+					mItems[(mHead + y - 1) & mask()] = std::move(mItems[(mHead + y) & mask()]);
+				}
+				mItems[(mHead + count - 1) & mask()] = T();
+				mCount.fetch_sub(1, std::memory_order_release);
 				return true;
 			}
 		}
@@ -122,27 +184,107 @@ public:
 	}
 
 	int size() {
-		std::lock_guard lock(mQLock);
-		return mQueue.Size();
+		return (int)mCount.load(std::memory_order_acquire);
 	}
 
 protected:
-	TArray<T> mQueue;
+	TArray<T> mItems;
+	unsigned int mHead = 0;
+	std::atomic<unsigned int> mCount{ 0 };
 	std::mutex mQLock;
+	void (*mNotify)() = nullptr;
+
+	unsigned int mask() const { return mItems.Size() - 1; }
+
+	// Double the capacity, unwrapping the ring so the head starts at 0 again
+	void grow() {
+		unsigned int count = mCount.load(std::memory_order_relaxed);
+		TArray<T> newItems;
+		newItems.Resize(mItems.Size() * 2);
+		for (unsigned int x = 0; x < count; x++) newItems[x] = std::move(mItems[(mHead + x) & mask()]);
+		mItems.Swap(newItems);
+		mHead = 0;
+	}
+};
+
+
+
+// @Cockatrice - Loader priorities, higher values are serviced first by the shared pool
+enum ELoaderPriority {
+	LOADER_PRIORITY_LOW = 0,
+	LOADER_PRIORITY_NORMAL = 1,
+	LOADER_PRIORITY_HIGH = 2,
 };
 
 
+// @Cockatrice - Anything the shared loader pool can service
+// A job is only ever run by one worker at a time, so loaders do not need to be reentrant
+class ResourceLoaderJob {
+public:
+	virtual ~ResourceLoaderJob() {}
+
+	virtual bool hasWork() = 0;
+	virtual bool processOne() = 0;		// Load a single item, return false if there was nothing to load
+
+	int priority() const { return mPriority; }
+	void setPriority(int priority) { mPriority = priority; }
+
+protected:
+	int mPriority = LOADER_PRIORITY_NORMAL;
+	std::atomic<bool> mClaimed{ false };
+
+	friend class ResourceLoaderPool;
+};
+
+
+// @Cockatrice - Shared worker pool for background loaders
+// Replaces one-thread-per-loader. Workers are sized from the core count (see bg_loader_threads)
+// and pull one item at a time from the highest priority loader that has work, so any idle
+// core can pick up work queued for any loader. Workers sleep until a queue notifies them.
+class ResourceLoaderPool {
+public:
+	static ResourceLoaderPool& Instance();
+	static void Notify() { Instance().wake(); }
+
+	~ResourceLoaderPool() { shutdown(); }
+
+	void addLoader(ResourceLoaderJob* job);
+	void removeLoader(ResourceLoaderJob* job);		// Blocks until the job is no longer running on a worker
+	void wake();
+	void shutdown();
+
+	int numWorkers();
+
+private:
+	ResourceLoaderPool() {}
+
+	void startWorkers();
+	void workerProc();
+
+	std::mutex mLock;
+	std::condition_variable mWake;
+	TArray<ResourceLoaderJob*> mJobs;		// Sorted by priority, highest first
+	std::vector<std::thread> mWorkers;
+	bool mPendingWake = false;
+	std::atomic<bool> mActive{ false };
+};
+
 
 // ResourceLoader<InputType, OutputType>
 template <typename IP, typename OP>
-class ResourceLoader {
+class ResourceLoader : public ResourceLoaderJob {
 public:
-	ResourceLoader() { }
+	ResourceLoader() {
+		mInputQ.setNotify(&ResourceLoaderPool::Notify);
+		mInputSecondaryQ.setNotify(&ResourceLoaderPool::Notify);
+	}
 	virtual ~ResourceLoader() { stop(); }
 
 	void start() {
-		if (mThread.get_id() == std::thread::id()) {
-			mThread = std::thread(&ResourceLoader<IP, OP>::bgproc, this);
+		if (!mPooled) {
+			mPooled = true;
+			mActive.store(true);
+			ResourceLoaderPool::Instance().addLoader(this);
 		}
 	}
 
@@ -155,11 +297,11 @@ public:
 	}
 
 	void stop() {
-		// Kill and finish the thread
-		if (mThread.joinable()) {
+		// Remove from the pool, waits for any in-flight load to finish
+		if (mPooled) {
+			mPooled = false;
 			mActive.store(false);
-			mWake.notify_all();
-			mThread.join();
+			ResourceLoaderPool::Instance().removeLoader(this);
 		}
 	}
 
@@ -167,13 +309,11 @@ public:
 	virtual void queue(IP input) {
 		mInputQ.queue(input);
 		mMaxQueue = std::max(mMaxQueue.load(), mInputQ.size());
-		mWake.notify_all();
 	}
 
 	virtual void queueSecondary(IP input) {
 		mInputSecondaryQ.queue(input);
 		mMaxQueueSecondary = std::max(mMaxQueueSecondary.load(), mInputSecondaryQ.size());
-		mWake.notify_all();
 	}
 
 	int numQueued() {
@@ -235,6 +375,51 @@ public:
 		return mStatTotalLoaded.load();
 	}
 
+	bool hasWork() override {
+		return mActive.load() && (mInputQ.size() > 0 || mInputSecondaryQ.size() > 0);
+	}
+
+	bool processOne() override {
+		if (!hasWork()) return false;
+
+		mRunning.store(true);
+
+		cycle_t lTime;
+		lTime.Reset();
+		lTime.Clock();
+
+		prepareLoad();
+
+		IP input;
+		if (!mInputQ.dequeue(input)) {
+			// Always load from secondary queue only if the primary queue has no items
+			if (!mInputSecondaryQ.dequeue(input)) {
+				cancelLoad();
+				mRunning.store(false);
+				return false;
+			}
+		}
+
+		OP output;
+		if (loadResource(input, output)) {
+			mOutputQ.queue(output);
+		}
+
+		completeLoad();
+
+		// Update load stats
+		lTime.Unclock();
+		mStatLoadTime += lTime.TimeMS();
+		mStatLoadCount += 1;
+		mStatAvgTime = mStatLoadTime / mStatLoadCount;
+		mStatMinTime = std::min(mStatMinTime.load(), lTime.TimeMS());
+		mStatMaxTime = std::max(mStatMaxTime.load(), lTime.TimeMS());
+		mStatTotalLoaded++;
+
+		mRunning.store(false);
+		return true;
+	}
+
 protected:
 	// Replace this to actually load the resource in the background
 	virtual bool loadResource(IP &input, OP &output) { return false; }
@@ -242,6 +427,7 @@ protected:
 	virtual void completeLoad() {}		// After load
 	virtual void cancelLoad() {}		// Load was cancelled
 
+	bool mPooled = false;
 	std::atomic<bool> mActive{ true };
 	std::atomic<bool> mRunning{ false };
 	std::atomic<int> mMaxQueue{ 0 }, mStatTotalLoaded{ 0 }, mMaxQueueSecondary{ 0 };
@@ -249,77 +435,17 @@ protected:
 
 	double mStatLoadTime = 0, mStatLoadCount = 0;
 
-	std::thread mThread;
-	std::mutex mWakeLock, mStatsLock;
-	std::condition_variable mWake;
-
 	TSQueue<IP> mInputQ;
 	TSQueue<IP> mInputSecondaryQ;
 	TSQueue<OP> mOutputQ;
-
-
-private:
-	void bgproc() {
-		std::unique_lock<std::mutex> lock(mWakeLock);
-
-		while (mActive.load()) {
-			bool processed = false;
-
-			// Process the queue
-			while (true) {
-				if (mInputQ.size() > 0 || mInputSecondaryQ.size() > 0) {
-					mRunning.store(true);
-
-					cycle_t lTime;
-					lTime.Reset();
-					lTime.Clock();
-
-					prepareLoad();
-
-					IP input;
-					if (!mInputQ.dequeue(input)) {
-						// Always load from secondary queue only if the primary queue has items
-						if(!mInputSecondaryQ.dequeue(input)) {
-							cancelLoad();
-							break;
-						}
-					}
-
-					OP output;
-					if (loadResource(input, output)) {
-						mOutputQ.queue(output);
-					}
-					processed = true;
-
-					completeLoad();
-
-					// Update load stats
-					lTime.Unclock();
-					mStatLoadTime += lTime.TimeMS();
-					mStatLoadCount += 1;
-					mStatAvgTime = mStatLoadTime / mStatLoadCount;
-					mStatMinTime = std::min(mStatMinTime.load(), lTime.TimeMS());
-					mStatMaxTime = std::max(mStatMaxTime.load(), lTime.TimeMS());
-					mStatTotalLoaded++;
-				}
-				else {
-					break;
-				}
-			}
-
-			mRunning.store(false);
-
-			if (!processed) {
-				mWake.wait_for(lock, std::chrono::milliseconds(5));
-			}
-		}
-	}
 };
 
 
 // @Cockatrice - Redesigning resource loader to work with an arbitrary set of queues
+// Loaders run on the shared ResourceLoaderPool unless they are bound to a thread-specific
+// resource (GL context, Vulkan upload queue), in which case they keep a dedicated thread
 template <typename IP, typename OP>
-class ResourceLoader2 {
+class ResourceLoader2 : public ResourceLoaderJob {
 public:
 	ResourceLoader2() { }
 
@@ -331,12 +457,28 @@ public:
 	virtual ~ResourceLoader2() { stop(); }
 
 	void start() {
-		if (mThread.get_id() == std::thread::id()) {
-			mThread = std::thread(&ResourceLoader2<IP, OP>::bgproc, this);
+		if (usesDedicatedThread()) {
+			if (mThread.get_id() == std::thread::id()) {
+				mThread = std::thread(&ResourceLoader2<IP, OP>::bgproc, this);
+			}
+		}
+		else if (!mPooled) {
+			mPooled = true;
+			mActive.store(true);
+			mInputQ->setNotify(&ResourceLoaderPool::Notify);
+			if (mInputQSecondary) mInputQSecondary->setNotify(&ResourceLoaderPool::Notify);
+			ResourceLoaderPool::Instance().addLoader(this);
 		}
 	}
 
 	void stop() {
+		if (mPooled) {
+			// Remove from the pool, waits for any in-flight load to finish
+			mPooled = false;
+			mActive.store(false);
+			ResourceLoaderPool::Instance().removeLoader(this);
+		}
+
 		// Kill and finish the thread
 		if (mThread.get_id() != std::thread::id() && mThread.joinable()) {
 			mActive.store(false);
@@ -374,13 +516,60 @@ public:
 		return mStatTotalLoaded.load();
 	}
 
+	bool hasWork() override {
+		return mActive.load() && (mInputQ->size() > 0 || (mInputQSecondary != nullptr && mInputQSecondary->size() > 0));
+	}
+
+	bool processOne() override {
+		if (!hasWork()) return false;
+
+		mRunning.store(true);
+
+		cycle_t lTime;
+		lTime.Reset();
+		lTime.Clock();
+
+		prepareLoad();
+
+		IP input;
+		if (!mInputQ->dequeue(input)) {
+			// Always load from secondary queue only if the primary queue has no items
+			if (mInputQSecondary == nullptr || !mInputQSecondary->dequeue(input)) {
+				cancelLoad();
+				mRunning.store(false);
+				return false;
+			}
+		}
+
+		OP output;
+		if (loadResource(input, output)) {
+			mOutputQ->queue(output);
+		}
+
+		completeLoad();
+
+		// Update load stats
+		lTime.Unclock();
+		mStatLoadTime += lTime.TimeMS();
+		mStatLoadCount += 1;
+		mStatAvgTime = mStatLoadTime / mStatLoadCount;
+		mStatMinTime = std::min(mStatMinTime.load(), lTime.TimeMS());
+		mStatMaxTime = std::max(mStatMaxTime.load(), lTime.TimeMS());
+		mStatTotalLoaded++;
+
+		mRunning.store(false);
+		return true;
+	}
+
 protected:
 	// Replace this to actually load the resource in the background
 	virtual bool loadResource(IP& input, OP& output) { return false; }
 	virtual void prepareLoad() {}		// Before load
 	virtual void completeLoad() {}		// After load
 	virtual void cancelLoad() {}		// Load was cancelled
+	virtual bool usesDedicatedThread() { return false; }	// True if loadResource() depends on per-thread state
 
+	bool mPooled = false;
 	std::atomic<bool> mActive{ true };
 	std::atomic<bool> mRunning{ false };
 	std::atomic<int> mStatTotalLoaded{ 0 };
@@ -397,6 +586,7 @@ protected:
 	TSQueue<OP>* mOutputQ = nullptr;
 
 protected:
+	// Only used by loaders that need a dedicated thread
 	virtual void bgproc() {
 		std::unique_lock<std::mutex> lock(mWakeLock);
 
@@ -404,52 +594,13 @@ protected:
 			bool processed = false;
 
 			// Process the queue
-			while (true) {
-				if (mInputQ->size() > 0 || (mInputQSecondary != nullptr && mInputQSecondary->size() > 0)) {
-					mRunning.store(true);
-
-					cycle_t lTime;
-					lTime.Reset();
-					lTime.Clock();
-
-					prepareLoad();
-
-					IP input;
-					if (!mInputQ->dequeue(input)) {
-						// Always load from secondary queue only if the primary queue has no items
-						if (mInputQSecondary == nullptr || !mInputQSecondary->dequeue(input)) {
-							cancelLoad();
-							continue;
-						}
-					}
-
-					OP output;
-					if (loadResource(input, output)) {
-						mOutputQ->queue(output);
-					}
-					processed = true;
-
-					completeLoad();
-
-					// Update load stats
-					lTime.Unclock();
-					mStatLoadTime += lTime.TimeMS();
-					mStatLoadCount += 1;
-					mStatAvgTime = mStatLoadTime / mStatLoadCount;
-					mStatMinTime = std::min(mStatMinTime.load(), lTime.TimeMS());
-					mStatMaxTime = std::max(mStatMaxTime.load(), lTime.TimeMS());
-					mStatTotalLoaded++;
-				}
-				else {
-					break;
-				}
+			while (processOne()) {
+				processed = true;
 			}
 
-			mRunning.store(false);
-
 			if (!processed) {
 				mWake.wait_for(lock, std::chrono::milliseconds(3));
 			}
 		}
 	}
-};
\ No newline at end of file
+};
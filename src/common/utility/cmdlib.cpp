@@ -47,6 +47,9 @@
 #ifndef _WIN32
 #include <pwd.h>
 #include <unistd.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 #endif
 
 /*
@@ -603,6 +606,26 @@ void RemoveFile(const char* file)
 #endif
 }
 
+//==========================================================================
+//
+// RenameFileReplacing
+//
+// @Cockatrice - Moves a file over an existing one in a single step, so
+// anyone opening the target gets either the old or the new file.
+//
+//==========================================================================
+
+bool RenameFileReplacing(const char* from, const char* to)
+{
+#ifndef _WIN32
+	return rename(from, to) == 0;
+#else
+	auto wfrom = WideString(from);
+	auto wto = WideString(to);
+	return !!MoveFileExW(wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#endif
+}
+
 int RemoveDir(const char* file)
 {
 #ifndef _WIN32
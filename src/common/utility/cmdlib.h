@@ -72,6 +72,7 @@ FString strbin1 (const char *start);
 
 void CreatePath(const char * fn);
 void RemoveFile(const char* file);
+bool RenameFileReplacing(const char* from, const char* to);
 int RemoveDir(const char* file);
 
 FString ExpandEnvVars(const char *searchpathstring);
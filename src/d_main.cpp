@@ -136,6 +136,7 @@ EXTERN_CVAR(Bool, cl_customizeinvulmap)
 EXTERN_CVAR(Bool, log_vgafont)
 EXTERN_CVAR(Bool, dlg_vgafont)
 CVAR(Int, vid_renderer, 1, 0)	// for some stupid mods which threw caution out of the window...
+CVAR(Bool, fs_mmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// @Cockatrice - Memory map resource archives, takes effect on the next start
 
 // Provide engine version to ZScript in a portable way
 CUSTOM_CVAR(Int, engine_major, ENG_MAJOR, CVAR_NOSAVE | CVAR_NOSET | CVAR_IGNORE | CVAR_CONFIG_ONLY | CVAR_VIRTUAL)
@@ -1289,6 +1290,7 @@ void D_DoomLoop ()
 			D_ProcessEvents();
 			D_Display ();
 			S_UpdateMusic();
+			JitProcessTierUps();	// @Cockatrice
 			if (wantToRestart)
 			{
 				wantToRestart = false;
@@ -3403,10 +3405,19 @@ static int D_InitGame(const FIWADInfo* iwad_info, std::vector<std::string>& allw
 
 	bool allowduplicates = Args->CheckParm("-allowduplicates");
 	auto hashfile = D_GetHashFile();
+	SetFileMapping(fs_mmap);
 	if (!fileSystem.InitMultipleFiles(allwads, &lfi, FileSystemPrintf, allowduplicates, hashfile))
 	{
 		I_FatalError("FileSystem: no files found");
 	}
+
+	// @Cockatrice - Per-archive breakdown of the file system startup
+	const char* statArg = Args->CheckValue("-stat");
+	if (statArg != nullptr && stricmp(statArg, "startup") == 0)
+	{
+		fileSystem.PrintStartupStats(FileSystemPrintf);
+	}
+
 	allwads.clear();
 	allwads.shrink_to_fit();
 	SetMapxxFlag();
@@ -4074,6 +4085,9 @@ void D_Cleanup()
 		G_CheckDemoStatus();
 	}
 
+	// @Cockatrice - Let a background save finish writing
+	G_FinishSaveGame(true);
+
 	// Music and sound should be stopped first
 	S_StopMusic(true);
 	S_ClearSoundData();
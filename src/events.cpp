@@ -265,6 +265,7 @@ void DNetworkBuffer::Serialize(FSerializer& arc)
 
 void EventManager::CallOnRegister()
 {
+	MarkSubscribersDirty();
 	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
 	{
 		handler->OnRegister();
@@ -337,6 +338,7 @@ bool EventManager::RegisterHandler(DStaticEventHandler* handler)
 		handler->ObjectFlags |= OF_Transient;
 	}
 
+	MarkSubscribersDirty();
 	return true;
 }
 
@@ -370,6 +372,7 @@ bool EventManager::UnregisterHandler(DStaticEventHandler* handler)
 		LastEventHandler = handler->prev;
 		GC::WriteBarrier(handler->prev);
 	}
+	MarkSubscribersDirty();
 	if (handler->IsStatic())
 	{
 		handler->ObjectFlags &= ~OF_Transient;
@@ -633,6 +636,63 @@ void EventManager::Shutdown()
 		handler->Destroy();
 	}
 	FirstEventHandler = LastEventHandler = nullptr;
+	MarkSubscribersDirty();
+}
+
+//==========================================================================
+//
+// @Cockatrice - Per-event subscriber lists
+//
+// The busy world events used to walk every handler and look up its
+// virtual, only to find the empty base implementation in most of them.
+// Handlers are sorted into a list per event instead, so an event that
+// no handler implements costs a branch.
+//
+//==========================================================================
+
+static const char *SubscriptionNames[NUM_EVENT_SUBSCRIPTIONS] =
+{
+	"WorldThingSpawned",
+	"WorldThingDied",
+	"WorldThingGround",
+	"WorldThingRevived",
+	"WorldThingDamaged",
+	"WorldThingDestroyed",
+	"WorldLinePreActivated",
+	"WorldLineActivated",
+	"WorldSectorDamaged",
+	"WorldLineDamaged",
+	"WorldTick",
+};
+
+static bool isEmpty(VMFunction *func);
+
+void EventManager::UpdateSubscribers()
+{
+	static unsigned VIndex[NUM_EVENT_SUBSCRIPTIONS];
+	static bool indexed = false;
+	if (!indexed)
+	{
+		for (int i = 0; i < NUM_EVENT_SUBSCRIPTIONS; i++)
+		{
+			VIndex[i] = GetVirtualIndex(RUNTIME_CLASS(DStaticEventHandler), SubscriptionNames[i]);
+			assert(VIndex[i] != ~0u);
+		}
+		indexed = true;
+	}
+
+	for (auto &list : Subscribers) list.Clear();
+	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
+	{
+		auto &virtuals = handler->GetClass()->Virtuals;
+		for (int i = 0; i < NUM_EVENT_SUBSCRIPTIONS; i++)
+		{
+			VMFunction *func = virtuals.Size() > VIndex[i] ? virtuals[VIndex[i]] : nullptr;
+			// Same test the handlers do before setting up the event
+			if (func != nullptr && !isEmpty(func)) Subscribers[i].Push(handler);
+		}
+	}
+	SubscribersDirty = false;
 }
 
 #define DEFINE_EVENT_LOOPER(name, play) void EventManager::name() \
@@ -642,6 +702,13 @@ void EventManager::Shutdown()
 		handler->name(); \
 }
 
+// @Cockatrice - Same as above for events with a subscriber list
+#define DEFINE_SUBSCRIBED_EVENT_LOOPER(name, play) void EventManager::name() \
+{ \
+	if (ShouldCallStatic(play)) staticEventManager.name(); \
+	Dispatch(ESUB_##name, false, [](DStaticEventHandler *handler) { handler->name(); }); \
+}
+
 void EventManager::OnEngineInitialize()
 {
 	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
@@ -689,6 +756,11 @@ void EventManager::PostSave(int saveType) {
 		handler->PostSave(saveType);
 }
 
+void EventManager::SaveCompleted(int saveType, bool success) {
+	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
+		handler->SaveCompleted(saveType, success);
+}
+
 bool EventManager::HandleError(int errorType, FString errMsg) {
 	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
 		if (handler->IsStatic() && handler->HandleError(errorType, errMsg)) return true;
@@ -740,8 +812,7 @@ void EventManager::WorldThingSpawned(AActor* actor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingSpawned(actor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingSpawned(actor);
+	Dispatch(ESUB_WorldThingSpawned, false, [&](DStaticEventHandler *handler) { handler->WorldThingSpawned(actor); });
 }
 
 void EventManager::WorldThingDied(AActor* actor, AActor* inflictor)
@@ -752,8 +823,7 @@ void EventManager::WorldThingDied(AActor* actor, AActor* inflictor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDied(actor, inflictor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingDied(actor, inflictor);
+	Dispatch(ESUB_WorldThingDied, false, [&](DStaticEventHandler *handler) { handler->WorldThingDied(actor, inflictor); });
 }
 
 void EventManager::WorldThingGround(AActor* actor, FState* st)
@@ -764,8 +834,7 @@ void EventManager::WorldThingGround(AActor* actor, FState* st)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingGround(actor, st);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingGround(actor, st);
+	Dispatch(ESUB_WorldThingGround, false, [&](DStaticEventHandler *handler) { handler->WorldThingGround(actor, st); });
 }
 
 void EventManager::WorldThingRevived(AActor* actor)
@@ -776,8 +845,7 @@ void EventManager::WorldThingRevived(AActor* actor)
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingRevived(actor);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingRevived(actor);
+	Dispatch(ESUB_WorldThingRevived, false, [&](DStaticEventHandler *handler) { handler->WorldThingRevived(actor); });
 }
 
 void EventManager::WorldThingDamaged(AActor* actor, AActor* inflictor, AActor* source, int damage, FName mod, int flags, DAngle angle)
@@ -788,8 +856,7 @@ void EventManager::WorldThingDamaged(AActor* actor, AActor* inflictor, AActor* s
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle);
+	Dispatch(ESUB_WorldThingDamaged, false, [&](DStaticEventHandler *handler) { handler->WorldThingDamaged(actor, inflictor, source, damage, mod, flags, angle); });
 }
 
 void EventManager::WorldThingDestroyed(AActor* actor)
@@ -802,8 +869,7 @@ void EventManager::WorldThingDestroyed(AActor* actor)
 	if (!(actor->ObjectFlags & OF_Spawned))
 		return;
 
-	for (DStaticEventHandler* handler = LastEventHandler; handler; handler = handler->prev)
-		handler->WorldThingDestroyed(actor);
+	Dispatch(ESUB_WorldThingDestroyed, true, [&](DStaticEventHandler *handler) { handler->WorldThingDestroyed(actor); });
 
 	if (ShouldCallStatic(true)) staticEventManager.WorldThingDestroyed(actor);
 }
@@ -812,24 +878,21 @@ void EventManager::WorldLinePreActivated(line_t* line, AActor* actor, int activa
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldLinePreActivated(line, actor, activationType, shouldactivate, optpos);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldLinePreActivated(line, actor, activationType, shouldactivate, optpos != nullptr ? *optpos  : DVector3(0,0,0));
+	Dispatch(ESUB_WorldLinePreActivated, false, [&](DStaticEventHandler *handler) { handler->WorldLinePreActivated(line, actor, activationType, shouldactivate, optpos != nullptr ? *optpos : DVector3(0, 0, 0)); });
 }
 
 void EventManager::WorldLineActivated(line_t* line, AActor* actor, int activationType, DVector3 *optpos)
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldLineActivated(line, actor, activationType, optpos);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		handler->WorldLineActivated(line, actor, activationType, optpos != nullptr ? *optpos : DVector3(0, 0, 0));
+	Dispatch(ESUB_WorldLineActivated, false, [&](DStaticEventHandler *handler) { handler->WorldLineActivated(line, actor, activationType, optpos != nullptr ? *optpos : DVector3(0, 0, 0)); });
 }
 
 int EventManager::WorldSectorDamaged(sector_t* sector, AActor* source, int damage, FName damagetype, int part, DVector3 position, bool isradius)
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldSectorDamaged(sector, source, damage, damagetype, part, position, isradius);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		damage = handler->WorldSectorDamaged(sector, source, damage, damagetype, part, position, isradius);
+	Dispatch(ESUB_WorldSectorDamaged, false, [&](DStaticEventHandler *handler) { damage = handler->WorldSectorDamaged(sector, source, damage, damagetype, part, position, isradius); });
 	return damage;
 }
 
@@ -837,8 +900,7 @@ int EventManager::WorldLineDamaged(line_t* line, AActor* source, int damage, FNa
 {
 	if (ShouldCallStatic(true)) staticEventManager.WorldLineDamaged(line, source, damage, damagetype, side, position, isradius);
 
-	for (DStaticEventHandler* handler = FirstEventHandler; handler; handler = handler->next)
-		damage = handler->WorldLineDamaged(line, source, damage, damagetype, side, position, isradius);
+	Dispatch(ESUB_WorldLineDamaged, false, [&](DStaticEventHandler *handler) { damage = handler->WorldLineDamaged(line, source, damage, damagetype, side, position, isradius); });
 	return damage;
 }
 
@@ -1068,7 +1130,7 @@ void EventManager::NewGame()
 // normal event loopers (non-special, argument-less)
 DEFINE_EVENT_LOOPER(RenderFrame, false)
 DEFINE_EVENT_LOOPER(WorldLightning, true)
-DEFINE_EVENT_LOOPER(WorldTick, true)
+DEFINE_SUBSCRIBED_EVENT_LOOPER(WorldTick, true)
 DEFINE_EVENT_LOOPER(UiTick, false)
 DEFINE_EVENT_LOOPER(PostUiTick, false)
 
@@ -2039,6 +2101,16 @@ void DStaticEventHandler::PostSave(int saveType) {
 }
 
 
+void DStaticEventHandler::SaveCompleted(int saveType, bool success) {
+	IFVIRTUAL(DStaticEventHandler, SaveCompleted)
+	{
+		if (isEmpty(func)) return;
+		VMValue params[3] = { (DStaticEventHandler*)this, saveType, success };
+		VMCall(func, params, 3, nullptr, 0);
+	}
+}
+
+
 bool DStaticEventHandler::HandleError(int errorType, FString engineErrMsg) {
 	IFVIRTUAL(DStaticEventHandler, HandleError)
 	{
@@ -2470,3 +2542,25 @@ CCMD(netevent)
 		primaryLevel->localEventManager->SendNetworkEvent(argv[1], arg[0], arg[1], arg[2], true);
 	}
 }
+
+// @Cockatrice - Lists which handlers receive the subscribed events
+CCMD(eventsubscribers)
+{
+	auto list = [](const char *title, EventManager &manager)
+	{
+		if (manager.SubscribersDirty) manager.UpdateSubscribers();
+		Printf(TEXTCOLOR_YELLOW "%s\n", title);
+		for (int i = 0; i < NUM_EVENT_SUBSCRIPTIONS; i++)
+		{
+			FString names;
+			for (auto handler : manager.Subscribers[i])
+			{
+				names.AppendFormat("%s%s", names.IsEmpty() ? "" : ", ", handler->GetClass()->TypeName.GetChars());
+			}
+			Printf("  %-22s %s\n", SubscriptionNames[i], names.IsEmpty() ? "-" : names.GetChars());
+		}
+	};
+
+	list("Static handlers", staticEventManager);
+	if (primaryLevel != nullptr && primaryLevel->localEventManager != nullptr) list("Map handlers", *primaryLevel->localEventManager);
+}
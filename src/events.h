@@ -321,6 +321,7 @@ public:
 	bool IsSaveAllowed(bool quicksave);			// @Cockatrice - Callback to check if game saving is allowed at this moment
 	void PreSave(int saveType);					// @Cockatrice - Called immediately before a save, allowing managers to alter the world before saving
 	void PostSave(int saveType);				// @Cocaktrice - Called immediately after a save
+	void SaveCompleted(int saveType, bool success);	// @Cockatrice - Called when the background save thread is done writing the file
 	bool HandleError(int errorType, FString engineErrMsg);		// @Cockatrice - Give the script a chance to handle a fatal error more gracefully than a console dump
 
 	//
@@ -460,6 +461,23 @@ enum EventManagerError {
 	ERR_SAVEGAMEVERSION = 5
 };
 
+// @Cockatrice - Events that are dispatched through per-event subscriber lists
+enum EEventSubscription
+{
+	ESUB_WorldThingSpawned,
+	ESUB_WorldThingDied,
+	ESUB_WorldThingGround,
+	ESUB_WorldThingRevived,
+	ESUB_WorldThingDamaged,
+	ESUB_WorldThingDestroyed,
+	ESUB_WorldLinePreActivated,
+	ESUB_WorldLineActivated,
+	ESUB_WorldSectorDamaged,
+	ESUB_WorldLineDamaged,
+	ESUB_WorldTick,
+
+	NUM_EVENT_SUBSCRIPTIONS
+};
 
 struct EventManager
 {
@@ -467,6 +485,42 @@ struct EventManager
 	DStaticEventHandler* FirstEventHandler = nullptr;
 	DStaticEventHandler* LastEventHandler = nullptr;
 
+	// @Cockatrice - Handlers with a non-empty override of each subscribed event, in list order.
+	// Rebuilt on the next dispatch after the handler list changed.
+	TArray<DStaticEventHandler*> Subscribers[NUM_EVENT_SUBSCRIPTIONS];
+	unsigned SubscriberGeneration = 0;
+	bool SubscribersDirty = true;
+
+	void MarkSubscribersDirty()
+	{
+		SubscribersDirty = true;
+		SubscriberGeneration++;
+	}
+	void UpdateSubscribers();
+
+	// Calls func for every subscriber of the event. If a handler changes the handler list,
+	// the rest of the dispatch continues along the linked list, the same as the plain loops do.
+	template<class Func>
+	void Dispatch(EEventSubscription ev, bool reverse, Func &&func)
+	{
+		if (SubscribersDirty) UpdateSubscribers();
+		auto &subs = Subscribers[ev];
+		if (subs.Size() == 0) return;
+
+		const unsigned generation = SubscriberGeneration;
+		const unsigned count = subs.Size();
+		for (unsigned i = 0; i < count; i++)
+		{
+			DStaticEventHandler *handler = subs[reverse ? count - 1 - i : i];
+			func(handler);
+			if (generation != SubscriberGeneration)
+			{
+				while ((handler = reverse ? handler->prev : handler->next) != nullptr) func(handler);
+				return;
+			}
+		}
+	}
+
 	EventManager() = default;
 	EventManager(FLevelLocals *l) { Level = l; }
 	~EventManager() { Shutdown(); }
@@ -524,6 +578,7 @@ struct EventManager
 	// @Cockatrice - Save callbacks
 	void PreSave(int saveType);
 	void PostSave(int saveType);
+	void SaveCompleted(int saveType, bool success);
 	bool HandleError(int errorType, FString errMsg);
 
 	// this executes on every tick on UI side, always
@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <memory>
+#include <thread>
+#include <atomic>
 
 #include "i_time.h"
 
@@ -108,7 +110,7 @@ void	G_DoPlayDemo (void);
 void	G_DoCompleted (void);
 void	G_DoVictory (void);
 void	G_DoWorldDone (void);
-void	G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description);
+void	G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description, int saveType);
 void	G_DoAutoSave ();
 void	G_DoQuickSave ();
 
@@ -121,6 +123,7 @@ CVAR (Bool, chasedemo, false, 0);
 CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (Bool, longsavemessages, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (Bool, cl_waitforsave, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR (Bool, save_async, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);	// @Cockatrice - compress and write savegames on a background thread
 CVAR (Bool, enablescriptscreenshot, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 CVAR (Bool, cl_restartondeath, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 EXTERN_CVAR (Float, con_midtime);
@@ -1140,6 +1143,9 @@ void G_Ticker ()
 	int i;
 	gamestate_t	oldgamestate;
 
+	// @Cockatrice - report a background save that finished since the last tic
+	G_FinishSaveGame(false);
+
 	// do player reborns if needed
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -1189,7 +1195,7 @@ void G_Ticker ()
 			break;
 		case ga_savegame:
 			staticEventManager.PreSave(0);
-			G_DoSaveGame (true, false, savegamefile, savedescription.GetChars());
+			G_DoSaveGame (true, false, savegamefile, savedescription.GetChars(), 0);
 			staticEventManager.PostSave(0);
 			gameaction = ga_nothing;
 			savegamefile = "";
@@ -2022,6 +2028,9 @@ void FinishLoadingCVars();
 
 void G_DoLoadGame ()
 {
+	// @Cockatrice - the file to load may still be getting written
+	G_FinishSaveGame(true);
+
 	SetupLoadingCVars();
 	bool hidecon;
 
@@ -2423,7 +2432,7 @@ void G_DoAutoSave ()
 	description.Format("Autosave: %s", readableTime);
 
 	staticEventManager.PreSave(2);
-	G_DoSaveGame (false, false, file, description.GetChars());
+	G_DoSaveGame (false, false, file, description.GetChars(), 2);
 	staticEventManager.PostSave(2);
 }
 
@@ -2452,7 +2461,7 @@ void G_DoQuickSave ()
 	description.Format("Quicksave: %s", readableTime);
 
 	staticEventManager.PreSave(1);
-	G_DoSaveGame (true, true, file, description.GetChars());
+	G_DoSaveGame (true, true, file, description.GetChars(), 1);
 	staticEventManager.PostSave(1);
 }
 
@@ -2509,26 +2518,152 @@ static void PutSaveComment (FSerializer &arc)
 	arc.AddString("Comment", comment.GetChars());
 }
 
-static void PutSavePic (FileWriter *file, int width, int height)
+static void PutSavePic (FPNGImage *pic, int width, int height)
 {
-	if (width <= 0 || height <= 0 || !storesavepic)
-	{
-		M_CreateDummyPNG (file);
-	}
-	else
+	// An empty picture gets written as a dummy PNG
+	if (width > 0 && height > 0 && storesavepic)
 	{
 		D_Render([&]()
 			{
-				WriteSavePic(&players[consoleplayer], file, width, height);
+				WriteSavePic(&players[consoleplayer], pic, width, height);
 			}, false);
 	}
 }
 
-void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description)
+//==========================================================================
+//
+// @Cockatrice - Savegames are written in two steps. The game thread
+// serializes the world and grabs the savepic's pixels, which is all that
+// needs a consistent world. Compression, PNG encoding, the zip write and
+// the verification happen on a background thread, and the result gets
+// reported from G_Ticker once that is done. Only one save can be in flight,
+// a new save or load waits for the previous one first.
+//
+//==========================================================================
+
+struct FSaveGameJob
+{
+	FString filename;
+	FString description;
+	FString software;
+	FString mapName;
+	bool okForQuicksave;
+	bool forceQuicksave;
+	int saveType;
+	int saveDate;
+
+	FPNGImage savepic;
+	TArray<FString> filenames;
+	TArray<FCompressedBuffer> content;	// all owned by the job, the first entry gets the encoded savepic
+
+	bool succeeded = false;
+	std::atomic<bool> done{ false };
+	std::thread thread;
+
+	~FSaveGameJob()
+	{
+		if (thread.joinable()) thread.join();
+		for (auto &buff : content) buff.Clean();
+	}
+
+	void Run();
+};
+
+static std::unique_ptr<FSaveGameJob> PendingSave;
+
+void FSaveGameJob::Run()
+{
+	BufferWriter pic;
+	if (savepic.IsEmpty()) M_CreateDummyPNG(&pic);
+	else savepic.Write(&pic);
+
+	// put some basic info into the PNG so that this isn't lost when the image gets extracted.
+	M_AppendPNGText(&pic, "Software", software.GetChars());
+	M_AppendPNGText(&pic, "Title", description.GetChars());
+	M_AppendPNGText(&pic, "Current Map", mapName.GetChars());
+	M_FinishPNG(&pic);
+
+	auto picdata = pic.GetBuffer();
+	auto &bufpng = content[0];
+	bufpng.mSize = bufpng.mCompressedSize = picdata->size();
+	bufpng.mMethod = FileSys::METHOD_STORED;
+	bufpng.mCRC32 = static_cast<unsigned int>(crc32(0, picdata->data(), picdata->size()));
+	bufpng.mBuffer = new char[picdata->size()];
+	memcpy(bufpng.mBuffer, picdata->data(), picdata->size());
+
+	// Everything serialized for this save is still uncompressed, the other levels' snapshots already are
+	for (unsigned i = 1; i < content.Size(); i++)
+	{
+		CompressStoredBuffer(content[i]);
+	}
+
+	for (unsigned i = 0; i < content.Size(); i++)
+		content[i].filename = filenames[i].GetChars();
+
+	// Write next to the slot and only replace it once the new file checks out, so that a
+	// crash during the write keeps the previous save and nothing reads a half written file.
+	FString tempname = filename + ".tmp";
+	if (WriteZip(tempname.GetChars(), content.Data(), content.Size()))
+	{
+		// Check whether the file is ok by trying to open it.
+		FResourceFile *test = FResourceFile::OpenResourceFile(tempname.GetChars(), true);
+		if (test != nullptr)
+		{
+			delete test;
+			// rename only replaces an existing file on POSIX systems
+			succeeded = rename(tempname.GetChars(), filename.GetChars()) == 0;
+			if (!succeeded)
+			{
+				remove(filename.GetChars());
+				succeeded = rename(tempname.GetChars(), filename.GetChars()) == 0;
+			}
+		}
+	}
+	if (!succeeded) remove(tempname.GetChars());
+
+	done = true;
+}
+
+//==========================================================================
+//
+// Reports a finished background save. With 'wait' set this blocks until
+// the pending save is done, otherwise it only checks.
+//
+//==========================================================================
+
+void G_FinishSaveGame (bool wait)
+{
+	if (PendingSave == nullptr || (!wait && !PendingSave->done))
+	{
+		return;
+	}
+
+	auto job = std::move(PendingSave);
+	if (job->thread.joinable()) job->thread.join();
+
+	if (job->succeeded)
+	{
+		savegameManager.NotifyNewSave(job->filename, job->description, job->saveDate, job->okForQuicksave, job->forceQuicksave);
+		BackupSaveName = job->filename;
+
+		if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), job->filename.GetChars());
+		else Printf("%s\n", GStrings.GetString("GGSAVED"));
+	}
+	else
+	{
+		Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
+	}
+
+	staticEventManager.SaveCompleted(job->saveType, job->succeeded);
+}
+
+bool G_IsSaving ()
 {
-	TArray<FCompressedBuffer> savegame_content;
-	TArray<FString> savegame_filenames;
+	return PendingSave != nullptr;
+}
 
+void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, const char *description, int saveType)
+{
 	char buf[100];
 
 	// Do not even try, if we're not in a level. (Can happen after
@@ -2543,13 +2678,16 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		filename = G_BuildSaveName ("demosave");
 	}
 
+	// Don't let two saves write at the same time, the second one may even target the same file.
+	G_FinishSaveGame(true);
+
 	if (cl_waitforsave)
 		I_FreezeTime(true);
 
 	insave = true;
 	try
 	{
-		level.SnapshotLevel();
+		level.SnapshotLevel(false);
 	}
 	catch(CRecoverableError &err)
 	{
@@ -2561,6 +2699,8 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		// The time freeze must be reset if the save fails.
 		if (cl_waitforsave)
 			I_FreezeTime(false);
+		// @Cockatrice - Handlers waiting for this save must hear about the failure too
+		staticEventManager.SaveCompleted(saveType, false);
 		return;
 	}
 	catch (...)
@@ -2568,10 +2708,11 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		insave = false;
 		if (cl_waitforsave)
 			I_FreezeTime(false);
+		staticEventManager.SaveCompleted(saveType, false);
 		throw;
 	}
 
-	BufferWriter savepic;
+	auto job = std::make_unique<FSaveGameJob>();
 	FSerializer savegameinfo;		// this is for displayable info about the savegame
 	FSerializer savegameglobals;	// and this for non-level related info that must be saved.
 
@@ -2579,13 +2720,8 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	savegameglobals.OpenWriter(save_formatted);
 
 	SaveVersion = SAVEVER;
-	PutSavePic(&savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
+	PutSavePic(&job->savepic, SAVEPICWIDTH, SAVEPICHEIGHT);
 	mysnprintf(buf, countof(buf), GAMENAME " %s", GetVersionString());
-	// put some basic info into the PNG so that this isn't lost when the image gets extracted.
-	M_AppendPNGText(&savepic, "Software", buf);
-	M_AppendPNGText(&savepic, "Title", description);
-	M_AppendPNGText(&savepic, "Current Map", primaryLevel->MapName.GetChars());
-	M_FinishPNG(&savepic);
 
 	int ver = SAVEVER;
 	savegameinfo.AddString("Software", buf)
@@ -2627,52 +2763,33 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 		savegameglobals("nextskill", NextSkill);
 	}
 
-	auto picdata = savepic.GetBuffer();
-	FCompressedBuffer bufpng = { picdata->size(), picdata->size(), FileSys::METHOD_STORED, static_cast<unsigned int>(crc32(0, &(*picdata)[0], picdata->size())), (char*)&(*picdata)[0] };
+	job->filename = filename;
+	job->description = description;
+	job->software = buf;
+	job->mapName = primaryLevel->MapName;
+	job->okForQuicksave = okForQuicksave;
+	job->forceQuicksave = forceQuicksave;
+	job->saveType = saveType;
+	job->saveDate = cdatei;
 
-	savegame_content.Push(bufpng);
-	savegame_filenames.Push("savepic.png");
-	savegame_content.Push(savegameinfo.GetCompressedOutput());
-	savegame_filenames.Push("info.json");
-	savegame_content.Push(savegameglobals.GetCompressedOutput());
-	savegame_filenames.Push("globals.json");
-	G_WriteSnapshots (savegame_filenames, savegame_content);
-	
-	for (unsigned i = 0; i < savegame_content.Size(); i++)
-		savegame_content[i].filename = savegame_filenames[i].GetChars();
+	job->content.Push({ 0, 0, FileSys::METHOD_STORED, 0, nullptr, nullptr });	// savepic, encoded by the job
+	job->filenames.Push("savepic.png");
+	job->content.Push(savegameinfo.GetStoredOutput());
+	job->filenames.Push("info.json");
+	job->content.Push(savegameglobals.GetStoredOutput());
+	job->filenames.Push("globals.json");
 
-	bool succeeded = false;
-
-	if (WriteZip(filename.GetChars(), savegame_content.Data(), savegame_content.Size()))
+	// The level infos keep their snapshots, so the job needs its own copies
+	TArray<FCompressedBuffer> snapshots;
+	G_WriteSnapshots (job->filenames, snapshots);
+	for (auto snapshot : snapshots)
 	{
-		// Check whether the file is ok by trying to open it.
-		FResourceFile *test = FResourceFile::OpenResourceFile(filename.GetChars(), true);
-		if (test != nullptr)
-		{
-			delete test;
-			succeeded = true;
-		}
+		auto data = new char[snapshot.mCompressedSize];
+		memcpy(data, snapshot.mBuffer, snapshot.mCompressedSize);
+		snapshot.mBuffer = data;
+		job->content.Push(snapshot);
 	}
 
-	if (succeeded)
-	{
-		savegameManager.NotifyNewSave(filename, description, cdatei, okForQuicksave, forceQuicksave);
-		BackupSaveName = filename;
-
-		if (longsavemessages) Printf("%s (%s)\n", GStrings.GetString("GGSAVED"), filename.GetChars());
-		else Printf("%s\n", GStrings.GetString("GGSAVED"));
-	}
-	else
-	{
-		Printf(PRINT_HIGH, "%s\n", GStrings.GetString("TXT_SAVEFAILED"));
-	}
-
-
-	// delete the JSON buffers we created just above. Everything else will
-	// either still be needed or taken care of automatically.
-	savegame_content[1].Clean();
-	savegame_content[2].Clean();
-
 	// We don't need the snapshot any longer.
 	level.info->Snapshot.Clean();
 		
@@ -2680,6 +2797,18 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 
 	if (cl_waitforsave)
 		I_FreezeTime(false);
+
+	PendingSave = std::move(job);
+	if (save_async)
+	{
+		auto pending = PendingSave.get();
+		PendingSave->thread = std::thread([pending]() { pending->Run(); });
+	}
+	else
+	{
+		PendingSave->Run();
+		G_FinishSaveGame(true);
+	}
 }
 
 
@@ -3368,7 +3497,7 @@ DEFINE_ACTION_FUNCTION(FLevelLocals, MakeQuickSave)
 		FString readableTime = myasctime();
 		description.Format("Quicksave %s", readableTime.GetChars());
 		staticEventManager.PreSave(1);
-		G_DoSaveGame(true, true, file, description.GetChars());
+		G_DoSaveGame(true, true, file, description.GetChars(), 1);
 		staticEventManager.PostSave(1);
 		ACTION_RETURN_BOOL(true);
 	}
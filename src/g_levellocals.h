@@ -41,6 +41,7 @@
 #include "r_sky.h"
 #include "portal.h"
 #include "p_blockmap.h"
+#include "p_actorgrid.h"
 #include "p_local.h"
 #include "po_man.h"
 #include "p_acs.h"
@@ -172,7 +173,7 @@ private:
 	void PlayerSpawnPickClass (int playernum);
 
 public:
-	void SnapshotLevel();
+	void SnapshotLevel(bool compress = true);
 	void UnSnapshotLevel(bool hubLoad);
 
 	void FinalizePortals();
@@ -495,6 +496,7 @@ public:
 	TMap<int, FHealthGroup> healthGroups;
 
 	FBlockmap blockmap;
+	FActorGrid ActorGrid;	// @Cockatrice - Serves FBlockThingsIterator queries
 	TArray<polyblock_t *> PolyBlockMap;
 	FUDMFKeyMap UDMFKeys[4];
 
@@ -695,6 +695,7 @@ struct sector_t
 
 	int			skytransfer;						// MBF sky transfer info.
 	int 		validcount;					// if == validcount, already checked
+	uint32_t	RenderStamp;				// @Cockatrice - bumped by the setters below that change how the walls of this sector look
 
 	uint32_t selfmap, bottommap, midmap, topmap;		// killough 4/4/98: dynamic colormaps
 											// [RH] these can also be blend values if
@@ -959,11 +960,13 @@ public:
 	void SetGlowHeight(int pos, float height)
 	{
 		planes[pos].GlowHeight = height;
+		RenderStamp++;
 	}
 
 	void SetGlowColor(int pos, PalEntry color)
 	{
 		planes[pos].GlowColor = color;
+		RenderStamp++;
 	}
 
 	FTextureID GetTexture(int pos) const
@@ -975,6 +978,7 @@ public:
 	{
 		FTextureID old = planes[pos].Texture;
 		planes[pos].Texture = tex;
+		RenderStamp++;
 		if (floorclip && pos == floor && tex != old) AdjustFloorClip();
 	}
 
@@ -991,6 +995,7 @@ public:
 	void SetPlaneTexZ(int pos, double val, bool dirtify = false)	// This mainly gets used by init code. The only place where it must set the vertex to dirty is the interpolation code.
 	{
 		planes[pos].TexZ = val;
+		RenderStamp++;
 		if (dirtify) SetAllVerticesDirty();
 		CheckOverlap();
 	}
@@ -998,6 +1003,7 @@ public:
 	void ChangePlaneTexZ(int pos, double val)
 	{
 		planes[pos].TexZ += val;
+		RenderStamp++;
 		SetAllVerticesDirty();
 		CheckOverlap();
 	}
@@ -1010,11 +1016,13 @@ public:
 	void ChangeLightLevel(int newval)
 	{
 		lightlevel = ClampLight(lightlevel + newval);
+		RenderStamp++;
 	}
 
 	void SetLightLevel(int newval)
 	{
 		lightlevel = ClampLight(newval);
+		RenderStamp++;
 	}
 
 	int GetLightLevel() const
@@ -1063,6 +1071,7 @@ public:
 	void SetSpecialColor(int slot, int r, int g, int b)
 	{
 		SpecialColors[slot] = PalEntry(255, r, g, b);
+		RenderStamp++;
 		if ((slot == sector_t::wallbottom || slot == sector_t::walltop) && SpecialColors[slot] != 0xffffffff) CheckExColorFlag();
 	}
 
@@ -1070,6 +1079,7 @@ public:
 	{
 		rgb.a = 255;
 		SpecialColors[slot] = rgb;
+		RenderStamp++;
 		if ((slot == sector_t::wallbottom || slot == sector_t::walltop) && rgb != 0xffffffff) CheckExColorFlag();
 	}
 
@@ -1077,6 +1087,7 @@ public:
 	{
 		rgb.a = 255;
 		AdditiveColors[slot] = rgb;
+		RenderStamp++;
 		if ((slot == sector_t::walltop) && AdditiveColors[slot] != 0xffffffff) CheckExColorFlag(); // Wallbottom of this is not used.
 
 	}
@@ -1087,6 +1098,7 @@ public:
 	{
 		if (tm) planes[slot].TextureFx = *tm;	// this is for getting the data from a texture.
 		else planes[slot].TextureFx = {};
+		RenderStamp++;
 	}
 
 
@@ -1256,17 +1268,20 @@ struct side_t
 	seg_t **segs;	// all segs belonging to this sidedef in ascending order. Used for precise rendering
 	int numsegs;
 	int sidenum;
+	uint32_t RenderStamp;	// @Cockatrice - bumped by the setters below, lets the hardware renderer keep its wall setup across frames
 
 	int GetLightLevel (bool foggy, int baselight, int which, bool is3dlight=false, int *pfakecontrast_usedbygzdoom=NULL) const;
 
 	void SetLight(int16_t l)
 	{
 		Light = l;
+		RenderStamp++;
 	}
 
 	void SetLight(int16_t l, int which)
 	{
 		TierLights[which] = l;
+		RenderStamp++;
 	}
 
 
@@ -1282,11 +1297,13 @@ struct side_t
 	void SetTexture(int which, FTextureID tex)
 	{
 		textures[which].texture = tex;
+		RenderStamp++;
 	}
 
 	void SetTextureXOffset(int which, double offset)
 	{
 		textures[which].xOffset = offset;;
+		RenderStamp++;
 	}
 	
 	void SetTextureXOffset(double offset)
@@ -1294,6 +1311,7 @@ struct side_t
 		textures[top].xOffset =
 		textures[mid].xOffset =
 		textures[bottom].xOffset = offset;
+		RenderStamp++;
 	}
 
 	double GetTextureXOffset(int which) const
@@ -1304,11 +1322,13 @@ struct side_t
 	void AddTextureXOffset(int which, double delta)
 	{
 		textures[which].xOffset += delta;
+		RenderStamp++;
 	}
 
 	void SetTextureYOffset(int which, double offset)
 	{
 		textures[which].yOffset = offset;
+		RenderStamp++;
 	}
 
 	void SetTextureYOffset(double offset)
@@ -1316,6 +1336,7 @@ struct side_t
 		textures[top].yOffset =
 		textures[mid].yOffset =
 		textures[bottom].yOffset = offset;
+		RenderStamp++;
 	}
 
 	double GetTextureYOffset(int which) const
@@ -1326,16 +1347,19 @@ struct side_t
 	void AddTextureYOffset(int which, double delta)
 	{
 		textures[which].yOffset += delta;
+		RenderStamp++;
 	}
 
 	void SetTextureXScale(int which, double scale)
 	{
 		textures[which].xScale = scale == 0 ? 1. : scale;
+		RenderStamp++;
 	}
 
 	void SetTextureXScale(double scale)
 	{
 		textures[top].xScale = textures[mid].xScale = textures[bottom].xScale = scale == 0 ? 1. : scale;
+		RenderStamp++;
 	}
 
 	double GetTextureXScale(int which) const
@@ -1346,16 +1370,19 @@ struct side_t
 	void MultiplyTextureXScale(int which, double delta)
 	{
 		textures[which].xScale *= delta;
+		RenderStamp++;
 	}
 
 	void SetTextureYScale(int which, double scale)
 	{
 		textures[which].yScale = scale == 0 ? 1. : scale;
+		RenderStamp++;
 	}
 
 	void SetTextureYScale(double scale)
 	{
 		textures[top].yScale = textures[mid].yScale = textures[bottom].yScale = scale == 0 ? 1. : scale;
+		RenderStamp++;
 	}
 
 	double GetTextureYScale(int which) const
@@ -1366,6 +1393,7 @@ struct side_t
 	void MultiplyTextureYScale(int which, double delta)
 	{
 		textures[which].yScale *= delta;
+		RenderStamp++;
 	}
 
 	int GetTextureFlags(int which)
@@ -1377,6 +1405,7 @@ struct side_t
 	{
 		textures[which].flags &= ~And;
 		textures[which].flags |= Or;
+		RenderStamp++;
 	}
 
 	void SetSpecialColor(int which, int slot, int r, int g, int b, bool useown = true)
@@ -1385,6 +1414,7 @@ struct side_t
 		if (useown) textures[which].flags |= part::UseOwnSpecialColors;
 		else  textures[which].flags &= ~part::UseOwnSpecialColors;
 		Flags |= WALLF_EXTCOLOR;
+		RenderStamp++;
 	}
 
 	void SetSpecialColor(int which, int slot, PalEntry rgb, bool useown = true)
@@ -1394,6 +1424,7 @@ struct side_t
 		if (useown) textures[which].flags |= part::UseOwnSpecialColors;
 		else  textures[which].flags &= ~part::UseOwnSpecialColors;
 		Flags |= WALLF_EXTCOLOR;
+		RenderStamp++;
 	}
 
 	// Note that the sector being passed in here may not be the actual sector this sidedef belongs to
@@ -1418,12 +1449,14 @@ struct side_t
 		{
 			textures[which].flags &= (~flag);
 		}
+		RenderStamp++;
 	}
 
 	void SetAdditiveColor(int which, PalEntry rgb)
 	{
 		rgb.a = 255;
 		textures[which].AdditiveColor = rgb;
+		RenderStamp++;
 	}
 
 	void SetTextureFx(int slot, const TextureManipulation* tm)
@@ -1437,6 +1470,7 @@ struct side_t
 		{
 			textures[slot].TextureFx = {};
 		}
+		RenderStamp++;
 	}
 
 	PalEntry GetAdditiveColor(int which, sector_t *frontsector) const
@@ -2642,6 +2642,7 @@ void MapLoader::LoadBlockMap (MapData * map)
 	Level->blockmap.blocklinks = new FBlockNode *[count];
 	memset (Level->blockmap.blocklinks, 0, count*sizeof(*Level->blockmap.blocklinks));
 	Level->blockmap.blockmap = Level->blockmap.blockmaplump+4;
+	Level->ActorGrid.Init(Level->blockmap);
 }
 
 //===========================================================================
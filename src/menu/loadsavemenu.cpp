@@ -61,6 +61,9 @@
 // @Cockatrice - TODO: Honor the savedir folder! We completely ignore it here
 void FSavegameManager::ReadSaveStrings()
 {
+	// @Cockatrice - a background save may still be writing one of the slots
+	G_FinishSaveGame(true);
+
 	if (SaveGames.Size() == 0)
 	{
 		FString filter;
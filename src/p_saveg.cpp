@@ -1110,7 +1110,7 @@ void FLevelLocals::Serialize(FSerializer &arc, bool hubload)
 //
 //==========================================================================
 
-void FLevelLocals::SnapshotLevel()
+void FLevelLocals::SnapshotLevel(bool compress)
 {
 	info->Snapshot.Clean();
 
@@ -1122,7 +1122,8 @@ void FLevelLocals::SnapshotLevel()
 		{
 			SaveVersion = SAVEVER;
 			Serialize(arc, false);
-			info->Snapshot = arc.GetCompressedOutput();
+			// @Cockatrice - savegames leave the compression to the save thread
+			info->Snapshot = compress ? arc.GetCompressedOutput() : arc.GetStoredOutput();
 		}
 	}
 }
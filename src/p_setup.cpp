@@ -367,6 +367,7 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	FraggleScriptThinker = nullptr;
 	CorpseQueue.Clear();
 	canvasTextureInfo.EmptyList();
+	ClearLightLinkCache();	// @Cockatrice - the cached light links point into the sections
 	sections.Clear();
 	segs.Clear();
 	extsectors.Clear();
@@ -387,6 +388,7 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	rejectmatrix.Clear();
 	Zones.Clear();
 	blockmap.Clear();
+	ActorGrid.Clear();
 	Polyobjects.Clear();
 
 	for (auto &pb : PolyBlockMap)
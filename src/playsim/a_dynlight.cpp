@@ -64,9 +64,13 @@
 #include "a_dynlight.h"
 #include "actorinlines.h"
 #include "memarena.h"
+#include "p_parallel.h"
+#include "i_time.h"
+#include "printf.h"
 
 static FMemArena DynLightArena(sizeof(FDynamicLight) * 200);
 static TArray<FDynamicLight*> FreeList;
+static TArray<FDynamicLight*> PendingLinks;
 static FRandom randLight;
 
 extern TArray<FLightDefaults *> StateLights;
@@ -228,6 +232,12 @@ void FDynamicLight::ReleaseLight()
 	else Level->lights = next;
 	if (next != nullptr) next->prev = prev;
 	next = prev = nullptr;
+	if (pendinglink)
+	{
+		auto index = PendingLinks.Find(this);
+		if (index < PendingLinks.Size()) PendingLinks[index] = nullptr;
+		pendinglink = false;
+	}
 	FreeList.Push(this);
 }
 
@@ -373,7 +383,7 @@ void FDynamicLight::Tick()
 		break;
 	}
 	if (m_currentRadius <= 0) m_currentRadius = 1;
-	UpdateLocation();
+	UpdateLocation(true);
 }
 
 
@@ -384,7 +394,7 @@ void FDynamicLight::Tick()
 //
 //
 //==========================================================================
-void FDynamicLight::UpdateLocation()
+void FDynamicLight::UpdateLocation(bool deferlink)
 {
 	double oldx= X();
 	double oldy= Y();
@@ -450,11 +460,36 @@ void FDynamicLight::UpdateLocation()
 		if (X() != oldx || Y() != oldy || radius != oldradius || angleChanged)
 		{
 			//Update the light lists
-			LinkLight();
+			if (deferlink) QueueLink();
+			else LinkLight();
 		}
 	}
 }
 
+//=============================================================================
+//
+// @Cockatrice - Light nodes come from an arena with a free list, like the
+// sector nodes, instead of one heap allocation per link.
+//
+//=============================================================================
+
+static FMemArena LightNodeArena(sizeof(FLightNode) * 1024);
+static FLightNode *FreeLightNodes;
+
+static FLightNode *GetLightNode()
+{
+	FLightNode *node = FreeLightNodes;
+	if (node != nullptr) FreeLightNodes = node->nextTarget;
+	else node = (FLightNode *)LightNodeArena.Alloc(sizeof(FLightNode));
+	return node;
+}
+
+static void PutLightNode(FLightNode *node)
+{
+	node->nextTarget = FreeLightNodes;
+	FreeLightNodes = node;
+}
+
 //=============================================================================
 //
 // These have been copied from the secnode code and modified for the light links
@@ -484,7 +519,7 @@ FLightNode * AddLightNode(FLightNode ** thread, void * linkto, FDynamicLight * l
 	// Couldn't find an existing node for this sector. Add one at the head
 	// of the list.
 	
-	node = new FLightNode;
+	node = GetLightNode();
 	
 	node->targ = linkto;
 	node->lightsource = light; 
@@ -527,7 +562,7 @@ static FLightNode * DeleteLightNode(FLightNode * node)
 		
 		// Return this node to the freelist
 		tn=node->nextTarget;
-		delete node;
+		PutLightNode(node);
 		return(tn);
 	}
 	return(nullptr);
@@ -541,7 +576,7 @@ static FLightNode * DeleteLightNode(FLightNode * node)
 //
 //==========================================================================
 
-double FDynamicLight::DistToSeg(const DVector3 &pos, vertex_t *start, vertex_t *end)
+double FDynamicLight::DistToSeg(const DVector3 &pos, const vertex_t *start, const vertex_t *end)
 {
 	double u, px, py;
 
@@ -565,170 +600,214 @@ double FDynamicLight::DistToSeg(const DVector3 &pos, vertex_t *start, vertex_t *
 
 //==========================================================================
 //
-// Collect all touched sidedefs and subsectors
-// to sidedefs and sector parts.
+// @Cockatrice - The result of a flood fill, which gets linked afterwards.
+// Collecting only reads level data, so moved lights can be collected in
+// parallel and results can be shared between links at the same spot.
 //
 //==========================================================================
-struct LightLinkEntry
+
+struct FLightCollection
 {
-	FSection *sect;
-	DVector3 pos;
+	TArray<FSection *> sections;
+	TArray<side_t *> sides;
+	bool hitonesidedback;
+	bool cacheable;		// false if the result went through a portal, whose state can change
+
+	void Clear()
+	{
+		sections.Clear();
+		sides.Clear();
+		hitonesidedback = false;
+		cacheable = true;
+	}
 };
-static TArray<LightLinkEntry> collected_ss;
 
-void FDynamicLight::CollectWithinRadius(const DVector3 &opos, FSection *section, float radius)
+// Everything a collection depends on besides static map geometry
+struct FLightCollectKey
 {
-	if (!section) return;
-	collected_ss.Clear();
-	collected_ss.Push({ section, opos });
-	section->validcount = dl_validcount;
+	FLevelLocals *Level;
+	FSection *section;
+	DVector3 pos;
+	DVector3 spotDir;
+	float radius;
 
-	bool hitonesidedback = false;
-	for (unsigned i = 0; i < collected_ss.Size(); i++)
+	bool operator==(const FLightCollectKey &other) const
 	{
-		auto pos = collected_ss[i].pos;
-		section = collected_ss[i].sect;
+		return Level == other.Level && section == other.section && pos == other.pos && spotDir == other.spotDir && radius == other.radius;
+	}
 
-		touching_sector = AddLightNode(&section->lighthead, section, this, touching_sector);
+	// Only an exact match can reuse a result, so the hash covers the exact key.
+	unsigned Hash() const
+	{
+		uint64_t h = uint64_t(section - Level->sections.allSections.Data()) * 0x9E3779B97F4A7C15ull;
+		const double values[7] = { pos.X, pos.Y, pos.Z, spotDir.X, spotDir.Y, spotDir.Z, radius };
+		for (double v : values)
+		{
+			uint64_t bits;
+			v += 0.0;	// -0 compares equal to 0
+			memcpy(&bits, &v, sizeof(bits));
+			h = (h ^ bits) * 0xFF51AFD7ED558CCDull;
+			h ^= h >> 32;
+		}
+		return unsigned(h);
+	}
+};
 
+struct FLightCacheEntry
+{
+	FLightCollectKey key;
+	bool used = false;
+	unsigned lastuse = 0;
+	FLightCollection result;
+};
 
-		auto processSide = [&](side_t *sidedef, const vertex_t *v1, const vertex_t *v2)
-		{
-			auto linedef = sidedef->linedef;
-			if (linedef && linedef->validcount != ::validcount)
-			{
-				// light is in front of the seg
-				if ((pos.Y - v1->fY()) * (v2->fX() - v1->fX()) + (v1->fX() - pos.X) * (v2->fY() - v1->fY()) <= 0)
-				{
-					linedef->validcount = ::validcount;
-					touching_sides = AddLightNode(&sidedef->lighthead, sidedef, this, touching_sides);
-				}
-				else if (linedef->sidedef[0] == sidedef && linedef->sidedef[1] == nullptr)
-				{
-					hitonesidedback = true;
-				}
-			}
-			if (linedef)
-			{
-				FLinePortal *port = linedef->getPortal();
-				if (port && port->mType == PORTT_LINKED)
-				{
-					line_t *other = port->mDestination;
-					if (other->validcount != ::validcount)
-					{
-						subsector_t *othersub = Level->PointInRenderSubsector(other->v1->fPos() + other->Delta() / 2);
-						FSection *othersect = othersub->section;
-						if (othersect->validcount != ::validcount)
-						{
-							othersect->validcount = ::validcount;
-							collected_ss.Push({ othersect, PosRelative(other->frontsector->PortalGroup) });
-						}
-					}
-				}
-			}
-		};
+// Per-thread replacement for validcount/dl_validcount, which cannot be shared between threads
+struct FLightCollectMarks
+{
+	TArray<int> sections, portalsections, lines;
+	int stamp = 0;
 
-		for (auto &segment : section->segments)
+	void Begin(FLevelLocals *Level)
+	{
+		unsigned numsections = Level->sections.allSections.Size();
+		if (sections.Size() != numsections || lines.Size() != Level->lines.Size() || stamp == INT_MAX)
 		{
-			// check distance from x/y to seg and if within radius add this seg and, if present the opposing subsector (lather/rinse/repeat)
-			// If out of range we do not need to bother with this seg.
-			if (DistToSeg(pos, segment.start, segment.end) <= radius)
-			{
-				auto sidedef = segment.sidedef;
-				if (sidedef)
-				{
-					processSide(sidedef, segment.start, segment.end);
-				}
-
-				auto partner = segment.partner;
-				if (partner)
-				{
-					FSection *sect = partner->section;
-					if (sect != nullptr && sect->validcount != dl_validcount)
-					{
-						sect->validcount = dl_validcount;
-						collected_ss.Push({ sect, pos });
-					}
-				}
-			}
+			sections.Resize(numsections);
+			portalsections.Resize(numsections);
+			lines.Resize(Level->lines.Size());
+			memset(sections.Data(), 0, numsections * sizeof(int));
+			memset(portalsections.Data(), 0, numsections * sizeof(int));
+			memset(lines.Data(), 0, lines.Size() * sizeof(int));
+			stamp = 0;
 		}
-		for (auto side : section->sides)
+		stamp++;
+	}
+};
+
+CVAR(Bool, sim_lightcache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Bool, sim_lightbatch, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+// The cache is set associative so that a light switching between a few states at one spot,
+// like a flickering lamp, keeps all of them without evicting its own entries.
+enum
+{
+	LIGHTCACHE_SIZE = 1024,	// must be a power of 2
+	LIGHTCACHE_WAYS = 4,
+};
+static TArray<FLightCacheEntry> LightCache;
+static unsigned LightCacheClock;
+static thread_local FLightCollectMarks CollectMarks;
+
+static FLightCacheEntry *CacheSet(const FLightCollectKey &key)
+{
+	unsigned numsets = LightCache.Size() / LIGHTCACHE_WAYS;
+	return &LightCache[(key.Hash() & (numsets - 1)) * LIGHTCACHE_WAYS];
+}
+
+static const FLightCollection *FindCachedLinks(const FLightCollectKey &key)
+{
+	if (!sim_lightcache || LightCache.Size() == 0) return nullptr;
+	auto set = CacheSet(key);
+	for (int i = 0; i < LIGHTCACHE_WAYS; i++)
+	{
+		if (set[i].used && set[i].key == key)
 		{
-			auto v1 = side->V1(), v2 = side->V2();
-			if (DistToSeg(pos, v1, v2) <= radius)
-			{
-				processSide(side, v1, v2);
-			}
+			set[i].lastuse = ++LightCacheClock;
+			return &set[i].result;
 		}
-		sector_t *sec = section->sector;
-		if (!sec->PortalBlocksSight(sector_t::ceiling))
+	}
+	return nullptr;
+}
+
+static void CacheLinks(const FLightCollectKey &key, const FLightCollection &result)
+{
+	if (!sim_lightcache || !result.cacheable) return;
+	if (LightCache.Size() == 0) LightCache.Resize(LIGHTCACHE_SIZE);
+
+	// Replace the least recently used entry of the set
+	auto set = CacheSet(key);
+	auto entry = &set[0];
+	for (int i = 0; i < LIGHTCACHE_WAYS; i++)
+	{
+		if (!set[i].used || set[i].key == key)
 		{
-			line_t *other = section->segments[0].sidedef->linedef;
-			if (sec->GetPortalPlaneZ(sector_t::ceiling) < Z() + radius)
-			{
-				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::ceiling);
-				subsector_t *othersub = Level->PointInRenderSubsector(refpos);
-				FSection *othersect = othersub->section;
-				if (othersect->validcount != dl_validcount)
-				{
-					othersect->validcount = dl_validcount;
-					collected_ss.Push({ othersect, PosRelative(othersub->sector->PortalGroup) });
-				}
-			}
-		}
-		if (!sec->PortalBlocksSight(sector_t::floor))
-		{
-			line_t *other = section->segments[0].sidedef->linedef;
-			if (sec->GetPortalPlaneZ(sector_t::floor) > Z() - radius)
-			{
-				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::floor);
-				subsector_t *othersub = Level->PointInRenderSubsector(refpos);
-				FSection *othersect = othersub->section;
-				if (othersect->validcount != dl_validcount)
-				{
-					othersect->validcount = dl_validcount;
-					collected_ss.Push({ othersect, PosRelative(othersub->sector->PortalGroup) });
-				}
-			}
+			entry = &set[i];
+			break;
 		}
+		if (set[i].lastuse < entry->lastuse) entry = &set[i];
 	}
-	shadowmapped = hitonesidedback && !DontShadowmap();
+	entry->key = key;
+	entry->used = true;
+	entry->lastuse = ++LightCacheClock;
+	entry->result.sections = result.sections;
+	entry->result.sides = result.sides;
+	entry->result.hitonesidedback = result.hitonesidedback;
+	entry->result.cacheable = true;
 }
 
-// @Cockatrice - Spotlight version, we use spotDir + pos to calculate the distance to segment
-// This is not accurate but it's good enough and the fastest way to do it without wasting a lot of time culling
-// what is behind the spotlight
-void FDynamicLight::CollectWithinRadiusSP(const DVector3 &opos, const DVector3 &spotDir, FSection *section, float radius)
+// Called when the level's geometry goes away
+void ClearLightLinkCache()
 {
+	LightCache.Reset();
+}
+
+//==========================================================================
+//
+// Collect all touched sidedefs and subsectors
+// to sidedefs and sector parts.
+//
+// @Cockatrice - Spotlights pass the offset to the center of the spot in
+// spotDir and we use spotDir + pos to calculate the distance to segment.
+// This is not accurate but it's good enough and the fastest way to do it
+// without wasting a lot of time culling what is behind the spotlight.
+// For other lights spotDir is zero.
+//
+//==========================================================================
+struct LightLinkEntry
+{
+	FSection *sect;
+	DVector3 pos;
+};
+
+void FDynamicLight::CollectWithinRadius(const DVector3 &opos, const DVector3 &spotDir, FSection *section, float radius, FLightCollection &out) const
+{
+	static thread_local TArray<LightLinkEntry> collected_ss;
+
+	out.Clear();
 	if (!section) return;
+
+	auto &marks = CollectMarks;
+	marks.Begin(Level);
+	const int stamp = marks.stamp;
+	FSection *const sectionbase = Level->sections.allSections.Data();
+
 	collected_ss.Clear();
 	collected_ss.Push({ section, opos });
-	section->validcount = dl_validcount;
+	marks.sections[section - sectionbase] = stamp;
 
-	bool hitonesidedback = false;
 	for (unsigned i = 0; i < collected_ss.Size(); i++)
 	{
 		auto pos = collected_ss[i].pos;
 		auto spotPos = pos + spotDir;
 		section = collected_ss[i].sect;
 
-		touching_sector = AddLightNode(&section->lighthead, section, this, touching_sector);
+		out.sections.Push(section);
 
 
 		auto processSide = [&](side_t *sidedef, const vertex_t *v1, const vertex_t *v2)
 		{
 			auto linedef = sidedef->linedef;
-			if (linedef && linedef->validcount != ::validcount)
+			if (linedef && marks.lines[linedef->Index()] != stamp)
 			{
 				// light is in front of the seg
 				if ((pos.Y - v1->fY()) * (v2->fX() - v1->fX()) + (v1->fX() - pos.X) * (v2->fY() - v1->fY()) <= 0)
 				{
-					linedef->validcount = ::validcount;
-					touching_sides = AddLightNode(&sidedef->lighthead, sidedef, this, touching_sides);
+					marks.lines[linedef->Index()] = stamp;
+					out.sides.Push(sidedef);
 				}
 				else if (linedef->sidedef[0] == sidedef && linedef->sidedef[1] == nullptr)
 				{
-					hitonesidedback = true;
+					out.hitonesidedback = true;
 				}
 			}
 			if (linedef)
@@ -736,14 +815,15 @@ void FDynamicLight::CollectWithinRadiusSP(const DVector3 &opos, const DVector3 &
 				FLinePortal *port = linedef->getPortal();
 				if (port && port->mType == PORTT_LINKED)
 				{
+					out.cacheable = false;
 					line_t *other = port->mDestination;
-					if (other->validcount != ::validcount)
+					if (marks.lines[other->Index()] != stamp)
 					{
 						subsector_t *othersub = Level->PointInRenderSubsector(other->v1->fPos() + other->Delta() / 2);
 						FSection *othersect = othersub->section;
-						if (othersect->validcount != ::validcount)
+						if (marks.portalsections[othersect - sectionbase] != stamp)
 						{
-							othersect->validcount = ::validcount;
+							marks.portalsections[othersect - sectionbase] = stamp;
 							collected_ss.Push({ othersect, PosRelative(other->frontsector->PortalGroup) });
 						}
 					}
@@ -767,9 +847,9 @@ void FDynamicLight::CollectWithinRadiusSP(const DVector3 &opos, const DVector3 &
 				if (partner)
 				{
 					FSection *sect = partner->section;
-					if (sect != nullptr && sect->validcount != dl_validcount)
+					if (sect != nullptr && marks.sections[sect - sectionbase] != stamp)
 					{
-						sect->validcount = dl_validcount;
+						marks.sections[sect - sectionbase] = stamp;
 						collected_ss.Push({ sect, pos });
 					}
 				}
@@ -786,50 +866,89 @@ void FDynamicLight::CollectWithinRadiusSP(const DVector3 &opos, const DVector3 &
 		sector_t *sec = section->sector;
 		if (!sec->PortalBlocksSight(sector_t::ceiling))
 		{
+			out.cacheable = false;
 			line_t *other = section->segments[0].sidedef->linedef;
 			if (sec->GetPortalPlaneZ(sector_t::ceiling) < Z() + radius)
 			{
 				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::ceiling);
 				subsector_t *othersub = Level->PointInRenderSubsector(refpos);
 				FSection *othersect = othersub->section;
-				if (othersect->validcount != dl_validcount)
+				if (marks.sections[othersect - sectionbase] != stamp)
 				{
-					othersect->validcount = dl_validcount;
+					marks.sections[othersect - sectionbase] = stamp;
 					collected_ss.Push({ othersect, PosRelative(othersub->sector->PortalGroup) });
 				}
 			}
 		}
 		if (!sec->PortalBlocksSight(sector_t::floor))
 		{
+			out.cacheable = false;
 			line_t *other = section->segments[0].sidedef->linedef;
 			if (sec->GetPortalPlaneZ(sector_t::floor) > Z() - radius)
 			{
 				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::floor);
 				subsector_t *othersub = Level->PointInRenderSubsector(refpos);
 				FSection *othersect = othersub->section;
-				if (othersect->validcount != dl_validcount)
+				if (marks.sections[othersect - sectionbase] != stamp)
 				{
-					othersect->validcount = dl_validcount;
+					marks.sections[othersect - sectionbase] = stamp;
 					collected_ss.Push({ othersect, PosRelative(othersub->sector->PortalGroup) });
 				}
 			}
 		}
 	}
-	shadowmapped = hitonesidedback && !DontShadowmap();
 }
 
 
+//==========================================================================
+//
+// Works out where the flood fill for this light starts.
+// Returns false if the light has no radius and should not touch anything.
+//
+//==========================================================================
+
+bool FDynamicLight::GetCollectKey(FLightCollectKey &key)
+{
+	if (radius <= 0) return false;
+
+	key.Level = Level;
+	key.section = Level->PointInRenderSubsector(Pos)->section;
+	key.pos = Pos;
+
+	// @Cockatrice - If this is a spot light, collect only within a radius from the center of the spot, we don't care about stuff that is behind the spot light
+	if (IsSpot())
+	{
+		// Determine center point in the direction of the light, reduce radius by half
+		// This may not work as we may have extended outside of our sector
+		float rad = radius * 0.5f;
+		DAngle pitch = *pPitch == target->Angles.Pitch ? target->Angles.Pitch : *pPitch;
+		DAngle angle = target->Angles.Yaw;
+		double cospitch = pitch.Cos();
+		key.spotDir.X = rad * cospitch * angle.Cos();
+		key.spotDir.Y = rad * cospitch * angle.Sin();
+		key.spotDir.Z = rad * -pitch.Sin();
+		key.radius = rad * rad;
+	}
+	else
+	{
+		// passing in radius*radius allows us to do a distance check without any calls to sqrt
+		key.spotDir.Zero();
+		key.radius = float(radius*radius);
+	}
+	return true;
+}
+
 //==========================================================================
 //
 // Link the light into the world
 //
 //==========================================================================
 
-void FDynamicLight::LinkLight()
+void FDynamicLight::ApplyLinks(const FLightCollection *links)
 {
 	// mark the old light nodes
 	FLightNode * node;
-	
+
 	node = touching_sides;
 	while (node)
     {
@@ -843,43 +962,22 @@ void FDynamicLight::LinkLight()
 		node = node->nextTarget;
 	}
 
-	if (radius>0)
+	if (links)
 	{
-		// passing in radius*radius allows us to do a distance check without any calls to sqrt
-		
-
-		// @Cockatrice - If this is a spot light, collect only within a radius from the center of the spot, we don't care about stuff that is behind the spot light
-		if (IsSpot()) {
-			dl_validcount++;
-			::validcount++;
-
-			// Determine center point in the direction of the light, reduce radius by half
-			// This may not work as we may have extended outside of our sector
-			float rad = radius * 0.5f;
-			DAngle pitch = *pPitch == target->Angles.Pitch ? target->Angles.Pitch : *pPitch;
-			DAngle angle = target->Angles.Yaw;
-			double cospitch = pitch.Cos();
-			DVector3 pPos;
-			pPos.X = rad * cospitch * angle.Cos();
-			pPos.Y = rad * cospitch * angle.Sin();
-			pPos.Z = rad * -pitch.Sin();
-
-			FSection *sect = Level->PointInRenderSubsector(Pos)->section;
-			CollectWithinRadiusSP(Pos, pPos, sect, rad * rad);
+		for (auto section : links->sections)
+		{
+			touching_sector = AddLightNode(&section->lighthead, section, this, touching_sector);
 		}
-		else {
-			FSection *sect = Level->PointInRenderSubsector(Pos)->section;
-
-			dl_validcount++;
-			::validcount++;
-
-			CollectWithinRadius(Pos, sect, float(radius*radius));
+		for (auto sidedef : links->sides)
+		{
+			touching_sides = AddLightNode(&sidedef->lighthead, sidedef, this, touching_sides);
 		}
+		shadowmapped = links->hitonesidedback && !DontShadowmap();
 	}
-		
+
 	// Now delete any nodes that won't be used. These are the ones where
 	// m_thing is still nullptr.
-	
+
 	node = touching_sides;
 	while (node)
 	{
@@ -903,6 +1001,101 @@ void FDynamicLight::LinkLight()
 	}
 }
 
+void FDynamicLight::LinkLight()
+{
+	static FLightCollection collected;
+	FLightCollectKey key;
+
+	if (!GetCollectKey(key))
+	{
+		ApplyLinks(nullptr);
+		return;
+	}
+
+	const FLightCollection *links = FindCachedLinks(key);
+	if (links == nullptr)
+	{
+		CollectWithinRadius(key.pos, key.spotDir, key.section, key.radius, collected);
+		CacheLinks(key, collected);
+		links = &collected;
+	}
+	ApplyLinks(links);
+}
+
+
+//==========================================================================
+//
+// @Cockatrice - Lights that moved during the light tick get linked together
+// at the end of it. The flood fills run in parallel, linking is serial.
+//
+//==========================================================================
+
+
+void FDynamicLight::QueueLink()
+{
+	if (!sim_lightbatch)
+	{
+		LinkLight();
+	}
+	else if (!pendinglink)
+	{
+		pendinglink = true;
+		PendingLinks.Push(this);
+	}
+}
+
+void LinkPendingLights()
+{
+	static TArray<FLightCollectKey> keys;
+	static TArray<const FLightCollection *> found;
+	static TArray<FLightCollection> collected;
+
+	// Released lights leave a null behind
+	unsigned count = 0;
+	for (auto light : PendingLinks)
+	{
+		if (light != nullptr) PendingLinks[count++] = light;
+	}
+	PendingLinks.Clamp(count);
+	if (count == 0) return;
+
+	keys.Resize(count);
+	found.Resize(count);
+	if (collected.Size() < count) collected.Resize(count);
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto light = PendingLinks[i];
+		light->pendinglink = false;
+		if (!light->GetCollectKey(keys[i])) found[i] = nullptr;
+		else found[i] = FindCachedLinks(keys[i]);
+	}
+
+	P_ParallelFor(count, 4, [&](int start, int end)
+	{
+		for (int i = start; i < end; i++)
+		{
+			if (found[i] == nullptr && PendingLinks[i]->radius > 0)
+			{
+				PendingLinks[i]->CollectWithinRadius(keys[i].pos, keys[i].spotDir, keys[i].section, keys[i].radius, collected[i]);
+			}
+		}
+	});
+
+	// Cache entries may get replaced below so everything gets linked first
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto light = PendingLinks[i];
+		if (light->radius <= 0) light->ApplyLinks(nullptr);
+		else light->ApplyLinks(found[i] ? found[i] : &collected[i]);
+	}
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (found[i] == nullptr && PendingLinks[i]->radius > 0) CacheLinks(keys[i], collected[i]);
+	}
+	PendingLinks.Clear();
+}
+
 
 //==========================================================================
 //
@@ -1239,3 +1432,63 @@ void FLevelLocals::RecreateAllAttachedLights()
 		}
 	}
 }
+
+//==========================================================================
+//
+// @Cockatrice - Relinks every active light one by one without the cache,
+// then batched without and with the cache
+//
+//==========================================================================
+
+CCMD(bench_lightlinks)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+
+	int passes = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000) : 100;
+
+	TArray<FDynamicLight *> lights;
+	for (auto light = primaryLevel->lights; light; light = light->next)
+	{
+		if (light->IsActive()) lights.Push(light);
+	}
+	if (lights.Size() == 0)
+	{
+		Printf("No active lights\n");
+		return;
+	}
+
+	bool wasCached = sim_lightcache, wasBatched = sim_lightbatch;
+	static const char *const names[] = { "single:", "batched:", "cached:" };
+	uint64_t time[3] = {};
+
+	for (int mode = 0; mode < 3; mode++)
+	{
+		sim_lightcache = mode == 2;
+		sim_lightbatch = mode > 0;
+		if (mode == 2)
+		{
+			// warm up the cache
+			for (auto light : lights) light->QueueLink();
+			LinkPendingLights();
+		}
+		uint64_t start = I_nsTime();
+		for (int i = 0; i < passes; i++)
+		{
+			for (auto light : lights) light->QueueLink();
+			LinkPendingLights();
+		}
+		time[mode] = I_nsTime() - start;
+	}
+	sim_lightcache = wasCached;
+	sim_lightbatch = wasBatched;
+
+	Printf("%d passes over %u lights, %d worker threads\n", passes, lights.Size(), P_ParallelWorkers());
+	for (int mode = 0; mode < 3; mode++)
+	{
+		Printf("  %-9s %8.3f ms\n", names[mode], time[mode] * 1e-6);
+	}
+}
@@ -9,6 +9,8 @@ struct seg_t;
 
 class FSerializer;
 struct FSectionLine;
+struct FLightCollection;
+struct FLightCollectKey;
 
 enum ELightType
 {
@@ -254,15 +256,18 @@ struct FDynamicLight
 	double iZ(double ticFrac) const { return LastPos.Z + ((Pos.Z - LastPos.Z) * ticFrac); }
 
 	void Tick();
-	void UpdateLocation();
+	void UpdateLocation(bool deferlink = false);
 	void LinkLight();
+	void QueueLink();
 	void UnlinkLight();
 	void ReleaseLight();
 
 private:
-	double DistToSeg(const DVector3 &pos, vertex_t *start, vertex_t *end);
-	void CollectWithinRadius(const DVector3 &pos, FSection *section, float radius);
-	void CollectWithinRadiusSP(const DVector3 &opos, const DVector3 &spotDir, FSection *section, float radius);
+	friend void LinkPendingLights();
+	static double DistToSeg(const DVector3 &pos, const vertex_t *start, const vertex_t *end);
+	void CollectWithinRadius(const DVector3 &opos, const DVector3 &spotDir, FSection *section, float radius, FLightCollection &out) const;
+	bool GetCollectKey(FLightCollectKey &key);
+	void ApplyLinks(const FLightCollection *links);
 
 public:
 	FCycler m_cycler;
@@ -300,7 +305,12 @@ public:
 	bool owned;
 	bool swapped;
 	bool explicitpitch;
+	bool pendinglink;		// @Cockatrice - waiting for LinkPendingLights
 
 };
 
+// @Cockatrice - Links the lights that moved during the light tick, see FDynamicLight::QueueLink
+void LinkPendingLights();
+void ClearLightLinkCache();
+
 
@@ -1191,6 +1191,8 @@ public:
 
 // interaction info
 	FBlockNode		*BlockNode;			// links in blocks (if needed)
+	int				GridCell = -1, GridIndex = -1;	// @Cockatrice - Slot in the level's actor grid
+	uint64_t		GridLinkSeq = 0;				// @Cockatrice - When it was last linked, orders grid results like the blockmap's node lists
 	struct sector_t	*Sector;
 	subsector_t *		subsector;
 	FSection *			section;
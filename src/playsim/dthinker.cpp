@@ -45,6 +45,9 @@
 #include "v_video.h"
 #include "g_cvars.h"
 #include "d_main.h"
+#include "i_time.h"
+#include "p_parallel.h"
+#include "p_tickprofiler.h"
 
 static int ThinkCount;
 static cycle_t ThinkCycles;
@@ -54,18 +57,10 @@ extern int BotWTG;
 
 IMPLEMENT_CLASS(DThinker, false, false)
 
-struct ProfileInfo
-{
-	int numcalls = 0;
-	cycle_t timer;
-
-	ProfileInfo()
-	{
-		timer.Reset();
-	}
-};
+// @Cockatrice - The isolated phases are a few counter updates each, so handing them to the worker pool only pays off
+// once a list has a lot of them. Use bench_isolated to find the break-even point on a given machine.
+CVAR(Int, sim_parallel_thinkers, 4096, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
-static TMap<FName, ProfileInfo> Profiles;
 static unsigned int profilethinkers, profilelimit;
 DThinker *NextToThink;
 
@@ -89,6 +84,13 @@ void FThinkerCollection::Link(DThinker *thinker, int statnum)
 	}
 
 	list->AddTail(thinker);
+
+	// @Cockatrice - Thinkers moved into the sleep pool without Sleep() still get checked like any other sleeper
+	if (statnum == STAT_SLEEP)
+	{
+		thinker->InSleepList = true;
+		SleepWheel.Schedule(thinker, thinker->sleepTimer);
+	}
 }
 
 // Insert the sleeper at the head of the list
@@ -96,6 +98,239 @@ void FThinkerCollection::LinkSleeper(DThinker* thinker, int statnum)
 {
 	Thinkers[statnum].AddHead(thinker);
 	//if (statnum != STAT_TRAVELLING) thinker->ObjectFlags &= ~OF_JustSpawned;
+
+	if (statnum == STAT_SLEEP)
+	{
+		thinker->InSleepList = true;
+		SleepWheel.Schedule(thinker, thinker->sleepTimer);
+	}
+}
+
+//==========================================================================
+//
+// FSleeperWheel
+//
+//==========================================================================
+
+void FSleeperWheel::Schedule(DThinker *thinker, int tics)
+{
+	Unschedule(thinker);
+	thinker->WakeTic = CurrentTic + max(tics, 1);
+	Place(thinker);
+}
+
+void FSleeperWheel::Unschedule(DThinker *thinker)
+{
+	if (thinker->SleepSlot == nullptr) return;
+
+	if (thinker->SleepPrev != nullptr) thinker->SleepPrev->SleepNext = thinker->SleepNext;
+	else *thinker->SleepSlot = thinker->SleepNext;
+	if (thinker->SleepNext != nullptr) thinker->SleepNext->SleepPrev = thinker->SleepPrev;
+
+	thinker->SleepNext = thinker->SleepPrev = nullptr;
+	thinker->SleepSlot = nullptr;
+}
+
+void FSleeperWheel::Place(DThinker *thinker)
+{
+	int delta = int(thinker->WakeTic - CurrentTic);
+	DThinker **slot;
+
+	if (delta < NEAR_SLOTS)
+	{
+		// Anything overdue goes into the current slot, which is about to be collected
+		if (delta < 0) thinker->WakeTic = CurrentTic;
+		slot = &Near[thinker->WakeTic & (NEAR_SLOTS - 1)];
+	}
+	else if (delta < FAR_RANGE)
+	{
+		slot = &Far[(thinker->WakeTic >> NEAR_BITS) & (FAR_SLOTS - 1)];
+	}
+	else
+	{
+		slot = &Overflow;
+	}
+
+	thinker->SleepSlot = slot;
+	thinker->SleepPrev = nullptr;
+	thinker->SleepNext = *slot;
+	if (*slot != nullptr) (*slot)->SleepPrev = thinker;
+	*slot = thinker;
+}
+
+// Detaches a whole slot and sorts its thinkers in again relative to the current tic
+void FSleeperWheel::Requeue(DThinker *&slot)
+{
+	DThinker *node = slot;
+	slot = nullptr;
+	while (node != nullptr)
+	{
+		DThinker *next = node->SleepNext;
+		Place(node);
+		node = next;
+	}
+}
+
+void FSleeperWheel::Advance(TArray<DThinker*> &due)
+{
+	CurrentTic++;
+
+	if ((CurrentTic & (NEAR_SLOTS - 1)) == 0)
+	{
+		// Entering a new stretch of NEAR_SLOTS tics, spread its far slot out over the near slots
+		Requeue(Far[(CurrentTic >> NEAR_BITS) & (FAR_SLOTS - 1)]);
+		Requeue(Overflow);
+	}
+
+	DThinker *&slot = Near[CurrentTic & (NEAR_SLOTS - 1)];
+	while (slot != nullptr)
+	{
+		DThinker *thinker = slot;
+		Unschedule(thinker);
+		due.Push(thinker);
+	}
+}
+
+int FSleeperWheel::TimeLeft(const DThinker *thinker) const
+{
+	return int(thinker->WakeTic - CurrentTic);
+}
+
+void FSleeperWheel::Clear()
+{
+	for (auto &slot : Near) while (slot != nullptr) Unschedule(slot);
+	for (auto &slot : Far) while (slot != nullptr) Unschedule(slot);
+	while (Overflow != nullptr) Unschedule(Overflow);
+}
+
+//==========================================================================
+//
+// Wakes the sleepers that are due this tic. Same rules as the old
+// per-tic list walk: a sleeper whose timer ran out is asked ShouldWake
+// every tic until it wakes, and Wake is deferred until the cycle is over.
+//
+//==========================================================================
+
+void FThinkerCollection::CheckSleepers()
+{
+	inSleepCycle = true;
+
+	dueSleepers.Clear();
+	SleepWheel.Advance(dueSleepers);
+
+	for (auto node : dueSleepers)
+	{
+		if (node->ObjectFlags & OF_EuthanizeMe) continue;
+
+		if (node->sleepInterval <= 0 || node->CallShouldWake())
+		{
+			node->CallWake();
+		}
+
+		// Still in the pool and not put back to sleep by the script, so check again next tic.
+		// If it did wake, moving it out of STAT_SLEEP below takes it off the wheel again.
+		if (node->InSleepList && node->SleepSlot == nullptr && !(node->ObjectFlags & OF_EuthanizeMe))
+		{
+			SleepWheel.Schedule(node, 1);
+		}
+	}
+
+	// Wake the waiting dreamers
+	for (auto dreamer : tempWakers) {
+		if (dreamer) dreamer->ChangeStatNum(STAT_DEFAULT);
+	}
+	tempWakers.Clear();
+
+	inSleepCycle = false;
+}
+
+//==========================================================================
+//
+// Puts everything in the sleep pool back on the wheel after loading a
+// savegame, using the timers that were stored with the thinkers.
+//
+//==========================================================================
+
+void FThinkerCollection::RebuildSleepWheel()
+{
+	SleepWheel.Clear();
+
+	for (auto list : { &Thinkers[STAT_SLEEP], &FreshThinkers[STAT_SLEEP] })
+	{
+		DThinker *node = list->GetHead();
+		if (node == nullptr) continue;
+
+		while (node != list->Sentinel)
+		{
+			node->InSleepList = true;
+			SleepWheel.Schedule(node, node->sleepTimer);
+			node = node->NextThinker;
+		}
+	}
+}
+
+//==========================================================================
+//
+// Prints one tic recorded by the tick profiler for profilethinkers
+//
+//==========================================================================
+
+static void PrintThinkerProfile(const FTickProfileFrame *frame)
+{
+	if (frame == nullptr) return;
+
+	struct SortedProfileInfo
+	{
+		const char* className;
+		int numcalls;
+		double time;
+	};
+
+	TArray<SortedProfileInfo> sorted;
+	sorted.Grow(frame->classes.Size());
+
+	for (auto &entry : frame->classes)
+	{
+		sorted.Push({ TickProfiler.SlotName(entry.slot), entry.calls, entry.ms });
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const SortedProfileInfo& left, const SortedProfileInfo& right)
+	{
+		switch (profilethinkers)
+		{
+		case 1: // by name, from A to Z
+			return stricmp(left.className, right.className) < 0;
+		case 2: // by name, from Z to A
+			return stricmp(right.className, left.className) < 0;
+		case 3: // number of calls, ascending
+			return left.numcalls < right.numcalls;
+		case 4: // number of calls, descending
+			return right.numcalls < left.numcalls;
+		case 5: // average time, ascending
+			return left.time / left.numcalls < right.time / right.numcalls;
+		case 6: // average time, descending
+			return right.time / right.numcalls < left.time / left.numcalls;
+		case 7: // total time, ascending
+			return left.time < right.time;
+		default: // total time, descending
+			return right.time < left.time;
+		}
+	});
+
+	Printf(TEXTCOLOR_YELLOW "Total, ms   Averg, ms   Calls   Actor class\n");
+	Printf(TEXTCOLOR_YELLOW "----------  ----------  ------  --------------------\n");
+
+	const unsigned count = min(profilelimit > 0 ? profilelimit : UINT_MAX, sorted.Size());
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const SortedProfileInfo& info = sorted[i];
+		Printf("%s%10.6f  %s%10.6f  %s%6d  %s%s\n",
+			profilethinkers >= 7 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time,
+			profilethinkers == 5 || profilethinkers == 6 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time / info.numcalls,
+			profilethinkers == 3 || profilethinkers == 4 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.numcalls,
+			profilethinkers == 1 || profilethinkers == 2 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.className);
+	}
 }
 
 //==========================================================================
@@ -116,18 +351,20 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 	ThinkCycles.Clock();
 
-	// Handle sleeping thinkers, allow them to slip back into the regular pool when unnecessary
-	inSleepCycle = true;
-	Thinkers[STAT_SLEEP].CheckSleepingThinkers(1);
-	FreshThinkers[STAT_SLEEP].CheckSleepingThinkers(1);
+	// @Cockatrice - profilethinkers reads the next tic from the tick profiler, even if it isn't recording all the time
+	if (profilethinkers) TickProfiler.CaptureNext();
+	TickProfiler.BeginTic(gametic);
+	const bool profile = TickProfiler.IsActive();
 
-	// Wake the waiting dreamers
-	for (auto dreamer : tempWakers) {
-		if (dreamer) dreamer->ChangeStatNum(STAT_DEFAULT);
+	// Handle sleeping thinkers, allow them to slip back into the regular pool when unnecessary
+	uint64_t stamp = profile ? FTickProfiler::Stamp() : 0;
+	CheckSleepers();
+	if (profile)
+	{
+		uint64_t time = FTickProfiler::Stamp() - stamp;
+		TickProfiler.AddSlot(FTickProfiler::SLOT_SLEEPERS, time);
+		TickProfiler.AddStat(STAT_SLEEP, time);
 	}
-	tempWakers.Clear();
-
-	inSleepCycle = false;
 
 
 	bool dolights;
@@ -161,131 +398,56 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 		}
 	};
 
-
-	if (!profilethinkers)
+	auto tickList = [=](FThinkerList &list, FThinkerList *dest, int statnum)
 	{
-		// Tick every thinker left from last time
-		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
-		{
-			if (i == STAT_SLEEP || i == STAT_SLEEP_FOREVER) { continue; }
-			Thinkers[i].TickThinkers(nullptr);
-		}
+		if (!profile || list.IsEmpty()) return list.TickThinkers(dest);
 
-		// Keep ticking the fresh thinkers until there are no new ones.
-		do
-		{
-			count = 0;
-			for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
-			{
-				if (i == STAT_SLEEP || i == STAT_SLEEP_FOREVER) { continue; }
-				count += FreshThinkers[i].TickThinkers(&Thinkers[i]);
-			}
-		} while (count != 0);
+		uint64_t start = FTickProfiler::Stamp();
+		int ticked = list.TickThinkers(dest);
+		TickProfiler.AddStat(statnum, FTickProfiler::Stamp() - start);
+		return ticked;
+	};
 
-		recreateLights();
-		if (dolights)
-		{
-			for (auto light = Level->lights; light;)
-			{
-				auto next = light->next;
-				light->Tick();
-				light = next;
-			}
-		}
+	// Tick every thinker left from last time
+	for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
+	{
+		if (i == STAT_SLEEP || i == STAT_SLEEP_FOREVER) { continue; }
+		tickList(Thinkers[i], nullptr, i);
 	}
-	else
+
+	// Keep ticking the fresh thinkers until there are no new ones.
+	do
 	{
-		Profiles.Clear();
-		// Tick every thinker left from last time
+		count = 0;
 		for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
 		{
 			if (i == STAT_SLEEP || i == STAT_SLEEP_FOREVER) { continue; }
-			Thinkers[i].ProfileThinkers(nullptr);
+			count += tickList(FreshThinkers[i], &Thinkers[i], i);
 		}
+	} while (count != 0);
 
-		// Keep ticking the fresh thinkers until there are no new ones.
-		do
-		{
-			count = 0;
-			for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
-			{
-				if (i == STAT_SLEEP || i == STAT_SLEEP_FOREVER) { continue; }
-				count += FreshThinkers[i].ProfileThinkers(&Thinkers[i]);
-			}
-		} while (count != 0);
-
-		recreateLights();
-		if (dolights)
-		{
-			// Also profile the internal dynamic lights, even though they are not implemented as thinkers.
-			auto &prof = Profiles[NAME_InternalDynamicLight];
-			prof.timer.Clock();
-			for (auto light = Level->lights; light;)
-			{
-				prof.numcalls++;
-				auto next = light->next;
-				light->Tick();
-				light = next;
-			}
-			prof.timer.Unclock();
-		}
-
-
-		struct SortedProfileInfo
-		{
-			const char* className;
-			int numcalls;
-			double time;
-		};
-
-		TArray<SortedProfileInfo> sorted;
-		sorted.Grow(Profiles.CountUsed());
-
-		auto it = TMap<FName, ProfileInfo>::Iterator(Profiles);
-		TMap<FName, ProfileInfo>::Pair *pair;
-		while (it.NextPair(pair))
+	recreateLights();
+	if (dolights)
+	{
+		// Also profile the internal dynamic lights, even though they are not implemented as thinkers.
+		int lights = 0;
+		stamp = profile ? FTickProfiler::Stamp() : 0;
+		for (auto light = Level->lights; light;)
 		{
-			sorted.Push({ pair->Key.GetChars(), pair->Value.numcalls, pair->Value.timer.TimeMS() });
+			lights++;
+			auto next = light->next;
+			light->Tick();
+			light = next;
 		}
+		LinkPendingLights();	// @Cockatrice - the lights that moved get relinked together
+		if (profile && lights > 0) TickProfiler.AddSlot(FTickProfiler::SLOT_DYNLIGHTS, FTickProfiler::Stamp() - stamp, lights);
+	}
 
-		std::sort(sorted.begin(), sorted.end(), [](const SortedProfileInfo& left, const SortedProfileInfo& right)
-		{
-			switch (profilethinkers)
-			{
-			case 1: // by name, from A to Z
-				return stricmp(left.className, right.className) < 0;
-			case 2: // by name, from Z to A
-				return stricmp(right.className, left.className) < 0;
-			case 3: // number of calls, ascending
-				return left.numcalls < right.numcalls;
-			case 4: // number of calls, descending
-				return right.numcalls < left.numcalls;
-			case 5: // average time, ascending
-				return left.time / left.numcalls < right.time / right.numcalls;
-			case 6: // average time, descending
-				return right.time / right.numcalls < left.time / left.numcalls;
-			case 7: // total time, ascending
-				return left.time < right.time;
-			default: // total time, descending
-				return right.time < left.time;
-			}
-		});
-
-		Printf(TEXTCOLOR_YELLOW "Total, ms   Averg, ms   Calls   Actor class\n");
-		Printf(TEXTCOLOR_YELLOW "----------  ----------  ------  --------------------\n");
-
-		const unsigned count = min(profilelimit > 0 ? profilelimit : UINT_MAX, sorted.Size());
-
-		for (unsigned i = 0; i < count; ++i)
-		{
-			const SortedProfileInfo& info = sorted[i];
-			Printf("%s%10.6f  %s%10.6f  %s%6d  %s%s\n",
-				profilethinkers >= 7 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time,
-				profilethinkers == 5 || profilethinkers == 6 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.time / info.numcalls,
-				profilethinkers == 3 || profilethinkers == 4 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.numcalls,
-				profilethinkers == 1 || profilethinkers == 2 ? TEXTCOLOR_YELLOW : TEXTCOLOR_WHITE, info.className);
-		}
+	TickProfiler.EndTic();
 
+	if (profilethinkers)
+	{
+		PrintThinkerProfile(TickProfiler.GetFrame(0));
 		profilethinkers = 0;
 	}
 
@@ -303,6 +465,9 @@ void FThinkerCollection::DestroyAllThinkers(bool fullgc)
 	int i;
 	bool error = false;
 
+	// The lists get taken down without unlinking each thinker, so the wheel must let go of them first
+	SleepWheel.Clear();
+
 	for (i = 0; i <= MAX_STATNUM; i++)
 	{
 		if (i != STAT_TRAVELLING && i != STAT_STATIC)
@@ -336,6 +501,15 @@ void FThinkerCollection::SerializeThinkers(FSerializer &arc, bool hubLoad)
 
 	if (arc.isWriting())
 	{
+		// @Cockatrice - the wheel only tracks the wake tic, store the time left like the old timers did
+		for (auto list : { &Thinkers[STAT_SLEEP], &FreshThinkers[STAT_SLEEP] })
+		{
+			for (DThinker *node = list->GetHead(); node != nullptr && node != list->Sentinel; node = node->NextThinker)
+			{
+				if (node->SleepSlot != nullptr) node->sleepTimer = SleepWheel.TimeLeft(node);
+			}
+		}
+
 		arc.BeginArray("thinkers");
 		for (i = 0; i <= MAX_STATNUM; i++)
 		{
@@ -395,6 +569,7 @@ void FThinkerCollection::SerializeThinkers(FSerializer &arc, bool hubLoad)
 			}
 			arc.EndArray();
 		}
+		RebuildSleepWheel();
 	}
 }
 
@@ -441,6 +616,8 @@ void FThinkerList::AddTail(DThinker *thinker)
 	GC::WriteBarrier(thinker, Sentinel);
 	GC::WriteBarrier(tail, thinker);
 	GC::WriteBarrier(Sentinel, thinker);
+
+	if (!HasIsolated && thinker->IsTickIsolated()) HasIsolated = true;
 }
 
 
@@ -461,6 +638,8 @@ void FThinkerList::AddHead(DThinker *thinker)
 	GC::WriteBarrier(thinker, Sentinel);
 	GC::WriteBarrier(head, thinker);
 	GC::WriteBarrier(Sentinel, thinker);
+
+	if (!HasIsolated && thinker->IsTickIsolated()) HasIsolated = true;
 }
 
 
@@ -480,6 +659,8 @@ void FThinkerList::AddAfter(DThinker *after, DThinker *thinker)
 	GC::WriteBarrier(after, thinker);
 	GC::WriteBarrier(nnext, thinker);
 	GC::WriteBarrier(thinker, nnext);
+
+	if (!HasIsolated && thinker->IsTickIsolated()) HasIsolated = true;
 }
 
 /*  Sorting ended up causing tiny little lag spikes and will no longer be used in favor of a slower but more stable method
@@ -779,50 +960,41 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 		return 0;
 	}
 
-	while (node != Sentinel)
+	// @Cockatrice - One timestamp per thinker, the time since the previous one goes to the thinker's class
+	const bool profile = TickProfiler.IsActive();
+	uint64_t stamp = profile ? FTickProfiler::Stamp() : 0;
+
+	// @Cockatrice - Run the isolated part of eligible thinkers on the worker pool first, if the previous tic had
+	// enough of them to be worth it. Otherwise they tick inline and are only counted for the next tic.
+	// The fresh list is left alone, everything in it still needs PostBeginPlay.
+	const bool isolated = dest == nullptr && HasIsolated && IsolatedSeen >= sim_parallel_thinkers;
+	const bool countIsolated = dest == nullptr && HasIsolated && !isolated;
+	int seen = 0;
+	if (isolated)
 	{
-		++count;
-		NextToThink = node->NextThinker;
-		if (node->ObjectFlags & OF_JustSpawned)
+		IsolatedThinkers.Clear();
+		for (DThinker *n = node; n != Sentinel; n = n->NextThinker)
 		{
-			// Leave OF_JustSpawn set until after Tick() so the ticker can check it.
-			if (dest != nullptr)
-			{ // Move thinker from this list to the destination list
-				node->Remove();
-				dest->AddTail(node);
+			if (!(n->ObjectFlags & (OF_JustSpawned | OF_EuthanizeMe)) && n->IsTickIsolated())
+			{
+				IsolatedThinkers.Push(n);
 			}
-			node->CallPostBeginPlay();
 		}
-		else if (dest != nullptr)
+
+		P_ParallelFor(IsolatedThinkers.Size(), 64, [this](int start, int end)
 		{
-			I_Error("There is a thinker in the fresh list that has already ticked.\n");
-		}
+			for (int i = start; i < end; i++)
+			{
+				IsolatedThinkers[i]->IsolatedTicked = IsolatedThinkers[i]->TickIsolated();
+			}
+		});
 
-		if (!(node->ObjectFlags & OF_EuthanizeMe))
-		{ // Only tick thinkers not scheduled for destruction
-			ThinkCount++;
-			node->CallTick();
-			node->ObjectFlags &= ~OF_JustSpawned;
+		if (profile && IsolatedThinkers.Size() > 0)
+		{
+			uint64_t now = FTickProfiler::Stamp();
+			TickProfiler.AddSlot(FTickProfiler::SLOT_PARALLEL, now - stamp, IsolatedThinkers.Size());
+			stamp = now;
 		}
-		
-		node = NextToThink;
-	}
-	return count;
-}
-
-//==========================================================================
-//
-//
-//
-//==========================================================================
-int FThinkerList::ProfileThinkers(FThinkerList *dest)
-{
-	int count = 0;
-	DThinker *node = GetHead();
-
-	if (node == nullptr)
-	{
-		return 0;
 	}
 
 	while (node != Sentinel)
@@ -847,20 +1019,43 @@ int FThinkerList::ProfileThinkers(FThinkerList *dest)
 		if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
 			ThinkCount++;
-
-			auto &prof = Profiles[node->GetClass()->TypeName];
-			prof.numcalls++;
-			prof.timer.Clock();
-			node->CallTick();
-			prof.timer.Unclock();
+			if (countIsolated && !(node->ObjectFlags & OF_JustSpawned) && node->IsTickIsolated()) seen++;
+			if (node->IsolatedTicked)
+			{
+				node->IsolatedTicked = false;
+				node->TickMerge();
+			}
+			else
+			{
+				node->CallTick();
+			}
 			node->ObjectFlags &= ~OF_JustSpawned;
+
+			if (profile)
+			{
+				uint64_t now = FTickProfiler::Stamp();
+				TickProfiler.AddClass(node->GetClass(), now - stamp);
+				stamp = now;
+			}
 		}
+		
 		node = NextToThink;
 	}
+
+	if (isolated)
+	{
+		// Thinkers that were destroyed or moved to another list before their turn must not merge a stale result later
+		for (auto n : IsolatedThinkers) n->IsolatedTicked = false;
+		IsolatedSeen = IsolatedThinkers.Size();
+		IsolatedThinkers.Clear();
+	}
+	else if (countIsolated)
+	{
+		IsolatedSeen = seen;
+	}
 	return count;
 }
 
-
 //==========================================================================
 //
 //
@@ -899,6 +1094,9 @@ void DThinker::Serialize(FSerializer &arc)
 
 void DThinker::Remove()
 {
+	FSleeperWheel::Unschedule(this);
+	InSleepList = false;
+
 	if (this == NextToThink)
 	{
 		NextToThink = NextThinker;
@@ -1348,6 +1546,158 @@ DThinker *FThinkerIterator::Next (bool exact)
 //
 //==========================================================================
 
+//==========================================================================
+//
+// @Cockatrice - Per tic cost of the old sleeper list walk versus the
+// sleeper wheel. The benchmark sleepers live in their own list and wheel,
+// so the level is left alone. They sleep for longer than the benchmark
+// runs, which leaves only the bookkeeping to measure.
+// Usage: bench_sleepers [count] [tics]
+//
+//==========================================================================
+
+void FThinkerCollection::BenchmarkSleepers(int count, int tics)
+{
+	FThinkerList list;
+	FSleeperWheel wheel;
+	TArray<DThinker*> due;
+
+	for (int i = 0; i < count; i++)
+	{
+		auto thinker = static_cast<DThinker*>(RUNTIME_CLASS(DThinker)->CreateNew());
+		thinker->Level = primaryLevel;
+		thinker->sleepInterval = thinker->sleepTimer = tics + 1 + (i * 7919) % 30000;
+		list.AddHead(thinker);
+		wheel.Schedule(thinker, thinker->sleepTimer);
+	}
+
+	uint64_t start = I_nsTime();
+	for (int t = 0; t < tics; t++)
+	{
+		list.CheckSleepingThinkers(1);
+	}
+	double listUS = (I_nsTime() - start) / 1000.0 / tics;
+
+	start = I_nsTime();
+	for (int t = 0; t < tics; t++)
+	{
+		wheel.Advance(due);
+	}
+	double wheelUS = (I_nsTime() - start) / 1000.0 / tics;
+
+	Printf("%7d sleepers, %d tics: list walk %9.3f us/tic, wheel %9.3f us/tic (%u due)\n", count, tics, listUS, wheelUS, due.Size());
+
+	wheel.Clear();
+	list.DestroyThinkers();
+}
+
+CCMD(bench_sleepers)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+
+	int tics = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 100000) : 350;
+	if (argv.argc() > 1)
+	{
+		FThinkerCollection::BenchmarkSleepers(clamp(atoi(argv[1]), 1, 1000000), tics);
+	}
+	else
+	{
+		FThinkerCollection::BenchmarkSleepers(10000, tics);
+		FThinkerCollection::BenchmarkSleepers(50000, tics);
+	}
+}
+
+//==========================================================================
+//
+// @Cockatrice - Per tic cost of ticking trivial isolated thinkers inline
+// versus running their isolated phase on the worker pool. The benchmark
+// thinkers count down like the light thinkers and live in their own list,
+// so the level is left alone.
+// Usage: bench_isolated [count] [tics]
+//
+//==========================================================================
+
+class DIsolatedBench : public DThinker
+{
+	DECLARE_CLASS(DIsolatedBench, DThinker)
+public:
+	void Tick() override { if (--Count <= 0) Count = Period; }
+	bool IsTickIsolated() const override { return true; }
+	bool TickIsolated() override
+	{
+		if (Count <= 1) return false;
+		Count--;
+		return true;
+	}
+
+	int Count = 0;
+	int Period = 0;
+};
+
+IMPLEMENT_CLASS(DIsolatedBench, false, false)
+
+void FThinkerCollection::BenchmarkIsolated(int count, int tics)
+{
+	FThinkerList list;
+	for (int i = 0; i < count; i++)
+	{
+		auto thinker = static_cast<DIsolatedBench*>(RUNTIME_CLASS(DIsolatedBench)->CreateNew());
+		thinker->Level = primaryLevel;
+		thinker->Period = 8 + i % 57;
+		thinker->Count = 1 + i % thinker->Period;
+		thinker->ObjectFlags &= ~OF_JustSpawned;
+		list.AddTail(thinker);
+	}
+
+	int oldThreshold = sim_parallel_thinkers;
+	int oldCount = ThinkCount;
+	double us[2];
+	for (int mode = 0; mode < 2; mode++)
+	{
+		// The threshold decides from the previous tic, so the first tic only sets the count
+		sim_parallel_thinkers = mode == 0 ? INT_MAX : 0;
+		list.TickThinkers(nullptr);
+
+		uint64_t start = I_nsTime();
+		for (int t = 0; t < tics; t++)
+		{
+			list.TickThinkers(nullptr);
+		}
+		us[mode] = (I_nsTime() - start) / 1000.0 / tics;
+	}
+	sim_parallel_thinkers = oldThreshold;
+	ThinkCount = oldCount;
+
+	Printf("%7d thinkers, %d tics: inline %9.3f us/tic, worker pool %9.3f us/tic (%d workers)\n", count, tics, us[0], us[1], P_ParallelWorkers());
+	list.DestroyThinkers();
+}
+
+CCMD(bench_isolated)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+
+	int tics = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 100000) : 350;
+	if (argv.argc() > 1)
+	{
+		FThinkerCollection::BenchmarkIsolated(clamp(atoi(argv[1]), 1, 1000000), tics);
+	}
+	else
+	{
+		for (int count = 256; count <= 65536; count *= 4)
+		{
+			FThinkerCollection::BenchmarkIsolated(count, tics);
+		}
+	}
+}
+
 ADD_STAT (think)
 {
 	FString out;
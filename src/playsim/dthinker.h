@@ -67,21 +67,55 @@ struct FThinkerList
 	bool IsEmpty() const;
 	void DestroyThinkers();
 	bool DoDestroyThinkers();
-	int CheckSleepingThinkers(int ticsElapsed = 1);			// Check and unsleep thinkers periodically
+	int CheckSleepingThinkers(int ticsElapsed = 1);			// Check and unsleep thinkers periodically. Superseded by FSleeperWheel, kept for comparison
 	int TickThinkers(FThinkerList *dest);					// Returns: # of thinkers ticked
-	int ProfileThinkers(FThinkerList *dest);
 	void SaveList(FSerializer &arc);
 
 private:
 	DThinker *Sentinel = nullptr;
+	bool HasIsolated = false;	// @Cockatrice - Set once a thinker with an isolated tick phase has been linked into this list
+	int IsolatedSeen = 0;		// @Cockatrice - Thinkers eligible for the isolated phase on the previous tic
+	TArray<DThinker *> IsolatedThinkers;
 
 	friend struct FThinkerCollection;
 };
 
+// @Cockatrice - Hierarchical timer wheel for STAT_SLEEP thinkers, keyed by the tic they are due.
+// Advancing a tic only touches the thinkers due on that tic, plus one coarse slot every NEAR_SLOTS tics
+// that gets spread out over the fine slots. Sleepers stay linked in their thinker list as before,
+// this only decides when they get looked at. Thinkers are linked in intrusively, so unscheduling is O(1).
+struct FSleeperWheel
+{
+	enum
+	{
+		NEAR_BITS = 8,
+		NEAR_SLOTS = 1 << NEAR_BITS,	// one slot per tic
+		FAR_BITS = 6,
+		FAR_SLOTS = 1 << FAR_BITS,		// one slot per NEAR_SLOTS tics
+		FAR_RANGE = NEAR_SLOTS * (FAR_SLOTS - 1),
+	};
+
+	void Schedule(DThinker *thinker, int tics);		// Due in 'tics' tics, at least 1
+	static void Unschedule(DThinker *thinker);
+	void Advance(TArray<DThinker*> &due);			// Moves on by one tic and collects everything due
+	int TimeLeft(const DThinker *thinker) const;
+	void Clear();
+
+private:
+	void Place(DThinker *thinker);
+	void Requeue(DThinker *&slot);
+
+	DThinker *Near[NEAR_SLOTS] = {};
+	DThinker *Far[FAR_SLOTS] = {};
+	DThinker *Overflow = nullptr;		// More than FAR_RANGE tics away, rechecked whenever a far slot is spread out
+	uint32_t CurrentTic = 0;
+};
+
 struct FThinkerCollection
 {
 	void DestroyThinkersInList(int statnum)
 	{
+		if (statnum == STAT_SLEEP) SleepWheel.Clear();
 		Thinkers[statnum].DestroyThinkers();
 		FreshThinkers[statnum].DestroyThinkers();
 	}
@@ -96,6 +130,10 @@ struct FThinkerCollection
 
 	bool IsSleepCycle() const { return inSleepCycle; }
 	void AddWaker(DThinker* einstein) { tempWakers.Push(einstein); }
+	void CheckSleepers();								// @Cockatrice - Wakes everything due this tic
+	void RebuildSleepWheel();
+	static void BenchmarkSleepers(int count, int tics);
+	static void BenchmarkIsolated(int count, int tics);
 
 private:
 	FThinkerList Thinkers[MAX_STATNUM + 2];
@@ -103,6 +141,8 @@ private:
 
 	bool inSleepCycle = false;							// Set when running through sleepers.  If in sleep cycle, we put new sleeping thinkers into FreshThinkers and new wakes into the wake list
 	TArray<DThinker*> tempWakers;
+	FSleeperWheel SleepWheel;
+	TArray<DThinker*> dueSleepers;
 
 	friend class FThinkerIterator;
 };
@@ -128,6 +168,17 @@ public:
 	virtual bool CallShouldWake();
 	virtual void CallWake();
 
+	// @Cockatrice - Parallel tick phase
+	// Thinkers that return true from IsTickIsolated get TickIsolated called on a worker thread before the
+	// serial pass over their list, then TickMerge in list order where Tick would normally run.
+	// TickIsolated may only read and write the thinker's own members. Anything touching shared state
+	// (RNG, sectors, other thinkers) has to be deferred to TickMerge. Returning false from TickIsolated
+	// means this tick can't be done in isolation, and Tick is called as usual instead. Lists with fewer
+	// eligible thinkers than sim_parallel_thinkers always call Tick, so both paths must give the same result.
+	virtual bool IsTickIsolated() const { return false; }
+	virtual bool TickIsolated() { return false; }
+	virtual void TickMerge() {}
+
 	void Serialize(FSerializer &arc) override;
 	size_t PropagateMark();
 	
@@ -138,6 +189,7 @@ private:
 
 	friend struct FThinkerList;
 	friend struct FThinkerCollection;
+	friend struct FSleeperWheel;
 	friend class FThinkerIterator;
 	friend class DObject;
 	friend class FDoomSerializer;
@@ -146,7 +198,14 @@ private:
 
 	// Sleep info
 	int sleepInterval = 0;	// How many tics to sleep before checking for wake
-	int sleepTimer = 0;		// Timer data
+	int sleepTimer = 0;		// Timer data. Only brought up to date for serialization while the thinker is in the sleeper wheel
+
+	// @Cockatrice - Sleeper wheel links
+	DThinker *SleepNext = nullptr, *SleepPrev = nullptr;
+	DThinker **SleepSlot = nullptr;		// Head of the wheel slot this thinker is in, null if not scheduled
+	uint32_t WakeTic = 0;
+	bool InSleepList = false;			// Linked into STAT_SLEEP
+	bool IsolatedTicked = false;		// @Cockatrice - TickIsolated finished for this tic, TickMerge is due
 
 public:
 	FLevelLocals *Level;
@@ -57,6 +57,21 @@ static FRandom pr_fireflicker ("FireFlicker");
 
 IMPLEMENT_CLASS(DLighting, false, false)
 
+bool DLighting::IsTickIsolated() const
+{
+	// Script subclasses may override Tick, which has to run through the VM on the game thread
+	return !GetClass()->bRuntimeClass;
+}
+
+void DLighting::TickMerge()
+{
+	if (m_PendingLight >= 0)
+	{
+		m_Sector->SetLightLevel(m_PendingLight);
+		m_PendingLight = -1;
+	}
+}
+
 //-----------------------------------------------------------------------------
 //
 // FIRELIGHT FLICKER
@@ -98,6 +113,14 @@ void DFireFlicker::Tick ()
 	}
 }
 
+bool DFireFlicker::TickIsolated()
+{
+	// The tic the counter runs out reads the sector and the RNG, leave that one to Tick
+	if (m_Count <= 1) return false;
+	m_Count--;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 // P_SpawnFireFlicker
@@ -160,6 +183,14 @@ void DFlicker::Tick ()
 	}
 }
 
+bool DFlicker::TickIsolated()
+{
+	// Switching the light reads the sector and the RNG, leave that to Tick
+	if (m_Count == 0) return false;
+	m_Count--;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -217,6 +248,14 @@ void DLightFlash::Tick ()
 	}
 }
 
+bool DLightFlash::TickIsolated()
+{
+	// The tic the counter runs out reads the sector and the RNG, leave that one to Tick
+	if (m_Count <= 1) return false;
+	m_Count--;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 // P_SpawnLightFlash
@@ -287,6 +326,14 @@ void DStrobe::Tick ()
 	}
 }
 
+bool DStrobe::TickIsolated()
+{
+	// The tic the counter runs out reads the sector and the RNG, leave that one to Tick
+	if (m_Count <= 1) return false;
+	m_Count--;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Hexen-style constructor
@@ -439,6 +486,21 @@ void DGlow2::Tick ()
 	m_Sector->SetLightLevel(((m_End - m_Start) * m_Tics) / m_MaxTics + m_Start);
 }
 
+bool DGlow2::TickIsolated()
+{
+	if (m_Tics >= m_MaxTics)
+	{
+		// The one-shot end destroys the thinker, which must happen on the game thread
+		if (m_OneShot) return false;
+		std::swap(m_Start, m_End);
+		m_Tics -= m_MaxTics;
+	}
+	m_Tics++;
+
+	m_PendingLight = ((m_End - m_Start) * m_Tics) / m_MaxTics + m_Start;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -495,6 +557,24 @@ void DPhased::Tick ()
 		m_Phase--;
 }
 
+bool DPhased::TickIsolated()
+{
+	const int steps = 12;
+
+	if (m_Phase < steps)
+		m_PendingLight = ((255 - m_BaseLevel) * m_Phase) / steps + m_BaseLevel;
+	else if (m_Phase < 2*steps)
+		m_PendingLight = ((255 - m_BaseLevel) * (2*steps - m_Phase - 1) / steps + m_BaseLevel);
+	else
+		m_PendingLight = m_BaseLevel;
+
+	if (m_Phase == 0)
+		m_Phase = 63;
+	else
+		m_Phase--;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //
 //
@@ -5,6 +5,14 @@ class DLighting : public DSectorEffect
 	DECLARE_CLASS(DLighting, DSectorEffect)
 public:
 	static const int DEFAULT_STAT = STAT_LIGHT;
+
+	// @Cockatrice - Light thinkers only count down their own timers most tics, which can run in the parallel tick phase.
+	// A new light level computed there is stored in m_PendingLight and applied to the sector in TickMerge.
+	bool IsTickIsolated() const override;
+	void TickMerge() override;
+
+protected:
+	int m_PendingLight = -1;
 };
 
 class DFireFlicker : public DLighting
@@ -15,6 +23,7 @@ public:
 	void Construct(sector_t *sector, int upper, int lower);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -28,6 +37,7 @@ public:
 	void Construct(sector_t *sector, int upper, int lower);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -42,6 +52,7 @@ public:
 	void Construct(sector_t *sector, int min, int max);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	int 		m_Count;
 	int 		m_MaxLight;
@@ -58,6 +69,7 @@ public:
 	void Construct(sector_t *sector, int upper, int lower, int utics, int ltics);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	int 		m_Count;
 	int 		m_MinLight;
@@ -87,6 +99,7 @@ public:
 	void Construct(sector_t *sector, int start, int end, int tics, bool oneshot);
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	int			m_Start;
 	int			m_End;
@@ -107,6 +120,7 @@ public:
 
 	void		Serialize(FSerializer &arc);
 	void		Tick();
+	bool		TickIsolated() override;
 protected:
 	uint8_t		m_BaseLevel;
 	uint8_t		m_Phase;
@@ -0,0 +1,307 @@
+/*
+** p_actorgrid.cpp
+** @Cockatrice - Loose grid of actors for area queries
+**
+*/
+
+#include "p_actorgrid.h"
+#include "p_blockmap.h"
+#include "actor.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "g_levellocals.h"
+#include "p_maputl.h"
+#include "m_bbox.h"
+#include "i_time.h"
+#include "printf.h"
+#include "doomstat.h"
+#include "d_player.h"
+
+CVAR(Bool, sim_actorgrid, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Int, sim_actorgrid_cellsize, 128, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+//==========================================================================
+//
+// Covers the same area as the blockmap. Changes to the CVARs are
+// picked up on the next map.
+//
+//==========================================================================
+
+void FActorGrid::Init(const FBlockmap &blockmap)
+{
+	Clear();
+	if (!sim_actorgrid) return;
+
+	CellSize = clamp<int>(sim_actorgrid_cellsize, 32, 1024);
+	Margin = CellSize / 2;
+	OriginX = blockmap.bmaporgx;
+	OriginY = blockmap.bmaporgy;
+	Width = max(1, int(ceil(blockmap.bmapwidth * double(FBlockmap::MAPBLOCKUNITS) / CellSize)));
+	Height = max(1, int(ceil(blockmap.bmapheight * double(FBlockmap::MAPBLOCKUNITS) / CellSize)));
+	Cells.Resize(Width * Height + 1);
+}
+
+void FActorGrid::Clear()
+{
+	Cells.Reset();
+	Width = Height = 0;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FActorGrid::Link(AActor *actor)
+{
+	if (!IsActive()) return;
+	// LinkToWorld is exported to scripts, so a second link must not leave a duplicate behind
+	if (actor->GridCell >= 0) Unlink(actor);
+
+	// The blockmap puts new links at the head of each block, the sequence lets queries sort into that order
+	actor->GridLinkSeq = ++LinkSeq;
+	ModCount++;
+
+	int cell;
+	if (actor->radius > Margin)
+	{
+		cell = Cells.Size() - 1;
+	}
+	else
+	{
+		// Actors off the map go to the nearest edge cell, the query bounds weed them out
+		cell = CellY(actor->Y()) * Width + CellX(actor->X());
+	}
+
+	actor->GridCell = cell;
+	actor->GridIndex = Cells[cell].Actors.Push(actor);
+	Cells[cell].Bounds.Push(DVector3(actor->X(), actor->Y(), actor->radius));
+}
+
+void FActorGrid::Unlink(AActor *actor)
+{
+	int cell = actor->GridCell;
+	int index = actor->GridIndex;
+	actor->GridCell = actor->GridIndex = -1;
+
+	// The grid may have been cleared with the level before all actors were gone
+	if ((unsigned)cell >= Cells.Size()) return;
+	ModCount++;
+
+	auto &c = Cells[cell];
+	assert(c.Actors[index] == actor);
+
+	// Move the last actor of the cell into the free spot
+	unsigned last = c.Actors.Size() - 1;
+	if ((unsigned)index != last)
+	{
+		c.Actors[index] = c.Actors[last];
+		c.Bounds[index] = c.Bounds[last];
+		c.Actors[index]->GridIndex = index;
+	}
+	c.Actors.Pop();
+	c.Bounds.Pop();
+}
+
+//==========================================================================
+//
+// Prediction moves the player through the grid and swap-removes it from
+// its cell, so the whole cell is saved and put back afterwards. The
+// player must already be unlinked again when Restore is called.
+//
+//==========================================================================
+
+void FActorGrid::Backup(AActor *actor, FCellBackup &backup) const
+{
+	backup.Cell = (unsigned)actor->GridCell < Cells.Size() ? actor->GridCell : -1;
+	if (backup.Cell < 0) return;
+	backup.Bounds = Cells[backup.Cell].Bounds;
+	backup.Actors = Cells[backup.Cell].Actors;
+}
+
+void FActorGrid::Restore(AActor *actor, const FCellBackup &backup)
+{
+	actor->GridCell = actor->GridIndex = -1;
+	if ((unsigned)backup.Cell >= Cells.Size()) return;
+	ModCount++;
+
+	auto &c = Cells[backup.Cell];
+	c.Bounds = backup.Bounds;
+	c.Actors = backup.Actors;
+	for (unsigned i = 0; i < c.Actors.Size(); i++)
+	{
+		c.Actors[i]->GridCell = backup.Cell;
+		c.Actors[i]->GridIndex = i;
+	}
+}
+
+//==========================================================================
+//
+// Returns the number of inconsistent slots
+//
+//==========================================================================
+
+int FActorGrid::Validate() const
+{
+	int errors = 0;
+	for (unsigned cell = 0; cell < Cells.Size(); cell++)
+	{
+		auto &c = Cells[cell];
+		if (c.Bounds.Size() != c.Actors.Size()) errors++;
+		for (unsigned i = 0; i < c.Actors.Size(); i++)
+		{
+			auto actor = c.Actors[i];
+			if (actor->GridCell != (int)cell || actor->GridIndex != (int)i || (actor->ObjectFlags & OF_EuthanizeMe)) errors++;
+		}
+	}
+	return errors;
+}
+
+//==========================================================================
+//
+// Runs the same area queries through the blockmap walk and the grid
+//
+//==========================================================================
+
+CCMD(bench_actorgrid)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+	if (!primaryLevel->ActorGrid.IsActive())
+	{
+		Printf("The actor grid is off for this level, enable sim_actorgrid and restart the map\n");
+		return;
+	}
+
+	int queries = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000000) : 100000;
+	double radius = argv.argc() > 2 ? clamp(atof(argv[2]), 1., 4096.) : 256.;
+
+	TArray<DVector2> centers;
+	auto it = primaryLevel->GetThinkerIterator<AActor>();
+	while (auto actor = it.Next())
+	{
+		if (!(actor->flags & MF_NOBLOCKMAP)) centers.Push(actor->Pos().XY());
+	}
+	if (centers.Size() == 0)
+	{
+		Printf("No actors in the blockmap\n");
+		return;
+	}
+
+	bool wasOn = sim_actorgrid;
+	uint64_t found[2] = {}, time[2] = {};
+
+	for (int mode = 0; mode < 2; mode++)
+	{
+		sim_actorgrid = mode == 1;
+		uint64_t start = I_nsTime();
+		for (int i = 0; i < queries; i++)
+		{
+			const DVector2 &c = centers[i % centers.Size()];
+			FBoundingBox box(c.X, c.Y, radius);
+			FBlockThingsIterator bit(primaryLevel, box);
+			while (bit.Next()) found[mode]++;
+		}
+		time[mode] = I_nsTime() - start;
+	}
+
+	// Both must return the same actors in the same order, with and without centeronly
+	int mismatches = 0;
+	TArray<AActor *> results[2];
+	for (unsigned i = 0; i < centers.Size(); i++)
+	{
+		for (int centeronly = 0; centeronly < 2; centeronly++)
+		{
+			for (int mode = 0; mode < 2; mode++)
+			{
+				sim_actorgrid = mode == 1;
+				FBoundingBox box(centers[i].X, centers[i].Y, radius);
+				FBlockThingsIterator bit(primaryLevel, box);
+				results[mode].Clear();
+				while (auto actor = bit.Next(!!centeronly)) results[mode].Push(actor);
+			}
+			if (!(results[0] == results[1])) mismatches++;
+		}
+	}
+	sim_actorgrid = wasOn;
+
+	Printf("%d queries, radius %g, %u actors\n", queries, radius, centers.Size());
+	Printf("  blockmap: %8.3f ms, %llu results\n", time[0] * 1e-6, (unsigned long long)found[0]);
+	Printf("  grid:     %8.3f ms, %llu results\n", time[1] * 1e-6, (unsigned long long)found[1]);
+	if (mismatches > 0) Printf(TEXTCOLOR_RED "%d of %u queries returned different results or order\n", mismatches, centers.Size() * 2);
+}
+
+//==========================================================================
+//
+// Moves a dummy actor around the way prediction moves the player, restores
+// it the way P_UnPredictPlayer does and checks that the grid is unchanged.
+// The dummy is created without going through Spawn, so the test uses no
+// random numbers and leaves the spawn counters alone.
+//
+//==========================================================================
+
+CCMD(test_actorgrid)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+	auto &grid = primaryLevel->ActorGrid;
+	if (!grid.IsActive())
+	{
+		Printf("The actor grid is off for this level, enable sim_actorgrid and restart the map\n");
+		return;
+	}
+
+	auto player = players[consoleplayer].mo;
+	DVector3 pos = player != nullptr ? player->Pos() : DVector3(primaryLevel->blockmap.bmaporgx + 64, primaryLevel->blockmap.bmaporgy + 64, 0);
+
+	auto mo = static_cast<AActor *>(primaryLevel->CreateThinker(RUNTIME_CLASS(AActor)));
+	mo->flags = (mo->flags & ~MF_NOBLOCKMAP) | MF_NOSECTOR;
+	mo->SetXYZ(pos);
+	mo->LinkToWorld(nullptr);
+
+	int errors = grid.Validate();
+	FActorGrid::FCellBackup backup;
+	grid.Backup(mo, backup);
+	int cell = mo->GridCell, index = mo->GridIndex;
+
+	for (int i = 0; i < 64; i++)
+	{
+		FLinkContext ctx;
+		mo->UnlinkFromWorld(&ctx);
+		mo->SetXYZ(pos + DVector3((i % 8) * 40., (i / 8) * 40., 0));
+		mo->LinkToWorld(&ctx);
+		// a repeated link must not leave a second entry
+		grid.Link(mo);
+		errors += grid.Validate();
+	}
+
+	// Same order as P_UnPredictPlayer: unlink, stale fields from the actor backup, restore
+	FLinkContext ctx;
+	mo->UnlinkFromWorld(&ctx);
+	mo->SetXYZ(pos);
+	mo->LinkToWorld(&ctx);
+	grid.Unlink(mo);
+	mo->GridCell = cell + 1;
+	mo->GridIndex = index + 1;
+	grid.Restore(mo, backup);
+
+	errors += grid.Validate();
+	if (mo->GridCell != cell || mo->GridIndex != index) errors++;
+	FActorGrid::FCellBackup restored;
+	grid.Backup(mo, restored);
+	if (!(restored.Actors == backup.Actors)) errors++;
+
+	// Take the dummy out of the blockmap and the grid before it goes
+	mo->UnlinkFromWorld(nullptr);
+	mo->Destroy();
+	errors += grid.Validate();
+
+	Printf("%s: %d errors\n", errors ? TEXTCOLOR_RED "Actor grid test failed" : "Actor grid test passed", errors);
+}
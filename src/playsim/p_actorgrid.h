@@ -0,0 +1,92 @@
+#pragma once
+
+#include "basics.h"
+#include "tarray.h"
+#include "vectors.h"
+
+class AActor;
+struct FBlockmap;
+
+// @Cockatrice - Loose grid of actors for area queries
+// Every actor is stored once, in the cell that holds its center, with its position and radius packed
+// next to the other actors of that cell. Queries look at the cells around the area grown by half a cell,
+// actors with a radius larger than that are kept in a separate list that every query checks.
+// This replaces walking the blockmap's per-block node lists in FBlockThingsIterator, which needs a
+// hash to skip actors that span several blocks and jumps all over memory in crowded blocks.
+class FActorGrid
+{
+public:
+	void Init(const FBlockmap &blockmap);
+	void Clear();
+	bool IsActive() const { return Cells.Size() > 0; }
+	// Changes with every link and unlink, so iterators can tell when their results went stale
+	unsigned GetModCount() const { return ModCount; }
+
+	// The cell an actor is linked in, saved by player prediction so the order of its actors survives
+	struct FCellBackup
+	{
+		int Cell = -1;
+		TArray<DVector3> Bounds;
+		TArray<AActor *> Actors;
+	};
+
+	void Link(AActor *actor);
+	void Unlink(AActor *actor);
+	void Backup(AActor *actor, FCellBackup &backup) const;
+	void Restore(AActor *actor, const FCellBackup &backup);
+	int Validate() const;
+
+	// Calls func(actor, bounds) for every linked actor whose bounding box touches the rectangle (right and top exclusive),
+	// with the position and radius (in z) it was linked with. With centeronly, only actors whose center is inside the rectangle are reported.
+	template<class Func>
+	void Collect(double left, double bottom, double right, double top, bool centeronly, Func &&func) const
+	{
+		if (!IsActive() || left >= right || bottom >= top) return;
+
+		int x1 = CellX(left - Margin), x2 = CellX(right + Margin);
+		int y1 = CellY(bottom - Margin), y2 = CellY(top + Margin);
+
+		for (int y = y1; y <= y2; y++)
+		{
+			for (int x = x1; x <= x2; x++)
+			{
+				CollectCell(Cells[y * Width + x], left, bottom, right, top, centeronly, func);
+			}
+		}
+		CollectCell(Cells.Last(), left, bottom, right, top, centeronly, func);
+	}
+
+private:
+	struct FCell
+	{
+		TArray<DVector3> Bounds;	// x, y, radius
+		TArray<AActor *> Actors;
+	};
+
+	template<class Func>
+	static void CollectCell(const FCell &cell, double left, double bottom, double right, double top, bool centeronly, Func &func)
+	{
+		const DVector3 *bounds = cell.Bounds.Data();
+		const unsigned count = cell.Bounds.Size();
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			const double r = centeronly ? 0 : bounds[i].Z;
+			if (bounds[i].X + r >= left && bounds[i].X - r < right && bounds[i].Y + r >= bottom && bounds[i].Y - r < top)
+			{
+				func(cell.Actors[i], bounds[i]);
+			}
+		}
+	}
+
+	int CellX(double x) const { return clamp(int((x - OriginX) / CellSize), 0, Width - 1); }
+	int CellY(double y) const { return clamp(int((y - OriginY) / CellSize), 0, Height - 1); }
+
+	// The last cell holds the actors too large for the loose margin
+	TArray<FCell> Cells;
+	int Width = 0, Height = 0;
+	double OriginX = 0, OriginY = 0;
+	double CellSize = 128, Margin = 64;
+	unsigned ModCount = 0;
+	uint64_t LinkSeq = 0;
+};
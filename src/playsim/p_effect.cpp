@@ -50,6 +50,7 @@
 #include "actorinlines.h"
 #include "g_game.h"
 #include "serializer_doom.h"
+#include "p_parallel.h"
 
 #include "hwrenderer/scene/hw_drawstructs.h"
 
@@ -287,8 +288,50 @@ void P_InitEffects ()
 	blood2 = ParticleColor(RPART(kind)/3, GPART(kind)/3, BPART(kind)/3);
 }
 
+// @Cockatrice - Moves one particle that survived this tic. Only touches the particle itself,
+// so this runs on the worker pool when the map has no line portals to trace through.
+static void P_MoveParticle(FLevelLocals *Level, particle_t *particle)
+{
+	// Handle crossing a line portal
+	DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
+	particle->Pos.X = newxy.X;
+	particle->Pos.Y = newxy.Y;
+	particle->Pos.Z += particle->Vel.Z;
+	particle->Vel += particle->Acc;
+
+	if(particle->flags & SPF_ROLL)
+	{
+		particle->Roll += particle->RollVel;
+		particle->RollVel += particle->RollAcc;
+	}
+	
+	particle->subsector = Level->PointInRenderSubsector(particle->Pos);
+	sector_t *s = particle->subsector->sector;
+	// Handle crossing a sector portal.
+	if (!s->PortalBlocksMovement(sector_t::ceiling))
+	{
+		if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
+		{
+			particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
+			particle->subsector = NULL;
+		}
+	}
+	else if (!s->PortalBlocksMovement(sector_t::floor))
+	{
+		if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
+		{
+			particle->Pos += s->GetPortalDisplacement(sector_t::floor);
+			particle->subsector = NULL;
+		}
+	}
+}
+
 void P_ThinkParticles (FLevelLocals *Level)
 {
+	static TArray<particle_t *> moving;
+	moving.Clear();
+
+	// Freezing, fading and expiry edit the active list, so they stay serial
 	int i = Level->ActiveParticles;
 	particle_t *particle = nullptr, *prev = nullptr;
 	while (i != NO_PARTICLE)
@@ -326,40 +369,18 @@ void P_ThinkParticles (FLevelLocals *Level)
 			continue;
 		}
 
-		// Handle crossing a line portal
-		DVector2 newxy = Level->GetPortalOffsetPosition(particle->Pos.X, particle->Pos.Y, particle->Vel.X, particle->Vel.Y);
-		particle->Pos.X = newxy.X;
-		particle->Pos.Y = newxy.Y;
-		particle->Pos.Z += particle->Vel.Z;
-		particle->Vel += particle->Acc;
-
-		if(particle->flags & SPF_ROLL)
-		{
-			particle->Roll += particle->RollVel;
-			particle->RollVel += particle->RollAcc;
-		}
-		
-		particle->subsector = Level->PointInRenderSubsector(particle->Pos);
-		sector_t *s = particle->subsector->sector;
-		// Handle crossing a sector portal.
-		if (!s->PortalBlocksMovement(sector_t::ceiling))
-		{
-			if (particle->Pos.Z > s->GetPortalPlaneZ(sector_t::ceiling))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::ceiling);
-				particle->subsector = NULL;
-			}
-		}
-		else if (!s->PortalBlocksMovement(sector_t::floor))
-		{
-			if (particle->Pos.Z < s->GetPortalPlaneZ(sector_t::floor))
-			{
-				particle->Pos += s->GetPortalDisplacement(sector_t::floor);
-				particle->subsector = NULL;
-			}
-		}
+		moving.Push(particle);
 		prev = particle;
 	}
+
+	auto move = [Level](int start, int end)
+	{
+		for (int j = start; j < end; j++) P_MoveParticle(Level, moving[j]);
+	};
+
+	// The line portal trace uses the shared path traverser state
+	if (Level->PortalBlockmap.containsLines) move(0, moving.Size());
+	else P_ParallelFor(moving.Size(), 256, move);
 }
 
 void P_SpawnParticle(FLevelLocals *Level, const DVector3 &pos, const DVector3 &vel, const DVector3 &accel, PalEntry color, double startalpha, int lifetime, double size,
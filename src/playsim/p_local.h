@@ -274,6 +274,8 @@ bool	P_BounceWall (AActor *mo);
 bool	P_BounceActor (AActor *mo, AActor *BlockingMobj, bool ontop);
 bool    P_ReflectOffActor(AActor* mo, AActor* blocking);
 int	P_CheckSight (AActor *t1, AActor *t2, int flags=0);
+int	P_CheckSightBatch (AActor *looker, AActor *const *targets, int count, int flags, uint8_t *results);	// @Cockatrice - one looker, many targets
+int	P_CheckSightBatch (AActor *const *lookers, int count, AActor *target, int flags, uint8_t *results);	// @Cockatrice - many lookers, one target
 
 enum ESightFlags
 {
@@ -80,6 +80,8 @@
 #include "po_man.h"
 #include "vm.h"
 
+EXTERN_CVAR(Bool, sim_actorgrid)
+
 int P_VanillaPointOnDivlineSide(double x, double y, const divline_t* line);
 
 
@@ -346,6 +348,7 @@ void AActor::UnlinkFromWorld (FLinkContext *ctx)
 		}
 		BlockNode = NULL;
 	}
+	if (GridCell >= 0) Level->ActorGrid.Unlink(this);
 	ClearRenderSectorList();
 	ClearRenderLineList();
 }
@@ -555,6 +558,7 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 				}
 			}
 		}
+		Level->ActorGrid.Link(this);
 	}
 	// Portal links cannot be done unless the level is fully initialized.
 	if (!spawningmapthing) UpdateRenderSectorList();
@@ -933,6 +937,51 @@ void FBlockThingsIterator::ClearHash()
 	DynHash.Clear();
 }
 
+//===========================================================================
+//
+// FBlockThingsIterator :: FindInHash / AddToHash
+//
+//===========================================================================
+
+bool FBlockThingsIterator::FindInHash(AActor *me)
+{
+	size_t hash = ((size_t)me >> 3) % countof(Buckets);
+	for (int i = Buckets[hash]; i >= 0; )
+	{
+		HashEntry *entry = GetHashEntry(i);
+		if (entry->Actor == me)
+		{ // I've already been checked.
+			return true;
+		}
+		i = entry->Next;
+	}
+	return false;
+}
+
+void FBlockThingsIterator::AddToHash(AActor *me)
+{
+	size_t hash = ((size_t)me >> 3) % countof(Buckets);
+	HashEntry *entry;
+	if (NumFixedHash < (int)countof(FixedHash))
+	{
+		entry = &FixedHash[NumFixedHash];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = NumFixedHash++;
+	}
+	else
+	{
+		if (DynHash.Size() == 0)
+		{
+			DynHash.Grow(50);
+		}
+		int i = DynHash.Reserve(1);
+		entry = &DynHash[i];
+		entry->Next = Buckets[hash];
+		Buckets[hash] = i + countof(FixedHash);
+	}
+	entry->Actor = me;
+}
+
 //===========================================================================
 //
 // FBlockThingsIterator :: StartBlock
@@ -954,6 +1003,186 @@ void FBlockThingsIterator::StartBlock(int x, int y)
 	}
 }
 
+//===========================================================================
+//
+// FBlockThingsIterator :: Reset
+//
+// @Cockatrice - Area queries go through the actor grid when the level has
+// one. Levels with linked portals keep using the blockmap, which links
+// actors into every portal group they reach.
+//
+//===========================================================================
+
+void FBlockThingsIterator::Reset()
+{
+	useGrid = sim_actorgrid && Level->ActorGrid.IsActive() && Level->Displacements.size <= 1;
+	resumeSkip = false;
+	if (useGrid) StartGrid();
+	else StartBlock(minx, miny);
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: StartGrid
+//
+// The results are gathered on the first call to Next.
+//
+//===========================================================================
+
+void FBlockThingsIterator::StartGrid()
+{
+	NumFound = 0;
+	FoundPos = -1;
+	DynFound.Clear();
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: CollectGrid
+//
+// Picks the actors the block walk would return out of the grid and sorts
+// them into the order the walk would return them in. The grid stores the
+// position and radius each actor was linked into the blockmap with, so its
+// blocks can be worked out the same way LinkToWorld does.
+//
+//===========================================================================
+
+void FBlockThingsIterator::CollectGrid(bool centeronly)
+{
+	auto &bmap = Level->blockmap;
+	const double units = FBlockmap::MAPBLOCKUNITS;
+	const int width = maxx - minx + 1;
+
+	GridModCount = Level->ActorGrid.GetModCount();
+	FoundPos = 0;
+
+	// Only blocks that exist can be visited
+	int x1 = max(minx, 0), x2 = min(maxx, bmap.bmapwidth - 1);
+	int y1 = max(miny, 0), y2 = min(maxy, bmap.bmapheight - 1);
+	if (x1 > x2 || y1 > y2) return;
+
+	// Grown a little for rounding, and by a whole block at the map's left and bottom edge where GetBlockX/Y
+	// truncate toward zero. The block test below weeds out the extra actors.
+	double left = bmap.bmaporgx + x1 * units - (x1 == 0 ? units : 1);
+	double bottom = bmap.bmaporgy + y1 * units - (y1 == 0 ? units : 1);
+	double right = bmap.bmaporgx + (x2 + 1) * units + 1;
+	double top = bmap.bmaporgy + (y2 + 1) * units + 1;
+
+	Level->ActorGrid.Collect(left, bottom, right, top, false, [&](AActor *actor, const DVector3 &bounds)
+	{
+		int bx1 = bmap.GetBlockX(bounds.X - bounds.Z);
+		int bx2 = bmap.GetBlockX(bounds.X + bounds.Z);
+		int by1 = bmap.GetBlockY(bounds.Y - bounds.Z);
+		int by2 = bmap.GetBlockY(bounds.Y + bounds.Z);
+
+		// Actors off the map are not in the blockmap
+		if (bx1 >= bmap.bmapwidth || bx2 < 0 || by1 >= bmap.bmapheight || by2 < 0) return;
+		bx1 = max(0, bx1);
+		by1 = max(0, by1);
+		bx2 = min(bmap.bmapwidth - 1, bx2);
+		by2 = min(bmap.bmapheight - 1, by2);
+
+		// The walk returns actors that are in a single block without further checks
+		const bool single = bx1 == bx2 && by1 == by2;
+		bx1 = max(bx1, x1);
+		by1 = max(by1, y1);
+		bx2 = min(bx2, x2);
+		by2 = min(by2, y2);
+		if (bx1 > bx2 || by1 > by2) return;
+
+		int order = -1;
+		if (centeronly && !single)
+		{
+			// Only returned from the block that holds its center, with the walk's boundary test
+			for (int y = by1; y <= by2 && order < 0; y++)
+			{
+				double blockbottom = (y * units) + bmap.bmaporgy;
+				if (actor->Y() < blockbottom || actor->Y() >= blockbottom + units) continue;
+				for (int x = bx1; x <= bx2; x++)
+				{
+					double blockleft = (x * units) + bmap.bmaporgx;
+					if (actor->X() >= blockleft && actor->X() < blockleft + units)
+					{
+						order = (y - miny) * width + (x - minx);
+						break;
+					}
+				}
+			}
+			if (order < 0) return;
+		}
+		else
+		{
+			order = (by1 - miny) * width + (bx1 - minx);
+		}
+
+		FGridFound found = { actor, order, actor->GridLinkSeq };
+		if (NumFound < (int)countof(FixedFound) && DynFound.Size() == 0)
+		{
+			FixedFound[NumFound] = found;
+		}
+		else
+		{
+			if (DynFound.Size() == 0)
+			{
+				DynFound.Grow(NumFound * 2);
+				for (int i = 0; i < NumFound; i++) DynFound.Push(FixedFound[i]);
+			}
+			DynFound.Push(found);
+		}
+		NumFound++;
+	});
+
+	auto data = FoundData();
+	std::sort(data, data + NumFound, [](const FGridFound &a, const FGridFound &b)
+	{
+		return a.Order != b.Order ? a.Order < b.Order : a.Seq > b.Seq;
+	});
+}
+
+//===========================================================================
+//
+// FBlockThingsIterator :: LeaveGrid
+//
+// Something was linked or unlinked while the caller went through the
+// results, so they may no longer be what the block walk would return.
+// The walk takes over in the block of the last returned actor, with
+// everything returned so far in the hash so none of it comes back.
+//
+//===========================================================================
+
+void FBlockThingsIterator::LeaveGrid()
+{
+	useGrid = false;
+	if (FoundPos <= 0)
+	{
+		StartBlock(minx, miny);
+		return;
+	}
+
+	auto data = FoundData();
+	for (int i = 0; i < FoundPos; i++)
+	{
+		if (!FindInHash(data[i].Actor)) AddToHash(data[i].Actor);
+	}
+
+	const FGridFound &last = data[FoundPos - 1];
+	const int width = maxx - minx + 1;
+	StartBlock(minx + last.Order % width, miny + last.Order / width);
+
+	// Continue behind the last actor if it is still in this block. The actors returned before it are
+	// skipped for the rest of the block either way, in case it was relinked to the head of the list.
+	int index = cury * Level->blockmap.bmapwidth + curx;
+	for (FBlockNode *node = last.Actor->BlockNode; node != nullptr; node = node->NextBlock)
+	{
+		if (node->BlockIndex == index)
+		{
+			block = node->NextActor;
+			break;
+		}
+	}
+	resumeSkip = true;
+}
+
 //===========================================================================
 //
 // FBlockThingsIterator :: SwitchBlock
@@ -962,6 +1191,8 @@ void FBlockThingsIterator::StartBlock(int x, int y)
 
 void FBlockThingsIterator::SwitchBlock(int x, int y)
 {
+	useGrid = false;
+	resumeSkip = false;
 	minx = maxx = x;
 	miny = maxy = y;
 	StartBlock(x, y);
@@ -975,16 +1206,27 @@ void FBlockThingsIterator::SwitchBlock(int x, int y)
 
 AActor *FBlockThingsIterator::Next(bool centeronly)
 {
+	if (useGrid)
+	{
+		if (FoundPos < 0) CollectGrid(centeronly);
+
+		if (Level->ActorGrid.GetModCount() == GridModCount)
+		{
+			return FoundPos < NumFound ? FoundData()[FoundPos++].Actor : nullptr;
+		}
+		LeaveGrid();
+	}
+
 	for (;;)
 	{
 		while (block != NULL)
 		{
 			AActor *me = block->Me;
 			FBlockNode *mynode = block;
-			HashEntry *entry;
-			int i;
 
 			block = block->NextActor;
+			// Returned from the grid before the walk took over in this block
+			if (resumeSkip && FindInHash(me)) continue;
 			// Don't recheck things that were already checked
 			if (mynode->NextBlock == NULL && mynode->PrevBlock == &me->BlockNode)
 			{ // This actor doesn't span blocks, so we know it can only ever be checked once.
@@ -1005,43 +1247,14 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 					return me;
 				}
 			}
-			else
-			{
-				size_t hash = ((size_t)me >> 3) % countof(Buckets);
-				for (i = Buckets[hash]; i >= 0; )
-				{
-					entry = GetHashEntry(i);
-					if (entry->Actor == me)
-					{ // I've already been checked. Skip to the next actor.
-						break;
-					}
-					i = entry->Next;
-				}
-				if (i < 0)
-				{ // Add me to the hash table and return me.
-					if (NumFixedHash < (int)countof(FixedHash))
-					{
-						entry = &FixedHash[NumFixedHash];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = NumFixedHash++;
-					}
-					else
-					{
-						if (DynHash.Size() == 0)
-						{
-							DynHash.Grow(50);
-						}
-						i = DynHash.Reserve(1);
-						entry = &DynHash[i];
-						entry->Next = Buckets[hash];
-						Buckets[hash] = i + countof(FixedHash);
-					}
-					entry->Actor = me;
-					return me;
-				}
+			else if (!FindInHash(me))
+			{ // Add me to the hash table and return me.
+				AddToHash(me);
+				return me;
 			}
 		}
 
+		resumeSkip = false;
 		if (++curx > maxx)
 		{
 			curx = minx;
@@ -1162,7 +1375,38 @@ void FMultiBlockThingsIterator::Reset()
 //
 //===========================================================================
 
-TArray<intercept_t> FPathTraverse::intercepts(128);
+FTraverseContext &FTraverseContext::Get()
+{
+	static thread_local FTraverseContext context;
+	return context;
+}
+
+FValidContext &FValidContext::Get()
+{
+	static thread_local FValidContext context;
+	return context;
+}
+
+void FValidContext::NewPass(FLevelLocals *l)
+{
+	if (l != Level || lineStamps.Size() != l->lines.Size() || polyStamps.Size() != l->Polyobjects.Size() || ++stamp == INT_MAX)
+	{
+		Level = l;
+		lineStamps.Resize(l->lines.Size());
+		polyStamps.Resize(l->Polyobjects.Size());
+		memset(lineStamps.Data(), 0, lineStamps.Size() * sizeof(int));
+		memset(polyStamps.Data(), 0, polyStamps.Size() * sizeof(int));
+		stamp = 1;
+	}
+}
+
+bool FValidContext::MarkPoly(const FPolyObj *poly)
+{
+	int &mark = polyStamps[int(poly - Level->Polyobjects.Data())];
+	if (mark == stamp) return false;
+	mark = stamp;
+	return true;
+}
 
 
 //===========================================================================
@@ -1177,36 +1421,54 @@ TArray<intercept_t> FPathTraverse::intercepts(128);
 //
 //===========================================================================
 
-void FPathTraverse::AddLineIntercepts(int bx, int by)
+void FPathTraverse::AddLineIntercept(line_t *ld)
 {
-	FBlockLinesIterator it(Level, bx, by, bx, by, true);
-	line_t *ld;
+	int 				s1;
+	int 				s2;
+	double 				frac;
+	divline_t			dl;
 
-	while ((ld = it.Next()))
-	{
-		int 				s1;
-		int 				s2;
-		double 				frac;
-		divline_t			dl;
+	s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
+	s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
+	
+	if (s1 == s2) return;	// line isn't crossed
+	
+	// hit the line
+	P_MakeDivline (ld, &dl);
+	frac = P_InterceptVector (&trace, &dl);
 
-		s1 = P_PointOnDivlineSide (ld->v1->fX(), ld->v1->fY(), &trace);
-		s2 = P_PointOnDivlineSide (ld->v2->fX(), ld->v2->fY(), &trace);
-		
-		if (s1 == s2) continue;	// line isn't crossed
+	if (frac < Startfrac || frac > 1.) return;	// behind source or beyond end point
 		
-		// hit the line
-		P_MakeDivline (ld, &dl);
-		frac = P_InterceptVector (&trace, &dl);
+	intercept_t newintercept;
 
-		if (frac < Startfrac || frac > 1.) continue;	// behind source or beyond end point
-			
-		intercept_t newintercept;
+	newintercept.frac = frac;
+	newintercept.isaline = true;
+	newintercept.done = false;
+	newintercept.d.line = ld;
+	intercepts.Push (newintercept);
+}
+
+// @Cockatrice - Same order as FBlockLinesIterator (polyobjects first, then the block's lines),
+// but marked in the traverse context instead of with the global validcount.
+void FPathTraverse::AddLineIntercepts(int bx, int by)
+{
+	if (!Level->blockmap.isValidBlock(bx, by)) return;
+
+	unsigned offset = by * Level->blockmap.bmapwidth + bx;
+	for (auto link = Level->PolyBlockMap.Size() > offset ? Level->PolyBlockMap[offset] : nullptr; link != nullptr; link = link->next)
+	{
+		if (link->polyobj == nullptr || !valid.MarkPoly(link->polyobj)) continue;
 
-		newintercept.frac = frac;
-		newintercept.isaline = true;
-		newintercept.done = false;
-		newintercept.d.line = ld;
-		intercepts.Push (newintercept);
+		for (auto ld : link->polyobj->Linedefs)
+		{
+			if (valid.MarkLine(ld)) AddLineIntercept(ld);
+		}
+	}
+
+	for (int *list = Level->blockmap.GetLines(bx, by); *list != -1; list++)
+	{
+		line_t *ld = &Level->lines[*list];
+		if (valid.MarkLine(ld)) AddLineIntercept(ld);
 	}
 }
 
@@ -1459,7 +1721,7 @@ void FPathTraverse::init(double x1, double y1, double x2, double y2, int flags,
 		flags |= PT_DELTA;
 	}
 
-	validcount++;
+	valid.NewPass(Level);
 	intercept_index = intercepts.Size();
 	Startfrac = startfrac;
 
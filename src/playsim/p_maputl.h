@@ -10,6 +10,7 @@
 
 extern int validcount;
 struct FBlockNode;
+struct FPolyObj;
 
 struct divline_t
 {
@@ -306,7 +307,31 @@ class FBlockThingsIterator
 
 	HashEntry *GetHashEntry(int i) { return i < (int)countof(FixedHash) ? &FixedHash[i] : &DynHash[i - countof(FixedHash)]; }
 
+	bool FindInHash(AActor *me);
+	void AddToHash(AActor *me);
+
+	// @Cockatrice - Results gathered from the level's actor grid, which replaces the block walk when available.
+	// They are sorted into the order the block walk would return them in: by the first block in which the walk
+	// reports the actor, then newest link first, as the blocks' node lists are.
+	struct FGridFound
+	{
+		AActor *Actor;
+		int Order;		// visiting order of the block
+		uint64_t Seq;
+	};
+	bool useGrid = false;
+	bool resumeSkip = false;
+	int NumFound = 0, FoundPos = 0;
+	unsigned GridModCount = 0;
+	FGridFound FixedFound[32];
+	TArray<FGridFound> DynFound;
+
+	FGridFound *FoundData() { return DynFound.Size() > 0 ? DynFound.Data() : FixedFound; }
+
 	void StartBlock(int x, int y);
+	void StartGrid();
+	void CollectGrid(bool centeronly);
+	void LeaveGrid();
 	void SwitchBlock(int x, int y);
 	void ClearHash();
 
@@ -326,7 +351,7 @@ public:
 	}
 	void init(const FBoundingBox &box, bool clearhash = true);
 	AActor *Next(bool centeronly = false);
-	void Reset() { StartBlock(minx, miny); }
+	void Reset();
 };
 
 class FMultiBlockThingsIterator
@@ -364,10 +389,48 @@ public:
 
 
 
+// @Cockatrice - Per-thread stand-in for the global validcount
+// Path traversals and sight checks mark lines and polyobjects with a stamp private to the thread,
+// so they can run on worker threads without touching shared data. Both share the one context of their
+// thread, just like they used to share validcount, and start a pass before collecting any lines.
+// NewPass is also the only place the stamps are reset, when the level or its line count changes.
+struct FValidContext
+{
+	TArray<int> lineStamps, polyStamps;
+	int stamp = 0;
+	FLevelLocals *Level = nullptr;
+
+	void NewPass(FLevelLocals *l);
+
+	// Returns false if the line was already checked in this pass
+	bool MarkLine(const line_t *ld)
+	{
+		int &mark = lineStamps[ld->Index()];
+		if (mark == stamp) return false;
+		mark = stamp;
+		return true;
+	}
+
+	bool MarkPoly(const FPolyObj *poly);
+
+	static FValidContext &Get();
+};
+
+// @Cockatrice - Per-thread intercept stack of FPathTraverse
+struct FTraverseContext
+{
+	TArray<intercept_t> intercepts;
+
+	FTraverseContext() : intercepts(128) {}
+
+	static FTraverseContext &Get();
+};
+
 class FPathTraverse
 {
 protected:
-	static TArray<intercept_t> intercepts;
+	FValidContext &valid;
+	TArray<intercept_t> &intercepts;
 
 	FLevelLocals *Level;
 	divline_t trace;
@@ -376,9 +439,10 @@ protected:
 	unsigned int intercept_count;
 	unsigned int count;
 
+	void AddLineIntercept(line_t *ld);
 	virtual void AddLineIntercepts(int bx, int by);
 	virtual void AddThingIntercepts(int bx, int by, FBlockThingsIterator &it, bool compatible);
-	FPathTraverse(FLevelLocals *l) 
+	FPathTraverse(FLevelLocals *l) : valid(FValidContext::Get()), intercepts(FTraverseContext::Get().intercepts)
 	{
 		Level = l;
 	}
@@ -387,6 +451,7 @@ public:
 	intercept_t *Next();
 
 	FPathTraverse(FLevelLocals *l, double x1, double y1, double x2, double y2, int flags, double startfrac = 0)
+		: valid(FValidContext::Get()), intercepts(FTraverseContext::Get().intercepts)
 	{
 		Level = l;
 		init(x1, y1, x2, y2, flags, startfrac);
@@ -0,0 +1,81 @@
+/*
+** p_parallel.cpp
+** @Cockatrice - Worker pool for the parallel phases of the playsim tick
+**
+*/
+
+#include <thread>
+#include <future>
+#include <vector>
+#include <memory>
+
+#include "p_parallel.h"
+#include "ctpl.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "basics.h"
+
+CVAR(Bool, sim_parallel, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+static std::unique_ptr<ctpl::thread_pool> SimPool;
+
+static ctpl::thread_pool *GetSimPool()
+{
+	if (SimPool == nullptr)
+	{
+		// Leave a core for the game thread, which always takes a share of the work itself
+		int threads = clamp((int)std::thread::hardware_concurrency() - 1, 1, 8);
+		SimPool.reset(new ctpl::thread_pool(threads));
+	}
+	return SimPool.get();
+}
+
+int P_ParallelWorkers()
+{
+	return sim_parallel ? GetSimPool()->size() : 0;
+}
+
+void P_ParallelFor(int count, int minBatch, const std::function<void(int start, int end)> &func)
+{
+	if (count <= 0) return;
+
+	int batches = 1;
+	if (sim_parallel && count >= minBatch * 2)
+	{
+		batches = min(count / max(minBatch, 1), GetSimPool()->size() + 1);
+	}
+
+	if (batches <= 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	std::vector<std::future<void>> pending;
+	pending.reserve(batches - 1);
+
+	auto batchStart = [=](int batch) { return (int)((int64_t)count * batch / batches); };
+
+	for (int b = 1; b < batches; b++)
+	{
+		int start = batchStart(b), end = batchStart(b + 1);
+		pending.push_back(SimPool->push([&func, start, end](int) { func(start, end); }));
+	}
+
+	func(0, batchStart(1));
+
+	// get() rethrows anything a worker ran into, after all of them are done with the shared data
+	std::exception_ptr error;
+	for (auto &f : pending)
+	{
+		try { f.get(); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+CCMD(sim_parallelinfo)
+{
+	Printf("Parallel tick phase: %s, %d worker threads\n", sim_parallel ? "enabled" : "disabled", P_ParallelWorkers());
+}
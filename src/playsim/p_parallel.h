@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+
+// @Cockatrice - Worker pool for the parallel parts of the playsim tick.
+// Work is split into contiguous index ranges. The game thread runs the first range itself and
+// waits until every other range is done, so the call behaves like a plain loop to the caller.
+// Code run through this may only write to the items of its own range and read shared level data.
+// Results must not depend on the order the ranges run in, which keeps playback and demos in sync.
+
+// Calls func(start, end) over [0, count), split into ranges of at least minBatch items.
+// Runs everything inline when sim_parallel is off or there is too little work.
+void P_ParallelFor(int count, int minBatch, const std::function<void(int start, int end)> &func);
+
+int P_ParallelWorkers();
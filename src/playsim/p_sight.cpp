@@ -21,6 +21,8 @@
 //-----------------------------------------------------------------------------
 //
 #include <assert.h>
+#include <atomic>
+#include <functional>
 
 #include "doomdef.h"
 
@@ -36,6 +38,10 @@
 
 #include "g_levellocals.h"
 #include "actorinlines.h"
+#include "p_parallel.h"
+#include "c_dispatch.h"
+#include "i_time.h"
+#include "doomstat.h"
 
 static FRandom pr_botchecksight ("BotCheckSight");
 static FRandom pr_checksight ("CheckSight");
@@ -51,7 +57,7 @@ This uses specialized forms of the maputils routines for optimized performance
 */
 
 // Performance meters
-static int sightcounts[6];
+static std::atomic<int> sightcounts[6];
 static cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
@@ -87,12 +93,34 @@ struct SightTask
 };
 
 
-static TArray<intercept_t> intercepts (128);
-static TArray<SightTask> portals(32);
+// @Cockatrice - Per-thread state of the sight checker
+// Lines and polyobjects are marked through the thread's FValidContext, which it shares with FPathTraverse,
+// so sight checks can run on several threads at once.
+struct FSightContext
+{
+	TArray<intercept_t> intercepts;
+	TArray<SightTask> portals;
+	FValidContext &valid;
+	int counts[6] = {};
+
+	FSightContext() : intercepts(128), portals(32), valid(FValidContext::Get()) {}
+
+	void FlushCounts()
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (counts[i] != 0) sightcounts[i].fetch_add(counts[i], std::memory_order_relaxed);
+			counts[i] = 0;
+		}
+	}
+};
+
+static thread_local FSightContext SightContext;
 
 class SightCheck
 {
 	FLevelLocals *Level;
+	FSightContext &ctx;
 	DVector3 sightstart;
 	DVector2 sightend;
 	double Startfrac;
@@ -117,7 +145,7 @@ class SightCheck
 	bool LineBlocksSight(line_t *ld);
 
 public:
-	SightCheck(FLevelLocals *l)
+	SightCheck(FLevelLocals *l, FSightContext &c) : ctx(c)
 	{
 		Level = l;
 	}
@@ -279,16 +307,16 @@ bool SightCheck::PTR_SightTraverse (intercept_t *in)
 
 		if (portaldir != sector_t::floor && (open.portalflags & SO_TOPBACK) && !(open.portalflags & SO_TOPFRONT))
 		{
-			portals.Push({ in->frac, topslope, bottomslope, sector_t::ceiling, backsec->GetOppositePortalGroup(sector_t::ceiling) });
+			ctx.portals.Push({ in->frac, topslope, bottomslope, sector_t::ceiling, backsec->GetOppositePortalGroup(sector_t::ceiling) });
 		}
 		if (portaldir != sector_t::ceiling && (open.portalflags & SO_BOTTOMBACK) && !(open.portalflags & SO_BOTTOMFRONT))
 		{
-			portals.Push({ in->frac, topslope, bottomslope, sector_t::floor, backsec->GetOppositePortalGroup(sector_t::floor) });
+			ctx.portals.Push({ in->frac, topslope, bottomslope, sector_t::floor, backsec->GetOppositePortalGroup(sector_t::floor) });
 		}
 	}
 	if (lport != nullptr && lport->mDestination != nullptr)
 	{
-		portals.Push({ in->frac, topslope, bottomslope, portaldir, lport->mDestination->frontsector->PortalGroup });
+		ctx.portals.Push({ in->frac, topslope, bottomslope, portaldir, lport->mDestination->frontsector->PortalGroup });
 		return false;
 	}
 
@@ -441,11 +469,10 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	if (!ctx.valid.MarkLine(ld))
 	{
 		return true;
 	}
-	ld->validcount = validcount;
 	if (P_PointOnDivlineSide (ld->v1->fPos(), &Trace) ==
 		P_PointOnDivlineSide (ld->v2->fPos(), &Trace))
 	{
@@ -463,12 +490,12 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		if (LineBlocksSight(ld)) return false;
 	}
 
-	sightcounts[3]++;
+	ctx.counts[3]++;
 	// store the line for later intersection testing
 	intercept_t newintercept;
 	newintercept.isaline = true;
 	newintercept.d.line = ld;
-	intercepts.Push (newintercept);
+	ctx.intercepts.Push (newintercept);
 
 	return true;
 }
@@ -502,9 +529,8 @@ int SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			if (ctx.valid.MarkPoly(polyLink->polyobj))
 			{
-				polyLink->polyobj->validcount = validcount;
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine(polyLink->polyobj->Linedefs[i]))
@@ -547,6 +573,7 @@ bool SightCheck::P_SightTraverseIntercepts ()
 	unsigned scanpos;
 	divline_t dl;
 
+	TArray<intercept_t> &intercepts = ctx.intercepts;
 	count = intercepts.Size ();
 //
 // calculate intercept distance
@@ -634,8 +661,8 @@ bool SightCheck::P_SightPathTraverse ()
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
-	intercepts.Clear ();
+	ctx.valid.NewPass(Level);
+	ctx.intercepts.Clear ();
 	x1 = sightstart.X + Startfrac * Trace.dx;
 	y1 = sightstart.Y + Startfrac * Trace.dy;
 	x2 = sightend.X;
@@ -667,11 +694,11 @@ bool SightCheck::P_SightPathTraverse ()
 	// We also must check if the starting sector contains  portals, and start sight checks in those as well.
 	if (portaldir != sector_t::floor && checkceiling && !lastsector->PortalBlocksSight(sector_t::ceiling))
 	{
-		portals.Push({ 0, topslope, bottomslope, sector_t::ceiling, lastsector->GetOppositePortalGroup(sector_t::ceiling) });
+		ctx.portals.Push({ 0, topslope, bottomslope, sector_t::ceiling, lastsector->GetOppositePortalGroup(sector_t::ceiling) });
 	}
 	if (portaldir != sector_t::ceiling && checkfloor && !lastsector->PortalBlocksSight(sector_t::floor))
 	{
-		portals.Push({ 0, topslope, bottomslope, sector_t::floor, lastsector->GetOppositePortalGroup(sector_t::floor) });
+		ctx.portals.Push({ 0, topslope, bottomslope, sector_t::floor, lastsector->GetOppositePortalGroup(sector_t::floor) });
 	}
 
 	x1 -= Level->blockmap.bmaporgx;
@@ -767,7 +794,7 @@ bool SightCheck::P_SightPathTraverse ()
 		itres = P_SightBlockLinesIterator(mapx, mapy);
 		if (itres == 0)
 		{
-			sightcounts[1]++;
+			ctx.counts[1]++;
 			return false;	// early out
 		}
 
@@ -778,7 +805,7 @@ bool SightCheck::P_SightPathTraverse ()
 		switch (((xs_FloorToInt(yintercept) == mapy) << 1) | (xs_FloorToInt(xintercept) == mapx))
 		{
 		case 0:		// neither xintercept nor yintercept match!
-sightcounts[5]++;
+ctx.counts[5]++;
 			// Continuing won't make things any better, so we might as well stop right here
 			return false;
 
@@ -797,7 +824,7 @@ sightcounts[5]++;
 			break;
 
 		case 3:		// xintercept and yintercept both match
-			sightcounts[4]++;
+			ctx.counts[4]++;
 			// The trace is exiting a block through its corner. Not only does the block
 			// being entered need to be checked (which will happen when this loop
 			// continues), but the other two blocks adjacent to the corner also need to
@@ -805,7 +832,7 @@ sightcounts[5]++;
 			if (!P_SightBlockLinesIterator (mapx + mapxstep, mapy) ||
 				!P_SightBlockLinesIterator (mapx, mapy + mapystep))
 			{
-sightcounts[1]++;
+ctx.counts[1]++;
 				return false;
 			}
 			xintercept += xstep;
@@ -824,7 +851,7 @@ sightcounts[1]++;
 //
 // couldn't early out, so go through the sorted list
 //
-sightcounts[2]++;
+ctx.counts[2]++;
 
 	bool traverseres = P_SightTraverseIntercepts ( );
 	if (itres == -1) return false;	// if the iterator had an early out there was no line of sight. The traverser was only called to collect more portals.
@@ -845,17 +872,18 @@ sightcounts[2]++;
 =====================
 */
 
-int P_CheckSight (AActor *t1, AActor *t2, int flags)
-{
-	SightCycles.Clock();
-
-	bool res;
-
-	if (t1 == nullptr || t2 == nullptr)
-	{
-		return false;
-	}
+//==========================================================================
+//
+// P_SightPrecheck
+//
+// @Cockatrice - Everything in the sight check before the trace, including
+// the random chance to see invisible things. Must run on the game thread.
+// Returns 0 or 1 for a decided check and -1 if a trace is needed.
+//
+//==========================================================================
 
+static int P_SightPrecheck (AActor *t1, AActor *t2, int flags, FSightContext &ctx)
+{
 	if ((t2->flags9 & MF9_MVISBLOCKED) && !(flags & SF_IGNOREVISIBILITY))
 	{
 		return false;
@@ -868,9 +896,8 @@ int P_CheckSight (AActor *t1, AActor *t2, int flags)
 	//
 	if (!t1->Level->CheckReject(s1, s2))
 	{
-sightcounts[0]++;
-		res = false;			// can't possibly be connected
-		goto done;
+ctx.counts[0]++;
+		return false;			// can't possibly be connected
 	}
 
 //
@@ -885,8 +912,7 @@ sightcounts[0]++;
 	{ // small chance of an attack being made anyway
 		if ((t1->Level->BotInfo.m_Thinking ? pr_botchecksight() : pr_checksight()) > 50)
 		{
-			res = false;
-			goto done;
+			return false;
 		}
 	}
 
@@ -906,56 +932,207 @@ sightcounts[0]++;
 			  (t2->Z() >= s2->heightsec->ceilingplane.ZatPoint(t2) &&
 			   t1->Top() <= s2->heightsec->ceilingplane.ZatPoint(t1)))))
 		{
-			res = false;
-			goto done;
+			return false;
 		}
 	}
+	return -1;
+}
+
+//==========================================================================
+//
+// P_SightTrace
+//
+// @Cockatrice - The trace part of the sight check. Only reads level data,
+// so it may run on any thread with that thread's context.
+//
+//==========================================================================
 
+static bool P_SightTrace (AActor *t1, AActor *t2, int flags, FSightContext &ctx)
+{
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 
-	validcount++;
-	portals.Clear();
-	{
-		sector_t *sec;
-		double lookheight = t1->Z() + t1->Height*0.75;
-		t1->GetPortalTransition(lookheight, &sec);
+	ctx.portals.Clear();
+
+	sector_t *sec;
+	double lookheight = t1->Z() + t1->Height*0.75;
+	t1->GetPortalTransition(lookheight, &sec);
 
-		double bottomslope = t2->Z() - lookheight;
-		double topslope = bottomslope + t2->Height;
-		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
+	double bottomslope = t2->Z() - lookheight;
+	double topslope = bottomslope + t2->Height;
+	SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
 
 
-		SightCheck s(t1->Level);
-		s.init(t1, t2, sec, &task, flags);
-		res = s.P_SightPathTraverse ();
-		if (!res)
+	SightCheck s(t1->Level, ctx);
+	s.init(t1, t2, sec, &task, flags);
+	bool res = s.P_SightPathTraverse ();
+	if (!res)
+	{
+		double dist = t1->Distance2D(t2);
+		for (unsigned i = 0; i < ctx.portals.Size(); i++)
 		{
-			double dist = t1->Distance2D(t2);
-			for (unsigned i = 0; i < portals.Size(); i++)
+			ctx.portals[i].Frac += 1 / dist;
+			s.init(t1, t2, NULL, &ctx.portals[i], flags);
+			if (s.P_SightPathTraverse())
 			{
-				portals[i].Frac += 1 / dist;
-				s.init(t1, t2, NULL, &portals[i], flags);
-				if (s.P_SightPathTraverse())
-				{
-					res = true;
-					break;
-				}
+				return true;
 			}
 		}
 	}
+	return res;
+}
+
+/*
+=====================
+=
+= P_CheckSight
+=
+= Returns true if a straight line between t1 and t2 is unobstructed
+= look from eyes of t1 to any part of t2
+=
+= killough 4/20/98: cleaned up, made to use new LOS struct
+=
+=====================
+*/
+
+int P_CheckSight (AActor *t1, AActor *t2, int flags)
+{
+	if (t1 == nullptr || t2 == nullptr)
+	{
+		return false;
+	}
+
+	SightCycles.Clock();
+
+	auto &ctx = SightContext;
+	int res = P_SightPrecheck(t1, t2, flags, ctx);
+	if (res < 0) res = P_SightTrace(t1, t2, flags, ctx);
+	ctx.FlushCounts();
 
-done:
 	SightCycles.Unclock();
 	return res;
 }
 
+//==========================================================================
+//
+// P_CheckSightBatch
+//
+// @Cockatrice - Checks many looker/target pairs in one call. The prechecks
+// run first, in order, on the calling thread so the random rolls for
+// invisible things happen exactly as with single checks. The remaining
+// traces are spread over the playsim worker pool.
+// results receives 0 or 1 per pair, returns the number of visible pairs.
+//
+//==========================================================================
+
+static int P_CheckSightPairs (int count, int flags, uint8_t *results, const std::function<void(int, AActor *&, AActor *&)> &getpair)
+{
+	if (count <= 0) return 0;
+
+	SightCycles.Clock();
+
+	// Local so that nested or concurrent batches each get their own list
+	TArray<int> traces;
+
+	auto &ctx = SightContext;
+	for (int i = 0; i < count; i++)
+	{
+		AActor *t1, *t2;
+		getpair(i, t1, t2);
+		int res = (t1 == nullptr || t2 == nullptr) ? 0 : P_SightPrecheck(t1, t2, flags, ctx);
+		results[i] = res > 0;
+		if (res < 0) traces.Push(i);
+	}
+	ctx.FlushCounts();
+
+	P_ParallelFor(traces.Size(), 8, [&](int start, int end)
+	{
+		auto &tctx = SightContext;
+		for (int j = start; j < end; j++)
+		{
+			AActor *t1, *t2;
+			getpair(traces[j], t1, t2);
+			results[traces[j]] = P_SightTrace(t1, t2, flags, tctx);
+		}
+		tctx.FlushCounts();
+	});
+
+	int visible = 0;
+	for (int i = 0; i < count; i++) visible += results[i];
+
+	SightCycles.Unclock();
+	return visible;
+}
+
+int P_CheckSightBatch (AActor *looker, AActor *const *targets, int count, int flags, uint8_t *results)
+{
+	return P_CheckSightPairs(count, flags, results, [=](int i, AActor *&t1, AActor *&t2) { t1 = looker; t2 = targets[i]; });
+}
+
+int P_CheckSightBatch (AActor *const *lookers, int count, AActor *target, int flags, uint8_t *results)
+{
+	return P_CheckSightPairs(count, flags, results, [=](int i, AActor *&t1, AActor *&t2) { t1 = lookers[i]; t2 = target; });
+}
+
+//==========================================================================
+//
+// Compares single and batched checks of every monster against the player
+//
+//==========================================================================
+
+CCMD(bench_sight)
+{
+	if (gamestate != GS_LEVEL || primaryLevel->Players[consoleplayer]->mo == nullptr)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+
+	int rounds = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000) : 100;
+	AActor *player = primaryLevel->Players[consoleplayer]->mo;
+
+	TArray<AActor *> lookers;
+	auto it = primaryLevel->GetThinkerIterator<AActor>();
+	while (auto mo = it.Next())
+	{
+		if ((mo->flags3 & MF3_ISMONSTER) && mo != player) lookers.Push(mo);
+	}
+	if (lookers.Size() == 0)
+	{
+		Printf("No monsters on this map\n");
+		return;
+	}
+
+	TArray<uint8_t> results(lookers.Size(), true);
+	int seen[2] = {};
+	uint64_t time[2] = {};
+
+	uint64_t start = I_nsTime();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (auto mo : lookers) seen[0] += P_CheckSight(mo, player, SF_IGNOREVISIBILITY);
+	}
+	time[0] = I_nsTime() - start;
+
+	start = I_nsTime();
+	for (int r = 0; r < rounds; r++)
+	{
+		seen[1] += P_CheckSightBatch(lookers.Data(), lookers.Size(), player, SF_IGNOREVISIBILITY, results.Data());
+	}
+	time[1] = I_nsTime() - start;
+
+	Printf("%u monsters, %d rounds, %d worker threads\n", lookers.Size(), rounds, P_ParallelWorkers());
+	Printf("  single: %8.3f ms, %d visible\n", time[0] * 1e-6, seen[0] / rounds);
+	Printf("  batch:  %8.3f ms, %d visible\n", time[1] * 1e-6, seen[1] / rounds);
+	if (seen[0] != seen[1]) Printf(TEXTCOLOR_RED "Results differ\n");
+}
+
 ADD_STAT (sight)
 {
 	FString out;
 	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3].load(), sightcounts[0].load(), sightcounts[1].load(), sightcounts[2].load(), sightcounts[4].load(), sightcounts[5].load());
 	return out;
 }
 
@@ -970,5 +1147,5 @@ void P_ResetSightCounters (bool full)
 		MaxSightCycles = SightCycles;
 	}
 	SightCycles.Reset();
-	memset (sightcounts, 0, sizeof(sightcounts));
+	for (auto &count : sightcounts) count = 0;
 }
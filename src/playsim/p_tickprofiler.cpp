@@ -0,0 +1,256 @@
+/*
+** p_tickprofiler.cpp
+** @Cockatrice - Per-class tick profiler with a ring buffer of recent tics
+**
+** Timings are gathered into flat arrays indexed by a slot stored on the class,
+** so the cost while ticking is one timestamp and two array adds per thinker.
+** At the end of a tic only the classes that actually ran are copied into
+** the history, which can be exported as CSV or as a Chrome trace
+** (chrome://tracing, Perfetto) to inspect a spike after it happened.
+**
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "p_tickprofiler.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include "v_text.h"
+#include "doomstat.h"
+
+CVAR(Bool, sim_tickprofile, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+FTickProfiler TickProfiler;
+
+static const char *PseudoSlotNames[] = { "(parallel phase)", "InternalDynamicLight", "(sleeper wheel)" };
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTickProfiler::GrowSlots()
+{
+	if (slotNames.Size() == 0)
+	{
+		for (auto name : PseudoSlotNames)
+		{
+			slotsByName.Insert(name, slotNames.Push(name));
+		}
+	}
+
+	unsigned old = curTime.Size();
+	curTime.Resize(slotNames.Size());
+	curCalls.Resize(slotNames.Size());
+	for (unsigned i = old; i < curTime.Size(); i++)
+	{
+		curTime[i] = 0;
+		curCalls[i] = 0;
+	}
+}
+
+int FTickProfiler::AssignSlot(PClass *cls)
+{
+	// Classes are recreated on restart, so look the name up before handing out a new slot
+	int *existing = slotsByName.CheckKey(cls->TypeName);
+	if (existing != nullptr)
+	{
+		cls->ProfilerSlot = *existing;
+	}
+	else
+	{
+		cls->ProfilerSlot = slotNames.Push(cls->TypeName);
+		slotsByName.Insert(cls->TypeName, cls->ProfilerSlot);
+		GrowSlots();
+	}
+	return cls->ProfilerSlot;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTickProfiler::BeginTic(int tic)
+{
+	active = sim_tickprofile || captureNext;
+	if (!active) return;
+
+	if (slotNames.Size() == 0) GrowSlots();
+
+	curTic = tic;
+	memset(curStat, 0, sizeof(curStat));
+	ticStart = Stamp();
+	if (count == 0) firstStart = ticStart;
+}
+
+void FTickProfiler::EndTic()
+{
+	if (!active) return;
+
+	auto &frame = history[head];
+	frame.tic = curTic;
+	frame.startMS = StampToMS(ticStart - firstStart);
+	frame.totalMS = (float)StampToMS(Stamp() - ticStart);
+	for (int i = 0; i <= MAX_STATNUM; i++)
+	{
+		frame.statMS[i] = (float)StampToMS(curStat[i]);
+	}
+
+	frame.classes.Clear();
+	for (int slot : touched)
+	{
+		frame.classes.Push({ slot, curCalls[slot], (float)StampToMS(curTime[slot]) });
+		curCalls[slot] = 0;
+		curTime[slot] = 0;
+	}
+	touched.Clear();
+
+	head = (head + 1) % HISTORY;
+	if (count < HISTORY) count++;
+	active = captureNext = false;
+}
+
+const FTickProfileFrame *FTickProfiler::GetFrame(int age) const
+{
+	if (age < 0 || age >= count) return nullptr;
+	return &history[(head - 1 - age + HISTORY) % HISTORY];
+}
+
+void FTickProfiler::Clear()
+{
+	head = count = 0;
+}
+
+//==========================================================================
+//
+// Export
+//
+//==========================================================================
+
+bool FTickProfiler::ExportCSV(const char *filename) const
+{
+	FILE *f = fopen(filename, "w");
+	if (f == nullptr) return false;
+
+	fprintf(f, "tic,start_ms,category,name,calls,ms\n");
+	for (int age = count - 1; age >= 0; age--)
+	{
+		auto frame = GetFrame(age);
+		fprintf(f, "%d,%.4f,tic,total,,%.4f\n", frame->tic, frame->startMS, frame->totalMS);
+		for (int i = 0; i <= MAX_STATNUM; i++)
+		{
+			if (frame->statMS[i] > 0) fprintf(f, "%d,%.4f,statnum,%d,,%.4f\n", frame->tic, frame->startMS, i, frame->statMS[i]);
+		}
+		for (auto &entry : frame->classes)
+		{
+			fprintf(f, "%d,%.4f,class,%s,%d,%.4f\n", frame->tic, frame->startMS, SlotName(entry.slot), entry.calls, entry.ms);
+		}
+	}
+	return fclose(f) == 0;
+}
+
+bool FTickProfiler::ExportTrace(const char *filename) const
+{
+	FILE *f = fopen(filename, "w");
+	if (f == nullptr) return false;
+
+	// Times are in microseconds. Statnums and classes are aggregated per tic, so their slices are
+	// laid out back to back from the start of the tic, the longest first, rather than at the time they ran.
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Tics\"}},\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"Statnums\"}},\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"Classes\"}}");
+
+	TArray<FTickProfileEntry> sorted;
+	for (int age = count - 1; age >= 0; age--)
+	{
+		auto frame = GetFrame(age);
+		double ts = frame->startMS * 1000.;
+		fprintf(f, ",\n{\"name\":\"Tic %d\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", frame->tic, ts, frame->totalMS * 1000.);
+
+		double pos = ts;
+		for (int i = 0; i <= MAX_STATNUM; i++)
+		{
+			if (frame->statMS[i] <= 0) continue;
+			fprintf(f, ",\n{\"name\":\"Statnum %d\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}", i, pos, frame->statMS[i] * 1000.);
+			pos += frame->statMS[i] * 1000.;
+		}
+
+		sorted = frame->classes;
+		std::sort(sorted.begin(), sorted.end(), [](const FTickProfileEntry &a, const FTickProfileEntry &b) { return a.ms > b.ms; });
+		pos = ts;
+		for (auto &entry : sorted)
+		{
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"calls\":%d}}",
+				SlotName(entry.slot), pos, entry.ms * 1000., entry.calls);
+			pos += entry.ms * 1000.;
+		}
+	}
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
+
+//==========================================================================
+//
+// Console commands
+//
+//==========================================================================
+
+CCMD(tickprofile_export)
+{
+	if (TickProfiler.NumFrames() == 0)
+	{
+		Printf("No tics recorded%s\n", sim_tickprofile ? "" : ", set sim_tickprofile to true to start recording");
+		return;
+	}
+
+	FString filename = argv.argc() > 1 ? argv[1] : "tickprofile.json";
+	bool csv = filename.Len() > 4 && !stricmp(filename.GetChars() + filename.Len() - 4, ".csv");
+	bool ok = csv ? TickProfiler.ExportCSV(filename.GetChars()) : TickProfiler.ExportTrace(filename.GetChars());
+
+	if (ok) Printf("Wrote %d tics to %s\n", TickProfiler.NumFrames(), filename.GetChars());
+	else Printf(TEXTCOLOR_RED "Could not write %s\n", filename.GetChars());
+}
+
+CCMD(tickprofile_clear)
+{
+	TickProfiler.Clear();
+}
+
+// Shows the slowest of the recorded tics and the classes that took the most time in it
+CCMD(tickprofile)
+{
+	int tics = TickProfiler.NumFrames();
+	if (argv.argc() > 1) tics = min(tics, max(atoi(argv[1]), 1));
+	const FTickProfileFrame *worst = nullptr;
+	double total = 0;
+
+	for (int age = 0; age < tics; age++)
+	{
+		auto frame = TickProfiler.GetFrame(age);
+		total += frame->totalMS;
+		if (worst == nullptr || frame->totalMS > worst->totalMS) worst = frame;
+	}
+
+	if (worst == nullptr)
+	{
+		Printf("No tics recorded%s\n", sim_tickprofile ? "" : ", set sim_tickprofile to true to start recording");
+		return;
+	}
+
+	Printf("Last %d tics: average %.3f ms, slowest tic %d at %.3f ms\n", tics, total / tics, worst->tic, worst->totalMS);
+
+	TArray<FTickProfileEntry> sorted = worst->classes;
+	std::sort(sorted.begin(), sorted.end(), [](const FTickProfileEntry &a, const FTickProfileEntry &b) { return a.ms > b.ms; });
+
+	Printf(TEXTCOLOR_YELLOW "Total, ms   Calls   Class\n");
+	for (unsigned i = 0; i < min(sorted.Size(), 10u); i++)
+	{
+		Printf("%10.6f  %6d  %s\n", sorted[i].ms, sorted[i].calls, TickProfiler.SlotName(sorted[i].slot));
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include "tarray.h"
+#include "name.h"
+#include "stats.h"
+#include "i_time.h"
+#include "dthinker.h"
+
+// @Cockatrice - Low overhead per-class tick profiler
+// Thinker time is accumulated into arrays indexed by a per-class slot, with one timestamp per ticked thinker.
+// The last HISTORY tics are kept in a ring buffer so a single spike can be inspected or exported after the fact.
+
+struct FTickProfileEntry
+{
+	int slot;
+	int calls;
+	float ms;
+};
+
+struct FTickProfileFrame
+{
+	int tic = 0;
+	double startMS = 0;				// Wall time the tic started, relative to the first recorded tic
+	float totalMS = 0;
+	float statMS[MAX_STATNUM + 1];
+	TArray<FTickProfileEntry> classes;
+};
+
+class FTickProfiler
+{
+public:
+	enum { HISTORY = 512 };
+
+	// Pseudo classes for work that isn't a thinker tick
+	enum { SLOT_PARALLEL, SLOT_DYNLIGHTS, SLOT_SLEEPERS, NUM_PSEUDO_SLOTS };
+
+	// Records the coming tic when enabled or when a one-off capture was requested
+	void BeginTic(int tic);
+	void EndTic();
+	bool IsActive() const { return active; }
+	void CaptureNext() { captureNext = true; }
+
+	static uint64_t Stamp()
+	{
+#ifdef __linux__
+		if (!PerfAvailable) return I_nsTime();
+#endif
+		return rdtsc();
+	}
+
+	static double StampToMS(uint64_t stamp)
+	{
+#ifdef __linux__
+		if (!PerfAvailable) return stamp * 1e-6;
+#endif
+		return stamp * PerfToMillisec;
+	}
+
+	void AddClass(PClass *cls, uint64_t time)
+	{
+		int slot = cls->ProfilerSlot >= 0 ? cls->ProfilerSlot : AssignSlot(cls);
+		AddSlot(slot, time);
+	}
+
+	void AddSlot(int slot, uint64_t time, int calls = 1)
+	{
+		if (curCalls[slot] == 0) touched.Push(slot);
+		curCalls[slot] += calls;
+		curTime[slot] += time;
+	}
+
+	void AddStat(int statnum, uint64_t time)
+	{
+		curStat[statnum] += time;
+	}
+
+	const FTickProfileFrame *GetFrame(int age) const;	// 0 is the last recorded tic
+	int NumFrames() const { return count; }
+	const char *SlotName(int slot) const { return slotNames[slot].GetChars(); }
+
+	bool ExportCSV(const char *filename) const;
+	bool ExportTrace(const char *filename) const;
+	void Clear();
+
+private:
+	void GrowSlots();
+	int AssignSlot(PClass *cls);
+
+	bool active = false, captureNext = false;
+	int curTic = 0;
+	uint64_t ticStart = 0, firstStart = 0;
+
+	TArray<FName> slotNames;
+	TMap<FName, int> slotsByName;	// Keeps the slots stable across class table rebuilds
+	TArray<uint64_t> curTime;
+	TArray<int> curCalls;
+	TArray<int> touched;
+	uint64_t curStat[MAX_STATNUM + 1] = {};
+
+	FTickProfileFrame history[HISTORY];
+	int head = 0, count = 0;
+};
+
+extern FTickProfiler TickProfiler;
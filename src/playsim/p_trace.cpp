@@ -38,6 +38,9 @@
 #include "doomstat.h"
 #include "p_maputl.h"
 #include "p_spec.h"
+#include "p_parallel.h"
+#include "c_dispatch.h"
+#include "i_time.h"
 #include "g_levellocals.h"
 #include "p_terrain.h"
 #include "vm.h"
@@ -208,6 +211,47 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 }
 
 
+//==========================================================================
+//
+// @Cockatrice - Batched traces
+//
+// FPathTraverse keeps its intercepts and line marks per thread, so the
+// traces themselves can run on the worker pool. Each result only depends
+// on its own request, which keeps the outcome independent of the
+// thread count. Line activation changes the map for the following traces,
+// so batches that ask for it run in order on the calling thread.
+//
+//==========================================================================
+
+int P_TraceBatch(FTraceRequest *requests, int count)
+{
+	if (count <= 0) return 0;
+
+	auto run = [=](int start, int end)
+	{
+		for (int i = start; i < end; i++)
+		{
+			auto &req = requests[i];
+			req.Hit = Trace(req.Start, req.Sector, req.Direction, req.MaxDist, req.ActorMask, req.WallMask, req.Ignore,
+				*req.Results, req.TraceFlags, req.Callback, req.CallbackData);
+		}
+	};
+
+	bool serial = false;
+	for (int i = 0; i < count && !serial; i++)
+	{
+		serial = !!(requests[i].TraceFlags & (TRACE_PCross | TRACE_Impact));
+	}
+
+	if (serial) run(0, count);
+	else P_ParallelFor(count, 4, run);
+
+	int hits = 0;
+	for (int i = 0; i < count; i++) hits += requests[i].Hit;
+	return hits;
+}
+
+
 //============================================================================
 //
 // traverses a sector portal
@@ -1044,7 +1088,12 @@ static bool EditTraceResult (uint32_t flags, FTraceResults &res)
 //  [ZZ] here go the methods for the ZScript interface
 //
 //==========================================================================
-IMPLEMENT_CLASS(DLineTracer, false, false)
+IMPLEMENT_CLASS(DLineTracer, false, true)
+
+IMPLEMENT_POINTERS_START(DLineTracer)
+	IMPLEMENT_POINTER(PendingIgnore)
+IMPLEMENT_POINTERS_END
+
 DEFINE_FIELD(DLineTracer, Results)
 
 // define TraceResults fields
@@ -1101,11 +1150,8 @@ DEFINE_ACTION_FUNCTION(DLineTracer, Trace)
 	ACTION_RETURN_BOOL(res);
 }
 
-ETraceStatus DLineTracer::TraceCallback(FTraceResults& res, void* pthis)
+static void PatchHitTexture(FTraceResults &res)
 {
-	DLineTracer* self = (DLineTracer*)pthis;
-	// "res" here should refer to self->Results anyway.
-
 	// patch results a bit. modders don't expect it to work like this most likely.
 	// code by MarisaKirisame
 	if (res.HitType == TRACE_HitWall)
@@ -1128,10 +1174,23 @@ ETraceStatus DLineTracer::TraceCallback(FTraceResults& res, void* pthis)
 			break;
 		}
 	}
+}
 
+ETraceStatus DLineTracer::TraceCallback(FTraceResults& res, void* pthis)
+{
+	DLineTracer* self = (DLineTracer*)pthis;
+	// "res" here should refer to self->Results anyway.
+	PatchHitTexture(res);
 	return self->CallZScriptCallback();
 }
 
+// @Cockatrice - Stands in for the script callback of tracers that don't override it
+static ETraceStatus BatchTraceCallback(FTraceResults &res, void *)
+{
+	PatchHitTexture(res);
+	return TRACE_Stop;
+}
+
 ETraceStatus DLineTracer::CallZScriptCallback()
 {
 	IFVIRTUAL(DLineTracer, TraceCallback)
@@ -1145,3 +1204,185 @@ ETraceStatus DLineTracer::CallZScriptCallback()
 
 	return TRACE_Stop;
 }
+
+//==========================================================================
+//
+// @Cockatrice - Batched LineTracer
+//
+// SetupTrace stores the arguments of Trace, TraceBatch runs every set up
+// tracer and fills in its Results. Tracers whose class overrides
+// TraceCallback run on the game thread in array order once the others are
+// done, the rest go through P_TraceBatch.
+//
+//==========================================================================
+
+DEFINE_ACTION_FUNCTION(DLineTracer, SetupTrace)
+{
+	PARAM_SELF_PROLOGUE(DLineTracer);
+	PARAM_FLOAT(start_x);
+	PARAM_FLOAT(start_y);
+	PARAM_FLOAT(start_z);
+	PARAM_POINTER_NOT_NULL(sector, sector_t);
+	PARAM_FLOAT(direction_x);
+	PARAM_FLOAT(direction_y);
+	PARAM_FLOAT(direction_z);
+	PARAM_FLOAT(maxDist);
+	PARAM_INT(traceFlags);
+	PARAM_UINT(wallMask);
+	PARAM_BOOL(ignoreAllActors);
+	PARAM_OBJECT(ignore, AActor);
+
+	auto &req = self->Pending;
+	req.Start = DVector3(start_x, start_y, start_z);
+	req.Sector = sector;
+	req.Direction = DVector3(direction_x, direction_y, direction_z);
+	req.MaxDist = maxDist;
+	req.ActorMask = (ActorFlag)(ignoreAllActors ? 0x0 : 0xFFFFFFFF);
+	req.WallMask = wallMask;
+	// Same as Trace, line activation is not available to scripts
+	req.TraceFlags = (traceFlags & ~(TRACE_PCross | TRACE_Impact)) | TRACE_3DCallback;
+	req.Results = &self->Results;
+	self->PendingIgnore = ignore;
+	self->HasPending = true;
+	return 0;
+}
+
+static bool HasScriptedCallback(DLineTracer *self)
+{
+	IFOVERRIDENVIRTUALPTRNAME(self, "LineTracer", TraceCallback)
+	{
+		return true;
+	}
+	return false;
+}
+
+DEFINE_ACTION_FUNCTION(DLineTracer, TraceBatch)
+{
+	PARAM_PROLOGUE;
+	PARAM_POINTER(tracers, TArray<DLineTracer *>);
+	PARAM_POINTER(hits, TArray<int>);
+
+	// Not static, a scripted callback may start another batch
+	TArray<FTraceRequest> batched, scripted;
+	TArray<int> batchedIndex, scriptedIndex;
+
+	hits->Resize(tracers->Size());
+	for (unsigned i = 0; i < tracers->Size(); i++)
+	{
+		(*hits)[i] = 0;
+		DLineTracer *tracer = (*tracers)[i];
+		if (tracer == nullptr || !tracer->HasPending) continue;
+
+		tracer->HasPending = false;
+		FTraceRequest req = tracer->Pending;
+		req.Ignore = tracer->PendingIgnore;
+		req.CallbackData = tracer;
+		if (HasScriptedCallback(tracer))
+		{
+			req.Callback = &DLineTracer::TraceCallback;
+			scripted.Push(req);
+			scriptedIndex.Push(i);
+		}
+		else
+		{
+			req.Callback = &BatchTraceCallback;
+			batched.Push(req);
+			batchedIndex.Push(i);
+		}
+	}
+
+	int count = P_TraceBatch(batched.Data(), batched.Size());
+	for (unsigned i = 0; i < batched.Size(); i++)
+	{
+		(*hits)[batchedIndex[i]] = batched[i].Hit;
+	}
+
+	for (unsigned i = 0; i < scripted.Size(); i++)
+	{
+		auto &req = scripted[i];
+		req.Hit = Trace(req.Start, req.Sector, req.Direction, req.MaxDist, req.ActorMask, req.WallMask, req.Ignore,
+			*req.Results, req.TraceFlags, req.Callback, req.CallbackData);
+		(*hits)[scriptedIndex[i]] = req.Hit;
+		count += req.Hit;
+	}
+	ACTION_RETURN_INT(count);
+}
+
+//==========================================================================
+//
+// Compares single and batched traces, fanned out from every monster
+//
+//==========================================================================
+
+CCMD(bench_trace)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("You must be in a level to run this\n");
+		return;
+	}
+
+	int rounds = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 10000) : 20;
+	int fan = argv.argc() > 2 ? clamp(atoi(argv[2]), 1, 64) : 16;
+
+	TArray<FTraceRequest> requests;
+	TArray<FTraceResults> results[2];
+	auto it = primaryLevel->GetThinkerIterator<AActor>();
+	while (auto mo = it.Next())
+	{
+		if (!(mo->flags3 & MF3_ISMONSTER)) continue;
+		for (int i = 0; i < fan; i++)
+		{
+			DAngle angle = mo->Angles.Yaw + DAngle::fromDeg(360. * i / fan);
+			FTraceRequest req = {};
+			req.Start = mo->PosPlusZ(mo->Height / 2);
+			req.Sector = mo->Sector;
+			req.Direction = DVector3(angle.ToVector(), 0);
+			req.MaxDist = 2048;
+			req.ActorMask = MF_SHOOTABLE;
+			req.WallMask = ML_BLOCKEVERYTHING | ML_BLOCKHITSCAN;
+			req.Ignore = mo;
+			requests.Push(req);
+		}
+	}
+	if (requests.Size() == 0)
+	{
+		Printf("No monsters on this map\n");
+		return;
+	}
+	results[0].Resize(requests.Size());
+	results[1].Resize(requests.Size());
+
+	int hits[2] = {};
+	uint64_t time[2] = {};
+
+	uint64_t start = I_nsTime();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (auto &req : requests)
+		{
+			hits[0] += Trace(req.Start, req.Sector, req.Direction, req.MaxDist, req.ActorMask, req.WallMask, req.Ignore, results[0][&req - requests.Data()], 0);
+		}
+	}
+	time[0] = I_nsTime() - start;
+
+	for (unsigned i = 0; i < requests.Size(); i++) requests[i].Results = &results[1][i];
+	start = I_nsTime();
+	for (int r = 0; r < rounds; r++)
+	{
+		hits[1] += P_TraceBatch(requests.Data(), requests.Size());
+	}
+	time[1] = I_nsTime() - start;
+
+	int mismatches = 0;
+	for (unsigned i = 0; i < requests.Size(); i++)
+	{
+		auto &a = results[0][i], &b = results[1][i];
+		if (a.HitType != b.HitType || a.Actor != b.Actor || a.Line != b.Line || a.HitPos != b.HitPos) mismatches++;
+	}
+
+	Printf("%u traces, %d rounds, %d worker threads\n", requests.Size(), rounds, P_ParallelWorkers());
+	Printf("  single: %8.3f ms, %d hits\n", time[0] * 1e-6, hits[0] / rounds);
+	Printf("  batch:  %8.3f ms, %d hits\n", time[1] * 1e-6, hits[1] / rounds);
+	if (mismatches > 0) Printf(TEXTCOLOR_RED "%d results differ\n", mismatches);
+}
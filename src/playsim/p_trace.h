@@ -116,14 +116,42 @@ bool Trace(const DVector3 &start, sector_t *sector, const DVector3 &direction, d
 	ActorFlags ActorMask, uint32_t WallMask, AActor *ignore, FTraceResults &res, uint32_t traceFlags = 0,
 	ETraceStatus(*callback)(FTraceResults &res, void *) = NULL, void *callbackdata = NULL);
 
+// @Cockatrice - One trace of a batch, with the same arguments as Trace
+struct FTraceRequest
+{
+	DVector3 Start;
+	sector_t *Sector;
+	DVector3 Direction;
+	double MaxDist;
+	ActorFlags ActorMask;
+	uint32_t WallMask;
+	AActor *Ignore;
+	uint32_t TraceFlags;
+	ETraceStatus(*Callback)(FTraceResults &res, void *);	// Runs on a worker thread, must only touch res and its own data
+	void *CallbackData;
+	FTraceResults *Results;
+	bool Hit;
+};
+
+// Runs the traces across the playsim worker pool, the results are the same as calling Trace for each request in order.
+// Batches with TRACE_PCross or TRACE_Impact requests activate lines and run serially on the calling thread.
+// Returns the number of requests that hit something.
+int P_TraceBatch(FTraceRequest *requests, int count);
+
 // [ZZ] this is the object that's used for ZScript
 class DLineTracer : public DObject
 {
 	DECLARE_CLASS(DLineTracer, DObject)
+	HAS_OBJECT_POINTERS
 public:
 	FTraceResults Results;
 	static ETraceStatus TraceCallback(FTraceResults& res, void* pthis);
 	ETraceStatus CallZScriptCallback();
+
+	// @Cockatrice - Arguments stored by SetupTrace for TraceBatch
+	FTraceRequest Pending;
+	TObjPtr<AActor*> PendingIgnore;
+	bool HasPending = false;
 };
 
 #endif //__P_TRACE_H__
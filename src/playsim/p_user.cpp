@@ -147,6 +147,7 @@ static int LastPredictedTic;
 static player_t PredictionPlayerBackup;
 static AActor *PredictionActor;
 static TArray<uint8_t> PredictionActorBackupArray;
+static FActorGrid::FCellBackup PredictionGridBackup;
 static TArray<AActor *> PredictionSectorListBackup;
 
 static TArray<sector_t *> PredictionTouchingSectorsBackup;
@@ -1455,6 +1456,8 @@ void P_PredictPlayer (player_t *player)
 	PredictionActor = player->mo;
 	PredictionActorBackupArray.Resize(act->GetClass()->Size);
 	memcpy(PredictionActorBackupArray.Data(), &act->snext, act->GetClass()->Size - ((uint8_t *)&act->snext - (uint8_t *)act));
+	// @Cockatrice - the grid slot is part of the copied range but gets restored separately
+	act->Level->ActorGrid.Backup(act, PredictionGridBackup);
 
 	// Since this is a DObject it needs to have its fields backed up manually for restore, otherwise any changes
 	// to it will be permanent while predicting. This is now auto-created on pawns to prevent creation spam.
@@ -1610,6 +1613,8 @@ void P_UnPredictPlayer ()
 
 		act->UnlinkFromWorld(&ctx);
 		memcpy(&act->snext, PredictionActorBackupArray.Data(), PredictionActorBackupArray.Size() - ((uint8_t *)&act->snext - (uint8_t *)act));
+		// @Cockatrice - the copied GridCell and GridIndex are stale, put the player's old cell back as it was
+		act->Level->ActorGrid.Restore(act, PredictionGridBackup);
 
 		if (act->ViewPos != nullptr)
 		{
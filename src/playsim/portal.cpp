@@ -137,6 +137,13 @@ public:
 //
 // Similar to AddLineIntercepts but checks the portal blockmap for line-to-line portals
 //
+// @Cockatrice - The old validcount check here never marked the line, so a
+// portal line spanning several portal blocks was added once per block.
+// Marking it keeps only the first copy. The copies had the same frac and
+// came after the first one, and Next picks the first of equal fracs, so
+// the intercept order is unchanged. GetOffsetPosition, the only user,
+// stops at the first intercept anyway.
+//
 //===========================================================================
 
 void FLinePortalTraverse::AddLineIntercepts(int bx, int by)
@@ -151,7 +158,7 @@ void FLinePortalTraverse::AddLineIntercepts(int bx, int by)
 		double frac;
 		divline_t dl;
 
-		if (ld->validcount == validcount) continue;	// already processed
+		if (!valid.MarkLine(ld)) continue;	// already processed
 
 		if (P_PointOnDivlineSide (ld->v1->fPos(), &trace) ==
 			P_PointOnDivlineSide (ld->v2->fPos(), &trace))
@@ -127,6 +127,9 @@ sector_t* RenderViewpoint(FRenderViewpoint& mainvp, AActor* camera, IntRect* bou
 
 	screen->SetLevelMesh(camera->Level->levelMesh);
 
+	// @Cockatrice - Sprites, particles and models find their lights through this grid
+	hw_BuildLightClusters(camera->Level);
+
 	// Update the attenuation flag of all light defaults for each viewpoint.
 	// This function will only do something if the setting differs.
 	FLightDefaults::SetAttenuationForLevel(!!(camera->Level->flags3 & LEVEL3_ATTENUATE));
@@ -199,7 +202,7 @@ sector_t* RenderViewpoint(FRenderViewpoint& mainvp, AActor* camera, IntRect* bou
 	return mainvp.sector;
 }
 
-void DoWriteSavePic(FileWriter* file, ESSType ssformat, uint8_t* scr, int width, int height, sector_t* viewsector, bool upsidedown)
+void DoWriteSavePic(FPNGImage* pic, ESSType ssformat, uint8_t* scr, int width, int height, sector_t* viewsector, bool upsidedown)
 {
 	PalEntry palette[256];
 	PalEntry modulateColor;
@@ -246,7 +249,8 @@ void DoWriteSavePic(FileWriter* file, ESSType ssformat, uint8_t* scr, int width,
 		pitch *= -1;
 	}
 
-	M_CreatePNG(file, scr, ssformat == SS_PAL ? palette : nullptr, ssformat, width, height, pitch, vid_gamma);
+	// @Cockatrice - Only the pixels are captured here, the PNG gets encoded by the savegame writer
+	pic->Capture(scr, ssformat == SS_PAL ? palette : nullptr, ssformat, width, height, pitch, vid_gamma);
 }
 
 //===========================================================================
@@ -255,11 +259,11 @@ void DoWriteSavePic(FileWriter* file, ESSType ssformat, uint8_t* scr, int width,
 //
 //===========================================================================
 
-void WriteSavePic(player_t* player, FileWriter* file, int width, int height)
+void WriteSavePic(player_t* player, FPNGImage* pic, int width, int height)
 {
 	if (!V_IsHardwareRenderer())
 	{
-		SWRenderer->WriteSavePic(player, file, width, height);
+		SWRenderer->WriteSavePic(player, pic, width, height);
 	}
 	else
 	{
@@ -294,7 +298,7 @@ void WriteSavePic(player_t* player, FileWriter* file, int width, int height)
 		TArray<uint8_t> scr(width * height * 3, true);
 		screen->CopyScreenToBuffer(width, height, scr.Data());
 
-		DoWriteSavePic(file, SS_RGB, scr.Data(), width, height, viewsector, screen->FlipSavePic());
+		DoWriteSavePic(pic, SS_RGB, scr.Data(), width, height, viewsector, screen->FlipSavePic());
 
 		// Switch back the screen render buffers
 		screen->SetViewportRects(nullptr);
@@ -27,6 +27,7 @@
 #include "flatvertices.h"
 #include "earcut.hpp"
 #include "v_video.h"
+#include "hwrenderer/scene/hw_wallcache.h"
 
 //=============================================================================
 //
@@ -494,4 +495,5 @@ void CreateVBO(FFlatVertexBuffer* fvb, TArray<sector_t>& sectors)
 	fvb->mCurIndex = fvb->mIndex = fvb->vbo_shadowdata.Size();
 	fvb->Copy(0, fvb->mIndex);
 	fvb->mIndexBuffer->SetData(fvb->ibo_data.Size() * sizeof(uint32_t), &fvb->ibo_data[0], BufferUsageType::Static);
+	hw_ClearWallCache();	// @Cockatrice - the recorded walls belong to the previous level
 }
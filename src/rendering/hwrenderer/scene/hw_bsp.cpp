@@ -43,12 +43,18 @@
 #include "flatvertices.h"
 #include "hw_vertexbuilder.h"
 #include "hw_walldispatcher.h"
+#include "hw_wallcache.h"
+#include <future>
+#include <mutex>
+#include <thread>
 
 #ifdef ARCH_IA32
 #include <immintrin.h>
 #endif // ARCH_IA32
 
 CVAR(Bool, gl_multithread, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+// @Cockatrice - Number of worker threads consuming the BSP's jobs, 0 picks one per free core
+CVAR(Int, gl_multithread_workers, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
 EXTERN_CVAR(Float, r_actorspriteshadowdist)
 EXTERN_CVAR(Bool, r_radarclipper)
@@ -58,6 +64,12 @@ thread_local bool isWorkerThread;
 ctpl::thread_pool renderPool(4);
 bool inited = false;
 
+HWWorkerOutput BSPWorkerOutput[MAX_BSP_WORKERS + 1];
+thread_local HWWorkerOutput *CurrentWorkerOutput;
+thread_local HWWorkerCounts WorkerCounts;
+static std::recursive_mutex WorkerMutex;
+static std::atomic<int> WorkerLines, WorkerSprites, WorkerFlats, WorkerDecals;
+
 const int MAXDITHERACTORS = 20; // Maximum number of enemies that can set dither-transparency flags
 AActor* RenderedTargets[MAXDITHERACTORS];
 int RTnum;
@@ -69,13 +81,25 @@ void ClearDitherTargets()
 	  RenderedTargets[ii] = nullptr;
 }
 
+HWWorkerLock::HWWorkerLock()
+{
+	locked = isWorkerThread;
+	if (locked) WorkerMutex.lock();
+}
+
+HWWorkerLock::~HWWorkerLock()
+{
+	if (locked) WorkerMutex.unlock();
+}
+
 struct RenderJob
 {
 	enum
 	{
 		FlatJob,
 		WallJob,
-		SpriteJob,
+		ThingJob,
+		PortalThingJob,	// a thing from a sector portal's thing list
 		ParticleJob,
 		PortalJob,
 		TerminateJob	// inserted when all work is done so that the worker can return.
@@ -84,26 +108,64 @@ struct RenderJob
 	int type;
 	subsector_t *sub;
 	seg_t *seg;
+	AActor *thing;
 };
 
 
+//==========================================================================
+//
+// @Cockatrice - The queue is filled by the BSP traversal on the main thread
+// and emptied by any number of workers. Jobs are stored in fixed size blocks
+// which are allocated as needed and kept for later frames, so a job never
+// moves once written and the readers need no locking.
+//
+//==========================================================================
+
 class RenderJobQueue
 {
-	RenderJob pool[300000];	// Way more than ever needed. The largest ever seen on a single viewpoint is around 40000.
+	enum
+	{
+		BLOCK_SHIFT = 12,
+		BLOCK_SIZE = 1 << BLOCK_SHIFT,
+		MAX_BLOCKS = 4096,	// 16 million jobs. The largest ever seen on a single viewpoint is around 40000.
+	};
+
+	RenderJob *blocks[MAX_BLOCKS] = {};
+	int numblocks = 0;
 	std::atomic<int> readindex{};
 	std::atomic<int> writeindex{};
+
 public:
-	void AddJob(int type, subsector_t *sub, seg_t *seg = nullptr)
+	~RenderJobQueue()
 	{
-		// This does not check for array overflows. The pool should be large enough that it never hits the limit.
+		for (int i = 0; i < numblocks; i++) delete[] blocks[i];
+	}
 
-		pool[writeindex] = { type, sub, seg };
-		writeindex++;	// update index only after the value has been written.
+	void AddJob(int type, subsector_t *sub, seg_t *seg = nullptr, AActor *thing = nullptr)
+	{
+		int index = writeindex.load(std::memory_order_relaxed);
+		int block = index >> BLOCK_SHIFT;
+		if (block == numblocks)
+		{
+			if (numblocks == MAX_BLOCKS) I_FatalError("Render job queue overflow");
+			blocks[numblocks++] = new RenderJob[BLOCK_SIZE];
+		}
+		blocks[block][index & (BLOCK_SIZE - 1)] = { type, sub, seg, thing };
+		writeindex.store(index + 1, std::memory_order_release);	// publish the job only after it has been written.
 	}
 
-	RenderJob *GetJob()
+	// Claims the next job. The returned index is the job's position in the traversal order.
+	RenderJob *GetJob(int &index)
 	{
-		if (readindex < writeindex) return &pool[readindex++];
+		int read = readindex.load(std::memory_order_relaxed);
+		while (read < writeindex.load(std::memory_order_acquire))
+		{
+			if (readindex.compare_exchange_weak(read, read + 1, std::memory_order_relaxed))
+			{
+				index = read;
+				return &blocks[read >> BLOCK_SHIFT][read & (BLOCK_SIZE - 1)];
+			}
+		}
 		return nullptr;
 	}
 	
@@ -116,16 +178,34 @@ public:
 
 static RenderJobQueue jobQueue;	// One static queue is sufficient here. This code will never be called recursively.
 
-void HWDrawInfo::WorkerThread()
+static int NumBSPWorkers()
+{
+	int workers = gl_multithread_workers;
+	if (workers <= 0) workers = int(std::thread::hardware_concurrency()) - 1;
+	return clamp<int>(workers, 1, min<int>(MAX_BSP_WORKERS, renderPool.size()));
+}
+
+//==========================================================================
+//
+// With several workers the output is null for the first one, which is
+// the only one to update the timers, and each worker collects its items
+// in its own HWWorkerOutput.
+//
+//==========================================================================
+
+void HWDrawInfo::WorkerThread(HWWorkerOutput *output)
 {
 	sector_t *front, *back;
-	HWWallDispatcher disp(this);
+	bool timed = output == nullptr || output == &BSPWorkerOutput[0];
+	int lines = 0;
 
-	WTTotal.Clock();
+	if (timed) WTTotal.Clock();
 	isWorkerThread = true;	// for adding asserts in GL API code. The worker thread may never call any GL API.
+	CurrentWorkerOutput = output;
 	while (true)
 	{
-		auto job = jobQueue.GetJob();
+		int index;
+		auto job = jobQueue.GetJob(index);
 		if (job == nullptr)
 		{
 #ifdef ARCH_IA32
@@ -142,19 +222,30 @@ void HWDrawInfo::WorkerThread()
 			_mm_pause();
 			_mm_pause();
 #endif // ARCH_IA32
+			continue;
 		}
+
+		if (output) output->job = index;
+
 		// Note that the main thread MUST have prepared the fake sectors that get used below!
 		// This worker thread cannot prepare them itself without costly synchronization.
-		else switch (job->type)
+		switch (job->type)
 		{
 		case RenderJob::TerminateJob:
-			WTTotal.Unclock();
+			CurrentWorkerOutput = nullptr;
+			isWorkerThread = false;
+			WorkerLines += lines;
+			WorkerSprites += WorkerCounts.sprites;
+			WorkerFlats += WorkerCounts.flats;
+			WorkerDecals += WorkerCounts.decals;
+			WorkerCounts = {};
+			if (timed) WTTotal.Unclock();
 			return;
 
 		case RenderJob::WallJob:
 		{
 			HWWall wall;
-			SetupWall.Clock();
+			if (timed) SetupWall.Clock();
 			wall.sub = job->sub;
 
 			front = hw_FakeFlat(job->sub->sector, in_area, false);
@@ -184,45 +275,173 @@ void HWDrawInfo::WorkerThread()
 			}
 			else back = nullptr;
 
-			wall.Process(&disp, job->seg, front, back);
-			rendered_lines++;
-			SetupWall.Unclock();
+			hw_ProcessWall(this, wall, job->seg, front, back);
+			lines++;
+			if (timed) SetupWall.Unclock();
 			break;
 		}
 
 		case RenderJob::FlatJob:
 		{
 			HWFlat flat;
-			SetupFlat.Clock();
+			if (timed) SetupFlat.Clock();
 			flat.section = job->sub->section;
 			front = hw_FakeFlat(job->sub->render_sector, in_area, false);
 			flat.ProcessSector(this, front);
-			SetupFlat.Unclock();
+			if (timed) SetupFlat.Unclock();
 			break;
 		}
 
-		case RenderJob::SpriteJob:
-			SetupSprite.Clock();
+		case RenderJob::ThingJob:
+		case RenderJob::PortalThingJob:
+			if (timed) SetupSprite.Clock();
 			front = hw_FakeFlat(job->sub->sector, in_area, false);
-			RenderThings(job->sub, front);
-			SetupSprite.Unclock();
+			RenderThing(job->thing, front, job->type == RenderJob::PortalThingJob);
+			if (timed) SetupSprite.Unclock();
 			break;
 
 		case RenderJob::ParticleJob:
-			SetupSprite.Clock();
+			if (timed) SetupSprite.Clock();
 			front = hw_FakeFlat(job->sub->sector, in_area, false);
 			RenderParticles(job->sub, front);
-			SetupSprite.Unclock();
+			if (timed) SetupSprite.Unclock();
 			break;
 
 		case RenderJob::PortalJob:
+		{
+			HWWorkerLock lock;
 			AddSubsectorToPortal((FSectorPortalGroup *)job->seg, job->sub);
 			break;
 		}
+		}
 
 	}
 }
 
+//==========================================================================
+//
+// @Cockatrice - Processes the actors of the line portals the workers found.
+// Their items go into the slot after the last worker with the keys that
+// were recorded when the portal was found.
+//
+//==========================================================================
+
+void HWDrawInfo::ProcessDeferredLinePortals(int numworkers, area_t in_area)
+{
+	if (DeferredLinePortals.Size() == 0) return;
+
+	// Portals found in the same job keep the order they were found in
+	std::stable_sort(DeferredLinePortals.begin(), DeferredLinePortals.end(), [](const HWDeferredPortal &a, const HWDeferredPortal &b) { return a.job < b.job; });
+
+	auto output = &BSPWorkerOutput[numworkers];
+	CurrentWorkerOutput = output;
+	for (auto &deferred : DeferredLinePortals)
+	{
+		output->job = deferred.job;
+		output->fixedkeys = deferred.keys;
+		ProcessLinePortalActors(deferred.glport, in_area);
+	}
+	output->fixedkeys = nullptr;
+	CurrentWorkerOutput = nullptr;
+	DeferredLinePortals.Clear();
+}
+
+//==========================================================================
+//
+// @Cockatrice - Appends the workers' items to the draw info in key order
+//
+//==========================================================================
+
+template<class Key, class Func>
+static void MergeByJob(TArray<Key> **keys, int count, Func &&append)
+{
+	unsigned pos[MAX_BSP_WORKERS + 1] = {};
+	while (true)
+	{
+		int best = -1;
+		for (int w = 0; w < count; w++)
+		{
+			if (pos[w] < keys[w]->Size() && (best < 0 || (*keys[w])[pos[w]] < (*keys[best])[pos[best]])) best = w;
+		}
+		if (best < 0) break;
+
+		// Ties go to the lower slot, the deferred portals come after the worker that found them
+		auto &from = *keys[best];
+		Key key = from[pos[best]];
+		do append(best, pos[best]++);
+		while (pos[best] < from.Size() && from[pos[best]] == key);
+	}
+}
+
+void HWDrawInfo::MergeWorkerOutput(int numworkers)
+{
+	// Includes the slot with the deferred portals
+	const int count = numworkers + 1;
+
+	for (int list = 0; list < GLDL_TYPES; list++)
+	{
+		TArray<int64_t> *keys[MAX_BSP_WORKERS + 1];
+		auto &to = drawlists[list];
+		for (int w = 0; w < count; w++) keys[w] = &BSPWorkerOutput[w].itemkeys[list];
+
+		MergeByJob(keys, count, [&](int w, unsigned i)
+		{
+			auto &from = BSPWorkerOutput[w].drawlists[list];
+			auto &item = from.drawitems[i];
+			switch (item.rendertype)
+			{
+			case DrawType_WALL:
+				to.drawitems.Push(HWDrawItem(DrawType_WALL, to.walls.Push(from.walls[item.index])));
+				break;
+			case DrawType_FLAT:
+				to.drawitems.Push(HWDrawItem(DrawType_FLAT, to.flats.Push(from.flats[item.index])));
+				break;
+			case DrawType_SPRITE:
+				to.drawitems.Push(HWDrawItem(DrawType_SPRITE, to.sprites.Push(from.sprites[item.index])));
+				break;
+			}
+		});
+
+		for (int w = 0; w < count; w++)
+		{
+			BSPWorkerOutput[w].drawlists[list].Reset();
+			BSPWorkerOutput[w].itemkeys[list].Clear();
+		}
+	}
+
+	for (int slot = 0; slot < 2; slot++)
+	{
+		TArray<int> *jobs[MAX_BSP_WORKERS + 1];
+		for (int w = 0; w < count; w++) jobs[w] = &BSPWorkerOutput[w].decaljobs[slot];
+
+		MergeByJob(jobs, count, [&](int w, unsigned i)
+		{
+			Decals[slot].Push(BSPWorkerOutput[w].Decals[slot][i]);
+		});
+
+		for (int w = 0; w < count; w++)
+		{
+			BSPWorkerOutput[w].Decals[slot].Clear();
+			BSPWorkerOutput[w].decaljobs[slot].Clear();
+		}
+	}
+}
+
+//==========================================================================
+//
+// On the BSP workers new draw items go into the worker's own lists
+//
+//==========================================================================
+
+HWDrawList &HWDrawInfo::OutputList(int list)
+{
+	auto output = CurrentWorkerOutput;
+	if (output == nullptr) return drawlists[list];
+
+	auto &keys = output->itemkeys[list];
+	keys.Push(output->fixedkeys ? output->fixedkeys[list] : output->NextKey(list));
+	return output->drawlists[list];
+}
 
 
 
@@ -409,10 +628,9 @@ void HWDrawInfo::AddLine (seg_t *seg, bool portalclip)
 			else
 			{
 				HWWall wall;
-				HWWallDispatcher disp(this);
 				SetupWall.Clock();
 				wall.sub = seg->Subsector;
-				wall.Process(&disp, seg, currentsector, backsector);
+				hw_ProcessWall(this, wall, seg, currentsector, backsector);
 				rendered_lines++;
 				SetupWall.Unclock();
 			}
@@ -585,6 +803,8 @@ void HWDrawInfo::RenderThings(subsector_t * sub, sector_t * sector)
 {
 	sector_t * sec=sub->sector;
 	// Handle all things in sector.
+	// @Cockatrice - This is done on the main thread even when multithreading, so that the things are claimed
+	// in traversal order and each one is set up by a single worker. Only the setup itself becomes a job.
 	const auto &vp = Viewpoint;
 	for (auto p = sec->touching_renderthings; p != nullptr; p = p->m_snext)
 	{
@@ -606,20 +826,8 @@ void HWDrawInfo::RenderThings(subsector_t * sub, sector_t * sector)
 		// If this thing is in a map section that's not in view it can't possibly be visible
 		if (CurrentMapSections[thing->subsector->mapsection])
 		{
-			HWSprite sprite;
-
-			// [Nash] draw sprite shadow
-			if (R_ShouldDrawSpriteShadow(thing))
-			{
-				double dist = (thing->Pos() - vp.Pos).LengthSquared();
-				double check = r_actorspriteshadowdist;
-				if (dist <= check * check)
-				{
-					sprite.Process(this, thing, sector, in_area, false, true);
-				}
-			}
-
-			sprite.Process(this, thing, sector, in_area, false);
+			if (multithread) jobQueue.AddJob(RenderJob::ThingJob, sub, nullptr, thing);
+			else RenderThing(thing, sector, false);
 		}
 	}
 	
@@ -637,26 +845,31 @@ void HWDrawInfo::RenderThings(subsector_t * sub, sector_t * sector)
 			}
 		}
 
-		HWSprite sprite;
+		if (multithread) jobQueue.AddJob(RenderJob::PortalThingJob, sub, nullptr, thing);
+		else RenderThing(thing, sector, true);
+	}
+}
+
+void HWDrawInfo::RenderThing(AActor *thing, sector_t *sector, bool thruportal)
+{
+	HWSprite sprite;
 
-		// [Nash] draw sprite shadow
-		if (R_ShouldDrawSpriteShadow(thing))
+	// [Nash] draw sprite shadow
+	if (R_ShouldDrawSpriteShadow(thing))
+	{
+		double dist = (thing->Pos() - Viewpoint.Pos).LengthSquared();
+		double check = r_actorspriteshadowdist;
+		if (dist <= check * check)
 		{
-			double dist = (thing->Pos() - vp.Pos).LengthSquared();
-			double check = r_actorspriteshadowdist;
-			if (dist <= check * check)
-			{
-				sprite.Process(this, thing, sector, in_area, true, true);
-			}
+			sprite.Process(this, thing, sector, in_area, thruportal, true);
 		}
-
-		sprite.Process(this, thing, sector, in_area, true);
 	}
+
+	sprite.Process(this, thing, sector, in_area, thruportal);
 }
 
 void HWDrawInfo::RenderParticles(subsector_t *sub, sector_t *front)
 {
-	SetupSprite.Clock();
 	for (uint32_t i = 0; i < sub->sprites.Size(); i++)
 	{
 		DVisualThinker *sp = sub->sprites[i];
@@ -683,7 +896,6 @@ void HWDrawInfo::RenderParticles(subsector_t *sub, sector_t *front)
 		HWSprite sprite;
 		sprite.ProcessParticle(this, &Level->Particles[i], front, nullptr);
 	}
-	SetupSprite.Unclock();
 }
 
 
@@ -821,19 +1033,7 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 		sector->validcount = validcount;
 		sector->MoreFlags |= SECMF_DRAWN;
 
-		if (gl_render_things && (sector->touching_renderthings || sector->sectorportal_thinglist))
-		{
-			if (multithread)
-			{
-				jobQueue.AddJob(RenderJob::SpriteJob, sub, nullptr);
-			}
-			else
-			{
-				SetupSprite.Clock();
-				RenderThings(sub, fakesector);
-				SetupSprite.Unclock();
-			}
-		}
+		// @Cockatrice - This must look at the things before RenderThings marks them as processed
 		if (r_dithertransparency && Viewpoint.IsAllowedOoB() && (RTnum < MAXDITHERACTORS))
 		{
 			// [DVR] Not parallelizable due to variables RTnum and RenderedTargets[]
@@ -848,6 +1048,19 @@ void HWDrawInfo::DoSubsector(subsector_t * sub)
 				}
 			}
 		}
+		if (gl_render_things && (sector->touching_renderthings || sector->sectorportal_thinglist))
+		{
+			if (multithread)
+			{
+				RenderThings(sub, fakesector);
+			}
+			else
+			{
+				SetupSprite.Clock();
+				RenderThings(sub, fakesector);
+				SetupSprite.Unclock();
+			}
+		}
 	}
 
 	if (gl_render_flats)
@@ -1026,22 +1239,41 @@ void HWDrawInfo::RenderBSP(void *node, bool drawpsprites)
 	}
 
 	validcount++;	// used for processing sidedefs only once by the renderer.
+	hw_BeginWallCache(this);
 
 	multithread = gl_multithread;
 	if (multithread)
 	{
+		int numworkers = NumBSPWorkers();
+		std::future<void> futures[MAX_BSP_WORKERS];
+
 		jobQueue.ReleaseAll();
-		auto future = renderPool.push([&](int id) {
-			WorkerThread();
-		});
+		WorkerLines = WorkerSprites = WorkerFlats = WorkerDecals = 0;
+		for (int i = 0; i < numworkers; i++)
+		{
+			auto output = numworkers > 1 ? &BSPWorkerOutput[i] : nullptr;
+			futures[i] = renderPool.push([this, output](int id) {
+				WorkerThread(output);
+			});
+		}
 		if (Viewpoint.IsOrtho() && ((Level->flags3 & LEVEL3_NOFOGOFWAR) || !r_radarclipper)) RenderOrthoNoFog();
 		else RenderBSPNode(node);
 
-		jobQueue.AddJob(RenderJob::TerminateJob, nullptr, nullptr);
+		// Each worker returns on the first terminate job it picks up
+		for (int i = 0; i < numworkers; i++) jobQueue.AddJob(RenderJob::TerminateJob, nullptr, nullptr);
 		Bsp.Unclock();
 		MTWait.Clock();
-		future.wait();
+		for (int i = 0; i < numworkers; i++) futures[i].wait();
+		if (numworkers > 1)
+		{
+			ProcessDeferredLinePortals(numworkers, in_area);
+			MergeWorkerOutput(numworkers);
+		}
 		MTWait.Unclock();
+		rendered_lines += WorkerLines;
+		rendered_sprites += WorkerSprites;
+		rendered_flats += WorkerFlats;
+		rendered_decals += WorkerDecals;
 	}
 	else
 	{
@@ -126,7 +126,8 @@ void HWDecal::DrawDecal(HWDrawInfo *di, FRenderState &state)
 		}
 	}
 
-	rendered_decals++;
+	if (isWorkerThread) WorkerCounts.decals++;
+	else rendered_decals++;
 	state.SetTextureMode(TM_NORMAL);
 	state.SetObjectColor(0xffffffff);
 	state.SetFog(fc, -1);
@@ -228,17 +229,23 @@ void HWWall::ProcessDecal(HWDrawInfo *di, DBaseDecal *decal, const FVector3 &nor
 		decalTile != lastPatch &&						// only if this is a new frame
 		gl_texture_thread &&
 		screen->SupportsBackgroundCache()) {
+		HWWorkerLock lock;	// @Cockatrice - the background loader may only be fed by one BSP worker at a time
 
 		int scaleflags = 0;
 		if (shouldUpscale(texture, UF_Sprite)) scaleflags |= CTF_Upscale;
 
 		FMaterial * gltex = FMaterial::ValidateTexture(texture, scaleflags, false);
 		if (!gltex || !gltex->IsHardwareCached(decal->Translation.index())) {
+			double dx, dy;
+			decal->GetXY(decal->Side, dx, dy);
+			double size = max(texture->GetDisplayWidth() * fabs(decal->ScaleX), texture->GetDisplayHeight() * fabs(decal->ScaleY));
+			float priority = di->BGLoadPriority(DVector3(dx, dy, decal->GetRealZ(decal->Side)), size);
+
 			if (gltex) {
-				screen->BackgroundCacheMaterial(gltex, decal->Translation, true);  // TODO: Prevent calling this every time the sprite wants to render, it's incredibly wasteful
+				screen->BackgroundCacheMaterial(gltex, decal->Translation, true, false, priority);  // TODO: Prevent calling this every time the sprite wants to render, it's incredibly wasteful
 			}
 			else {
-				screen->BackgroundCacheTextureMaterial(texture, decal->Translation, scaleflags, true);
+				screen->BackgroundCacheTextureMaterial(texture, decal->Translation, scaleflags, true, priority);
 			}
 
 			// Last ditch, grab the last rendered patch from this sprite
@@ -382,6 +382,21 @@ angle_t HWDrawInfo::FrustumAngle()
 	return a1;
 }
 
+//-----------------------------------------------------------------------------
+//
+// @Cockatrice - Background load priority for a texture of the given world
+// size drawn at pos. This is roughly the fraction of the screen it will
+// cover, so close and large things load before distant ones.
+//
+//-----------------------------------------------------------------------------
+
+float HWDrawInfo::BGLoadPriority(const DVector3 &pos, double size)
+{
+	double dist = max((pos - Viewpoint.Pos).Length(), 1.0);
+	double coverage = size / (2.0 * dist * max(r_viewwindow.FocalTangent, 0.01));
+	return (float)clamp(coverage, 0.001, double(BGLOAD_PRIORITY_HUD_NEXT) - 1.0);
+}
+
 //-----------------------------------------------------------------------------
 //
 // Setup the modelview matrix
@@ -440,8 +455,16 @@ HWPortal * HWDrawInfo::FindPortal(const void * src)
 
 HWDecal *HWDrawInfo::AddDecal(bool onmirror)
 {
-	auto decal = (HWDecal*)RenderDataAllocator.Alloc(sizeof(HWDecal));
-	Decals[onmirror ? 1 : 0].Push(decal);
+	auto decal = (HWDecal*)AllocRenderData(sizeof(HWDecal));
+	int slot = onmirror ? 1 : 0;
+	auto output = CurrentWorkerOutput;
+	if (output != nullptr)
+	{
+		// @Cockatrice - Merged back in job order after the BSP
+		output->decaljobs[slot].Push(output->job);
+		output->Decals[slot].Push(decal);
+	}
+	else Decals[slot].Push(decal);
 	return decal;
 }
 
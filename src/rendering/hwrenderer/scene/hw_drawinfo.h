@@ -28,6 +28,7 @@ struct HWDecal;
 class IShadowMap;
 struct particle_t;
 struct FDynLightData;
+struct FPNGImage;
 struct HUDSprite;
 class ACorona;
 class Clipper;
@@ -95,6 +96,74 @@ enum DrawListType
 	GLDL_TYPES,
 };
 
+//==========================================================================
+//
+// @Cockatrice - Output of one BSP worker thread
+//
+// With more than one worker each of them collects its draw items and decals
+// here, tagged with the index of the job that created them. The job indices
+// rise with the BSP traversal, so merging the workers by job index yields
+// exactly the lists a single worker would have produced.
+//
+// Draw items also carry their position within the job. The actors of line
+// portals are processed after the workers are done, into the slot after
+// the last worker, and take the position between the items that were
+// created before and after the portal was found.
+//
+//==========================================================================
+
+enum { MAX_BSP_WORKERS = 8 };
+
+struct HWWorkerOutput
+{
+	HWDrawList drawlists[GLDL_TYPES];
+	TArray<int64_t> itemkeys[GLDL_TYPES];	// job << 32 | position in the job
+	TArray<HWDecal *> Decals[2];
+	TArray<int> decaljobs[2];
+	FMemArena RenderData{ 1024 * 1024 };	// lives as long as RenderDataAllocator's contents
+	int job = 0;
+	const int64_t *fixedkeys = nullptr;		// keys for all items while deferred actors are processed
+
+	// Items take the odd positions, so there is always an even one between two of them
+	int64_t NextKey(int list) const
+	{
+		int64_t first = int64_t(job) << 32;
+		auto &keys = itemkeys[list];
+		return keys.Size() > 0 && keys.Last() > first ? keys.Last() + 2 : first + 1;
+	}
+};
+
+// @Cockatrice - A line portal found by a BSP worker and the keys its actors' items get
+struct HWDeferredPortal
+{
+	FLinePortalSpan *glport;
+	int job;
+	int64_t keys[GLDL_TYPES];
+};
+
+extern HWWorkerOutput BSPWorkerOutput[MAX_BSP_WORKERS + 1];	// the last one after the active workers takes the deferred portals
+extern thread_local HWWorkerOutput *CurrentWorkerOutput;	// null outside of the multi-worker BSP
+
+// Stats a BSP worker counts on its own and adds to rendered_sprites etc. when it finishes, like its walls
+struct HWWorkerCounts
+{
+	int sprites = 0, flats = 0, decals = 0;
+};
+extern thread_local bool isWorkerThread;
+extern thread_local HWWorkerCounts WorkerCounts;
+
+// Serializes what the BSP workers do to state shared by the entire scene (portals, missing texture
+// lists, background texture loading). Only locks on a worker thread, the paths involved are rare.
+class HWWorkerLock
+{
+	bool locked;
+public:
+	HWWorkerLock();
+	~HWWorkerLock();
+	HWWorkerLock(const HWWorkerLock &) = delete;
+	HWWorkerLock &operator=(const HWWorkerLock &) = delete;
+};
+
 
 struct HWDrawInfo
 {
@@ -151,6 +220,7 @@ struct HWDrawInfo
 	FRenderViewpoint Viewpoint;
 	HWViewpointUniforms VPUniforms;	// per-viewpoint uniform state
 	TArray<HWPortal *> Portals;
+	TArray<HWDeferredPortal> DeferredLinePortals;	// @Cockatrice - line portals whose actors get processed after the BSP workers are done
 	TArray<HWDecal *> Decals[2];	// the second slot is for mirrors which get rendered in a separate pass.
 	TArray<HUDSprite> hudsprites;	// These may just be stored by value.
 	//TArray<ACorona*> Coronas;
@@ -193,7 +263,10 @@ private:
 	subsector_t *currentsubsector;	// used by the line processing code.
 	sector_t *currentsector;
 
-	void WorkerThread();
+	void WorkerThread(HWWorkerOutput *output);
+	void ProcessDeferredLinePortals(int numworkers, area_t in_area);
+	void MergeWorkerOutput(int numworkers);
+	HWDrawList &OutputList(int list);
 
 	void UnclipSubsector(subsector_t *sub);
 	
@@ -205,6 +278,7 @@ private:
 	void AddSpecialPortalLines(subsector_t * sub, sector_t * sector, linebase_t *line);
 	public:
 	void RenderThings(subsector_t * sub, sector_t * sector);
+	void RenderThing(AActor *thing, sector_t *sector, bool thruportal);
 	void RenderParticles(subsector_t *sub, sector_t *front);
 	void DoSubsector(subsector_t * sub);
 	int SetupLightsForOtherPlane(subsector_t * sub, FDynLightData &lightdata, const secplane_t *plane);
@@ -285,6 +359,7 @@ public:
 	void ProcessSectorStacks(area_t in_area);
 
 	void ProcessActorsInPortal(FLinePortalSpan *glport, area_t in_area);
+	void ProcessLinePortalActors(FLinePortalSpan *glport, area_t in_area);
 
 	void AddOtherFloorPlane(int sector, gl_subsectorrendernode * node);
 	void AddOtherCeilingPlane(int sector, gl_subsectorrendernode * node);
@@ -299,6 +374,7 @@ public:
 	void SetViewMatrix(const FRotator &angles, float vx, float vy, float vz, bool mirror, bool planemirror);
 	void SetupView(FRenderState &state, float vx, float vy, float vz, bool mirror, bool planemirror);
 	angle_t FrustumAngle();
+	float BGLoadPriority(const DVector3 &pos, double size);
 
 	void DrawDecals(FRenderState &state, TArray<HWDecal *> &decals);
 	void DrawPlayerSprites(bool hudModelStep, FRenderState &state);
@@ -327,7 +403,7 @@ public:
 
 void CleanSWDrawer();
 sector_t* RenderViewpoint(FRenderViewpoint& mainvp, AActor* camera, IntRect* bounds, float fov, float ratio, float fovratio, bool mainview, bool toscreen, bool isSavePic = false);
-void WriteSavePic(player_t* player, FileWriter* file, int width, int height);
+void WriteSavePic(player_t* player, FPNGImage* pic, int width, int height);
 sector_t* RenderView(player_t* player);
 
 
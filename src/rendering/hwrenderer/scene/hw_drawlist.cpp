@@ -38,12 +38,37 @@
 #include "hw_drawinfo.h"
 #include "hw_fakeflat.h"
 #include "hw_walldispatcher.h"
+#include "c_cvars.h"
+#include "ctpl.h"
+#include <future>
+#include <mutex>
+#include <vector>
+
+// @Cockatrice - Parallel translucent sort
+CVAR(Bool, gl_parallel_sort, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+EXTERN_CVAR(Bool, gl_multithread)
+extern ctpl::thread_pool renderPool;
+
+static bool ParallelSortRunning;
+static std::mutex RenderDataMutex;
 
 FMemArena RenderDataAllocator(1024*1024);	// Use large blocks to reduce allocation time.
 
 void ResetRenderDataAllocator()
 {
 	RenderDataAllocator.FreeAll();
+	for (auto &output : BSPWorkerOutput) output.RenderData.FreeAll();
+}
+
+// The BSP workers allocate from their own arenas, the sort workers allocate the pieces of split items
+void *AllocRenderData(size_t size)
+{
+	if (CurrentWorkerOutput != nullptr) return CurrentWorkerOutput->RenderData.Alloc(size);
+	if (!ParallelSortRunning) return RenderDataAllocator.Alloc(size);
+
+	std::lock_guard<std::mutex> lock(RenderDataMutex);
+	return RenderDataAllocator.Alloc(size);
 }
 
 //==========================================================================
@@ -53,7 +78,7 @@ void ResetRenderDataAllocator()
 //==========================================================================
 class StaticSortNodeArray : public TDeletingArray<SortNode*>
 {
-	unsigned usecount;
+	unsigned usecount = 0;
 public:
 	unsigned Size() { return usecount; }
 	void Clear() { usecount=0; }
@@ -72,7 +97,8 @@ SortNode * StaticSortNodeArray::GetNew()
 }
 
 
-static StaticSortNodeArray SortNodes;
+// Each sort worker builds its part of the tree in its own pool
+static thread_local StaticSortNodeArray SortNodes;
 
 //==========================================================================
 //
@@ -613,7 +639,7 @@ SortNode * HWDrawList::SortSpriteList(SortNode * head)
 	int count;
 	unsigned i;
 
-	static TArray<SortNode*> sortspritelist;
+	static thread_local TArray<SortNode*> sortspritelist;
 
 	SortNode * parent=head->parent;
 
@@ -701,11 +727,41 @@ SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
 			return SortSpriteList(head);
 		}
 	}
-	if (head->left) head->left=DoSort(di, head->left);
-	if (head->right) head->right=DoSort(di, head->right);
+	if (head->left) SortSubtree(di, head->left);
+	if (head->right) SortSubtree(di, head->right);
 	return sn;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+enum
+{
+	PARALLEL_SORT_MIN_ITEMS = 256,	// Smaller lists are sorted on the main thread
+	PARALLEL_SORT_DEPTH = 3,		// Up to 16 partitions
+	PARALLEL_SORT_MIN_PARTITION = 32,
+};
+
+void HWDrawList::SortSubtree(HWDrawInfo *di, SortNode *&child)
+{
+	if (DeferredSorts != nullptr && SortDepth >= PARALLEL_SORT_DEPTH)
+	{
+		int count = 0;
+		for (SortNode *node = child; node && count < PARALLEL_SORT_MIN_PARTITION; node = node->next) count++;
+		if (count >= PARALLEL_SORT_MIN_PARTITION)
+		{
+			DeferredSorts->Push(&child);
+			return;
+		}
+	}
+
+	SortDepth++;
+	child = DoSort(di, child);
+	SortDepth--;
+}
+
 //==========================================================================
 //
 //
@@ -713,10 +769,189 @@ SortNode * HWDrawList::DoSort(HWDrawInfo *di, SortNode * head)
 //==========================================================================
 void HWDrawList::Sort(HWDrawInfo *di)
 {
+	SortTranslucent.Clock();
 	reverseSort = !!(di->Level->i_compatflags & COMPATF_SPRITESORT);
     SortZ = di->Viewpoint.Pos.Z;
 	MakeSortList();
-	sorted = DoSort(di, SortNodes[SortNodeStart]);
+	SortDepth = 0;
+	if (gl_parallel_sort && gl_multithread && drawitems.Size() >= PARALLEL_SORT_MIN_ITEMS)
+		sorted = SortParallel(di);
+	else
+		sorted = DoSort(di, SortNodes[SortNodeStart]);
+	SortTranslucent.Unclock();
+}
+
+//==========================================================================
+//
+// @Cockatrice - Parallel translucent sort
+//
+// The main thread splits the top levels of the tree. Every subtree below
+// that is independent of the rest, so each one is copied into a list of
+// its own and sorted on a worker with the same code as above. Splits
+// append new items to that list. The result is handed back as a flat
+// array and rebuilt in the main list, so the tree is the same as if it
+// had been sorted in one go.
+//
+//==========================================================================
+
+struct FSortedNode
+{
+	int item, left, equal, right;
+};
+
+struct FSortPartition
+{
+	SortNode **Slot;
+	HWDrawList List;
+	TArray<int> Origin;			// Index in the main list of each item copied into List
+	TArray<FSortedNode> Nodes;	// Sorted subtree, the root comes first
+};
+
+static TDeletingArray<FSortPartition *> SortPartitions;
+
+static int FlattenSortTree(TArray<FSortedNode> &out, SortNode *node)
+{
+	int first = -1, prev = -1;
+	for (; node; node = node->equal)	// Sprite lists can have long equal chains, so don't recurse for those
+	{
+		int index = out.Reserve(1);
+		out[index] = { node->itemindex, -1, -1, -1 };
+		if (prev >= 0) out[prev].equal = index;
+		else first = index;
+		prev = index;
+
+		if (node->left)
+		{
+			int left = FlattenSortTree(out, node->left);
+			out[index].left = left;
+		}
+		if (node->right)
+		{
+			int right = FlattenSortTree(out, node->right);
+			out[index].right = right;
+		}
+	}
+	return first;
+}
+
+SortNode * HWDrawList::SortParallel(HWDrawInfo *di)
+{
+	TArray<SortNode **> deferred;
+	DeferredSorts = &deferred;
+	SortNode *root = DoSort(di, SortNodes[SortNodeStart]);
+	DeferredSorts = nullptr;
+
+	if (deferred.Size() == 0) return root;
+
+	while (SortPartitions.Size() < deferred.Size()) SortPartitions.Push(new FSortPartition);
+
+	auto sortPartition = [this, di](FSortPartition *part)
+	{
+		// Copy the items of the subtree, the main list is only read while the workers run
+		auto &list = part->List;
+		list.reverseSort = reverseSort;
+		list.SortZ = SortZ;
+		for (SortNode *node = *part->Slot; node; node = node->next)
+		{
+			const HWDrawItem &item = drawitems[node->itemindex];
+			part->Origin.Push(node->itemindex);
+			switch (item.rendertype)
+			{
+			case DrawType_WALL:
+				list.drawitems.Push(HWDrawItem(DrawType_WALL, list.walls.Push(walls[item.index])));
+				break;
+			case DrawType_FLAT:
+				list.drawitems.Push(HWDrawItem(DrawType_FLAT, list.flats.Push(flats[item.index])));
+				break;
+			case DrawType_SPRITE:
+				list.drawitems.Push(HWDrawItem(DrawType_SPRITE, list.sprites.Push(sprites[item.index])));
+				break;
+			}
+		}
+
+		list.MakeSortList();
+		list.sorted = list.DoSort(di, SortNodes[list.SortNodeStart]);
+		FlattenSortTree(part->Nodes, list.sorted);
+
+		// The nodes came from this thread's pool
+		SortNodes.Release(list.SortNodeStart);
+		list.sorted = nullptr;
+	};
+
+	unsigned count = deferred.Size();
+	std::atomic<unsigned> next{ 0 };
+	auto work = [&]()
+	{
+		for (unsigned i = next++; i < count; i = next++) sortPartition(SortPartitions[i]);
+	};
+
+	for (unsigned i = 0; i < count; i++) SortPartitions[i]->Slot = deferred[i];
+
+	ParallelSortRunning = true;
+	std::vector<std::future<void>> futures;
+	int helpers = min<int>(count - 1, renderPool.size());
+	for (int i = 0; i < helpers; i++)
+	{
+		futures.push_back(renderPool.push([&](int id) { work(); }));
+	}
+	work();
+	for (auto &future : futures) future.wait();
+	ParallelSortRunning = false;
+
+	// Merge the partitions back in, in order
+	TArray<int> itemmap;
+	TArray<SortNode *> nodes;
+	for (unsigned p = 0; p < count; p++)
+	{
+		auto part = SortPartitions[p];
+		auto &list = part->List;
+
+		itemmap.Resize(list.drawitems.Size());
+		for (unsigned i = 0; i < list.drawitems.Size(); i++)
+		{
+			if (i < part->Origin.Size())
+			{
+				itemmap[i] = part->Origin[i];
+				continue;
+			}
+
+			// An item split off on the worker
+			const HWDrawItem &item = list.drawitems[i];
+			switch (item.rendertype)
+			{
+			case DrawType_WALL:
+				itemmap[i] = drawitems.Push(HWDrawItem(DrawType_WALL, walls.Push(list.walls[item.index])));
+				break;
+			case DrawType_FLAT:
+				itemmap[i] = drawitems.Push(HWDrawItem(DrawType_FLAT, flats.Push(list.flats[item.index])));
+				break;
+			case DrawType_SPRITE:
+				itemmap[i] = drawitems.Push(HWDrawItem(DrawType_SPRITE, sprites.Push(list.sprites[item.index])));
+				break;
+			}
+		}
+
+		nodes.Resize(part->Nodes.Size());
+		for (auto &node : nodes) node = SortNodes.GetNew();
+		for (unsigned i = 0; i < nodes.Size(); i++)
+		{
+			const FSortedNode &sorted = part->Nodes[i];
+			SortNode *node = nodes[i];
+			node->itemindex = itemmap[sorted.item];
+			node->parent = node->next = nullptr;
+			node->left = sorted.left >= 0 ? nodes[sorted.left] : nullptr;
+			node->equal = sorted.equal >= 0 ? nodes[sorted.equal] : nullptr;
+			node->right = sorted.right >= 0 ? nodes[sorted.right] : nullptr;
+		}
+		*part->Slot = nodes[0];
+
+		list.Reset();
+		part->Origin.Clear();
+		part->Nodes.Clear();
+	}
+
+	sort_partitions += count;
+	return root;
 }
 
 //==========================================================================
@@ -763,7 +998,7 @@ void HWDrawList::SortFlats()
 
 HWWall *HWDrawList::NewWall()
 {
-	auto wall = (HWWall*)RenderDataAllocator.Alloc(sizeof(HWWall));
+	auto wall = (HWWall*)AllocRenderData(sizeof(HWWall));
 	drawitems.Push(HWDrawItem(DrawType_WALL, walls.Push(wall)));
 	return wall;
 }
@@ -775,7 +1010,7 @@ HWWall *HWDrawList::NewWall()
 //==========================================================================
 HWFlat *HWDrawList::NewFlat()
 {
-	auto flat = (HWFlat*)RenderDataAllocator.Alloc(sizeof(HWFlat));
+	auto flat = (HWFlat*)AllocRenderData(sizeof(HWFlat));
 	drawitems.Push(HWDrawItem(DrawType_FLAT,flats.Push(flat)));
 	return flat;
 }
@@ -787,7 +1022,7 @@ HWFlat *HWDrawList::NewFlat()
 //==========================================================================
 HWSprite *HWDrawList::NewSprite()
 {	
-	auto sprite = (HWSprite*)RenderDataAllocator.Alloc(sizeof(HWSprite));
+	auto sprite = (HWSprite*)AllocRenderData(sizeof(HWSprite));
 	drawitems.Push(HWDrawItem(DrawType_SPRITE, sprites.Push(sprite)));
 	return sprite;
 }
@@ -4,6 +4,7 @@
 
 extern FMemArena RenderDataAllocator;
 void ResetRenderDataAllocator();
+void *AllocRenderData(size_t size);
 struct HWDrawInfo;
 class HWWall;
 class HWFlat;
@@ -69,6 +70,11 @@ struct HWDrawList
     float SortZ;
 	SortNode * sorted;
 	bool reverseSort;
+
+	// @Cockatrice - While the top of the tree is split up for the parallel sort, subtrees
+	// below a certain depth are collected here instead of being sorted
+	TArray<SortNode **> *DeferredSorts = nullptr;
+	int SortDepth = 0;
 	
 public:
 	HWDrawList()
@@ -107,6 +113,8 @@ public:
 	int CompareSprites(SortNode * a,SortNode * b);
 	SortNode * SortSpriteList(SortNode * head);
 	SortNode * DoSort(HWDrawInfo *di, SortNode * head);
+	void SortSubtree(HWDrawInfo *di, SortNode *&child);
+	SortNode * SortParallel(HWDrawInfo *di);
 	void Sort(HWDrawInfo *di);
 
 	void DoDraw(HWDrawInfo *di, FRenderState &state, bool translucent, int i);
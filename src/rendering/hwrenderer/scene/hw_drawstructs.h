@@ -217,6 +217,7 @@ public:
 	//private:
 
 	void PutWall(HWWallDispatcher* di, bool translucent);
+	bool PrepareWall(HWDrawInfo* di, bool translucent);
 	void PutPortal(HWWallDispatcher* di, int ptype, int plane);
 	void CheckTexturePosition(FTexCoordInfo* tci);
 
@@ -449,6 +450,7 @@ inline float Dist2(float x1,float y1,float x2,float y2)
 
 bool hw_SetPlaneTextureRotation(const HWSectorPlane * secplane, FGameTexture * gltexture, VSMatrix &mat);
 void hw_GetDynModelLight(AActor *self, FDynLightData &modellightdata, double ticFrac = 1.0);
+void hw_BuildLightClusters(FLevelLocals *Level);	// @Cockatrice - Per viewpoint light grid for sprite and model lighting
 LightProbe* FindLightProbe(FLevelLocals* level, float x, float y, float z);
 
 extern const float LARGE_VALUE;
@@ -444,7 +444,8 @@ void HWFlat::Process(HWDrawInfo *di, sector_t * model, int whichplane, bool fog)
 
 	// For hacks this won't go into a render list.
 	PutFlat(di, fog);
-	rendered_flats++;
+	if (isWorkerThread) WorkerCounts.flats++;
+	else rendered_flats++;
 }
 
 //==========================================================================
@@ -196,6 +196,7 @@ void HWDrawInfo::AddOtherCeilingPlane(int sector, gl_subsectorrendernode * node)
 void HWDrawInfo::AddUpperMissingTexture(side_t * side, subsector_t *sub, float Backheight)
 {
 	if (!side->segs[0]->backsector) return;
+	HWWorkerLock lock;	// @Cockatrice - the walls of a subsector may be processed by different workers
 
 	for (int i = 0; i < side->numsegs; i++)
 	{
@@ -255,6 +256,7 @@ void HWDrawInfo::AddLowerMissingTexture(side_t * side, subsector_t *sub, float B
 		// process the missing texture for them.
 		if (backsec->transdoorheight == backsec->GetPlaneTexZ(sector_t::floor)) return;
 	}
+	HWWorkerLock lock;	// @Cockatrice - the walls of a subsector may be processed by different workers
 
 	// we need to check all segs of this sidedef
 	for (int i = 0; i < side->numsegs; i++)
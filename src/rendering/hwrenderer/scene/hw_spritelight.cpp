@@ -37,6 +37,8 @@
 #include "hwrenderer/scene/hw_drawinfo.h"
 #include "hwrenderer/scene/hw_drawstructs.h"
 #include "models.h"
+#include "c_cvars.h"
+#include <float.h>
 #include <cmath>	// needed for std::floor on mac
 
 template<class T>
@@ -103,16 +105,276 @@ LightProbe* FindLightProbe(FLevelLocals* level, float x, float y, float z)
 
 //==========================================================================
 //
-// Sets a single light value from all dynamic lights affecting the specified location
+// @Cockatrice - Light clusters
+//
+// A uniform 3D grid over all active lights, built once per viewpoint.
+// Each cell holds the lights whose sphere bounds overlap it, so sprites,
+// particles and models only look at the lights near their position
+// instead of walking the node lists of their sections. The section
+// links are kept in a hash of (section, light) pairs because a light
+// must still only affect things in sections it was linked to.
 //
 //==========================================================================
 
-void HWDrawInfo::GetDynSpriteLight(AActor *self, float x, float y, float z, FLightNode *node, int portalgroup, float *out)
+CVAR(Bool, gl_lightclusters, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+struct FLightClusters
+{
+	FLevelLocals *Level = nullptr;
+	bool active = false;
+	TArray<FDynamicLight *> lights;
+	double cellsize, cellheight;
+	double originX, originY, originZ;
+	int width, height, depth;
+	TArray<int> cellstart;		// width * height * depth + 1 entries
+	TArray<int> celllights;		// indices into lights
+	TArray<uint64_t> links;		// open addressing, 0 is empty
+	unsigned linkmask;
+
+	int CellX(double x) const { return clamp(int((x - originX) / cellsize), 0, width - 1); }
+	int CellY(double y) const { return clamp(int((y - originY) / cellsize), 0, height - 1); }
+	int CellZ(double z) const { return clamp(int((z - originZ) / cellheight), 0, depth - 1); }
+	int CellIndex(int cx, int cy, int cz) const { return cx + width * (cy + height * cz); }
+
+	static unsigned HashLink(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return (unsigned)key;
+	}
+
+	void AddLink(int section, int light)
+	{
+		uint64_t key = ((uint64_t(section) << 32) | unsigned(light)) + 1;
+		for (unsigned i = HashLink(key) & linkmask;; i = (i + 1) & linkmask)
+		{
+			if (links[i] == key) return;
+			if (links[i] == 0)
+			{
+				links[i] = key;
+				return;
+			}
+		}
+	}
+
+	bool IsLinked(int section, int light) const
+	{
+		uint64_t key = ((uint64_t(section) << 32) | unsigned(light)) + 1;
+		for (unsigned i = HashLink(key) & linkmask;; i = (i + 1) & linkmask)
+		{
+			if (links[i] == key) return true;
+			if (links[i] == 0) return false;
+		}
+	}
+};
+
+static FLightClusters LightClusters;
+
+enum
+{
+	MAX_CLUSTER_AXIS = 128,
+	MAX_CLUSTER_DEPTH = 32,
+	MAX_CLUSTER_CELLS = 64 * 64 * 16,
+};
+
+//==========================================================================
+//
+// Must be called on the main thread before the BSP of the viewpoint is
+// traversed. Levels with portal displacements keep using the node lists
+// because the light positions depend on the group they are seen from.
+//
+//==========================================================================
+
+void hw_BuildLightClusters(FLevelLocals *Level)
+{
+	auto &lc = LightClusters;
+	lc.active = false;
+	lc.Level = Level;
+	lc.lights.Clear();
+	if (!gl_lightclusters || !Level->HasDynamicLights || Level->Displacements.size > 0) return;
+
+	double minX = DBL_MAX, minY = DBL_MAX, minZ = DBL_MAX;
+	double maxX = -DBL_MAX, maxY = -DBL_MAX, maxZ = -DBL_MAX;
+	unsigned numlinks = 0;
+	for (auto light = Level->lights; light; light = light->next)
+	{
+		double radius = light->GetRadius();
+		if (radius <= 0) continue;
+		lc.lights.Push(light);
+		minX = min(minX, light->X() - radius);
+		minY = min(minY, light->Y() - radius);
+		minZ = min(minZ, light->Z() - radius);
+		maxX = max(maxX, light->X() + radius);
+		maxY = max(maxY, light->Y() + radius);
+		maxZ = max(maxZ, light->Z() + radius);
+		for (auto node = light->touching_sector; node; node = node->nextTarget) numlinks++;
+	}
+	if (lc.lights.Size() == 0) return;
+
+	// Start with cells about the size of a typical light and coarsen until the grid fits.
+	double cellsize = 256, cellheight = 256;
+	int width, height, depth;
+	for (;;)
+	{
+		width = int((maxX - minX) / cellsize) + 1;
+		height = int((maxY - minY) / cellsize) + 1;
+		depth = int((maxZ - minZ) / cellheight) + 1;
+		if (depth > MAX_CLUSTER_DEPTH)
+		{
+			cellheight *= 2;
+			continue;
+		}
+		if (width > MAX_CLUSTER_AXIS || height > MAX_CLUSTER_AXIS || width * height * depth > MAX_CLUSTER_CELLS)
+		{
+			cellsize *= 2;
+			continue;
+		}
+		break;
+	}
+	lc.cellsize = cellsize;
+	lc.cellheight = cellheight;
+	lc.originX = minX;
+	lc.originY = minY;
+	lc.originZ = minZ;
+	lc.width = width;
+	lc.height = height;
+	lc.depth = depth;
+
+	// Count the lights per cell, turn the counts into start offsets and fill the cells in a second pass.
+	int numcells = width * height * depth;
+	lc.cellstart.Resize(numcells + 1);
+	memset(lc.cellstart.Data(), 0, (numcells + 1) * sizeof(int));
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (unsigned i = 0; i < lc.lights.Size(); i++)
+		{
+			auto light = lc.lights[i];
+			double radius = light->GetRadius();
+			int x1 = lc.CellX(light->X() - radius), x2 = lc.CellX(light->X() + radius);
+			int y1 = lc.CellY(light->Y() - radius), y2 = lc.CellY(light->Y() + radius);
+			int z1 = lc.CellZ(light->Z() - radius), z2 = lc.CellZ(light->Z() + radius);
+			for (int cz = z1; cz <= z2; cz++)
+			{
+				for (int cy = y1; cy <= y2; cy++)
+				{
+					for (int cx = x1; cx <= x2; cx++)
+					{
+						int cell = lc.CellIndex(cx, cy, cz);
+						if (pass == 0) lc.cellstart[cell + 1]++;
+						else lc.celllights[lc.cellstart[cell]++] = i;
+					}
+				}
+			}
+		}
+		if (pass == 0)
+		{
+			for (int c = 0; c < numcells; c++) lc.cellstart[c + 1] += lc.cellstart[c];
+			lc.celllights.Resize(lc.cellstart[numcells]);
+		}
+		else
+		{
+			// the fill pass advanced every start to the next cell's start.
+			for (int c = numcells; c > 0; c--) lc.cellstart[c] = lc.cellstart[c - 1];
+			lc.cellstart[0] = 0;
+		}
+	}
+
+	unsigned linksize = 64;
+	while (linksize < numlinks * 2) linksize <<= 1;
+	lc.links.Resize(linksize);
+	memset(lc.links.Data(), 0, linksize * sizeof(uint64_t));
+	lc.linkmask = linksize - 1;
+	for (unsigned i = 0; i < lc.lights.Size(); i++)
+	{
+		for (auto node = lc.lights[i]->touching_sector; node; node = node->nextTarget)
+		{
+			lc.AddLink(Level->sections.SectionIndex((FSection *)node->targ), i);
+		}
+	}
+	lc.active = true;
+}
+
+static bool LightClustersActive(FLevelLocals *Level)
+{
+	return LightClusters.active && LightClusters.Level == Level && gl_lightclusters;
+}
+
+//==========================================================================
+//
+// Adds the contribution of a single light to a sprite light value
+//
+//==========================================================================
+
+static void AddDynSpriteLight(FLevelLocals *Level, FDynamicLight *light, AActor *self, float x, float y, float z, int portalgroup, float *out)
 {
-	FDynamicLight *light;
 	float frac, lr, lg, lb;
 	float radius;
-	
+	float dist;
+	FVector3 L;
+
+	// This is a performance critical section of code where we cannot afford to let the compiler decide whether to inline the function or not.
+	// This will do the calculations explicitly rather than calling one of AActor's utility functions.
+	if (Level->Displacements.size > 0)
+	{
+		int fromgroup = light->Sector->PortalGroup;
+		int togroup = portalgroup;
+		if (fromgroup == togroup || fromgroup == 0 || togroup == 0) goto direct;
+
+		DVector2 offset = Level->Displacements.getOffset(fromgroup, togroup);
+		L = FVector3(x - (float)(light->X() + offset.X), y - (float)(light->Y() + offset.Y), z - (float)light->Z());
+	}
+	else
+	{
+	direct:
+		L = FVector3(x - (float)light->X(), y - (float)light->Y(), z - (float)light->Z());
+	}
+
+	dist = (float)L.LengthSquared();
+	radius = light->GetRadius();
+
+	if (dist < radius * radius)
+	{
+		dist = sqrtf(dist);	// only calculate the square root if we really need it.
+
+		frac = 1.0f - (dist / radius);
+
+		if (light->IsSpot())
+		{
+			L *= -1.0f / dist;
+			DAngle negPitch = -*light->pPitch;
+			DAngle Angle = light->target->Angles.Yaw;
+			double xyLen = negPitch.Cos();
+			double spotDirX = -Angle.Cos() * xyLen;
+			double spotDirY = -Angle.Sin() * xyLen;
+			double spotDirZ = -negPitch.Sin();
+			double cosDir = L.X * spotDirX + L.Y * spotDirY + L.Z * spotDirZ;
+			frac *= (float)smoothstep(light->pSpotOuterAngle->Cos(), light->pSpotInnerAngle->Cos(), cosDir);
+		}
+
+		if (frac > 0 && (!light->shadowmapped || (light->GetRadius() > 0 && screen->mShadowMap.ShadowTest(light->Pos, { x, y, z }))))
+		{
+			lr = light->GetRed() / 255.0f;
+			lg = light->GetGreen() / 255.0f;
+			lb = light->GetBlue() / 255.0f;
+			if (light->IsSubtractive())
+			{
+				float bright = (float)FVector3(lr, lg, lb).Length();
+				FVector3 lightColor(lr, lg, lb);
+				lr = (bright - lr) * -1;
+				lg = (bright - lg) * -1;
+				lb = (bright - lb) * -1;
+			}
+
+			out[0] += lr * frac;
+			out[1] += lg * frac;
+			out[2] += lb * frac;
+		}
+	}
+}
+
+static void SetProbeLight(FLevelLocals *Level, float x, float y, float z, float *out)
+{
 	out[0] = out[1] = out[2] = 0.f;
 
 	LightProbe* probe = FindLightProbe(Level, x, y, z);
@@ -122,76 +384,51 @@ void HWDrawInfo::GetDynSpriteLight(AActor *self, float x, float y, float z, FLig
 		out[1] = probe->Green;
 		out[2] = probe->Blue;
 	}
+}
+
+//==========================================================================
+//
+// Sets a single light value from all dynamic lights affecting the specified location
+//
+//==========================================================================
+
+void HWDrawInfo::GetDynSpriteLight(AActor *self, float x, float y, float z, FLightNode *node, int portalgroup, float *out)
+{
+	SetProbeLight(Level, x, y, z, out);
 
 	// Go through both light lists
 	while (node)
 	{
-		light=node->lightsource;
+		FDynamicLight *light = node->lightsource;
 		if (light->ShouldLightActor(self))
 		{
-			float dist;
-			FVector3 L;
-
-			// This is a performance critical section of code where we cannot afford to let the compiler decide whether to inline the function or not.
-			// This will do the calculations explicitly rather than calling one of AActor's utility functions.
-			if (Level->Displacements.size > 0)
-			{
-				int fromgroup = light->Sector->PortalGroup;
-				int togroup = portalgroup;
-				if (fromgroup == togroup || fromgroup == 0 || togroup == 0) goto direct;
-
-				DVector2 offset = Level->Displacements.getOffset(fromgroup, togroup);
-				L = FVector3(x - (float)(light->X() + offset.X), y - (float)(light->Y() + offset.Y), z - (float)light->Z());
-			}
-			else
-			{
-			direct:
-				L = FVector3(x - (float)light->X(), y - (float)light->Y(), z - (float)light->Z());
-			}
-
-			dist = (float)L.LengthSquared();
-			radius = light->GetRadius();
-
-			if (dist < radius * radius)
-			{
-				dist = sqrtf(dist);	// only calculate the square root if we really need it.
-
-				frac = 1.0f - (dist / radius);
+			AddDynSpriteLight(Level, light, self, x, y, z, portalgroup, out);
+		}
+		node = node->nextLight;
+	}
+}
 
-				if (light->IsSpot())
-				{
-					L *= -1.0f / dist;
-					DAngle negPitch = -*light->pPitch;
-					DAngle Angle = light->target->Angles.Yaw;
-					double xyLen = negPitch.Cos();
-					double spotDirX = -Angle.Cos() * xyLen;
-					double spotDirY = -Angle.Sin() * xyLen;
-					double spotDirZ = -negPitch.Sin();
-					double cosDir = L.X * spotDirX + L.Y * spotDirY + L.Z * spotDirZ;
-					frac *= (float)smoothstep(light->pSpotOuterAngle->Cos(), light->pSpotInnerAngle->Cos(), cosDir);
-				}
+//==========================================================================
+//
+// Same as above but only looks at the lights of the cluster containing the location
+//
+//==========================================================================
 
-				if (frac > 0 && (!light->shadowmapped || (light->GetRadius() > 0 && screen->mShadowMap.ShadowTest(light->Pos, { x, y, z }))))
-				{
-					lr = light->GetRed() / 255.0f;
-					lg = light->GetGreen() / 255.0f;
-					lb = light->GetBlue() / 255.0f;
-					if (light->IsSubtractive())
-					{
-						float bright = (float)FVector3(lr, lg, lb).Length();
-						FVector3 lightColor(lr, lg, lb);
-						lr = (bright - lr) * -1;
-						lg = (bright - lg) * -1;
-						lb = (bright - lb) * -1;
-					}
+static void GetClusterSpriteLight(FLevelLocals *Level, AActor *self, float x, float y, float z, FSection *section, int portalgroup, float *out)
+{
+	auto &lc = LightClusters;
+	SetProbeLight(Level, x, y, z, out);
 
-					out[0] += lr * frac;
-					out[1] += lg * frac;
-					out[2] += lb * frac;
-				}
-			}
+	int sectionindex = Level->sections.SectionIndex(section);
+	int cell = lc.CellIndex(lc.CellX(x), lc.CellY(y), lc.CellZ(z));
+	for (int i = lc.cellstart[cell]; i < lc.cellstart[cell + 1]; i++)
+	{
+		int index = lc.celllights[i];
+		FDynamicLight *light = lc.lights[index];
+		if (light->ShouldLightActor(self) && lc.IsLinked(sectionindex, index))
+		{
+			AddDynSpriteLight(Level, light, self, x, y, z, portalgroup, out);
 		}
-		node = node->nextLight;
 	}
 }
 
@@ -199,10 +436,20 @@ void HWDrawInfo::GetDynSpriteLight(AActor *thing, particle_t *particle, float *o
 {
 	if (thing != NULL)
 	{
+		if (LightClustersActive(Level))
+		{
+			GetClusterSpriteLight(Level, thing, (float)thing->X(), (float)thing->Y(), (float)thing->Center(), thing->section, thing->Sector->PortalGroup, out);
+			return;
+		}
 		GetDynSpriteLight(thing, (float)thing->X(), (float)thing->Y(), (float)thing->Center(), thing->section->lighthead, thing->Sector->PortalGroup, out);
 	}
 	else if (particle != NULL)
 	{
+		if (LightClustersActive(Level))
+		{
+			GetClusterSpriteLight(Level, NULL, (float)particle->Pos.X, (float)particle->Pos.Y, (float)particle->Pos.Z, particle->subsector->section, particle->subsector->sector->PortalGroup, out);
+			return;
+		}
 		GetDynSpriteLight(NULL, (float)particle->Pos.X, (float)particle->Pos.Y, (float)particle->Pos.Z, particle->subsector->section->lighthead, particle->subsector->sector->PortalGroup, out);
 	}
 }
@@ -210,12 +457,127 @@ void HWDrawInfo::GetDynSpriteLight(AActor *thing, particle_t *particle, float *o
 // static so that we build up a reserve (memory allocations stop)
 // For multithread processing each worker thread needs its own copy, though.
 static thread_local TArray<FDynamicLight*> addedLightsArray; 
+static thread_local TArray<int> clusterSectionsArray;
+static thread_local TArray<uint32_t> clusterMarksArray;
+static thread_local uint32_t clusterMark;
+
+struct FClusterModelLight
+{
+	double distSquared;
+	int index;
+};
+static thread_local TArray<FClusterModelLight> clusterFoundArray;
+
+//==========================================================================
+//
+// Model lighting through the light clusters. The sections are collected
+// first and the candidate lights of all cells overlapping the actor are
+// tested against them, with a per-thread mark so each light is looked at once.
+//
+// This finds the same lights as the node lists but not in the same order,
+// which matters once a model has more lights than the light buffer takes.
+// They are added nearest first so the ones dropped at the cap are the
+// farthest, rather than whatever came last in the cell walk.
+//
+//==========================================================================
+
+static void GetClusterModelLight(AActor *self, FDynLightData &modellightdata, double ticFrac)
+{
+	auto &lc = LightClusters;
+	auto Level = self->Level;
+	auto &sections = clusterSectionsArray;
+	auto &marks = clusterMarksArray;
+	auto &found = clusterFoundArray;
+
+	float x = (float)self->X();
+	float y = (float)self->Y();
+	float z = (float)self->Center();
+	float actorradius = (float)self->RenderRadius();
+	float radiusSquared = actorradius * actorradius;
+
+	sections.Clear();
+	BSPWalkCircle(Level, x, y, radiusSquared, [&](subsector_t *subsector) // Iterate through all subsectors potentially touched by actor
+	{
+		int index = Level->sections.SectionIndex(subsector->section);
+		if (sections.Find(index) == sections.Size()) sections.Push(index);
+	});
+	if (sections.Size() == 0) return;
+
+	if (marks.Size() < lc.lights.Size())
+	{
+		marks.Resize(lc.lights.Size());
+		memset(marks.Data(), 0, marks.Size() * sizeof(uint32_t));
+	}
+	if (++clusterMark == 0)
+	{
+		memset(marks.Data(), 0, marks.Size() * sizeof(uint32_t));
+		clusterMark = 1;
+	}
+	uint32_t mark = clusterMark;
+
+	found.Clear();
+	int x1 = lc.CellX(x - actorradius), x2 = lc.CellX(x + actorradius);
+	int y1 = lc.CellY(y - actorradius), y2 = lc.CellY(y + actorradius);
+	int z1 = lc.CellZ(z - actorradius), z2 = lc.CellZ(z + actorradius);
+	for (int cz = z1; cz <= z2; cz++)
+	{
+		for (int cy = y1; cy <= y2; cy++)
+		{
+			for (int cx = x1; cx <= x2; cx++)
+			{
+				int cell = lc.CellIndex(cx, cy, cz);
+				for (int i = lc.cellstart[cell]; i < lc.cellstart[cell + 1]; i++)
+				{
+					int index = lc.celllights[i];
+					if (marks[index] == mark) continue;
+					marks[index] = mark;
+
+					FDynamicLight *light = lc.lights[index];
+					if (!light->ShouldLightActor(self)) continue;
+
+					float radius = (float)(light->GetRadius() + actorradius);
+					double dx = light->X() - x;
+					double dy = light->Y() - y;
+					double dz = light->Z() - z;
+					double distSquared = dx * dx + dy * dy + dz * dz;
+					if (distSquared >= radius * radius) continue;
+
+					for (auto section : sections)
+					{
+						if (lc.IsLinked(section, index))
+						{
+							found.Push({ distSquared, index });
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Ties go by light index so the order does not depend on the cell walk
+	std::sort(found.begin(), found.end(), [](const FClusterModelLight &a, const FClusterModelLight &b)
+	{
+		return a.distSquared != b.distSquared ? a.distSquared < b.distSquared : a.index < b.index;
+	});
+
+	// Without displacements every light is in the actor's group.
+	int group = self->Sector->PortalGroup;
+	for (auto &f : found)
+	{
+		AddLightToList(modellightdata, group, lc.lights[f.index], true, ticFrac);
+	}
+}
 
 void hw_GetDynModelLight(AActor *self, FDynLightData &modellightdata, double ticFrac)
 {
 	modellightdata.Clear();
 
-	if (self)
+	if (self && LightClustersActive(self->Level))
+	{
+		GetClusterModelLight(self, modellightdata, ticFrac);
+	}
+	else if (self)
 	{
 		auto &addedLights = addedLightsArray;	// avoid going through the thread local storage for each use.
 
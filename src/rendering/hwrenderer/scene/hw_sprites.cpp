@@ -1014,15 +1014,18 @@ void HWSprite::Process(HWDrawInfo *di, AActor* thing, sector_t * sector, area_t
 			 scaleflags != thing->lastScaleFlags) &&
 			 gl_texture_thread &&
 			 screen->SupportsBackgroundCache()) {
-
+			HWWorkerLock lock;	// @Cockatrice - the background loader may only be fed by one BSP worker at a time
 
 			FMaterial * gltex = FMaterial::ValidateTexture(tex, scaleflags, false);
 			if (!gltex || !gltex->IsHardwareCached(thing->Translation.index())) {
+				double size = max(tex->GetDisplayWidth() * fabs(thing->Scale.X), tex->GetDisplayHeight() * fabs(thing->Scale.Y));
+				float priority = di->BGLoadPriority(thingpos, size);
+
 				if (gltex) {
-					screen->BackgroundCacheMaterial(gltex, thing->Translation, true);
+					screen->BackgroundCacheMaterial(gltex, thing->Translation, true, false, priority);
 				}
 				else {
-					screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, true);
+					screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, true, priority);
 				}
 
 				if (lastPatch.isValid() && scaleflags == thing->lastScaleFlags) {
@@ -1191,7 +1194,9 @@ void HWSprite::Process(HWDrawInfo *di, AActor* thing, sector_t * sector, area_t
 			(spritenum != thing->lastModelSprite || thing->frame != thing->lastModelFrame) &&		// only if this is a new frame or model
 			screen->SupportsBackgroundCache()) {
 
+			HWWorkerLock lock;	// @Cockatrice - the background loader may only be fed by one BSP worker at a time
 			bool success = true;
+			float priority = di->BGLoadPriority(thingpos, max(thing->radius * 2, thing->Height));
 
 			// Verify all model textures are loaded, and if they are not submit and fallback
 			for (int x = modelframe->skinIDs.Size() - 1; x >= 0; x--) {
@@ -1204,10 +1209,10 @@ void HWSprite::Process(HWDrawInfo *di, AActor* thing, sector_t * sector, area_t
 				FMaterial* gltex = FMaterial::ValidateTexture(tex, scaleflags, false);
 				if (!gltex || !gltex->IsHardwareCached(thing->Translation.index())) {
 					if (gltex) {
-						screen->BackgroundCacheMaterial(gltex, thing->Translation, false);
+						screen->BackgroundCacheMaterial(gltex, thing->Translation, false, false, priority);
 					}
 					else {
-						screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, false);
+						screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, false, priority);
 					}
 
 					success = false;
@@ -1225,10 +1230,10 @@ void HWSprite::Process(HWDrawInfo *di, AActor* thing, sector_t * sector, area_t
 				FMaterial* gltex = FMaterial::ValidateTexture(tex, scaleflags, false);
 				if (!gltex || !gltex->IsHardwareCached(thing->Translation.index())) {
 					if (gltex) {
-						screen->BackgroundCacheMaterial(gltex, thing->Translation, false);
+						screen->BackgroundCacheMaterial(gltex, thing->Translation, false, false, priority);
 					}
 					else {
-						screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, false);
+						screen->BackgroundCacheTextureMaterial(tex, thing->Translation, scaleflags, false, priority);
 					}
 
 					success = false;
@@ -1499,7 +1504,8 @@ void HWSprite::Process(HWDrawInfo *di, AActor* thing, sector_t * sector, area_t
 		lightlist = nullptr;
 	}
 	PutSprite(di, hw_styleflags != STYLEHW_Solid, vp.TicFrac);
-	rendered_sprites++;
+	if (isWorkerThread) WorkerCounts.sprites++;
+	else rendered_sprites++;
 }
 
 
@@ -1684,7 +1690,8 @@ void HWSprite::ProcessParticle(HWDrawInfo *di, particle_t *particle, sector_t *s
 		lightlist = nullptr;
 
 	PutSprite(di, hw_styleflags != STYLEHW_Solid, vp.TicFrac);
-	rendered_sprites++;
+	if (isWorkerThread) WorkerCounts.sprites++;
+	else rendered_sprites++;
 }
 
 // [MC] VisualThinkers are to be rendered akin to actor sprites. The reason this whole system
@@ -1771,9 +1778,25 @@ void HWSprite::AdjustVisualThinker(HWDrawInfo* di, DVisualThinker* spr, sector_t
 
 void HWDrawInfo::ProcessActorsInPortal(FLinePortalSpan *glport, area_t in_area)
 {
-	TMap<AActor*, bool> processcheck;
 	if (glport->validcount == validcount) return;	// only process once per frame
 	glport->validcount = validcount;
+
+	// @Cockatrice - This moves the actors temporarily, which other BSP workers may not see while processing the same actors.
+	// The caller holds the worker lock.
+	if (auto output = CurrentWorkerOutput)
+	{
+		auto &deferred = DeferredLinePortals[DeferredLinePortals.Reserve(1)];
+		deferred.glport = glport;
+		deferred.job = output->job;
+		for (int list = 0; list < GLDL_TYPES; list++) deferred.keys[list] = output->NextKey(list) - 1;
+		return;
+	}
+	ProcessLinePortalActors(glport, in_area);
+}
+
+void HWDrawInfo::ProcessLinePortalActors(FLinePortalSpan *glport, area_t in_area)
+{
+	TMap<AActor*, bool> processcheck;
     const auto &vp = Viewpoint;
 	for (auto port : glport->lines)
 	{
@@ -0,0 +1,290 @@
+/*
+** hw_wallcache.cpp
+** @Cockatrice - Keeps the wall setup of unchanged sidedefs across frames
+**
+*/
+
+#include <atomic>
+#include "r_defs.h"
+#include "p_lnspec.h"
+#include "g_levellocals.h"
+#include "texturemanager.h"
+#include "c_cvars.h"
+#include "v_video.h"
+#include "stats.h"
+#include "hw_cvars.h"
+#include "hwrenderer/scene/hw_drawinfo.h"
+#include "hwrenderer/scene/hw_drawstructs.h"
+#include "hw_walldispatcher.h"
+#include "hw_wallcache.h"
+
+CVAR(Bool, gl_wallcache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Int, r_fakecontrast)
+#ifdef NPOT_EMULATION
+EXTERN_CVAR(Bool, hw_npottest)
+#endif
+
+//==========================================================================
+//
+// Everything the recorded walls of a sidedef were built from that may
+// change during play. The sector and side stamps cover offsets, scaling,
+// special colors, glow and TexZ, the rest is compared directly because
+// it also gets written without going through a setter.
+//
+//==========================================================================
+
+struct HWWallCacheEntry
+{
+	seg_t *seg = nullptr;
+	sector_t *front = nullptr, *back = nullptr;
+	secplane_t planes[4];
+	FColormap colormap[2];
+	short lightlevel[2];
+	uint32_t stamps[3];
+	uint32_t lineflags;
+	int linespecial;
+	double linealpha;
+	uint16_t sideflags;
+	FGameTexture *textures[5];
+	bool valid = false;
+	HWMeshHelper mesh;
+};
+
+// Settings the recorded walls depend on that are the same for all sidedefs
+struct HWWallCacheKey
+{
+	FLevelLocals *Level;
+	ELightMode lightmode;
+	int fakecontrast;
+	uint32_t flags, flags2, flags3;
+	int i_compatflags, i_compatflags2, ib_compatflags;
+	int8_t WallHorizLight, WallVertLight;
+	bool seamless;
+	bool npottest;
+	float maskthreshold;	// recorded with the alpha test of masked walls
+
+	bool operator==(const HWWallCacheKey &other) const
+	{
+		return memcmp(this, &other, sizeof(*this)) == 0;
+	}
+};
+
+static TArray<HWWallCacheEntry> WallCache;
+static HWWallCacheKey WallCacheKey;
+static std::atomic<int> WallCacheHits, WallCacheBuilt, WallCacheLive;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void hw_ClearWallCache()
+{
+	WallCache.Reset();
+	memset(&WallCacheKey, 0, sizeof(WallCacheKey));
+}
+
+//==========================================================================
+//
+// Must be called on the main thread before any wall of the pass is
+// processed. Drops all entries if a global setting changed.
+//
+//==========================================================================
+
+void hw_BeginWallCache(HWDrawInfo *di)
+{
+	WallCacheHits = WallCacheBuilt = WallCacheLive = 0;
+	if (!gl_wallcache)
+	{
+		if (WallCache.Size() > 0) hw_ClearWallCache();
+		return;
+	}
+
+	auto Level = di->Level;
+	HWWallCacheKey key;
+	memset(&key, 0, sizeof(key));
+	key.Level = Level;
+	key.lightmode = di->lightmode;
+	key.fakecontrast = r_fakecontrast;
+	key.flags = Level->flags;
+	key.flags2 = Level->flags2;
+	key.flags3 = Level->flags3;
+	key.i_compatflags = Level->i_compatflags;
+	key.i_compatflags2 = Level->i_compatflags2;
+	key.ib_compatflags = Level->ib_compatflags;
+	key.WallHorizLight = Level->WallHorizLight;
+	key.WallVertLight = Level->WallVertLight;
+	key.seamless = gl_seamless;
+#ifdef NPOT_EMULATION
+	key.npottest = hw_npottest;
+#endif
+	key.maskthreshold = gl_mask_threshold;
+
+	if (!(key == WallCacheKey) || WallCache.Size() != Level->sides.Size())
+	{
+		WallCache.Reset();
+		WallCache.Resize(Level->sides.Size());
+		WallCacheKey = key;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static bool IsCacheable(FLevelLocals *Level, seg_t *seg, sector_t *front, sector_t *back)
+{
+	auto side = seg->sidedef;
+	auto line = seg->linedef;
+
+	// polyobjects move, view dependent line types and anything that went through hw_FakeFlat or has 3D floors
+	if (side->Flags & WALLF_POLYOBJ) return false;
+	if (line->special == Line_Horizon || line->special == Line_Mirror || line->isVisualPortal()) return false;
+	if (front != &Level->sectors[front->sectornum] || front->heightsec || front->e->XFloor.ffloors.Size() || front->e->XFloor.lightlist.Size()) return false;
+	if (back && (back != &Level->sectors[back->sectornum] || back->heightsec || back->e->XFloor.ffloors.Size() || back->e->XFloor.lightlist.Size())) return false;
+	return true;
+}
+
+static void FillEntry(HWWallCacheEntry &entry, seg_t *seg, sector_t *front, sector_t *back)
+{
+	auto side = seg->sidedef;
+	entry.seg = seg;
+	entry.front = front;
+	entry.back = back;
+	entry.planes[0] = front->floorplane;
+	entry.planes[1] = front->ceilingplane;
+	entry.colormap[0] = front->Colormap;
+	entry.lightlevel[0] = front->lightlevel;
+	entry.stamps[0] = front->RenderStamp;
+	entry.stamps[1] = side->RenderStamp;
+	if (back)
+	{
+		entry.planes[2] = back->floorplane;
+		entry.planes[3] = back->ceilingplane;
+		entry.colormap[1] = back->Colormap;
+		entry.lightlevel[1] = back->lightlevel;
+		entry.stamps[2] = back->RenderStamp;
+	}
+	entry.lineflags = seg->linedef->flags;
+	entry.linespecial = seg->linedef->special;
+	entry.linealpha = seg->linedef->alpha;
+	entry.sideflags = side->Flags;
+	for (int i = 0; i < 3; i++) entry.textures[i] = TexMan.GetGameTexture(side->GetTexture(i), true);
+	entry.textures[3] = TexMan.GetGameTexture(front->GetTexture(sector_t::floor), true);
+	entry.textures[4] = TexMan.GetGameTexture(front->GetTexture(sector_t::ceiling), true);
+}
+
+static bool CheckEntry(HWWallCacheEntry &entry, seg_t *seg, sector_t *front, sector_t *back)
+{
+	auto side = seg->sidedef;
+	if (!entry.valid || entry.seg != seg || entry.front != front || entry.back != back) return false;
+	if (entry.stamps[0] != front->RenderStamp || entry.stamps[1] != side->RenderStamp) return false;
+	if (!(entry.planes[0] == front->floorplane) || !(entry.planes[1] == front->ceilingplane)) return false;
+	if (!(entry.colormap[0] == front->Colormap) || entry.lightlevel[0] != front->lightlevel) return false;
+	if (back)
+	{
+		if (entry.stamps[2] != back->RenderStamp) return false;
+		if (!(entry.planes[2] == back->floorplane) || !(entry.planes[3] == back->ceilingplane)) return false;
+		if (!(entry.colormap[1] == back->Colormap) || entry.lightlevel[1] != back->lightlevel) return false;
+	}
+	if (entry.lineflags != seg->linedef->flags || entry.linespecial != seg->linedef->special || entry.linealpha != seg->linedef->alpha) return false;
+	if (entry.sideflags != side->Flags) return false;
+	// animated textures
+	for (int i = 0; i < 3; i++)
+	{
+		if (entry.textures[i] != TexMan.GetGameTexture(side->GetTexture(i), true)) return false;
+	}
+	if (entry.textures[3] != TexMan.GetGameTexture(front->GetTexture(sector_t::floor), true)) return false;
+	if (entry.textures[4] != TexMan.GetGameTexture(front->GetTexture(sector_t::ceiling), true)) return false;
+	return true;
+}
+
+//==========================================================================
+//
+// Replaces HWWall::Process for one seg. Each linedef gets processed once
+// per BSP pass so the BSP workers never share an entry.
+//
+//==========================================================================
+
+void hw_ProcessWall(HWDrawInfo *di, HWWall &wall, seg_t *seg, sector_t *frontsector, sector_t *backsector)
+{
+	HWWallDispatcher disp(di);
+	auto side = seg->sidedef;
+
+	if (!gl_wallcache || (unsigned)side->Index() >= WallCache.Size() || di->isFullbrightScene() || !IsCacheable(di->Level, seg, frontsector, backsector))
+	{
+		WallCacheLive++;
+		wall.Process(&disp, seg, frontsector, backsector);
+		return;
+	}
+
+	auto &entry = WallCache[side->Index()];
+	if (!CheckEntry(entry, seg, frontsector, backsector))
+	{
+		auto &mesh = entry.mesh;
+		mesh.list.Clear();
+		mesh.translucent.Clear();
+		mesh.portals.Clear();
+		mesh.lower.Clear();
+		mesh.upper.Clear();
+
+		HWWallDispatcher recorder(di->Level, &mesh, di->lightmode);
+		HWWall rec;
+		rec.sub = wall.sub;
+		rec.Process(&recorder, seg, frontsector, backsector);
+
+		FillEntry(entry, seg, frontsector, backsector);
+		// Portals must be registered with the current view, so these sides always get processed live
+		entry.valid = mesh.portals.Size() == 0;
+		if (!entry.valid)
+		{
+			WallCacheLive++;
+			wall.Process(&disp, seg, frontsector, backsector);
+			return;
+		}
+		WallCacheBuilt++;
+	}
+	else
+	{
+		WallCacheHits++;
+		if (gl_seamless)
+		{
+			// Process does this on its own, the vertex heights are needed for splitting the walls
+			vertex_t *v1 = seg->linedef->v1, *v2 = seg->linedef->v2;
+			if (v1->dirty) v1->RecalcVertexHeights();
+			if (v2->dirty) v2->RecalcVertexHeights();
+		}
+	}
+
+	auto &mesh = entry.mesh;
+	auto sub = wall.sub;
+	for (auto &m : mesh.upper) di->AddUpperMissingTexture(m.side, sub, m.plane);
+	for (auto &m : mesh.lower) di->AddLowerMissingTexture(m.side, sub, m.plane);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		auto &walls = pass == 0 ? mesh.list : mesh.translucent;
+		for (auto &cached : walls)
+		{
+			wall = cached;
+			wall.sub = sub;
+			if (wall.PrepareWall(di, pass == 1)) di->AddWall(&wall);
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+ADD_STAT(wallcache)
+{
+	FString out;
+	out.Format("Wall cache: %d replayed, %d rebuilt, %d processed live, %u entries", WallCacheHits.load(), WallCacheBuilt.load(), WallCacheLive.load(), WallCache.Size());
+	return out;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+struct HWDrawInfo;
+class HWWall;
+struct seg_t;
+struct sector_t;
+
+// @Cockatrice - Wall setup cache
+// HWWall::Process output for a sidedef is recorded once and replayed on later passes until
+// something it was built from changes. Only the view dependent part of PutWall runs on a replay.
+void hw_BeginWallCache(HWDrawInfo *di);
+void hw_ClearWallCache();
+void hw_ProcessWall(HWDrawInfo *di, HWWall &wall, seg_t *seg, sector_t *frontsector, sector_t *backsector);
@@ -497,70 +497,83 @@ const char HWWall::passflag[] = {
 
 //==========================================================================
 //
-// 
+// @Cockatrice - the part of PutWall that depends on the current view.
+// Also used when replaying walls from the wall cache.
+// Returns false if the wall must not be drawn.
 //
 //==========================================================================
-void HWWall::PutWall(HWWallDispatcher *di, bool translucent)
+
+bool HWWall::PrepareWall(HWDrawInfo *ddi, bool translucent)
 {
-	if (texture && texture->GetTranslucency() && passflag[type] == 2)
+	if (translucent)
 	{
-		translucent = true;
+		ViewDistance = (ddi->Viewpoint.Pos - (seg->linedef->v1->fPos() + seg->linedef->Delta() / 2)).XY().LengthSquared();
 	}
 
-	auto ddi = di->di;
-	if (translucent)
+	if (ddi->isFullbrightScene())
 	{
-		flags |= HWF_TRANSLUCENT;
+		// light planes don't get drawn with fullbright rendering
+		if (texture == NULL) return false;
+		Colormap.Clear();
 	}
 
-	if (di->di)
+	if (ddi->isFullbrightScene() || (Colormap.LightColor.isWhite() && lightlevel == 255))
 	{
-		if (translucent)
-		{
-			ViewDistance = (ddi->Viewpoint.Pos - (seg->linedef->v1->fPos() + seg->linedef->Delta() / 2)).XY().LengthSquared();
-		}
+		flags &= ~HWF_GLOW;
+	}
 
-		if (ddi->isFullbrightScene())
+	if (!screen->BuffersArePersistent())
+	{
+		if (ddi->Level->HasDynamicLights && !ddi->isFullbrightScene() && texture != nullptr)
 		{
-			// light planes don't get drawn with fullbright rendering
-			if (texture == NULL) return;
-			Colormap.Clear();
+			SetupLights(ddi, lightdata);
 		}
+		MakeVertices(translucent);
+	}
 
-		if (ddi->isFullbrightScene() || (Colormap.LightColor.isWhite() && lightlevel == 255))
-		{
-			flags &= ~HWF_GLOW;
-		}
 
-		if (!screen->BuffersArePersistent())
+
+	bool solid;
+	if (passflag[type] == 1) solid = true;
+	else if (type == RENDERWALL_FFBLOCK) solid = texture && !texture->isMasked();
+	else solid = false;
+
+	bool hasDecals = solid && seg->sidedef && seg->sidedef->AttachedDecals;
+	if (hasDecals)
+	{
+		// If we want to use the light infos for the decal we cannot delay the creation until the render pass.
+		if (screen->BuffersArePersistent())
 		{
 			if (ddi->Level->HasDynamicLights && !ddi->isFullbrightScene() && texture != nullptr)
 			{
 				SetupLights(ddi, lightdata);
 			}
-			MakeVertices(translucent);
 		}
+		ProcessDecals(ddi);
+	}
+	return true;
+}
 
+//==========================================================================
+//
+// 
+//
+//==========================================================================
+void HWWall::PutWall(HWWallDispatcher *di, bool translucent)
+{
+	if (texture && texture->GetTranslucency() && passflag[type] == 2)
+	{
+		translucent = true;
+	}
 
+	if (translucent)
+	{
+		flags |= HWF_TRANSLUCENT;
+	}
 
-		bool solid;
-		if (passflag[type] == 1) solid = true;
-		else if (type == RENDERWALL_FFBLOCK) solid = texture && !texture->isMasked();
-		else solid = false;
-
-		bool hasDecals = solid && seg->sidedef && seg->sidedef->AttachedDecals;
-		if (hasDecals)
-		{
-			// If we want to use the light infos for the decal we cannot delay the creation until the render pass.
-			if (screen->BuffersArePersistent())
-			{
-				if (ddi->Level->HasDynamicLights && !ddi->isFullbrightScene() && texture != nullptr)
-				{
-					SetupLights(ddi, lightdata);
-				}
-			}
-			ProcessDecals(ddi);
-		}
+	if (di->di)
+	{
+		if (!PrepareWall(di->di, translucent)) return;
 	}
 
 
@@ -587,6 +600,7 @@ void HWWall::PutPortal(HWWallDispatcher *di, int ptype, int plane)
 	if (ddi)
 	{
 		MakeVertices(false);
+		HWWorkerLock lock;	// @Cockatrice - the portal list is shared by all BSP workers
 		switch (ptype)
 		{
 			// portals don't go into the draw list.
@@ -554,17 +554,17 @@ bool HUDSprite::GetWeaponRect(HWDrawInfo *di, DPSprite *psp, float sx, float sy,
 			if (tex2) {
 				int scaleflags2 = CTF_Expand;
 				if (shouldUpscale(tex2, UF_Sprite)) scaleflags2 |= CTF_Upscale;
-				screen->BackgroundCacheTextureMaterial(tex2, psp->Translation, scaleflags2, true);
+				screen->BackgroundCacheTextureMaterial(tex2, psp->Translation, scaleflags2, true, BGLOAD_PRIORITY_HUD_NEXT);
 			}
 		}
 
 		FMaterial * gltex = FMaterial::ValidateTexture(tex, scaleflags, false);
 		if (!gltex || !gltex->IsHardwareCached(psp->Translation.index())) {
 			if (gltex) {
-				screen->BackgroundCacheMaterial(gltex, psp->Translation, true);  // TODO: Prevent calling this every time the sprite wants to render, it's incredibly wasteful
+				screen->BackgroundCacheMaterial(gltex, psp->Translation, true, false, BGLOAD_PRIORITY_HUD);  // TODO: Prevent calling this every time the sprite wants to render, it's incredibly wasteful
 			}
 			else {
-				screen->BackgroundCacheTextureMaterial(tex, psp->Translation, scaleflags, true);
+				screen->BackgroundCacheTextureMaterial(tex, psp->Translation, scaleflags, true, BGLOAD_PRIORITY_HUD);
 			}
 			
 			bool foundNewer = false;
@@ -198,20 +198,20 @@ void FSoftwareRenderer::RenderView(player_t *player, DCanvas *target, void *vide
 	});
 }
 
-void DoWriteSavePic(FileWriter *file, ESSType ssformat, uint8_t *scr, int width, int height, sector_t *viewsector, bool upsidedown);
+void DoWriteSavePic(FPNGImage *pic, ESSType ssformat, uint8_t *scr, int width, int height, sector_t *viewsector, bool upsidedown);
 
-void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int width, int height)
+void FSoftwareRenderer::WriteSavePic (player_t *player, FPNGImage *pic, int width, int height)
 {
-	DCanvas pic(width, height, false);
+	DCanvas canvas(width, height, false);
 
 	// Take a snapshot of the player's view
 	mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
 	mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
-	mScene.RenderViewToCanvas(player->mo, &pic, 0, 0, width, height);
+	mScene.RenderViewToCanvas(player->mo, &canvas, 0, 0, width, height);
 	r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
 	r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
 
-	DoWriteSavePic(file, SS_PAL, pic.GetPixels(), width, height, r_viewpoint.sector, false);
+	DoWriteSavePic(pic, SS_PAL, canvas.GetPixels(), width, height, r_viewpoint.sector, false);
 }
 
 void FSoftwareRenderer::DrawRemainingPlayerSprites()
@@ -1468,6 +1468,36 @@ DEFINE_ACTION_FUNCTION_NATIVE(AActor, CheckSight, P_CheckSight)
 	ACTION_RETURN_BOOL(P_CheckSight(self, target, flags));
 }
 
+// @Cockatrice - Batched sight checks
+static int CheckSightBatch(AActor *self, TArray<AActor *> *targets, TArray<int> *visible, int flags, bool seenby)
+{
+	TArray<uint8_t> results(targets->Size(), true);
+	int count = seenby ? P_CheckSightBatch(targets->Data(), targets->Size(), self, flags, results.Data())
+		: P_CheckSightBatch(self, targets->Data(), targets->Size(), flags, results.Data());
+
+	visible->Resize(results.Size());
+	for (unsigned i = 0; i < results.Size(); i++) (*visible)[i] = results[i];
+	return count;
+}
+
+DEFINE_ACTION_FUNCTION(AActor, CheckSightBatch)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_POINTER(targets, TArray<AActor *>);
+	PARAM_POINTER(visible, TArray<int>);
+	PARAM_INT(flags);
+	ACTION_RETURN_INT(CheckSightBatch(self, targets, visible, flags, false));
+}
+
+DEFINE_ACTION_FUNCTION(AActor, CheckSeenByBatch)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_POINTER(lookers, TArray<AActor *>);
+	PARAM_POINTER(visible, TArray<int>);
+	PARAM_INT(flags);
+	ACTION_RETURN_INT(CheckSightBatch(self, lookers, visible, flags, true));
+}
+
 static void GiveSecret(AActor *self, bool printmessage, bool playsound)
 {
 	P_GiveSecret(self->Level, self, printmessage, playsound, -1);